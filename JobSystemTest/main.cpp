@@ -0,0 +1,324 @@
+#include <iostream>
+#include <stdexcept>
+#include <cstdlib>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../VulkanTest/JobSystem.hpp"
+
+static uint32_t failedChecks = 0;
+
+static void check(bool condition, const std::string& what)
+{
+	if (!condition)
+	{
+		std::cerr << "  FAILED: " << what << std::endl;
+		failedChecks++;
+	}
+}
+
+/****************************************************************************
+ * One job at a time, waited for right away: the owner pops it back while the idle workers try to steal it,
+ * so every round is the race on the deque's last element. Each job must run exactly once.
+ */
+static void testLastElementRace()
+{
+	const uint32_t rounds = 100000;
+	std::vector<std::atomic<uint32_t>> runs(rounds);
+	for (auto& count : runs)
+	{
+		count.store(0, std::memory_order_relaxed);
+	}
+
+	JobSystem jobSystem;
+	jobSystem.init(3);
+
+	std::atomic<uint32_t>* counts = runs.data();
+	for (uint32_t round = 0; round < rounds; round++)
+	{
+		JobSystem::Job* job = jobSystem.createLambdaJob([counts, round]() { counts[round].fetch_add(1, std::memory_order_relaxed); });
+		jobSystem.run(job);
+
+		// Gives the woken workers a varying head start, so the steal lands anywhere in the owner's pop
+		for (uint32_t spin = 0; spin < (round & 63); spin++)
+		{
+			std::this_thread::yield();
+		}
+		jobSystem.wait(job);
+	}
+
+	jobSystem.destroy();
+
+	uint32_t wrongRounds = 0;
+	for (const auto& count : runs)
+	{
+		wrongRounds += count.load(std::memory_order_relaxed) != 1 ? 1 : 0;
+	}
+	check(wrongRounds == 0, std::to_string(wrongRounds) + " jobs didn't run exactly once");
+}
+
+/****************************************************************************
+ * Continuations only start once the ancestor and all its children have finished, and every one of them runs
+ */
+static void testContinuations()
+{
+	const uint32_t rounds = 1000;
+	const uint32_t childCount = 64;
+
+	JobSystem jobSystem;
+	jobSystem.init(3);
+
+	std::atomic<uint32_t> finishedChildren{ 0 };
+	std::atomic<uint32_t> earlyContinuations{ 0 };
+	std::atomic<uint32_t> continuationRuns{ 0 };
+
+	for (uint32_t round = 0; round < rounds; round++)
+	{
+		finishedChildren = 0;
+
+		JobSystem::Job* ancestor = jobSystem.createJob([](JobSystem::Job&) {});
+		for (uint32_t i = 0; i < childCount; i++)
+		{
+			jobSystem.run(jobSystem.createLambdaJob([&finishedChildren]() { finishedChildren.fetch_add(1); }, ancestor));
+		}
+
+		// Parented to a root, so one wait covers all of them
+		JobSystem::Job* root = jobSystem.createJob([](JobSystem::Job&) {});
+		for (uint32_t i = 0; i < JobSystem::maxContinuations; i++)
+		{
+			JobSystem::Job* continuation = jobSystem.createLambdaJob([&]()
+				{
+					earlyContinuations.fetch_add(finishedChildren.load() == childCount ? 0 : 1);
+					continuationRuns.fetch_add(1);
+				}, root);
+			jobSystem.addContinuation(ancestor, continuation);
+		}
+
+		jobSystem.run(ancestor);
+		jobSystem.run(root);
+		jobSystem.wait(root);
+	}
+
+	check(earlyContinuations == 0, std::to_string(earlyContinuations) + " continuations ran before their ancestor's children finished");
+	check(continuationRuns == rounds * JobSystem::maxContinuations, "Not every continuation ran exactly once");
+
+	bool overflowThrew = false;
+	JobSystem::Job* ancestor = jobSystem.createJob([](JobSystem::Job&) {});
+	try
+	{
+		for (uint32_t i = 0; i <= JobSystem::maxContinuations; i++)
+		{
+			jobSystem.addContinuation(ancestor, jobSystem.createJob([](JobSystem::Job&) {}));
+		}
+	}
+	catch (const std::runtime_error&)
+	{
+		overflowThrew = true;
+	}
+	check(overflowThrew, "Adding more than maxContinuations continuations didn't throw");
+
+	jobSystem.destroy();
+}
+
+/****************************************************************************
+ * A tree of jobs that each wait for their children from inside the job. With a single worker every waiting
+ * thread has to keep executing the others' jobs, otherwise the pool deadlocks.
+ */
+struct TreeData
+{
+	JobSystem* system;
+	std::atomic<uint32_t>* leaves;
+	uint32_t depth;
+};
+
+static void treeJob(JobSystem::Job& job)
+{
+	const TreeData& data = JobSystem::getJobData<TreeData>(job);
+	if (data.depth == 0)
+	{
+		data.leaves->fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	TreeData childData = data;
+	childData.depth--;
+
+	JobSystem::Job* children[2];
+	for (JobSystem::Job*& child : children)
+	{
+		child = data.system->createJob(&treeJob, childData, nullptr);
+		data.system->run(child);
+	}
+	for (JobSystem::Job* child : children)
+	{
+		data.system->wait(child);
+	}
+}
+
+static void testWaitInsideJob()
+{
+	const uint32_t depth = 10; // 2047 jobs, within one thread's pool even if one thread creates all of them
+
+	for (uint32_t workerCount : { 1u, 3u })
+	{
+		JobSystem jobSystem;
+		jobSystem.init(workerCount);
+
+		std::atomic<uint32_t> leaves{ 0 };
+		TreeData data = { &jobSystem, &leaves, depth };
+		JobSystem::Job* root = jobSystem.createJob(&treeJob, data, nullptr);
+		jobSystem.run(root);
+		jobSystem.wait(root);
+
+		jobSystem.destroy();
+
+		check(leaves == 1u << depth, "Waiting inside jobs with " + std::to_string(workerCount) + " workers reached "
+			+ std::to_string(leaves) + " leaves instead of " + std::to_string(1u << depth));
+	}
+}
+
+/****************************************************************************
+ * Many times more jobs than a thread's pool holds, while one job created first stays alive the whole time.
+ * The ring has to wrap around past its slot without reusing it. A pool full of live jobs has to throw.
+ */
+static void testPoolWrapAround()
+{
+	const uint32_t poolSize = 4096; // JobSystem::jobPoolSize
+	const uint32_t jobCount = poolSize * 8;
+
+	JobSystem jobSystem;
+	jobSystem.init(3);
+
+	std::atomic<uint32_t> rootRuns{ 0 };
+	std::atomic<uint32_t> jobRuns{ 0 };
+
+	JobSystem::Job* root = jobSystem.createLambdaJob([&rootRuns]() { rootRuns.fetch_add(1); });
+	for (uint32_t i = 0; i < jobCount; i += 256)
+	{
+		JobSystem::Job* batch = jobSystem.createJob([](JobSystem::Job&) {});
+		for (uint32_t j = 0; j < 256; j++)
+		{
+			jobSystem.run(jobSystem.createLambdaJob([&jobRuns]() { jobRuns.fetch_add(1); }, batch));
+		}
+		jobSystem.run(batch);
+		jobSystem.wait(batch);
+	}
+	jobSystem.run(root);
+	jobSystem.wait(root);
+
+	check(jobRuns == jobCount, std::to_string(jobRuns) + " of " + std::to_string(jobCount) + " jobs ran across the pool wrap-around");
+	check(rootRuns == 1, "The job kept alive across the wrap-around ran " + std::to_string(rootRuns) + " times");
+
+	// Created and never run, so none of them ever finishes
+	bool exhaustionThrew = false;
+	try
+	{
+		for (uint32_t i = 0; i <= poolSize; i++)
+		{
+			jobSystem.createJob([](JobSystem::Job&) {});
+		}
+	}
+	catch (const std::runtime_error&)
+	{
+		exhaustionThrew = true;
+	}
+	check(exhaustionThrew, "Creating more live jobs than the pool holds didn't throw");
+
+	jobSystem.destroy();
+}
+
+/****************************************************************************
+ * Attached threads run jobs like the workers, one thread more than there are slots has to be refused
+ */
+static void testAttachThreadOverflow()
+{
+	const uint32_t externalThreads = 2;
+
+	JobSystem jobSystem;
+	jobSystem.init(2, externalThreads);
+
+	std::atomic<uint32_t> refusedThreads{ 0 };
+	std::atomic<uint32_t> wrongSums{ 0 };
+	std::vector<std::thread> threads;
+
+	for (uint32_t i = 0; i < externalThreads + 1; i++)
+	{
+		threads.emplace_back([&]()
+			{
+				try
+				{
+					jobSystem.attachThread();
+				}
+				catch (const std::runtime_error&)
+				{
+					refusedThreads.fetch_add(1);
+					return;
+				}
+
+				std::atomic<uint64_t> sum{ 0 };
+				jobSystem.parallelFor(10000, 100, [&sum](uint32_t begin, uint32_t end)
+					{
+						for (uint32_t k = begin; k < end; k++)
+						{
+							sum.fetch_add(k, std::memory_order_relaxed);
+						}
+					});
+				wrongSums.fetch_add(sum == 10000ull * 9999 / 2 ? 0 : 1);
+			});
+	}
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+
+	jobSystem.destroy();
+
+	check(refusedThreads == 1, std::to_string(refusedThreads) + " threads were refused a slot instead of 1");
+	check(wrongSums == 0, "Attached threads' parallel-for results are wrong");
+}
+
+/****************************************************************************
+ * Tests of the job system, exits with a failure if any check fails:
+ * JobSystemTest
+ */
+int main()
+{
+	struct Test
+	{
+		const char* name;
+		void (*function)();
+	};
+	const Test tests[] =
+	{
+		{ "Pop/steal race on the last job", &testLastElementRace },
+		{ "Continuations", &testContinuations },
+		{ "Waiting inside a job", &testWaitInsideJob },
+		{ "Job pool wrap-around", &testPoolWrapAround },
+		{ "attachThread overflow", &testAttachThreadOverflow },
+	};
+
+	for (const Test& test : tests)
+	{
+		std::cout << test.name << std::endl;
+		try
+		{
+			test.function();
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << "  FAILED: " << e.what() << std::endl;
+			failedChecks++;
+		}
+	}
+
+	if (failedChecks > 0)
+	{
+		std::cerr << failedChecks << " checks failed" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::cout << "All job system tests passed" << std::endl;
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,722 @@
+#include "MeshConverter.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+
+// ==== JSON ====
+
+// Just enough JSON for the glTF document, numbers are kept as doubles
+struct JsonValue
+{
+	enum class Type
+	{
+		Null,
+		Bool,
+		Number,
+		String,
+		Array,
+		Object
+	};
+
+	Type type = Type::Null;
+	bool boolean = false;
+	double number = 0.0;
+	std::string string;
+	std::vector<JsonValue> array;
+	std::map<std::string, JsonValue> object;
+
+	const JsonValue* find(const std::string& key) const
+	{
+		auto found = object.find(key);
+		return found != object.end() ? &found->second : nullptr;
+	}
+
+	double getNumber(const std::string& key, double defaultValue) const
+	{
+		const JsonValue* value = find(key);
+		return value != nullptr && value->type == Type::Number ? value->number : defaultValue;
+	}
+
+	const JsonValue& at(const std::string& key) const
+	{
+		const JsonValue* value = find(key);
+		if (value == nullptr)
+		{
+			throw std::runtime_error("Missing glTF property " + key);
+		}
+		return *value;
+	}
+
+	const JsonValue& at(size_t index) const
+	{
+		if (type != Type::Array || index >= array.size())
+		{
+			throw std::runtime_error("glTF index out of range");
+		}
+		return array[index];
+	}
+};
+
+class JsonParser
+{
+public:
+	JsonParser(const char* begin, const char* end) : current(begin), end(end) {}
+
+	JsonValue parse()
+	{
+		JsonValue value = parseValue();
+		skipWhitespace();
+		return value;
+	}
+
+private:
+	void skipWhitespace()
+	{
+		while (current < end && (*current == ' ' || *current == '\t' || *current == '\n' || *current == '\r'))
+		{
+			current++;
+		}
+	}
+
+	void expect(char c)
+	{
+		skipWhitespace();
+		if (current >= end || *current != c)
+		{
+			throw std::runtime_error(std::string("Malformed glTF JSON, expected ") + c);
+		}
+		current++;
+	}
+
+	bool consumeLiteral(const char* literal)
+	{
+		size_t length = strlen(literal);
+		if (static_cast<size_t>(end - current) >= length && strncmp(current, literal, length) == 0)
+		{
+			current += length;
+			return true;
+		}
+		return false;
+	}
+
+	JsonValue parseValue()
+	{
+		skipWhitespace();
+		if (current >= end)
+		{
+			throw std::runtime_error("Unexpected end of glTF JSON");
+		}
+
+		JsonValue value;
+		if (*current == '{')
+		{
+			value.type = JsonValue::Type::Object;
+			current++;
+			skipWhitespace();
+			if (current < end && *current == '}')
+			{
+				current++;
+				return value;
+			}
+
+			do
+			{
+				skipWhitespace();
+				std::string key = parseString();
+				expect(':');
+				value.object[key] = parseValue();
+				skipWhitespace();
+			} while (current < end && *current++ == ',');
+
+			if (current[-1] != '}')
+			{
+				throw std::runtime_error("Malformed glTF JSON object");
+			}
+		}
+		else if (*current == '[')
+		{
+			value.type = JsonValue::Type::Array;
+			current++;
+			skipWhitespace();
+			if (current < end && *current == ']')
+			{
+				current++;
+				return value;
+			}
+
+			do
+			{
+				value.array.push_back(parseValue());
+				skipWhitespace();
+			} while (current < end && *current++ == ',');
+
+			if (current[-1] != ']')
+			{
+				throw std::runtime_error("Malformed glTF JSON array");
+			}
+		}
+		else if (*current == '"')
+		{
+			value.type = JsonValue::Type::String;
+			value.string = parseString();
+		}
+		else if (consumeLiteral("true") || consumeLiteral("false"))
+		{
+			value.type = JsonValue::Type::Bool;
+			value.boolean = current[-1] == 'e' && current[-2] == 'u';
+		}
+		else if (consumeLiteral("null"))
+		{
+			value.type = JsonValue::Type::Null;
+		}
+		else
+		{
+			char* numberEnd;
+			value.type = JsonValue::Type::Number;
+			value.number = strtod(current, &numberEnd);
+			if (numberEnd == current)
+			{
+				throw std::runtime_error("Malformed glTF JSON value");
+			}
+			current = numberEnd;
+		}
+
+		return value;
+	}
+
+	std::string parseString()
+	{
+		expect('"');
+
+		std::string result;
+		while (current < end && *current != '"')
+		{
+			if (*current == '\\' && current + 1 < end)
+			{
+				current++;
+				switch (*current)
+				{
+				case 'n': result += '\n'; break;
+				case 't': result += '\t'; break;
+				case 'r': result += '\r'; break;
+				case 'b': result += '\b'; break;
+				case 'f': result += '\f'; break;
+				case 'u':
+				{
+					// Only needed for names, anything outside ASCII is replaced
+					unsigned long code = current + 4 < end ? strtoul(std::string(current + 1, current + 5).c_str(), nullptr, 16) : '?';
+					result += code < 0x80 ? static_cast<char>(code) : '?';
+					current += 4;
+					break;
+				}
+				default: result += *current; break;
+				}
+			}
+			else
+			{
+				result += *current;
+			}
+			current++;
+		}
+
+		expect('"');
+		return result;
+	}
+
+	const char* current;
+	const char* end;
+};
+
+
+// ==== BUFFERS ====
+
+static std::vector<uint8_t> readBinaryFile(const std::string& path)
+{
+	std::ifstream file(path, std::ios::ate | std::ios::binary);
+	if (!file.is_open())
+	{
+		throw std::runtime_error("Failed to open file " + path);
+	}
+
+	std::vector<uint8_t> data(static_cast<size_t>(file.tellg()));
+	file.seekg(0);
+	file.read(reinterpret_cast<char*>(data.data()), data.size());
+
+	return data;
+}
+
+static std::vector<uint8_t> decodeBase64(const std::string& text)
+{
+	std::vector<uint8_t> data;
+	uint32_t bits = 0;
+	int bitCount = 0;
+
+	for (char c : text)
+	{
+		int value;
+		if (c >= 'A' && c <= 'Z') value = c - 'A';
+		else if (c >= 'a' && c <= 'z') value = c - 'a' + 26;
+		else if (c >= '0' && c <= '9') value = c - '0' + 52;
+		else if (c == '+') value = 62;
+		else if (c == '/') value = 63;
+		else continue; // Padding
+
+		bits = (bits << 6) | value;
+		bitCount += 6;
+		if (bitCount >= 8)
+		{
+			bitCount -= 8;
+			data.push_back(static_cast<uint8_t>(bits >> bitCount));
+		}
+	}
+
+	return data;
+}
+
+struct GltfDocument
+{
+	JsonValue json;
+	std::vector<std::vector<uint8_t>> buffers;
+};
+
+static void loadDocument(const std::string& path, GltfDocument& document)
+{
+	std::vector<uint8_t> file = readBinaryFile(path);
+	std::vector<uint8_t> binaryChunk;
+
+	const uint32_t glbMagic = 0x46546C67; // "glTF"
+	const uint32_t jsonChunkType = 0x4E4F534A;
+	const uint32_t binaryChunkType = 0x004E4942;
+
+	uint32_t magic = 0;
+	if (file.size() >= 4)
+	{
+		memcpy(&magic, file.data(), 4);
+	}
+
+	if (magic == glbMagic)
+	{
+		// 12 byte header followed by the JSON chunk and an optional binary chunk
+		size_t offset = 12;
+		bool hasJson = false;
+		while (offset + 8 <= file.size())
+		{
+			uint32_t chunkLength, chunkType;
+			memcpy(&chunkLength, &file[offset], 4);
+			memcpy(&chunkType, &file[offset + 4], 4);
+			offset += 8;
+
+			if (offset + chunkLength > file.size())
+			{
+				throw std::runtime_error("Truncated GLB chunk in " + path);
+			}
+
+			if (chunkType == jsonChunkType)
+			{
+				const char* text = reinterpret_cast<const char*>(&file[offset]);
+				document.json = JsonParser(text, text + chunkLength).parse();
+				hasJson = true;
+			}
+			else if (chunkType == binaryChunkType)
+			{
+				binaryChunk.assign(file.begin() + offset, file.begin() + offset + chunkLength);
+			}
+
+			offset += (chunkLength + 3) & ~3u;
+		}
+
+		if (!hasJson)
+		{
+			throw std::runtime_error("GLB file " + path + " has no JSON chunk");
+		}
+	}
+	else
+	{
+		const char* text = reinterpret_cast<const char*>(file.data());
+		document.json = JsonParser(text, text + file.size()).parse();
+	}
+
+	std::string directory = path.substr(0, path.find_last_of("/\\") + 1);
+
+	const JsonValue* buffers = document.json.find("buffers");
+	if (buffers == nullptr)
+	{
+		return;
+	}
+
+	for (const auto& buffer : buffers->array)
+	{
+		const JsonValue* uri = buffer.find("uri");
+		if (uri == nullptr)
+		{
+			document.buffers.push_back(binaryChunk);
+		}
+		else if (uri->string.compare(0, 5, "data:") == 0)
+		{
+			size_t comma = uri->string.find(',');
+			document.buffers.push_back(decodeBase64(uri->string.substr(comma + 1)));
+		}
+		else
+		{
+			document.buffers.push_back(readBinaryFile(directory + uri->string));
+		}
+	}
+}
+
+/****************************************************************************
+ * Reads an accessor into floats, integer components are normalized if the accessor says so
+ */
+static std::vector<float> readAccessor(const GltfDocument& document, size_t accessorIndex, uint32_t& componentCount, size_t& count)
+{
+	const JsonValue& accessor = document.json.at("accessors").at(accessorIndex);
+	if (accessor.find("sparse") != nullptr)
+	{
+		throw std::runtime_error("Sparse glTF accessors aren't supported");
+	}
+
+	static const std::map<std::string, uint32_t> typeComponents = { { "SCALAR", 1 }, { "VEC2", 2 }, { "VEC3", 3 }, { "VEC4", 4 } };
+	componentCount = typeComponents.at(accessor.at("type").string);
+	count = static_cast<size_t>(accessor.at("count").number);
+
+	uint32_t componentType = static_cast<uint32_t>(accessor.at("componentType").number);
+	const JsonValue* normalized = accessor.find("normalized");
+	bool isNormalized = normalized != nullptr && normalized->boolean;
+
+	uint32_t componentSize = componentType == 5126 || componentType == 5125 ? 4 : componentType == 5122 || componentType == 5123 ? 2 : 1;
+
+	std::vector<float> values(count * componentCount, 0.0f);
+	const JsonValue* bufferViewIndex = accessor.find("bufferView");
+	if (bufferViewIndex == nullptr)
+	{
+		return values; // All zeros by definition
+	}
+
+	const JsonValue& bufferView = document.json.at("bufferViews").at(static_cast<size_t>(bufferViewIndex->number));
+	const std::vector<uint8_t>& buffer = document.buffers.at(static_cast<size_t>(bufferView.at("buffer").number));
+
+	size_t offset = static_cast<size_t>(bufferView.getNumber("byteOffset", 0) + accessor.getNumber("byteOffset", 0));
+	size_t stride = static_cast<size_t>(bufferView.getNumber("byteStride", componentSize * componentCount));
+
+	if (count > 0 && offset + (count - 1) * stride + componentSize * componentCount > buffer.size())
+	{
+		throw std::runtime_error("glTF accessor exceeds its buffer");
+	}
+
+	for (size_t i = 0; i < count; i++)
+	{
+		const uint8_t* element = &buffer[offset + i * stride];
+		for (uint32_t c = 0; c < componentCount; c++)
+		{
+			const uint8_t* component = element + c * componentSize;
+			float value = 0.0f;
+
+			switch (componentType)
+			{
+			case 5120: { int8_t v; memcpy(&v, component, 1); value = isNormalized ? std::fmax(v / 127.0f, -1.0f) : v; break; }
+			case 5121: { uint8_t v = *component; value = isNormalized ? v / 255.0f : v; break; }
+			case 5122: { int16_t v; memcpy(&v, component, 2); value = isNormalized ? std::fmax(v / 32767.0f, -1.0f) : v; break; }
+			case 5123: { uint16_t v; memcpy(&v, component, 2); value = isNormalized ? v / 65535.0f : v; break; }
+			case 5125: { uint32_t v; memcpy(&v, component, 4); value = static_cast<float>(v); break; }
+			case 5126: { memcpy(&value, component, 4); break; }
+			default: throw std::runtime_error("Unknown glTF component type");
+			}
+
+			values[i * componentCount + c] = value;
+		}
+	}
+
+	return values;
+}
+
+static std::vector<uint32_t> readIndices(const GltfDocument& document, size_t accessorIndex)
+{
+	// Indices above 2^24 wouldn't survive the float conversion
+	const JsonValue& accessor = document.json.at("accessors").at(accessorIndex);
+	const JsonValue& bufferView = document.json.at("bufferViews").at(static_cast<size_t>(accessor.at("bufferView").number));
+	const std::vector<uint8_t>& buffer = document.buffers.at(static_cast<size_t>(bufferView.at("buffer").number));
+
+	uint32_t componentType = static_cast<uint32_t>(accessor.at("componentType").number);
+	uint32_t componentSize = componentType == 5125 ? 4 : componentType == 5123 ? 2 : 1;
+	size_t count = static_cast<size_t>(accessor.at("count").number);
+	size_t offset = static_cast<size_t>(bufferView.getNumber("byteOffset", 0) + accessor.getNumber("byteOffset", 0));
+
+	if (offset + count * componentSize > buffer.size())
+	{
+		throw std::runtime_error("glTF index accessor exceeds its buffer");
+	}
+
+	std::vector<uint32_t> indices(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		uint32_t index = 0;
+		memcpy(&index, &buffer[offset + i * componentSize], componentSize); // Little endian
+		indices[i] = index;
+	}
+
+	return indices;
+}
+
+
+// ==== SCENE ====
+
+// Column major, like glTF and the shaders
+struct Matrix
+{
+	float m[16];
+
+	static Matrix identity()
+	{
+		Matrix result = {};
+		result.m[0] = result.m[5] = result.m[10] = result.m[15] = 1.0f;
+		return result;
+	}
+
+	Matrix operator*(const Matrix& other) const
+	{
+		Matrix result = {};
+		for (int column = 0; column < 4; column++)
+		{
+			for (int row = 0; row < 4; row++)
+			{
+				for (int k = 0; k < 4; k++)
+				{
+					result.m[column * 4 + row] += m[k * 4 + row] * other.m[column * 4 + k];
+				}
+			}
+		}
+		return result;
+	}
+};
+
+static Matrix getNodeTransform(const JsonValue& node)
+{
+	Matrix result = Matrix::identity();
+
+	if (const JsonValue* matrix = node.find("matrix"))
+	{
+		for (int i = 0; i < 16; i++)
+		{
+			result.m[i] = static_cast<float>(matrix->at(i).number);
+		}
+		return result;
+	}
+
+	// T * R * S
+	float t[3] = { 0.0f, 0.0f, 0.0f };
+	float r[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+	float s[3] = { 1.0f, 1.0f, 1.0f };
+
+	if (const JsonValue* translation = node.find("translation"))
+	{
+		for (int i = 0; i < 3; i++) t[i] = static_cast<float>(translation->at(i).number);
+	}
+	if (const JsonValue* rotation = node.find("rotation"))
+	{
+		for (int i = 0; i < 4; i++) r[i] = static_cast<float>(rotation->at(i).number);
+	}
+	if (const JsonValue* scale = node.find("scale"))
+	{
+		for (int i = 0; i < 3; i++) s[i] = static_cast<float>(scale->at(i).number);
+	}
+
+	float x = r[0], y = r[1], z = r[2], w = r[3];
+	float rotation[9] = {
+		1 - 2 * (y * y + z * z), 2 * (x * y + z * w), 2 * (x * z - y * w),
+		2 * (x * y - z * w), 1 - 2 * (x * x + z * z), 2 * (y * z + x * w),
+		2 * (x * z + y * w), 2 * (y * z - x * w), 1 - 2 * (x * x + y * y)
+	};
+
+	for (int column = 0; column < 3; column++)
+	{
+		for (int row = 0; row < 3; row++)
+		{
+			result.m[column * 4 + row] = rotation[column * 3 + row] * s[column];
+		}
+	}
+	result.m[12] = t[0];
+	result.m[13] = t[1];
+	result.m[14] = t[2];
+
+	return result;
+}
+
+static void appendPrimitive(const GltfDocument& document, const JsonValue& primitive, const Matrix& transform, SourceMesh& mesh)
+{
+	if (primitive.getNumber("mode", 4) != 4)
+	{
+		return; // Only triangle lists
+	}
+
+	const JsonValue& attributes = primitive.at("attributes");
+	uint32_t components;
+	size_t count;
+	std::vector<float> positions = readAccessor(document, static_cast<size_t>(attributes.at("POSITION").number), components, count);
+
+	std::vector<float> normals, texCoords, colors;
+	uint32_t colorComponents = 0;
+	size_t attributeCount;
+	if (const JsonValue* normal = attributes.find("NORMAL"))
+	{
+		normals = readAccessor(document, static_cast<size_t>(normal->number), components, attributeCount);
+	}
+	if (const JsonValue* texCoord = attributes.find("TEXCOORD_0"))
+	{
+		texCoords = readAccessor(document, static_cast<size_t>(texCoord->number), components, attributeCount);
+	}
+	if (const JsonValue* color = attributes.find("COLOR_0"))
+	{
+		colors = readAccessor(document, static_cast<size_t>(color->number), colorComponents, attributeCount);
+	}
+
+	// Normals go through the cofactor matrix, which handles non-uniform scale; a mirroring transform also flips the winding.
+	// Its columns are the cross products of the transform columns.
+	const float* m = transform.m;
+	float cofactor[9] = {
+		m[5] * m[10] - m[6] * m[9], m[6] * m[8] - m[4] * m[10], m[4] * m[9] - m[5] * m[8],
+		m[9] * m[2] - m[10] * m[1], m[10] * m[0] - m[8] * m[2], m[8] * m[1] - m[9] * m[0],
+		m[1] * m[6] - m[2] * m[5], m[2] * m[4] - m[0] * m[6], m[0] * m[5] - m[1] * m[4]
+	};
+	float determinant = m[0] * cofactor[0] + m[1] * cofactor[1] + m[2] * cofactor[2];
+
+	uint32_t baseVertex = static_cast<uint32_t>(mesh.vertices.size());
+	for (size_t i = 0; i < count; i++)
+	{
+		SourceVertex vertex = {};
+		const float* p = &positions[i * 3];
+		for (int row = 0; row < 3; row++)
+		{
+			vertex.position[row] = m[row] * p[0] + m[4 + row] * p[1] + m[8 + row] * p[2] + m[12 + row];
+		}
+
+		if (!normals.empty())
+		{
+			const float* n = &normals[i * 3];
+			float length = 0.0f;
+			for (int row = 0; row < 3; row++)
+			{
+				vertex.normal[row] = cofactor[row] * n[0] + cofactor[3 + row] * n[1] + cofactor[6 + row] * n[2];
+				length += vertex.normal[row] * vertex.normal[row];
+			}
+
+			length = std::sqrt(length);
+			for (int row = 0; row < 3; row++)
+			{
+				vertex.normal[row] = length > 0.0f ? vertex.normal[row] / length : 0.0f;
+			}
+		}
+
+		if (!texCoords.empty())
+		{
+			vertex.texCoord[0] = texCoords[i * 2];
+			vertex.texCoord[1] = texCoords[i * 2 + 1];
+		}
+
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			vertex.color[c] = c < colorComponents ? colors[i * colorComponents + c] : 1.0f;
+		}
+
+		mesh.vertices.push_back(vertex);
+	}
+
+	std::vector<uint32_t> indices;
+	if (const JsonValue* indexAccessor = primitive.find("indices"))
+	{
+		indices = readIndices(document, static_cast<size_t>(indexAccessor->number));
+	}
+	else
+	{
+		for (uint32_t i = 0; i < count; i++)
+		{
+			indices.push_back(i);
+		}
+	}
+
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		if (indices[i] >= count || indices[i + 1] >= count || indices[i + 2] >= count)
+		{
+			throw std::runtime_error("glTF index out of range");
+		}
+
+		if (determinant < 0.0f)
+		{
+			mesh.indices.insert(mesh.indices.end(), { baseVertex + indices[i], baseVertex + indices[i + 2], baseVertex + indices[i + 1] });
+		}
+		else
+		{
+			mesh.indices.insert(mesh.indices.end(), { baseVertex + indices[i], baseVertex + indices[i + 1], baseVertex + indices[i + 2] });
+		}
+	}
+
+	// Flags must hold for the whole mesh, one primitive without normals means generating them for everything
+	bool first = baseVertex == 0;
+	mesh.hasNormals = (first || mesh.hasNormals) && !normals.empty();
+	mesh.hasTexCoords = mesh.hasTexCoords || !texCoords.empty();
+	mesh.hasColors = mesh.hasColors || !colors.empty();
+}
+
+static void appendNode(const GltfDocument& document, size_t nodeIndex, const Matrix& parentTransform, SourceMesh& mesh, uint32_t depth)
+{
+	if (depth > 64)
+	{
+		throw std::runtime_error("glTF node hierarchy is too deep or cyclic");
+	}
+
+	const JsonValue& node = document.json.at("nodes").at(nodeIndex);
+	Matrix transform = parentTransform * getNodeTransform(node);
+
+	if (const JsonValue* meshIndex = node.find("mesh"))
+	{
+		const JsonValue& gltfMesh = document.json.at("meshes").at(static_cast<size_t>(meshIndex->number));
+		for (const auto& primitive : gltfMesh.at("primitives").array)
+		{
+			appendPrimitive(document, primitive, transform, mesh);
+		}
+	}
+
+	if (const JsonValue* children = node.find("children"))
+	{
+		for (const auto& child : children->array)
+		{
+			appendNode(document, static_cast<size_t>(child.number), transform, mesh, depth + 1);
+		}
+	}
+}
+
+/****************************************************************************
+ * glTF 2.0 - every triangle primitive of the default scene, flattened with its node transforms into one mesh.
+ * Materials, skins and morph targets are ignored.
+ */
+void importGltf(const std::string& path, SourceMesh& mesh)
+{
+	GltfDocument document;
+	loadDocument(path, document);
+
+	const JsonValue* scenes = document.json.find("scenes");
+	if (scenes != nullptr && !scenes->array.empty())
+	{
+		const JsonValue& scene = scenes->at(static_cast<size_t>(document.json.getNumber("scene", 0)));
+		if (const JsonValue* nodes = scene.find("nodes"))
+		{
+			for (const auto& node : nodes->array)
+			{
+				appendNode(document, static_cast<size_t>(node.number), Matrix::identity(), mesh, 0);
+			}
+		}
+	}
+	else if (const JsonValue* meshes = document.json.find("meshes"))
+	{
+		// No scene to place the meshes, take them as they are
+		for (const auto& gltfMesh : meshes->array)
+		{
+			for (const auto& primitive : gltfMesh.at("primitives").array)
+			{
+				appendPrimitive(document, primitive, Matrix::identity(), mesh);
+			}
+		}
+	}
+}
@@ -0,0 +1,66 @@
+#ifndef MESH_CONVERTER
+#define MESH_CONVERTER
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../VulkanTest/MeshFormat.hpp"
+
+// Uncompressed vertex every importer produces, packed into the file layout only when writing
+struct SourceVertex
+{
+	float position[3];
+	float normal[3];
+	float texCoord[2];
+	float color[4];
+};
+
+// Simplified level of detail, indexing the same vertices as the full detail mesh
+struct SourceLod
+{
+	std::vector<uint32_t> indices;
+	float error; // Farthest any vertex moved, in mesh units
+};
+
+struct SourceMesh
+{
+	std::vector<SourceVertex> vertices;
+	std::vector<uint32_t> indices; // Triangle list
+	std::vector<SourceLod> lods; // Coarser and coarser, not including the full detail indices
+	bool hasNormals = false;
+	bool hasTexCoords = false;
+	bool hasColors = false;
+};
+
+// ==== IMPORTERS ====
+void importObj(const std::string& path, SourceMesh& mesh);
+void importGltf(const std::string& path, SourceMesh& mesh); // .gltf with external or embedded buffers, or .glb
+
+// ==== PROCESSING ====
+void generateNormals(SourceMesh& mesh);
+MeshBounds computeBounds(const std::vector<SourceVertex>& vertices, const uint32_t* indices, size_t indexCount);
+void buildMeshlets(const SourceMesh& mesh, std::vector<Meshlet>& meshlets, std::vector<uint32_t>& meshletVertices, std::vector<uint8_t>& meshletIndices);
+
+// ==== OPTIMIZATION ====
+struct VertexCacheStatistics
+{
+	uint32_t transformedVertices; // Vertex shader invocations with a FIFO post-transform cache
+	float acmr; // Average transformed vertices per triangle, 0.5 is the ideal for large grids and 3 is the worst
+	float atvr; // Transformed vertices per vertex, 1 is the ideal
+};
+
+void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount);
+void optimizeVertexFetch(SourceMesh& mesh);
+VertexCacheStatistics analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize);
+
+// ==== SIMPLIFICATION ====
+// Must run after optimizeVertexFetch, since the levels refer to the final vertex order
+void buildLods(SourceMesh& mesh);
+
+// ==== WRITER ====
+// Quantized vertices: positions as 16 bit UNORM in the mesh bounds, SNORM8 normals, half float texture coordinates and UNORM8 colors
+uint32_t getVertexStride(const SourceMesh& mesh, bool quantize);
+void writeMeshFile(const std::string& path, const SourceMesh& mesh, bool quantize);
+
+#endif
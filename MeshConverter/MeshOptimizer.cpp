@@ -0,0 +1,216 @@
+#include "MeshConverter.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// Modeled cache for the ordering, larger than the real FIFOs so the order degrades gracefully on smaller ones
+const uint32_t optimizerCacheSize = 32;
+
+static float getVertexScore(int cachePosition, uint32_t remainingTriangles)
+{
+	if (remainingTriangles == 0)
+	{
+		return -1.0f;
+	}
+
+	float score = 0.0f;
+	if (cachePosition >= 0)
+	{
+		// The vertices of the last triangle get a fixed score, so the next triangle doesn't just reuse its edge
+		if (cachePosition < 3)
+		{
+			score = 0.75f;
+		}
+		else
+		{
+			score = std::pow(1.0f - (cachePosition - 3) / static_cast<float>(optimizerCacheSize - 3), 1.5f);
+		}
+	}
+
+	// Vertices with few triangles left are finished first, so they don't have to be transformed again later
+	score += 2.0f * std::pow(static_cast<float>(remainingTriangles), -0.5f);
+
+	return score;
+}
+
+/****************************************************************************
+ * Reorders the triangles for the post-transform vertex cache (Tom Forsyth's linear-speed algorithm).
+ * Triangles are emitted greedily by the score of their vertices, where the score prefers vertices
+ * recently used (still in the modeled LRU cache) and vertices with few remaining triangles.
+ */
+void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount)
+{
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	// Triangle lists per vertex
+	std::vector<uint32_t> remaining(vertexCount, 0);
+	for (uint32_t index : indices)
+	{
+		remaining[index]++;
+	}
+
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		adjacencyOffsets[v + 1] = adjacencyOffsets[v] + remaining[v];
+	}
+
+	std::vector<uint32_t> adjacency(indices.size());
+	std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+	}
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		vertexScore[v] = getVertexScore(-1, remaining[v]);
+	}
+
+	std::vector<float> triangleScore(triangleCount);
+	std::vector<bool> emitted(triangleCount, false);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+	}
+
+	std::vector<uint32_t> cache;
+	std::vector<uint32_t> newCache;
+	cache.reserve(optimizerCacheSize + 3);
+	newCache.reserve(optimizerCacheSize + 3);
+
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+
+	size_t fallbackCursor = 0;
+	int64_t bestTriangle = -1;
+
+	while (result.size() < indices.size())
+	{
+		// Nothing in the cache has triangles left, continue with the next unused triangle in the original order
+		if (bestTriangle < 0)
+		{
+			while (emitted[fallbackCursor])
+			{
+				fallbackCursor++;
+			}
+			bestTriangle = static_cast<int64_t>(fallbackCursor);
+		}
+
+		size_t triangle = static_cast<size_t>(bestTriangle);
+		emitted[triangle] = true;
+
+		// Emitted vertices go to the front of the cache, the rest keeps its order
+		newCache.clear();
+		for (size_t k = 0; k < 3; k++)
+		{
+			uint32_t vertex = indices[triangle * 3 + k];
+			result.push_back(vertex);
+			newCache.push_back(vertex);
+
+			// Drop the triangle from the vertex's list
+			uint32_t* begin = &adjacency[adjacencyOffsets[vertex]];
+			uint32_t* end = begin + remaining[vertex];
+			*std::find(begin, end, static_cast<uint32_t>(triangle)) = end[-1];
+			remaining[vertex]--;
+		}
+
+		for (uint32_t vertex : cache)
+		{
+			if (vertex != newCache[0] && vertex != newCache[1] && vertex != newCache[2])
+			{
+				newCache.push_back(vertex);
+			}
+		}
+
+		// Vertices pushed out of the cache lose their cache score
+		for (size_t i = optimizerCacheSize; i < newCache.size(); i++)
+		{
+			cachePosition[newCache[i]] = -1;
+			vertexScore[newCache[i]] = getVertexScore(-1, remaining[newCache[i]]);
+		}
+		newCache.resize(std::min(newCache.size(), static_cast<size_t>(optimizerCacheSize)));
+		cache.swap(newCache);
+
+		// Rescore the cached vertices and their triangles, picking the best one for the next round
+		for (size_t i = 0; i < cache.size(); i++)
+		{
+			cachePosition[cache[i]] = static_cast<int>(i);
+			vertexScore[cache[i]] = getVertexScore(static_cast<int>(i), remaining[cache[i]]);
+		}
+
+		bestTriangle = -1;
+		float bestScore = -1.0f;
+		for (uint32_t vertex : cache)
+		{
+			for (uint32_t i = 0; i < remaining[vertex]; i++)
+			{
+				uint32_t t = adjacency[adjacencyOffsets[vertex] + i];
+				triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+
+				if (triangleScore[t] > bestScore)
+				{
+					bestScore = triangleScore[t];
+					bestTriangle = t;
+				}
+			}
+		}
+	}
+
+	indices.swap(result);
+}
+
+/****************************************************************************
+ * Renumbers the vertices in the order the indices first use them, so the vertex fetches walk the
+ * vertex buffer mostly forward. Unreferenced vertices are dropped.
+ */
+void optimizeVertexFetch(SourceMesh& mesh)
+{
+	std::vector<uint32_t> remap(mesh.vertices.size(), UINT32_MAX);
+	std::vector<SourceVertex> vertices;
+	vertices.reserve(mesh.vertices.size());
+
+	for (auto& index : mesh.indices)
+	{
+		if (remap[index] == UINT32_MAX)
+		{
+			remap[index] = static_cast<uint32_t>(vertices.size());
+			vertices.push_back(mesh.vertices[index]);
+		}
+		index = remap[index];
+	}
+
+	mesh.vertices.swap(vertices);
+}
+
+/****************************************************************************
+ * Simulates a FIFO post-transform cache, which is how most hardware behaves
+ */
+VertexCacheStatistics analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize)
+{
+	VertexCacheStatistics statistics = {};
+
+	std::vector<uint32_t> insertedAt(vertexCount, 0); // Timestamp when the vertex entered the cache, 0 if never
+	uint32_t timestamp = cacheSize + 1;
+
+	for (uint32_t index : indices)
+	{
+		if (timestamp - insertedAt[index] > cacheSize)
+		{
+			insertedAt[index] = timestamp++;
+			statistics.transformedVertices++;
+		}
+	}
+
+	size_t triangleCount = indices.size() / 3;
+	statistics.acmr = triangleCount > 0 ? statistics.transformedVertices / static_cast<float>(triangleCount) : 0.0f;
+	statistics.atvr = vertexCount > 0 ? statistics.transformedVertices / static_cast<float>(vertexCount) : 0.0f;
+
+	return statistics;
+}
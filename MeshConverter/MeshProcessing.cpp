@@ -0,0 +1,170 @@
+#include "MeshConverter.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+/****************************************************************************
+ * Area weighted vertex normals - the cross product length is twice the triangle area
+ */
+void generateNormals(SourceMesh& mesh)
+{
+	for (auto& vertex : mesh.vertices)
+	{
+		vertex.normal[0] = vertex.normal[1] = vertex.normal[2] = 0.0f;
+	}
+
+	for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+	{
+		SourceVertex& a = mesh.vertices[mesh.indices[i]];
+		SourceVertex& b = mesh.vertices[mesh.indices[i + 1]];
+		SourceVertex& c = mesh.vertices[mesh.indices[i + 2]];
+
+		float ab[3], ac[3];
+		for (int k = 0; k < 3; k++)
+		{
+			ab[k] = b.position[k] - a.position[k];
+			ac[k] = c.position[k] - a.position[k];
+		}
+
+		float normal[3] = {
+			ab[1] * ac[2] - ab[2] * ac[1],
+			ab[2] * ac[0] - ab[0] * ac[2],
+			ab[0] * ac[1] - ab[1] * ac[0]
+		};
+
+		for (int k = 0; k < 3; k++)
+		{
+			a.normal[k] += normal[k];
+			b.normal[k] += normal[k];
+			c.normal[k] += normal[k];
+		}
+	}
+
+	for (auto& vertex : mesh.vertices)
+	{
+		float length = std::sqrt(vertex.normal[0] * vertex.normal[0] + vertex.normal[1] * vertex.normal[1] + vertex.normal[2] * vertex.normal[2]);
+		for (int k = 0; k < 3; k++)
+		{
+			vertex.normal[k] = length > 0.0f ? vertex.normal[k] / length : (k == 1 ? 1.0f : 0.0f);
+		}
+	}
+
+	mesh.hasNormals = true;
+}
+
+/****************************************************************************
+ * Box and bounding sphere of the vertices referenced by the indices.
+ * The sphere is centered in the box, which is loose for irregular shapes, but cheap and stable.
+ */
+MeshBounds computeBounds(const std::vector<SourceVertex>& vertices, const uint32_t* indices, size_t indexCount)
+{
+	MeshBounds bounds = {};
+	if (indexCount == 0)
+	{
+		return bounds;
+	}
+
+	for (int k = 0; k < 3; k++)
+	{
+		bounds.min[k] = bounds.max[k] = vertices[indices[0]].position[k];
+	}
+
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		const float* position = vertices[indices[i]].position;
+		for (int k = 0; k < 3; k++)
+		{
+			bounds.min[k] = std::min(bounds.min[k], position[k]);
+			bounds.max[k] = std::max(bounds.max[k], position[k]);
+		}
+	}
+
+	for (int k = 0; k < 3; k++)
+	{
+		bounds.center[k] = (bounds.min[k] + bounds.max[k]) * 0.5f;
+	}
+
+	float radiusSquared = 0.0f;
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		const float* position = vertices[indices[i]].position;
+		float distanceSquared = 0.0f;
+		for (int k = 0; k < 3; k++)
+		{
+			distanceSquared += (position[k] - bounds.center[k]) * (position[k] - bounds.center[k]);
+		}
+		radiusSquared = std::max(radiusSquared, distanceSquared);
+	}
+	bounds.radius = std::sqrt(radiusSquared);
+
+	return bounds;
+}
+
+/****************************************************************************
+ * Splits the triangle list into meshlets in index order, so the meshlet quality follows the index order.
+ * A meshlet is closed when the next triangle would exceed either the vertex or the triangle limit.
+ */
+void buildMeshlets(const SourceMesh& mesh, std::vector<Meshlet>& meshlets, std::vector<uint32_t>& meshletVertices, std::vector<uint8_t>& meshletIndices)
+{
+	std::vector<uint32_t> localIndex(mesh.vertices.size(), UINT32_MAX);
+	std::vector<uint32_t> meshletTriangleIndices; // Global indices of the current meshlet, for its bounds
+
+	Meshlet meshlet = {};
+
+	auto finishMeshlet = [&]()
+	{
+		if (meshlet.triangleCount == 0)
+		{
+			return;
+		}
+
+		MeshBounds bounds = computeBounds(mesh.vertices, meshletTriangleIndices.data(), meshletTriangleIndices.size());
+		memcpy(meshlet.center, bounds.center, sizeof(meshlet.center));
+		meshlet.radius = bounds.radius;
+		meshlets.push_back(meshlet);
+
+		for (uint32_t i = 0; i < meshlet.vertexCount; i++)
+		{
+			localIndex[meshletVertices[meshlet.vertexOffset + i]] = UINT32_MAX;
+		}
+
+		// Every meshlet starts at a 4 byte boundary, so it can be read in whole words
+		meshletIndices.resize((meshletIndices.size() + 3) & ~static_cast<size_t>(3), 0);
+
+		meshlet = {};
+		meshlet.vertexOffset = static_cast<uint32_t>(meshletVertices.size());
+		meshlet.indexOffset = static_cast<uint32_t>(meshletIndices.size());
+		meshletTriangleIndices.clear();
+	};
+
+	for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+	{
+		uint32_t newVertices = 0;
+		for (size_t k = 0; k < 3; k++)
+		{
+			newVertices += localIndex[mesh.indices[i + k]] == UINT32_MAX ? 1 : 0;
+		}
+
+		if (meshlet.vertexCount + newVertices > meshletMaxVertices || meshlet.triangleCount + 1 > meshletMaxTriangles)
+		{
+			finishMeshlet();
+		}
+
+		for (size_t k = 0; k < 3; k++)
+		{
+			uint32_t index = mesh.indices[i + k];
+			if (localIndex[index] == UINT32_MAX)
+			{
+				localIndex[index] = meshlet.vertexCount++;
+				meshletVertices.push_back(index);
+			}
+
+			meshletIndices.push_back(static_cast<uint8_t>(localIndex[index]));
+			meshletTriangleIndices.push_back(index);
+		}
+		meshlet.triangleCount++;
+	}
+
+	finishMeshlet();
+}
@@ -0,0 +1,159 @@
+#include "MeshConverter.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <unordered_map>
+
+// Levels that don't drop at least this share of the previous level's triangles aren't worth their index data
+const float lodMinReduction = 0.4f;
+// Coarsest level worth having, below this the draw overhead dominates anyway
+const size_t lodMinTriangles = 32;
+
+/****************************************************************************
+ * Vertex clustering: the vertices are snapped to a grid, and every cell keeps the one vertex closest to the average
+ * of its members. Triangles that collapse are dropped, and so are duplicates. Only original vertices are used,
+ * so every level shares the full detail vertex buffer.
+ */
+static void clusterVertices(const SourceMesh& mesh, const MeshBounds& bounds, uint32_t gridSize, SourceLod& lod)
+{
+	float extent = std::max({ bounds.max[0] - bounds.min[0], bounds.max[1] - bounds.min[1], bounds.max[2] - bounds.min[2] });
+	float cellScale = extent > 0.0f ? gridSize / extent : 0.0f;
+
+	struct Cell
+	{
+		float sum[3];
+		uint32_t count;
+		uint32_t representative;
+		float representativeDistance;
+	};
+
+	std::unordered_map<uint64_t, uint32_t> cellIndices;
+	std::vector<Cell> cells;
+	std::vector<uint32_t> vertexCells(mesh.vertices.size());
+
+	for (size_t v = 0; v < mesh.vertices.size(); v++)
+	{
+		const float* position = mesh.vertices[v].position;
+
+		uint64_t key = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			uint64_t cell = static_cast<uint64_t>(std::min(std::max((position[k] - bounds.min[k]) * cellScale, 0.0f), static_cast<float>(gridSize - 1)));
+			key = key * gridSize + cell;
+		}
+
+		auto inserted = cellIndices.emplace(key, static_cast<uint32_t>(cells.size()));
+		if (inserted.second)
+		{
+			cells.push_back({ { 0.0f, 0.0f, 0.0f }, 0, 0, INFINITY });
+		}
+
+		Cell& cell = cells[inserted.first->second];
+		for (int k = 0; k < 3; k++)
+		{
+			cell.sum[k] += position[k];
+		}
+		cell.count++;
+		vertexCells[v] = inserted.first->second;
+	}
+
+	for (size_t v = 0; v < mesh.vertices.size(); v++)
+	{
+		Cell& cell = cells[vertexCells[v]];
+		float distance = 0.0f;
+		for (int k = 0; k < 3; k++)
+		{
+			float delta = mesh.vertices[v].position[k] - cell.sum[k] / cell.count;
+			distance += delta * delta;
+		}
+
+		if (distance < cell.representativeDistance)
+		{
+			cell.representative = static_cast<uint32_t>(v);
+			cell.representativeDistance = distance;
+		}
+	}
+
+	// Only vertices the triangles use count towards the error
+	float errorSquared = 0.0f;
+	for (uint32_t index : mesh.indices)
+	{
+		const float* position = mesh.vertices[index].position;
+		const float* representative = mesh.vertices[cells[vertexCells[index]].representative].position;
+		float distance = 0.0f;
+		for (int k = 0; k < 3; k++)
+		{
+			distance += (position[k] - representative[k]) * (position[k] - representative[k]);
+		}
+		errorSquared = std::max(errorSquared, distance);
+	}
+	lod.error = std::sqrt(errorSquared);
+
+	// Rotated so the smallest index comes first, which keeps the winding and makes duplicates compare equal
+	std::vector<std::array<uint32_t, 3>> triangles;
+	for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+	{
+		std::array<uint32_t, 3> triangle;
+		for (int k = 0; k < 3; k++)
+		{
+			triangle[k] = cells[vertexCells[mesh.indices[i + k]]].representative;
+		}
+
+		if (triangle[0] == triangle[1] || triangle[1] == triangle[2] || triangle[0] == triangle[2])
+		{
+			continue;
+		}
+
+		while (triangle[0] > triangle[1] || triangle[0] > triangle[2])
+		{
+			triangle = { triangle[1], triangle[2], triangle[0] };
+		}
+		triangles.push_back(triangle);
+	}
+
+	std::sort(triangles.begin(), triangles.end());
+	triangles.erase(std::unique(triangles.begin(), triangles.end()), triangles.end());
+
+	lod.indices.clear();
+	for (const auto& triangle : triangles)
+	{
+		lod.indices.insert(lod.indices.end(), triangle.begin(), triangle.end());
+	}
+}
+
+/****************************************************************************
+ * Halves the clustering grid until the triangle count drops enough for a new level, as long as levels are left
+ */
+void buildLods(SourceMesh& mesh)
+{
+	mesh.lods.clear();
+
+	MeshBounds bounds = computeBounds(mesh.vertices, mesh.indices.data(), mesh.indices.size());
+	size_t previousTriangles = mesh.indices.size() / 3;
+	float previousError = 0.0f;
+
+	for (uint32_t gridSize = 1024; gridSize >= 2 && mesh.lods.size() + 1 < meshMaxLods && previousTriangles > lodMinTriangles; gridSize /= 2)
+	{
+		SourceLod lod;
+		clusterVertices(mesh, bounds, gridSize, lod);
+
+		size_t triangles = lod.indices.size() / 3;
+		if (triangles == 0)
+		{
+			break;
+		}
+		if (triangles > previousTriangles * (1.0f - lodMinReduction))
+		{
+			continue;
+		}
+
+		// The runtime selection relies on the error growing with every level
+		lod.error = std::max(lod.error, previousError);
+		optimizeVertexCache(lod.indices, mesh.vertices.size());
+
+		previousTriangles = triangles;
+		previousError = lod.error;
+		mesh.lods.push_back(std::move(lod));
+	}
+}
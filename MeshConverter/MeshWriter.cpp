@@ -0,0 +1,218 @@
+#include "MeshConverter.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+static void writeStream(std::ofstream& file, uint64_t offset, const void* data, size_t size)
+{
+	// Zero padding up to the aligned stream start
+	static const char padding[meshStreamAlignment] = {};
+	uint64_t position = static_cast<uint64_t>(file.tellp());
+	file.write(padding, static_cast<std::streamsize>(offset - position));
+
+	file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+}
+
+static uint16_t floatToHalf(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, 4);
+
+	uint32_t sign = (bits >> 16) & 0x8000;
+	int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xFF) - 127 + 15;
+	uint32_t mantissa = bits & 0x7FFFFF;
+
+	if (exponent >= 31)
+	{
+		return static_cast<uint16_t>(sign | 0x7C00 | (((bits >> 23) & 0xFF) == 0xFF && mantissa ? 0x200 : 0)); // Inf or NaN
+	}
+	if (exponent <= 0)
+	{
+		if (exponent < -10)
+		{
+			return static_cast<uint16_t>(sign);
+		}
+
+		// Denormal, round to nearest
+		mantissa |= 0x800000;
+		uint32_t shift = static_cast<uint32_t>(14 - exponent);
+		return static_cast<uint16_t>(sign | ((mantissa + (1u << (shift - 1))) >> shift));
+	}
+
+	// Rounding may carry into the exponent, which is still the right result
+	return static_cast<uint16_t>(sign | ((static_cast<uint32_t>(exponent) << 10) + ((mantissa + 0x1000) >> 13)));
+}
+
+static int8_t floatToSnorm8(float value)
+{
+	return static_cast<int8_t>(std::lround(std::fmax(-1.0f, std::fmin(1.0f, value)) * 127.0f));
+}
+
+static uint8_t floatToUnorm8(float value)
+{
+	return static_cast<uint8_t>(std::lround(std::fmax(0.0f, std::fmin(1.0f, value)) * 255.0f));
+}
+
+uint32_t getVertexStride(const SourceMesh& mesh, bool quantize)
+{
+	if (quantize)
+	{
+		return mesh.hasColors ? 20 : 16;
+	}
+	return mesh.hasColors ? 48 : 32;
+}
+
+/****************************************************************************
+ * Vertices are stored either as 32 bit floats, or quantized. The color is only stored if the source had one.
+ */
+static void packVertices(const SourceMesh& mesh, bool quantize, MeshFileHeader& header, std::vector<uint8_t>& vertexData)
+{
+	uint32_t stride = getVertexStride(mesh, quantize);
+	header.vertexStride = stride;
+	vertexData.assign(mesh.vertices.size() * stride, 0);
+
+	MeshAttributeDesc* attributes = header.attributes;
+
+	if (!quantize)
+	{
+		attributes[static_cast<uint32_t>(MeshAttribute::Position)] = { MeshAttributeFormat::Float3, 0 };
+		attributes[static_cast<uint32_t>(MeshAttribute::Normal)] = { MeshAttributeFormat::Float3, 12 };
+		attributes[static_cast<uint32_t>(MeshAttribute::TexCoord)] = { MeshAttributeFormat::Float2, 24 };
+		attributes[static_cast<uint32_t>(MeshAttribute::Color)] = { mesh.hasColors ? MeshAttributeFormat::Float4 : MeshAttributeFormat::None, 32 };
+
+		for (size_t i = 0; i < mesh.vertices.size(); i++)
+		{
+			// SourceVertex starts with exactly this layout
+			memcpy(&vertexData[i * stride], &mesh.vertices[i], stride);
+		}
+
+		for (int k = 0; k < 3; k++)
+		{
+			header.positionScale[k] = 1.0f;
+			header.positionOffset[k] = 0.0f;
+		}
+		return;
+	}
+
+	attributes[static_cast<uint32_t>(MeshAttribute::Position)] = { MeshAttributeFormat::Unorm16x4, 0 };
+	attributes[static_cast<uint32_t>(MeshAttribute::Normal)] = { MeshAttributeFormat::Snorm8x4, 8 };
+	attributes[static_cast<uint32_t>(MeshAttribute::TexCoord)] = { MeshAttributeFormat::Half2, 12 };
+	attributes[static_cast<uint32_t>(MeshAttribute::Color)] = { mesh.hasColors ? MeshAttributeFormat::Unorm8x4 : MeshAttributeFormat::None, 16 };
+
+	// Positions are stored relative to the bounding box, which keeps the full 16 bit precision for the mesh extent
+	const MeshBounds& bounds = header.bounds;
+	for (int k = 0; k < 3; k++)
+	{
+		header.positionScale[k] = (bounds.max[k] - bounds.min[k]) / 65535.0f;
+		header.positionOffset[k] = bounds.min[k];
+	}
+
+	for (size_t i = 0; i < mesh.vertices.size(); i++)
+	{
+		const SourceVertex& vertex = mesh.vertices[i];
+		uint8_t* output = &vertexData[i * stride];
+
+		uint16_t position[4] = {};
+		int8_t normal[4] = {};
+		for (int k = 0; k < 3; k++)
+		{
+			float extent = bounds.max[k] - bounds.min[k];
+			float normalized = extent > 0.0f ? (vertex.position[k] - bounds.min[k]) / extent : 0.0f;
+			position[k] = static_cast<uint16_t>(std::lround(std::fmax(0.0f, std::fmin(1.0f, normalized)) * 65535.0f));
+			normal[k] = floatToSnorm8(vertex.normal[k]);
+		}
+
+		uint16_t texCoord[2] = { floatToHalf(vertex.texCoord[0]), floatToHalf(vertex.texCoord[1]) };
+
+		memcpy(output, position, 8);
+		memcpy(output + 8, normal, 4);
+		memcpy(output + 12, texCoord, 4);
+
+		if (mesh.hasColors)
+		{
+			uint8_t color[4] = { floatToUnorm8(vertex.color[0]), floatToUnorm8(vertex.color[1]), floatToUnorm8(vertex.color[2]), floatToUnorm8(vertex.color[3]) };
+			memcpy(output + 16, color, 4);
+		}
+	}
+}
+
+void writeMeshFile(const std::string& path, const SourceMesh& mesh, bool quantize)
+{
+	MeshFileHeader header = {};
+	header.magic = meshFileMagic;
+	header.version = meshFileVersion;
+
+	// Quantization is relative to the bounds, so they go first
+	header.bounds = computeBounds(mesh.vertices, mesh.indices.data(), mesh.indices.size());
+
+	std::vector<uint8_t> vertexData;
+	header.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+	packVertices(mesh, quantize, header, vertexData);
+
+	// Every level of detail goes into the one index stream, full detail first
+	std::vector<uint32_t> indices = mesh.indices;
+	header.lodCount = static_cast<uint32_t>(std::min<size_t>(mesh.lods.size() + 1, meshMaxLods));
+	header.lods[0] = { 0, static_cast<uint32_t>(mesh.indices.size()), 0.0f, 0 };
+	for (uint32_t i = 1; i < header.lodCount; i++)
+	{
+		const SourceLod& lod = mesh.lods[i - 1];
+		header.lods[i] = { static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(lod.indices.size()), lod.error, 0 };
+		indices.insert(indices.end(), lod.indices.begin(), lod.indices.end());
+	}
+
+	// 16 bit indices whenever every vertex can be addressed with them
+	std::vector<uint8_t> indexData;
+	header.indexCount = static_cast<uint32_t>(indices.size());
+	header.indexSize = mesh.vertices.size() <= 65536 ? 2 : 4;
+	indexData.resize(indices.size() * header.indexSize);
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		if (header.indexSize == 2)
+		{
+			uint16_t index = static_cast<uint16_t>(indices[i]);
+			memcpy(&indexData[i * 2], &index, 2);
+		}
+		else
+		{
+			memcpy(&indexData[i * 4], &indices[i], 4);
+		}
+	}
+
+	std::vector<Meshlet> meshlets;
+	std::vector<uint32_t> meshletVertices;
+	std::vector<uint8_t> meshletIndices;
+	buildMeshlets(mesh, meshlets, meshletVertices, meshletIndices);
+
+	header.meshletCount = static_cast<uint32_t>(meshlets.size());
+	header.meshletVertexCount = static_cast<uint32_t>(meshletVertices.size());
+	header.meshletIndexSize = static_cast<uint32_t>(meshletIndices.size());
+
+	// The index stream must directly follow the vertex stream, the loader stages both with one copy
+	header.vertexOffset = alignMeshStream(sizeof(MeshFileHeader));
+	header.indexOffset = alignMeshStream(header.vertexOffset + vertexData.size());
+	header.meshletOffset = alignMeshStream(header.indexOffset + indexData.size());
+	header.meshletVertexOffset = alignMeshStream(header.meshletOffset + meshlets.size() * sizeof(Meshlet));
+	header.meshletIndexOffset = alignMeshStream(header.meshletVertexOffset + meshletVertices.size() * sizeof(uint32_t));
+	header.fileSize = header.meshletIndexOffset + meshletIndices.size();
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		throw std::runtime_error("Failed to create file " + path);
+	}
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	writeStream(file, header.vertexOffset, vertexData.data(), vertexData.size());
+	writeStream(file, header.indexOffset, indexData.data(), indexData.size());
+	writeStream(file, header.meshletOffset, meshlets.data(), meshlets.size() * sizeof(Meshlet));
+	writeStream(file, header.meshletVertexOffset, meshletVertices.data(), meshletVertices.size() * sizeof(uint32_t));
+	writeStream(file, header.meshletIndexOffset, meshletIndices.data(), meshletIndices.size());
+
+	if (!file)
+	{
+		throw std::runtime_error("Failed to write file " + path);
+	}
+}
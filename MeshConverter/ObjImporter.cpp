@@ -0,0 +1,177 @@
+#include "MeshConverter.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+struct ObjIndex
+{
+	int position;
+	int texCoord;
+	int normal;
+
+	bool operator==(const ObjIndex& other) const
+	{
+		return position == other.position && texCoord == other.texCoord && normal == other.normal;
+	}
+};
+
+struct ObjIndexHash
+{
+	size_t operator()(const ObjIndex& index) const
+	{
+		return (static_cast<size_t>(index.position) * 73856093) ^ (static_cast<size_t>(index.texCoord) * 19349663) ^ (static_cast<size_t>(index.normal) * 83492791);
+	}
+};
+
+// OBJ indices start at 1 and negative ones count back from the last element
+static int resolveIndex(int index, size_t count)
+{
+	return index < 0 ? static_cast<int>(count) + index : index - 1;
+}
+
+static ObjIndex parseFaceVertex(const std::string& token, size_t positionCount, size_t texCoordCount, size_t normalCount)
+{
+	ObjIndex index = { -1, -1, -1 };
+
+	// v, v/vt, v//vn or v/vt/vn
+	size_t firstSlash = token.find('/');
+	index.position = resolveIndex(std::stoi(token.substr(0, firstSlash)), positionCount);
+
+	if (firstSlash != std::string::npos)
+	{
+		size_t secondSlash = token.find('/', firstSlash + 1);
+		std::string texCoord = token.substr(firstSlash + 1, secondSlash == std::string::npos ? std::string::npos : secondSlash - firstSlash - 1);
+
+		if (!texCoord.empty())
+		{
+			index.texCoord = resolveIndex(std::stoi(texCoord), texCoordCount);
+		}
+		if (secondSlash != std::string::npos && secondSlash + 1 < token.size())
+		{
+			index.normal = resolveIndex(std::stoi(token.substr(secondSlash + 1)), normalCount);
+		}
+	}
+
+	return index;
+}
+
+/****************************************************************************
+ * Wavefront OBJ - positions (with the optional vertex color extension), texture coordinates, normals and
+ * polygonal faces, which are triangulated as fans. Groups, objects and materials are merged into one mesh.
+ */
+void importObj(const std::string& path, SourceMesh& mesh)
+{
+	std::ifstream file(path);
+	if (!file.is_open())
+	{
+		throw std::runtime_error("Failed to open file " + path);
+	}
+
+	std::vector<float> positions;
+	std::vector<float> colors;
+	std::vector<float> texCoords;
+	std::vector<float> normals;
+	std::unordered_map<ObjIndex, uint32_t, ObjIndexHash> vertexMap;
+
+	std::string line;
+	std::vector<uint32_t> polygon;
+	while (std::getline(file, line))
+	{
+		std::istringstream stream(line);
+		std::string type;
+		stream >> type;
+
+		if (type == "v")
+		{
+			float x = 0.0f, y = 0.0f, z = 0.0f;
+			stream >> x >> y >> z;
+			positions.insert(positions.end(), { x, y, z });
+
+			float r, g, b;
+			if (stream >> r >> g >> b)
+			{
+				colors.insert(colors.end(), { r, g, b });
+				mesh.hasColors = true;
+			}
+			else
+			{
+				colors.insert(colors.end(), { 1.0f, 1.0f, 1.0f });
+			}
+		}
+		else if (type == "vt")
+		{
+			float u = 0.0f, v = 0.0f;
+			stream >> u >> v;
+			// OBJ puts the origin at the bottom left, Vulkan samples from the top left
+			texCoords.insert(texCoords.end(), { u, 1.0f - v });
+		}
+		else if (type == "vn")
+		{
+			float x = 0.0f, y = 0.0f, z = 0.0f;
+			stream >> x >> y >> z;
+			normals.insert(normals.end(), { x, y, z });
+		}
+		else if (type == "f")
+		{
+			polygon.clear();
+
+			std::string token;
+			while (stream >> token)
+			{
+				ObjIndex index = parseFaceVertex(token, positions.size() / 3, texCoords.size() / 2, normals.size() / 3);
+				if (index.position < 0 || static_cast<size_t>(index.position) >= positions.size() / 3)
+				{
+					throw std::runtime_error("Invalid face index in " + path + ": " + line);
+				}
+
+				auto found = vertexMap.find(index);
+				if (found != vertexMap.end())
+				{
+					polygon.push_back(found->second);
+					continue;
+				}
+
+				SourceVertex vertex = {};
+				for (int i = 0; i < 3; i++)
+				{
+					vertex.position[i] = positions[index.position * 3 + i];
+					vertex.color[i] = colors[index.position * 3 + i];
+				}
+				vertex.color[3] = 1.0f;
+
+				if (index.texCoord >= 0 && static_cast<size_t>(index.texCoord) < texCoords.size() / 2)
+				{
+					vertex.texCoord[0] = texCoords[index.texCoord * 2];
+					vertex.texCoord[1] = texCoords[index.texCoord * 2 + 1];
+					mesh.hasTexCoords = true;
+				}
+				if (index.normal >= 0 && static_cast<size_t>(index.normal) < normals.size() / 3)
+				{
+					for (int i = 0; i < 3; i++)
+					{
+						vertex.normal[i] = normals[index.normal * 3 + i];
+					}
+				}
+
+				uint32_t vertexIndex = static_cast<uint32_t>(mesh.vertices.size());
+				mesh.vertices.push_back(vertex);
+				vertexMap[index] = vertexIndex;
+				polygon.push_back(vertexIndex);
+			}
+
+			for (size_t i = 2; i < polygon.size(); i++)
+			{
+				mesh.indices.insert(mesh.indices.end(), { polygon[0], polygon[i - 1], polygon[i] });
+			}
+		}
+	}
+
+	// Normals are only used if every vertex has one, otherwise they're all generated
+	mesh.hasNormals = !normals.empty();
+	for (const auto& entry : vertexMap)
+	{
+		mesh.hasNormals = mesh.hasNormals && entry.first.normal >= 0;
+	}
+}
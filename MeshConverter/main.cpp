@@ -0,0 +1,136 @@
+#include <iostream>
+#include <stdexcept>
+#include <cstdlib>
+#include <algorithm>
+#include <vector>
+
+#include "MeshConverter.hpp"
+
+/****************************************************************************
+ * Estimated vertex bandwidth of one draw of the mesh with the given vertex format:
+ * every vertex shader invocation fetches a whole vertex, plus the index buffer is read once
+ */
+static void printBandwidth(const char* name, const SourceMesh& mesh, const VertexCacheStatistics& cache, bool quantize)
+{
+	uint32_t stride = getVertexStride(mesh, quantize);
+	uint32_t indexSize = mesh.vertices.size() <= 65536 ? 2 : 4;
+	uint64_t vertexBytes = static_cast<uint64_t>(cache.transformedVertices) * stride;
+	uint64_t indexBytes = static_cast<uint64_t>(mesh.indices.size()) * indexSize;
+
+	std::cout << "  " << name << ": " << stride << " byte vertices, " << mesh.vertices.size() * stride << " byte vertex buffer, "
+		<< vertexBytes + indexBytes << " bytes fetched per draw" << std::endl;
+}
+
+/****************************************************************************
+ * Offline converter into the memory mappable mesh format:
+ * MeshConverter [--quantize] [--no-optimize] [--no-lods] <input.obj|input.gltf|input.glb> <output.mesh>
+ */
+int main(int argc, char** argv)
+{
+	bool quantize = false;
+	bool optimize = true;
+	bool lods = true;
+	std::vector<std::string> paths;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string argument = argv[i];
+		if (argument == "--quantize")
+		{
+			quantize = true;
+		}
+		else if (argument == "--no-optimize")
+		{
+			optimize = false;
+		}
+		else if (argument == "--no-lods")
+		{
+			lods = false;
+		}
+		else
+		{
+			paths.push_back(argument);
+		}
+	}
+
+	if (paths.size() != 2)
+	{
+		std::cerr << "Usage: MeshConverter [--quantize] [--no-optimize] [--no-lods] <input.obj|input.gltf|input.glb> <output.mesh>" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::string input = paths[0];
+	std::string output = paths[1];
+
+	std::string extension = input.substr(input.find_last_of('.') + 1);
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return static_cast<char>(tolower(c)); });
+
+	try
+	{
+		SourceMesh mesh;
+
+		if (extension == "obj")
+		{
+			importObj(input, mesh);
+		}
+		else if (extension == "gltf" || extension == "glb")
+		{
+			importGltf(input, mesh);
+		}
+		else
+		{
+			throw std::runtime_error("Unsupported input format " + extension);
+		}
+
+		if (mesh.indices.empty())
+		{
+			throw std::runtime_error("No triangles found in " + input);
+		}
+
+		if (!mesh.hasNormals)
+		{
+			generateNormals(mesh);
+		}
+
+		// Hardware post-transform caches are small FIFOs, 16 entries is a conservative model
+		const uint32_t cacheSize = 16;
+		VertexCacheStatistics before = analyzeVertexCache(mesh.indices, mesh.vertices.size(), cacheSize);
+
+		if (optimize)
+		{
+			optimizeVertexCache(mesh.indices, mesh.vertices.size());
+			optimizeVertexFetch(mesh);
+		}
+
+		VertexCacheStatistics after = analyzeVertexCache(mesh.indices, mesh.vertices.size(), cacheSize);
+
+		std::cout << "Vertex cache (" << cacheSize << " entry FIFO): ACMR " << before.acmr << " -> " << after.acmr
+			<< ", ATVR " << before.atvr << " -> " << after.atvr << std::endl;
+		std::cout << "Vertex bandwidth:" << std::endl;
+		printBandwidth("float32", mesh, after, false);
+		printBandwidth("quantized", mesh, after, true);
+
+		if (lods)
+		{
+			buildLods(mesh);
+
+			std::cout << "Levels of detail:" << std::endl;
+			for (size_t i = 0; i < mesh.lods.size(); i++)
+			{
+				std::cout << "  " << i + 1 << ": " << mesh.lods[i].indices.size() / 3 << " triangles, error " << mesh.lods[i].error << std::endl;
+			}
+		}
+
+		writeMeshFile(output, mesh, quantize);
+
+		std::cout << input << " -> " << output << ": " << mesh.vertices.size() << " vertices, " << mesh.indices.size() / 3 << " triangles"
+			<< (quantize ? ", quantized" : "") << std::endl;
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,139 @@
+#include "AllocationCounter.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<uint64_t> allocationCount{ 0 };
+static std::atomic<uint64_t> allocatedBytes{ 0 };
+static thread_local uint64_t threadAllocationCount = 0; // Plain integer, no thread_local constructor runs inside operator new
+
+uint64_t AllocationCounter::getCount()
+{
+	return allocationCount.load(std::memory_order_relaxed);
+}
+
+uint64_t AllocationCounter::getBytes()
+{
+	return allocatedBytes.load(std::memory_order_relaxed);
+}
+
+uint64_t AllocationCounter::getThreadCount()
+{
+	return threadAllocationCount;
+}
+
+// ==== REPLACED OPERATORS ====
+
+static void* countedAllocate(size_t size)
+{
+	allocationCount.fetch_add(1, std::memory_order_relaxed);
+	allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+	threadAllocationCount++;
+
+	// malloc(0) may return null, operator new may not
+	return std::malloc(size > 0 ? size : 1);
+}
+
+static void* countedAllocateAligned(size_t size, size_t alignment)
+{
+	allocationCount.fetch_add(1, std::memory_order_relaxed);
+	allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+	threadAllocationCount++;
+
+#ifdef _MSC_VER
+	return _aligned_malloc(size > 0 ? size : 1, alignment);
+#else
+	// aligned_alloc needs the size to be a multiple of the alignment
+	return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+#endif
+}
+
+static void countedFreeAligned(void* pointer)
+{
+#ifdef _MSC_VER
+	_aligned_free(pointer);
+#else
+	std::free(pointer);
+#endif
+}
+
+void* operator new(size_t size)
+{
+	void* pointer = countedAllocate(size);
+	if (pointer == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+	return pointer;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	return countedAllocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return countedAllocate(size);
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	void* pointer = countedAllocateAligned(size, static_cast<size_t>(alignment));
+	if (pointer == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+	return pointer;
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+	return operator new(size, alignment);
+}
+
+void operator delete(void* pointer) noexcept
+{
+	std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+	std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept
+{
+	std::free(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept
+{
+	std::free(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept
+{
+	countedFreeAligned(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t) noexcept
+{
+	countedFreeAligned(pointer);
+}
+
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept
+{
+	countedFreeAligned(pointer);
+}
+
+void operator delete[](void* pointer, size_t, std::align_val_t) noexcept
+{
+	countedFreeAligned(pointer);
+}
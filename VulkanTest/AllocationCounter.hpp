@@ -0,0 +1,23 @@
+#ifndef ALLOCATION_COUNTER
+#define ALLOCATION_COUNTER
+
+#include <cstdint>
+
+/****************************************************************************************************
+ * Counts every heap allocation made through operator new, which AllocationCounter.cpp replaces for the whole program.
+ * Each thread also keeps its own count, so a loop can check that it didn't allocate while other threads
+ * (file writers, decoders) still do: read the thread's count before and after, the difference has to be zero.
+ *
+ * Allocations inside the driver, GLFW or anything else that calls malloc directly aren't seen.
+ */
+class AllocationCounter
+{
+public:
+	// All threads since startup
+	static uint64_t getCount();
+	static uint64_t getBytes();
+	// The calling thread since it started
+	static uint64_t getThreadCount();
+};
+
+#endif
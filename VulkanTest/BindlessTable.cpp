@@ -0,0 +1,362 @@
+#include "BindlessTable.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+// ==== SETUP ====
+
+bool BindlessTable::isSupported(VkPhysicalDevice physicalDevice, VkPhysicalDeviceDescriptorIndexingFeaturesEXT& enabledFeatures)
+{
+	// The feature and property queries and VK_KHR_maintenance3, which the extension needs, are core from 1.1
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	if (properties.apiVersion < VK_API_VERSION_1_1)
+	{
+		return false;
+	}
+
+	uint32_t extensionCount = 0;
+	vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+	std::vector<VkExtensionProperties> extensions(extensionCount);
+	vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, extensions.data());
+
+	auto found = std::find_if(extensions.begin(), extensions.end(), [](const VkExtensionProperties& extension)
+	{
+		return std::strcmp(extension.extensionName, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) == 0;
+	});
+	if (found == extensions.end())
+	{
+		return false;
+	}
+
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+	indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+
+	VkPhysicalDeviceFeatures2 features = {};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features.pNext = &indexingFeatures;
+	vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+
+	if (!indexingFeatures.runtimeDescriptorArray || !indexingFeatures.descriptorBindingPartiallyBound ||
+		!indexingFeatures.descriptorBindingSampledImageUpdateAfterBind || !indexingFeatures.descriptorBindingStorageBufferUpdateAfterBind)
+	{
+		return false;
+	}
+
+	// Only what the table uses, the rest stays disabled
+	enabledFeatures = {};
+	enabledFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+	enabledFeatures.runtimeDescriptorArray = VK_TRUE;
+	enabledFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+	enabledFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+	enabledFeatures.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+	return true;
+}
+
+void BindlessTable::init(VkDevice device, const VkAllocationCallbacks* allocator, VkPhysicalDevice physicalDevice, uint32_t setCount, const Config& config)
+{
+	this->device = device;
+	this->allocator = allocator;
+
+	VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexingProperties = {};
+	indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+
+	VkPhysicalDeviceProperties2 properties = {};
+	properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	properties.pNext = &indexingProperties;
+	vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+
+	// Every stage sees the whole set, so the per stage limits apply to it as well
+	uint32_t maxImages = std::min({ config.maxImages, indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+		indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages });
+	uint32_t maxBuffers = std::min({ config.maxBuffers, indexingProperties.maxPerStageDescriptorUpdateAfterBindStorageBuffers,
+		indexingProperties.maxDescriptorSetUpdateAfterBindStorageBuffers });
+	uint32_t maxResources = indexingProperties.maxPerStageUpdateAfterBindResources;
+	if (maxImages + maxBuffers + 1 > maxResources)
+	{
+		maxImages = std::min(maxImages, maxResources / 2);
+		maxBuffers = std::min(maxBuffers, maxResources - maxImages - 1);
+	}
+
+	if (maxImages == 0 || maxBuffers == 0)
+	{
+		throw std::runtime_error("Device limits leave no room for a bindless table!");
+	}
+
+	VkSamplerCreateInfo samplerInfo = {};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_LINEAR;
+	samplerInfo.minFilter = VK_FILTER_LINEAR;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerInfo.maxLod = VK_LOD_CLAMP_NONE; // Streamed textures change their mip count
+
+	if (vkCreateSampler(device, &samplerInfo, allocator, &sampler) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create bindless sampler!");
+	}
+
+	std::array<VkDescriptorSetLayoutBinding, 3> bindings = {};
+	bindings[0].binding = 0;
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+	bindings[0].descriptorCount = 1;
+	bindings[0].stageFlags = VK_SHADER_STAGE_ALL;
+	bindings[0].pImmutableSamplers = &sampler;
+	bindings[1].binding = 1;
+	bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+	bindings[1].descriptorCount = maxImages;
+	bindings[1].stageFlags = VK_SHADER_STAGE_ALL;
+	bindings[2].binding = 2;
+	bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	bindings[2].descriptorCount = maxBuffers;
+	bindings[2].stageFlags = VK_SHADER_STAGE_ALL;
+
+	const VkDescriptorBindingFlagsEXT arrayFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT;
+	std::array<VkDescriptorBindingFlagsEXT, 3> bindingFlags = { 0, arrayFlags, arrayFlags };
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo = {};
+	bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+	bindingFlagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+	bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.pNext = &bindingFlagsInfo;
+	layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutInfo.pBindings = bindings.data();
+
+	if (vkCreateDescriptorSetLayout(device, &layoutInfo, allocator, &layout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create bindless descriptor set layout!");
+	}
+
+	std::array<VkDescriptorPoolSize, 3> poolSizes = {};
+	poolSizes[0] = { VK_DESCRIPTOR_TYPE_SAMPLER, setCount };
+	poolSizes[1] = { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, maxImages * setCount };
+	poolSizes[2] = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, maxBuffers * setCount };
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+	poolInfo.maxSets = setCount;
+	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolInfo.pPoolSizes = poolSizes.data();
+
+	if (vkCreateDescriptorPool(device, &poolInfo, allocator, &pool) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create bindless descriptor pool!");
+	}
+
+	std::vector<VkDescriptorSetLayout> layouts(setCount, layout);
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = pool;
+	allocInfo.descriptorSetCount = setCount;
+	allocInfo.pSetLayouts = layouts.data();
+
+	sets.resize(setCount);
+	if (vkAllocateDescriptorSets(device, &allocInfo, sets.data()) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to allocate bindless descriptor sets!");
+	}
+
+	images.assign(maxImages, { VK_NULL_HANDLE, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL });
+	buffers.assign(maxBuffers, { VK_NULL_HANDLE, 0, VK_WHOLE_SIZE });
+
+	// Handed out lowest first
+	freeImages.resize(maxImages);
+	for (uint32_t i = 0; i < maxImages; i++)
+	{
+		freeImages[i] = maxImages - 1 - i;
+	}
+	freeBuffers.resize(maxBuffers);
+	for (uint32_t i = 0; i < maxBuffers; i++)
+	{
+		freeBuffers[i] = maxBuffers - 1 - i;
+	}
+
+	pendingWrites.resize(setCount);
+	for (auto& pending : pendingWrites)
+	{
+		pending.imageDirty.assign(maxImages, 0);
+		pending.bufferDirty.assign(maxBuffers, 0);
+	}
+}
+
+void BindlessTable::destroy()
+{
+	// Freeing the pool frees the sets
+	if (pool != VK_NULL_HANDLE)
+	{
+		vkDestroyDescriptorPool(device, pool, allocator);
+		pool = VK_NULL_HANDLE;
+	}
+	if (layout != VK_NULL_HANDLE)
+	{
+		vkDestroyDescriptorSetLayout(device, layout, allocator);
+		layout = VK_NULL_HANDLE;
+	}
+	if (sampler != VK_NULL_HANDLE)
+	{
+		vkDestroySampler(device, sampler, allocator);
+		sampler = VK_NULL_HANDLE;
+	}
+
+	sets.clear();
+	releasedSlots.clear();
+	pendingWrites.clear();
+}
+
+// ==== SLOTS ====
+
+BindlessTable::Slot BindlessTable::allocateSlot(std::vector<Slot>& freeSlots, const char* kind)
+{
+	if (freeSlots.empty())
+	{
+		throw std::runtime_error(std::string("Bindless table is out of ") + kind + " slots!");
+	}
+
+	Slot slot = freeSlots.back();
+	freeSlots.pop_back();
+	return slot;
+}
+
+void BindlessTable::markImage(Slot slot)
+{
+	for (auto& pending : pendingWrites)
+	{
+		if (!pending.imageDirty[slot])
+		{
+			pending.imageDirty[slot] = 1;
+			pending.images.push_back(slot);
+		}
+	}
+}
+
+void BindlessTable::markBuffer(Slot slot)
+{
+	for (auto& pending : pendingWrites)
+	{
+		if (!pending.bufferDirty[slot])
+		{
+			pending.bufferDirty[slot] = 1;
+			pending.buffers.push_back(slot);
+		}
+	}
+}
+
+BindlessTable::Slot BindlessTable::addImage(VkImageView view)
+{
+	Slot slot = allocateSlot(freeImages, "image");
+	statistics.imageSlots++;
+	setImage(slot, view);
+	return slot;
+}
+
+void BindlessTable::setImage(Slot slot, VkImageView view)
+{
+	images[slot].imageView = view;
+	markImage(slot);
+}
+
+void BindlessTable::removeImage(Slot slot, uint64_t frame)
+{
+	// The descriptor itself stays as it is, partially bound arrays allow stale entries as long as nothing reads them.
+	// Clearing the view only keeps queued writes from pointing a set at a view that may be destroyed by then.
+	images[slot].imageView = VK_NULL_HANDLE;
+	releasedSlots.push_back({ slot, true, frame });
+	statistics.imageSlots--;
+}
+
+BindlessTable::Slot BindlessTable::addBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+{
+	Slot slot = allocateSlot(freeBuffers, "buffer");
+	statistics.bufferSlots++;
+	setBuffer(slot, buffer, offset, range);
+	return slot;
+}
+
+void BindlessTable::setBuffer(Slot slot, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+{
+	buffers[slot] = { buffer, offset, range };
+	markBuffer(slot);
+}
+
+void BindlessTable::removeBuffer(Slot slot, uint64_t frame)
+{
+	buffers[slot].buffer = VK_NULL_HANDLE;
+	releasedSlots.push_back({ slot, false, frame });
+	statistics.bufferSlots--;
+}
+
+// ==== UPDATE ====
+
+/****************************************************************************
+ * One write per changed slot. Slots without a resource are left alone, writing a null handle
+ * would need the nullDescriptor feature, and a partially bound array doesn't care as long as they aren't read.
+ */
+void BindlessTable::update(uint32_t setIndex, const DeletionQueue& deletionQueue)
+{
+	while (!releasedSlots.empty() && deletionQueue.isFrameComplete(releasedSlots.front().frame))
+	{
+		const ReleasedSlot& released = releasedSlots.front();
+		(released.image ? freeImages : freeBuffers).push_back(released.slot);
+		releasedSlots.pop_front();
+	}
+
+	PendingWrites& pending = pendingWrites[setIndex];
+	writes.clear();
+
+	for (Slot slot : pending.images)
+	{
+		pending.imageDirty[slot] = 0;
+		if (images[slot].imageView == VK_NULL_HANDLE)
+		{
+			continue;
+		}
+
+		VkWriteDescriptorSet write = {};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = sets[setIndex];
+		write.dstBinding = 1;
+		write.dstArrayElement = slot;
+		write.descriptorCount = 1;
+		write.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+		write.pImageInfo = &images[slot];
+		writes.push_back(write);
+	}
+
+	for (Slot slot : pending.buffers)
+	{
+		pending.bufferDirty[slot] = 0;
+		if (buffers[slot].buffer == VK_NULL_HANDLE)
+		{
+			continue;
+		}
+
+		VkWriteDescriptorSet write = {};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = sets[setIndex];
+		write.dstBinding = 2;
+		write.dstArrayElement = slot;
+		write.descriptorCount = 1;
+		write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		write.pBufferInfo = &buffers[slot];
+		writes.push_back(write);
+	}
+
+	pending.images.clear();
+	pending.buffers.clear();
+
+	if (!writes.empty())
+	{
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+		statistics.descriptorWrites += writes.size();
+	}
+}
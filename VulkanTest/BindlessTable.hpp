@@ -0,0 +1,107 @@
+#ifndef BINDLESS_TABLE
+#define BINDLESS_TABLE
+
+#include "VulkanDispatch.hpp"
+
+#include <cstdint>
+#include <vector>
+
+#include "DeletionQueue.hpp"
+#include "RingQueue.hpp"
+
+/****************************************************************************************************
+ * Bindless resources through VK_EXT_descriptor_indexing.
+ * - One descriptor set holds large arrays of sampled images and storage buffers, shaders pick the resource by
+ *   an index that comes from push constants or from other data, so nothing is bound per draw.
+ * - The arrays are partially bound, only the slots that are used have to be valid.
+ * - Slots are handed out from free lists. A released slot is only reused once the GPU has finished every frame
+ *   that could still read it.
+ *
+ * The bindings are update-after-bind, so slots can be rewritten while the command buffers that bind the set stay
+ * recorded, but a set must not change while a submission that uses it is still running. There is one set per
+ * frame in flight: changes are queued for every set and update() writes them into the set of the frame that is
+ * about to be submitted.
+ *
+ * Set layout: binding 0 is a linear repeating sampler, binding 1 the image array, binding 2 the buffer array.
+ */
+class BindlessTable
+{
+public:
+	typedef uint32_t Slot;
+	static const Slot invalidSlot = UINT32_MAX;
+
+	struct Config
+	{
+		uint32_t maxImages = 4096; // Clamped to the device limits
+		uint32_t maxBuffers = 1024;
+	};
+
+	struct Statistics
+	{
+		uint32_t imageSlots = 0; // In use
+		uint32_t bufferSlots = 0;
+		uint64_t descriptorWrites = 0;
+	};
+
+	// Fills in the descriptor indexing features to enable on the device, false if the device lacks any of them
+	static bool isSupported(VkPhysicalDevice physicalDevice, VkPhysicalDeviceDescriptorIndexingFeaturesEXT& enabledFeatures);
+
+	void init(VkDevice device, const VkAllocationCallbacks* allocator, VkPhysicalDevice physicalDevice, uint32_t setCount, const Config& config);
+	void destroy();
+
+	// The view must be in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL whenever a shader reads the slot
+	Slot addImage(VkImageView view);
+	void setImage(Slot slot, VkImageView view);
+	void removeImage(Slot slot, uint64_t frame); // Last frame that may still read the slot
+
+	Slot addBuffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+	void setBuffer(Slot slot, VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+	void removeBuffer(Slot slot, uint64_t frame);
+
+	// Writes the queued changes into the set before its frame is submitted and recycles the slots of finished frames
+	void update(uint32_t setIndex, const DeletionQueue& deletionQueue);
+
+	VkDescriptorSetLayout getLayout() const { return layout; }
+	VkDescriptorSet getSet(uint32_t setIndex) const { return sets[setIndex]; }
+	const Statistics& getStatistics() const { return statistics; }
+
+private:
+	struct ReleasedSlot
+	{
+		Slot slot;
+		bool image;
+		uint64_t frame;
+	};
+
+	struct PendingWrites
+	{
+		std::vector<uint8_t> imageDirty; // Per slot, so a slot changed several times is written once
+		std::vector<uint8_t> bufferDirty;
+		std::vector<Slot> images;
+		std::vector<Slot> buffers;
+	};
+
+	static Slot allocateSlot(std::vector<Slot>& freeSlots, const char* kind);
+	void markImage(Slot slot);
+	void markBuffer(Slot slot);
+
+	VkDevice device = VK_NULL_HANDLE;
+	const VkAllocationCallbacks* allocator = nullptr;
+	VkSampler sampler = VK_NULL_HANDLE;
+	VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+	VkDescriptorPool pool = VK_NULL_HANDLE;
+	std::vector<VkDescriptorSet> sets;
+
+	std::vector<VkDescriptorImageInfo> images; // Current content of every slot
+	std::vector<VkDescriptorBufferInfo> buffers;
+	std::vector<Slot> freeImages; // Handed out from the back
+	std::vector<Slot> freeBuffers;
+	RingQueue<ReleasedSlot> releasedSlots; // Oldest frame first
+
+	std::vector<PendingWrites> pendingWrites; // Per set
+	std::vector<VkWriteDescriptorSet> writes; // Scratch, kept to avoid allocating every frame
+
+	Statistics statistics;
+};
+
+#endif
@@ -0,0 +1,108 @@
+#include "CommandCache.hpp"
+
+#include <stdexcept>
+
+void CommandCache::init(VkDevice device, const VkAllocationCallbacks* allocator, uint32_t queueFamilyIndex, uint32_t variantCount)
+{
+	this->device = device;
+	this->allocator = allocator;
+	this->queueFamilyIndex = queueFamilyIndex;
+	this->variantCount = variantCount;
+}
+
+void CommandCache::destroy()
+{
+	for (Bucket& bucket : buckets)
+	{
+		for (Entry& entry : bucket.entries)
+		{
+			vkDestroyCommandPool(device, entry.commandPool, allocator); // Frees its command buffer
+		}
+	}
+	buckets.clear();
+}
+
+CommandCache::BucketHandle CommandCache::addBucket(const std::string& name)
+{
+	Bucket bucket;
+	bucket.name = name;
+	bucket.entries.resize(variantCount);
+
+	for (Entry& entry : bucket.entries)
+	{
+		VkCommandPoolCreateInfo poolInfo = {};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.queueFamilyIndex = queueFamilyIndex;
+		poolInfo.flags = 0; // Reset as a whole, which lets the driver reuse the buffer's memory
+
+		if (vkCreateCommandPool(device, &poolInfo, allocator, &entry.commandPool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create command cache pool!");
+		}
+
+		VkCommandBufferAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = entry.commandPool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+		allocInfo.commandBufferCount = 1;
+
+		if (vkAllocateCommandBuffers(device, &allocInfo, &entry.commandBuffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to allocate command cache buffer!");
+		}
+	}
+
+	buckets.push_back(bucket);
+	return static_cast<BucketHandle>(buckets.size() - 1);
+}
+
+CommandCache::Statistics CommandCache::getTotalStatistics() const
+{
+	Statistics total;
+	for (const Bucket& bucket : buckets)
+	{
+		total.lookups += bucket.statistics.lookups;
+		total.hits += bucket.statistics.hits;
+		total.recordings += bucket.statistics.recordings;
+	}
+	return total;
+}
+
+uint64_t CommandCache::hash(const void* data, size_t size, uint64_t seed)
+{
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	uint64_t value = seed;
+	for (size_t i = 0; i < size; i++)
+	{
+		value ^= bytes[i];
+		value *= 1099511628211ull; // FNV prime
+	}
+	return value;
+}
+
+void CommandCache::begin(Entry& entry, const VkCommandBufferInheritanceInfo& inheritance)
+{
+	vkResetCommandPool(device, entry.commandPool, 0);
+	entry.recorded = false;
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+	beginInfo.pInheritanceInfo = &inheritance;
+
+	if (vkBeginCommandBuffer(entry.commandBuffer, &beginInfo) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to begin recording cached command buffer!");
+	}
+}
+
+void CommandCache::end(Entry& entry, uint64_t key)
+{
+	if (vkEndCommandBuffer(entry.commandBuffer) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to record cached command buffer!");
+	}
+
+	entry.key = key;
+	entry.recorded = true;
+}
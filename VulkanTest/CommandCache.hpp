@@ -0,0 +1,106 @@
+#ifndef COMMAND_CACHE
+#define COMMAND_CACHE
+
+#include "VulkanDispatch.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/****************************************************************************************************
+ * Secondary command buffers cached by a hash of the inputs they were recorded from.
+ * - A bucket is a group of draws that change together, e.g. the meshes of a pass. It has a secondary command
+ *   buffer per variant (swap chain image), each in a command pool of its own.
+ * - get() takes the key of the bucket's current inputs - pipelines, buffers, descriptor sets, extents, push
+ *   constants, whatever the recording reads. If it matches the key the buffer was recorded with, the buffer is
+ *   returned as it is, otherwise it's re-recorded first. The primary command buffer that executes it can then
+ *   be recorded every frame for next to nothing.
+ * - Whatever isn't in the key is assumed not to change - data read by the GPU (indirect draws, instance buffers)
+ *   is fine to change, the commands only reference it.
+ *
+ * A variant's buffers may only be re-recorded once the primary command buffers executing them have finished,
+ * and get() is not thread safe.
+ */
+class CommandCache
+{
+public:
+	typedef uint32_t BucketHandle;
+
+	static const uint64_t hashSeed = 14695981039346656037ull; // FNV-1a offset basis
+
+	struct Statistics
+	{
+		uint64_t lookups = 0;
+		uint64_t hits = 0; // Returned without recording
+		uint64_t recordings = 0; // Including the first one of every variant
+	};
+
+	// The allocator is used for the command pools, nullptr uses the driver's
+	void init(VkDevice device, const VkAllocationCallbacks* allocator, uint32_t queueFamilyIndex, uint32_t variantCount);
+	void destroy();
+
+	BucketHandle addBucket(const std::string& name);
+
+	// Returns the bucket's secondary command buffer for the variant, recorded with record(commandBuffer) if the key changed.
+	// The inheritance info describes the render pass and subpass it's executed in.
+	template<typename Record>
+	VkCommandBuffer get(BucketHandle bucket, uint32_t variant, uint64_t key, const VkCommandBufferInheritanceInfo& inheritance, Record&& record)
+	{
+		Entry& entry = buckets[bucket].entries[variant];
+		Statistics& bucketStatistics = buckets[bucket].statistics;
+		bucketStatistics.lookups++;
+
+		if (entry.recorded && entry.key == key)
+		{
+			bucketStatistics.hits++;
+			return entry.commandBuffer;
+		}
+
+		begin(entry, inheritance);
+		record(entry.commandBuffer);
+		end(entry, key);
+		bucketStatistics.recordings++;
+		return entry.commandBuffer;
+	}
+
+	// FNV-1a, chained through the seed to hash several inputs into one key
+	static uint64_t hash(const void* data, size_t size, uint64_t seed = hashSeed);
+	template<typename T>
+	static uint64_t hash(const T& value, uint64_t seed = hashSeed)
+	{
+		return hash(&value, sizeof(T), seed);
+	}
+
+	uint32_t getBucketCount() const { return static_cast<uint32_t>(buckets.size()); }
+	const std::string& getBucketName(BucketHandle bucket) const { return buckets[bucket].name; }
+	const Statistics& getStatistics(BucketHandle bucket) const { return buckets[bucket].statistics; }
+	Statistics getTotalStatistics() const;
+
+private:
+	struct Entry
+	{
+		VkCommandPool commandPool = VK_NULL_HANDLE;
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		uint64_t key = 0;
+		bool recorded = false;
+	};
+
+	struct Bucket
+	{
+		std::string name;
+		std::vector<Entry> entries; // Per variant
+		Statistics statistics;
+	};
+
+	void begin(Entry& entry, const VkCommandBufferInheritanceInfo& inheritance);
+	void end(Entry& entry, uint64_t key);
+
+	VkDevice device = VK_NULL_HANDLE;
+	const VkAllocationCallbacks* allocator = nullptr;
+	uint32_t queueFamilyIndex = 0;
+	uint32_t variantCount = 0;
+	std::vector<Bucket> buckets;
+};
+
+#endif
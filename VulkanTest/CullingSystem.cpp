@@ -0,0 +1,424 @@
+#include "CullingSystem.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CULLING_SYSTEM_SSE
+#include <emmintrin.h>
+#endif
+
+typedef std::chrono::steady_clock Clock;
+
+static double millisecondsSince(Clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// ==== SPHERES ====
+
+void CullingSystem::resize(uint32_t count)
+{
+	uint32_t paddedCount = (count + 3) & ~3u;
+
+	objectCount = count;
+	centersX.assign(paddedCount, 0.0f);
+	centersY.assign(paddedCount, 0.0f);
+	centersZ.assign(paddedCount, 0.0f);
+	// Fails every plane test, so the padding never shows up in the output
+	radii.assign(paddedCount, -std::numeric_limits<float>::max());
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		radii[i] = 0.0f;
+	}
+}
+
+void CullingSystem::setSphere(uint32_t index, const glm::vec3& center, float radius)
+{
+	centersX[index] = center.x;
+	centersY[index] = center.y;
+	centersZ[index] = center.z;
+	radii[index] = radius;
+}
+
+/****************************************************************************
+ * The center is the translation, the radius grows with the largest axis scale so it stays conservative
+ * under non-uniform scaling
+ */
+void CullingSystem::updateSpheres(JobSystem& jobSystem, const glm::mat4* worldMatrices, float localRadius)
+{
+	jobSystem.parallelFor(objectCount, batchSize, [this, worldMatrices, localRadius](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; i++)
+		{
+			const glm::mat4& world = worldMatrices[i];
+			float scale = 0.0f;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				scale = std::max(scale, world[axis][0] * world[axis][0] + world[axis][1] * world[axis][1] + world[axis][2] * world[axis][2]);
+			}
+
+			centersX[i] = world[3][0];
+			centersY[i] = world[3][1];
+			centersZ[i] = world[3][2];
+			radii[i] = localRadius * std::sqrt(scale);
+		}
+	});
+}
+
+
+// ==== FRUSTUM ====
+
+/****************************************************************************
+ * Planes straight from the rows of the view projection matrix, with the Vulkan 0 to 1 depth range
+ */
+void CullingSystem::beginFrame(const glm::mat4& newViewProjection)
+{
+	viewProjection = newViewProjection;
+
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++)
+	{
+		rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+	}
+
+	planes[0] = rows[3] + rows[0]; // Left
+	planes[1] = rows[3] - rows[0]; // Right
+	planes[2] = rows[3] + rows[1]; // Bottom
+	planes[3] = rows[3] - rows[1]; // Top
+	planes[4] = rows[2]; // Near
+	planes[5] = rows[3] - rows[2]; // Far
+
+	for (glm::vec4& plane : planes)
+	{
+		float length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+		plane = plane * (1.0f / length);
+	}
+
+	depthBuffer.assign(depthWidth * depthHeight, 1.0f);
+
+	statistics = Statistics();
+	statistics.objectCount = objectCount;
+}
+
+/****************************************************************************
+ * Writes the indices of the spheres in [begin, end) that aren't completely behind any plane, returns how many.
+ * begin must be a multiple of 4, end may point into the padding.
+ */
+uint32_t CullingSystem::cullFrustumRange(uint32_t begin, uint32_t end, uint32_t* output) const
+{
+	uint32_t count = 0;
+
+#ifdef CULLING_SYSTEM_SSE
+	__m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+	for (int p = 0; p < 6; p++)
+	{
+		planeX[p] = _mm_set1_ps(planes[p].x);
+		planeY[p] = _mm_set1_ps(planes[p].y);
+		planeZ[p] = _mm_set1_ps(planes[p].z);
+		planeW[p] = _mm_set1_ps(planes[p].w);
+	}
+
+	__m128 zero = _mm_setzero_ps();
+
+	for (uint32_t i = begin; i < end; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(&centersX[i]);
+		__m128 y = _mm_loadu_ps(&centersY[i]);
+		__m128 z = _mm_loadu_ps(&centersZ[i]);
+		__m128 r = _mm_loadu_ps(&radii[i]);
+
+		// Inside a plane as long as distance + radius > 0
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int p = 0; p < 6; p++)
+		{
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], x), _mm_mul_ps(planeY[p], y)),
+				_mm_add_ps(_mm_mul_ps(planeZ[p], z), planeW[p]));
+			inside = _mm_and_ps(inside, _mm_cmpgt_ps(_mm_add_ps(distance, r), zero));
+		}
+
+		// Branchless compaction, the index is always written but only kept if the lane passed
+		int mask = _mm_movemask_ps(inside);
+		for (uint32_t lane = 0; lane < 4; lane++)
+		{
+			output[count] = i + lane;
+			count += (mask >> lane) & 1;
+		}
+	}
+#else
+	for (uint32_t i = begin; i < end; i++)
+	{
+		bool inside = true;
+		for (int p = 0; p < 6; p++)
+		{
+			inside &= planes[p].x * centersX[i] + planes[p].y * centersY[i] + planes[p].z * centersZ[i] + planes[p].w + radii[i] > 0.0f;
+		}
+
+		output[count] = i;
+		count += inside ? 1 : 0;
+	}
+#endif
+
+	return count;
+}
+
+/****************************************************************************
+ * Batch b left its results at b * batchSize in the visible list, moves them together
+ */
+void CullingSystem::compactBatches(uint32_t batchCount)
+{
+	uint32_t visibleCount = 0;
+	for (uint32_t b = 0; b < batchCount; b++)
+	{
+		uint32_t* batchOutput = visible.data() + b * batchSize;
+		if (visibleCount != b * batchSize)
+		{
+			std::copy(batchOutput, batchOutput + batchVisibleCounts[b], visible.data() + visibleCount);
+		}
+		visibleCount += batchVisibleCounts[b];
+	}
+
+	visible.resize(visibleCount);
+}
+
+void CullingSystem::cullFrustum(JobSystem& jobSystem)
+{
+	auto start = Clock::now();
+
+	uint32_t paddedCount = static_cast<uint32_t>(radii.size());
+	uint32_t batchCount = (paddedCount + batchSize - 1) / batchSize;
+
+	visible.resize(paddedCount);
+	batchVisibleCounts.resize(batchCount);
+
+	jobSystem.parallelFor(batchCount, 1, [this, paddedCount](uint32_t firstBatch, uint32_t lastBatch)
+	{
+		for (uint32_t b = firstBatch; b < lastBatch; b++)
+		{
+			uint32_t begin = b * batchSize;
+			uint32_t end = std::min(begin + batchSize, paddedCount);
+			batchVisibleCounts[b] = cullFrustumRange(begin, end, visible.data() + begin);
+		}
+	});
+
+	compactBatches(batchCount);
+
+	statistics.frustumVisible = statistics.occlusionVisible = static_cast<uint32_t>(visible.size());
+	statistics.frustumMilliseconds = millisecondsSince(start);
+}
+
+
+// ==== OCCLUSION ====
+
+/****************************************************************************
+ * Every covered pixel keeps the nearest occluder depth. Each triangle is written with the depth of its farthest
+ * vertex, which is never in front of the actual surface. Four pixels are set at once with SSE.
+ */
+void CullingSystem::rasterizeOccluder(const glm::vec3* vertices, const uint32_t* indices, uint32_t indexCount, const glm::mat4& world)
+{
+	auto start = Clock::now();
+
+	glm::mat4 worldViewProjection = viewProjection * world;
+
+	for (uint32_t t = 0; t + 2 < indexCount; t += 3)
+	{
+		float screenX[3], screenY[3];
+		float depth = 0.0f;
+		bool clipped = false;
+
+		for (int v = 0; v < 3; v++)
+		{
+			const glm::vec3& position = vertices[indices[t + v]];
+			glm::vec4 clip = worldViewProjection * glm::vec4(position, 1.0f);
+			if (clip.z < 0.0f || clip.w <= 0.0f)
+			{
+				clipped = true;
+				break;
+			}
+
+			float invW = 1.0f / clip.w;
+			screenX[v] = (clip.x * invW * 0.5f + 0.5f) * depthWidth;
+			screenY[v] = (clip.y * invW * 0.5f + 0.5f) * depthHeight;
+			depth = std::max(depth, clip.z * invW);
+		}
+
+		if (clipped)
+		{
+			continue;
+		}
+
+		float area = (screenX[1] - screenX[0]) * (screenY[2] - screenY[0]) - (screenY[1] - screenY[0]) * (screenX[2] - screenX[0]);
+		if (std::fabs(area) < 1e-6f)
+		{
+			continue;
+		}
+		if (area < 0.0f)
+		{
+			std::swap(screenX[1], screenX[2]);
+			std::swap(screenY[1], screenY[2]);
+		}
+
+		int minX = std::max(static_cast<int>(std::floor(std::min({ screenX[0], screenX[1], screenX[2] }))), 0);
+		int maxX = std::min(static_cast<int>(std::floor(std::max({ screenX[0], screenX[1], screenX[2] }))), static_cast<int>(depthWidth) - 1);
+		int minY = std::max(static_cast<int>(std::floor(std::min({ screenY[0], screenY[1], screenY[2] }))), 0);
+		int maxY = std::min(static_cast<int>(std::floor(std::max({ screenY[0], screenY[1], screenY[2] }))), static_cast<int>(depthHeight) - 1);
+		if (minX > maxX || minY > maxY)
+		{
+			continue;
+		}
+
+		// Edge functions a * x + b * y + c, positive inside
+		float a[3], b[3], c[3];
+		for (int e = 0; e < 3; e++)
+		{
+			int next = (e + 1) % 3;
+			a[e] = screenY[e] - screenY[next];
+			b[e] = screenX[next] - screenX[e];
+			c[e] = -(a[e] * screenX[e] + b[e] * screenY[e]);
+		}
+
+		statistics.occluderTriangles++;
+
+#ifdef CULLING_SYSTEM_SSE
+		__m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+		__m128 triangleDepth = _mm_set1_ps(depth);
+		__m128 zero = _mm_setzero_ps();
+
+		for (int y = minY; y <= maxY; y++)
+		{
+			float pixelY = y + 0.5f;
+			__m128 rowTerms[3];
+			for (int e = 0; e < 3; e++)
+			{
+				rowTerms[e] = _mm_set1_ps(b[e] * pixelY + c[e]);
+			}
+
+			// The width is a multiple of 4, so aligning the start down keeps every group inside the row
+			for (int x = minX & ~3; x <= maxX; x += 4)
+			{
+				__m128 pixelX = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), laneOffsets);
+				__m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[0]), pixelX), rowTerms[0]), zero);
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[1]), pixelX), rowTerms[1]), zero));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[2]), pixelX), rowTerms[2]), zero));
+
+				float* pixels = &depthBuffer[y * depthWidth + x];
+				__m128 current = _mm_loadu_ps(pixels);
+				__m128 nearest = _mm_min_ps(current, triangleDepth);
+				_mm_storeu_ps(pixels, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, current)));
+			}
+		}
+#else
+		for (int y = minY; y <= maxY; y++)
+		{
+			for (int x = minX; x <= maxX; x++)
+			{
+				float pixelX = x + 0.5f, pixelY = y + 0.5f;
+				if (a[0] * pixelX + b[0] * pixelY + c[0] >= 0.0f && a[1] * pixelX + b[1] * pixelY + c[1] >= 0.0f &&
+					a[2] * pixelX + b[2] * pixelY + c[2] >= 0.0f)
+				{
+					float& pixel = depthBuffer[y * depthWidth + x];
+					pixel = std::min(pixel, depth);
+				}
+			}
+		}
+#endif
+	}
+
+	statistics.rasterizeMilliseconds += millisecondsSince(start);
+}
+
+/****************************************************************************
+ * The sphere is replaced by its bounding box: the box corners give a screen rectangle that contains the sphere
+ * and a nearest depth that's never behind it. Occluded only if every pixel in the rectangle has something closer.
+ */
+bool CullingSystem::isOccluded(uint32_t index) const
+{
+	float radius = radii[index];
+	glm::vec4 clipCenter = viewProjection * glm::vec4(centersX[index], centersY[index], centersZ[index], 1.0f);
+	glm::vec4 axes[3] = { viewProjection[0] * radius, viewProjection[1] * radius, viewProjection[2] * radius };
+
+	float minX = std::numeric_limits<float>::max(), maxX = -minX;
+	float minY = minX, maxY = -minX;
+	float minDepth = minX;
+
+	for (int corner = 0; corner < 8; corner++)
+	{
+		glm::vec4 clip = clipCenter + axes[0] * ((corner & 1) ? 1.0f : -1.0f) + axes[1] * ((corner & 2) ? 1.0f : -1.0f)
+			+ axes[2] * ((corner & 4) ? 1.0f : -1.0f);
+
+		// Reaches through the near plane, too close to say anything
+		if (clip.z < 0.0f || clip.w <= 0.0f)
+		{
+			return false;
+		}
+
+		float invW = 1.0f / clip.w;
+		minX = std::min(minX, clip.x * invW);
+		maxX = std::max(maxX, clip.x * invW);
+		minY = std::min(minY, clip.y * invW);
+		maxY = std::max(maxY, clip.y * invW);
+		minDepth = std::min(minDepth, clip.z * invW);
+	}
+
+	// Occluders only cover the pixels whose centers they contain, the extra pixel around the rectangle
+	// makes sure a partly covered pixel at an occluder edge can't hide anything
+	int x0 = std::max(static_cast<int>(std::floor((minX * 0.5f + 0.5f) * depthWidth)) - 1, 0);
+	int x1 = std::min(static_cast<int>(std::floor((maxX * 0.5f + 0.5f) * depthWidth)) + 1, static_cast<int>(depthWidth) - 1);
+	int y0 = std::max(static_cast<int>(std::floor((minY * 0.5f + 0.5f) * depthHeight)) - 1, 0);
+	int y1 = std::min(static_cast<int>(std::floor((maxY * 0.5f + 0.5f) * depthHeight)) + 1, static_cast<int>(depthHeight) - 1);
+	if (x0 > x1 || y0 > y1)
+	{
+		return false;
+	}
+
+	for (int y = y0; y <= y1; y++)
+	{
+		const float* row = &depthBuffer[y * depthWidth];
+		for (int x = x0; x <= x1; x++)
+		{
+			if (row[x] >= minDepth)
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+void CullingSystem::cullOcclusion(JobSystem& jobSystem)
+{
+	auto start = Clock::now();
+
+	uint32_t candidateCount = static_cast<uint32_t>(visible.size());
+	uint32_t batchCount = (candidateCount + batchSize - 1) / batchSize;
+	batchVisibleCounts.resize(batchCount);
+
+	// Each batch only writes at or before the entry it's reading, so it can compact in place
+	jobSystem.parallelFor(batchCount, 1, [this, candidateCount](uint32_t firstBatch, uint32_t lastBatch)
+	{
+		for (uint32_t b = firstBatch; b < lastBatch; b++)
+		{
+			uint32_t begin = b * batchSize;
+			uint32_t end = std::min(begin + batchSize, candidateCount);
+			uint32_t count = 0;
+
+			for (uint32_t i = begin; i < end; i++)
+			{
+				uint32_t index = visible[i];
+				visible[begin + count] = index;
+				count += isOccluded(index) ? 0 : 1;
+			}
+
+			batchVisibleCounts[b] = count;
+		}
+	});
+
+	compactBatches(batchCount);
+
+	statistics.occlusionVisible = static_cast<uint32_t>(visible.size());
+	statistics.occlusionMilliseconds = millisecondsSince(start);
+}
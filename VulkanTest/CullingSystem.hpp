@@ -0,0 +1,78 @@
+#ifndef CULLING_SYSTEM
+#define CULLING_SYSTEM
+
+#include <cstdint>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include "JobSystem.hpp"
+
+/****************************************************************************************************
+ * CPU visibility culling of bounding spheres, producing a compact list of visible object indices.
+ * - The spheres are stored as structure-of-arrays, the frustum test runs on four of them at once with SSE.
+ * - Occlusion culling uses a coarse software depth buffer: the caller rasterizes a few occluders into it after
+ *   the frustum test, then every remaining sphere's screen rectangle is checked against the depth there.
+ * - Both tests are split into batches over the job system, each batch compacts its own output in place.
+ *
+ * Per frame: beginFrame, cullFrustum, optionally rasterizeOccluder and cullOcclusion, then getVisible.
+ */
+class CullingSystem
+{
+public:
+	struct Statistics
+	{
+		uint32_t objectCount = 0;
+		uint32_t frustumVisible = 0;
+		uint32_t occlusionVisible = 0; // Same as frustumVisible when occlusion culling didn't run
+		uint32_t occluderTriangles = 0; // Rasterized this frame
+		double frustumMilliseconds = 0.0;
+		double rasterizeMilliseconds = 0.0;
+		double occlusionMilliseconds = 0.0;
+	};
+
+	// Coarse on purpose, occluders only have to be roughly right and the test cost grows with the covered pixels
+	static const uint32_t depthWidth = 256;
+	static const uint32_t depthHeight = 128;
+
+	void resize(uint32_t count);
+	uint32_t getCount() const { return objectCount; }
+	void setSphere(uint32_t index, const glm::vec3& center, float radius);
+	// Spheres of objects sharing one local bounding sphere around their origin, e.g. instances of a centered mesh
+	void updateSpheres(JobSystem& jobSystem, const glm::mat4* worldMatrices, float localRadius);
+
+	// Extracts the frustum planes and clears the depth buffer
+	void beginFrame(const glm::mat4& viewProjection);
+	void cullFrustum(JobSystem& jobSystem);
+	// Triangles with a vertex behind the near plane are skipped, which only makes the occluder smaller
+	void rasterizeOccluder(const glm::vec3* vertices, const uint32_t* indices, uint32_t indexCount, const glm::mat4& world);
+	void cullOcclusion(JobSystem& jobSystem);
+
+	const std::vector<uint32_t>& getVisible() const { return visible; }
+	const Statistics& getStatistics() const { return statistics; }
+
+private:
+	static const uint32_t batchSize = 16384; // Objects per job, a multiple of 4
+
+	uint32_t cullFrustumRange(uint32_t begin, uint32_t end, uint32_t* output) const;
+	bool isOccluded(uint32_t index) const;
+	void compactBatches(uint32_t batchCount);
+
+	uint32_t objectCount = 0;
+	// Padded to a multiple of 4 with spheres that are never visible
+	std::vector<float> centersX;
+	std::vector<float> centersY;
+	std::vector<float> centersZ;
+	std::vector<float> radii;
+
+	glm::mat4 viewProjection = glm::mat4(1.0f);
+	glm::vec4 planes[6]; // Normalized, pointing inwards
+	std::vector<float> depthBuffer; // Normalized device depth, smaller is closer
+
+	std::vector<uint32_t> visible;
+	std::vector<uint32_t> batchVisibleCounts;
+	Statistics statistics;
+};
+
+#endif
@@ -0,0 +1,119 @@
+#include "DeletionQueue.hpp"
+
+#include <stdexcept>
+
+void DeletionQueue::init(VkDevice device, const VkAllocationCallbacks* allocator, QueueTimeline& timeline)
+{
+	this->device = device;
+	this->allocator = allocator;
+	this->timeline = &timeline;
+}
+
+void DeletionQueue::destroy()
+{
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		destroyObject(entries[i]);
+	}
+	entries.clear();
+	frameEnds.clear();
+}
+
+void DeletionQueue::pushObject(VkObjectType type, uint64_t handle, uint64_t frame)
+{
+	if (!entries.empty() && frame < entries.back().frame)
+	{
+		throw std::runtime_error("Deletion queue frames must not decrease!");
+	}
+
+	entries.push_back({ type, handle, frame });
+}
+
+void DeletionQueue::signalFrame(uint64_t frame)
+{
+	frameEnds.push_back({ frame, timeline->getSubmittedValue() });
+}
+
+void DeletionQueue::collect()
+{
+	// The timeline only moves forward, so the first unfinished frame ends the search
+	while (!frameEnds.empty() && timeline->isComplete(frameEnds.front().timelineValue))
+	{
+		completedFrame = frameEnds.front().frame;
+		anyFrameCompleted = true;
+		frameEnds.pop_front();
+	}
+
+	while (anyFrameCompleted && !entries.empty() && entries.front().frame <= completedFrame)
+	{
+		destroyObject(entries.front());
+		entries.pop_front();
+		destroyedObjects++;
+	}
+}
+
+DeletionQueue::Statistics DeletionQueue::getStatistics() const
+{
+	Statistics statistics;
+	statistics.pendingObjects = static_cast<uint32_t>(entries.size());
+	statistics.destroyedObjects = destroyedObjects;
+	statistics.completedFrame = completedFrame;
+	return statistics;
+}
+
+void DeletionQueue::destroyObject(const Entry& entry)
+{
+	switch (entry.type)
+	{
+	case VK_OBJECT_TYPE_BUFFER:
+		vkDestroyBuffer(device, reinterpret_cast<VkBuffer>(entry.handle), allocator);
+		break;
+	case VK_OBJECT_TYPE_BUFFER_VIEW:
+		vkDestroyBufferView(device, reinterpret_cast<VkBufferView>(entry.handle), allocator);
+		break;
+	case VK_OBJECT_TYPE_IMAGE:
+		vkDestroyImage(device, reinterpret_cast<VkImage>(entry.handle), allocator);
+		break;
+	case VK_OBJECT_TYPE_IMAGE_VIEW:
+		vkDestroyImageView(device, reinterpret_cast<VkImageView>(entry.handle), allocator);
+		break;
+	case VK_OBJECT_TYPE_DEVICE_MEMORY:
+		vkFreeMemory(device, reinterpret_cast<VkDeviceMemory>(entry.handle), allocator);
+		break;
+	case VK_OBJECT_TYPE_SAMPLER:
+		vkDestroySampler(device, reinterpret_cast<VkSampler>(entry.handle), allocator);
+		break;
+	case VK_OBJECT_TYPE_FRAMEBUFFER:
+		vkDestroyFramebuffer(device, reinterpret_cast<VkFramebuffer>(entry.handle), allocator);
+		break;
+	case VK_OBJECT_TYPE_RENDER_PASS:
+		vkDestroyRenderPass(device, reinterpret_cast<VkRenderPass>(entry.handle), allocator);
+		break;
+	case VK_OBJECT_TYPE_PIPELINE:
+		vkDestroyPipeline(device, reinterpret_cast<VkPipeline>(entry.handle), allocator);
+		break;
+	case VK_OBJECT_TYPE_PIPELINE_LAYOUT:
+		vkDestroyPipelineLayout(device, reinterpret_cast<VkPipelineLayout>(entry.handle), allocator);
+		break;
+	case VK_OBJECT_TYPE_SHADER_MODULE:
+		vkDestroyShaderModule(device, reinterpret_cast<VkShaderModule>(entry.handle), allocator);
+		break;
+	case VK_OBJECT_TYPE_DESCRIPTOR_POOL:
+		vkDestroyDescriptorPool(device, reinterpret_cast<VkDescriptorPool>(entry.handle), allocator);
+		break;
+	case VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT:
+		vkDestroyDescriptorSetLayout(device, reinterpret_cast<VkDescriptorSetLayout>(entry.handle), allocator);
+		break;
+	case VK_OBJECT_TYPE_QUERY_POOL:
+		vkDestroyQueryPool(device, reinterpret_cast<VkQueryPool>(entry.handle), allocator);
+		break;
+	case VK_OBJECT_TYPE_SEMAPHORE:
+		vkDestroySemaphore(device, reinterpret_cast<VkSemaphore>(entry.handle), allocator);
+		break;
+	case VK_OBJECT_TYPE_SWAPCHAIN_KHR:
+		vkDestroySwapchainKHR(device, reinterpret_cast<VkSwapchainKHR>(entry.handle), allocator);
+		break;
+	default:
+		throw std::runtime_error("Unsupported object type in the deletion queue!");
+	}
+}
@@ -0,0 +1,83 @@
+#ifndef DELETION_QUEUE
+#define DELETION_QUEUE
+
+#include "VulkanDispatch.hpp"
+
+#include <cstdint>
+#include <vector>
+
+#include "QueueTimeline.hpp"
+#include "RingQueue.hpp"
+
+/****************************************************************************************************
+ * Deferred destruction of Vulkan objects.
+ * Each handle is tagged with the last frame that may still use it, and it's destroyed once the GPU has finished
+ * that frame. A frame has finished once the queue timeline reaches the last value submitted in it, so replacing
+ * resources at runtime never needs vkDeviceWaitIdle.
+ *
+ * Frame numbers must never decrease - the queue is kept in frame order and only ever looked at from the front.
+ * Objects of the same frame are destroyed in the order they were pushed, so views go before their images
+ * and images before their memory.
+ */
+class DeletionQueue
+{
+public:
+	struct Statistics
+	{
+		uint32_t pendingObjects = 0;
+		uint64_t destroyedObjects = 0;
+		uint64_t completedFrame = 0;
+	};
+
+	void init(VkDevice device, const VkAllocationCallbacks* allocator, QueueTimeline& timeline);
+	void destroy(); // Destroys everything still queued, the device must be idle
+
+	// Handles of any type listed in destroyObject(), e.g. push(VK_OBJECT_TYPE_IMAGE, image, frame)
+	template <typename Handle>
+	void push(VkObjectType type, Handle handle, uint64_t frame)
+	{
+		if (handle != VK_NULL_HANDLE)
+		{
+			pushObject(type, reinterpret_cast<uint64_t>(handle), frame);
+		}
+	}
+
+	// Marks the end of the frame, after its last submission to the timeline
+	void signalFrame(uint64_t frame);
+	// Destroys the objects of every finished frame, call once per frame
+	void collect();
+
+	uint64_t getCompletedFrame() const { return completedFrame; }
+	bool isFrameComplete(uint64_t frame) const { return anyFrameCompleted && frame <= completedFrame; }
+	Statistics getStatistics() const;
+
+private:
+	struct Entry
+	{
+		VkObjectType type;
+		uint64_t handle;
+		uint64_t frame;
+	};
+
+	struct FrameEnd
+	{
+		uint64_t frame;
+		uint64_t timelineValue;
+	};
+
+	void pushObject(VkObjectType type, uint64_t handle, uint64_t frame);
+	void destroyObject(const Entry& entry);
+
+	VkDevice device = VK_NULL_HANDLE;
+	const VkAllocationCallbacks* allocator = nullptr;
+	QueueTimeline* timeline = nullptr;
+
+	RingQueue<Entry> entries; // Oldest frame first
+	RingQueue<FrameEnd> frameEnds; // Oldest first
+
+	uint64_t completedFrame = 0;
+	uint64_t destroyedObjects = 0;
+	bool anyFrameCompleted = false; // Frame 0 is a valid tag, so it can't double as "nothing finished yet"
+};
+
+#endif
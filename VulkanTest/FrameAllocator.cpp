@@ -0,0 +1,32 @@
+#include "FrameAllocator.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+void FrameAllocator::init(size_t capacity)
+{
+	memory.reset(new unsigned char[capacity]);
+	this->capacity = capacity;
+	offset = 0;
+	statistics.capacity = capacity;
+}
+
+void FrameAllocator::reset()
+{
+	statistics.peakBytes = std::max(statistics.peakBytes, offset);
+	statistics.frames++;
+	offset = 0;
+}
+
+void* FrameAllocator::allocate(size_t size, size_t alignment)
+{
+	// The block comes from new[], which aligns for any fundamental type, so aligning the offset is enough
+	size_t start = (offset + alignment - 1) & ~(alignment - 1);
+	if (start + size > capacity)
+	{
+		throw std::runtime_error("Frame allocator is out of memory!");
+	}
+
+	offset = start + size;
+	return memory.get() + start;
+}
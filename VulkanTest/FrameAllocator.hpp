@@ -0,0 +1,51 @@
+#ifndef FRAME_ALLOCATOR
+#define FRAME_ALLOCATOR
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+/****************************************************************************************************
+ * Linear allocator for transient CPU data of one frame - sort keys, candidate lists, scratch arrays.
+ * - One block is allocated up front, allocating just moves an offset forward and nothing is freed individually.
+ * - reset() at the start of every frame makes the whole block available again, so anything allocated from it
+ *   is only valid until then.
+ * - Running out is an error, not a reason to fall back to the heap: the capacity is sized for the worst frame.
+ *
+ * Only for trivially destructible types, nothing allocated here is ever destroyed. Render thread only.
+ */
+class FrameAllocator
+{
+public:
+	struct Statistics
+	{
+		size_t capacity = 0;
+		size_t peakBytes = 0; // Most used in one frame
+		uint64_t frames = 0;
+	};
+
+	void init(size_t capacity);
+	void reset();
+
+	void* allocate(size_t size, size_t alignment);
+	// Uninitialized
+	template <typename T>
+	T* allocate(size_t count)
+	{
+		static_assert(std::is_trivially_destructible<T>::value, "Frame allocations are never destroyed");
+		return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+	}
+
+	size_t getUsedBytes() const { return offset; }
+	const Statistics& getStatistics() const { return statistics; }
+
+private:
+	std::unique_ptr<unsigned char[]> memory;
+	size_t capacity = 0;
+	size_t offset = 0;
+
+	Statistics statistics;
+};
+
+#endif
@@ -0,0 +1,490 @@
+#include "FrameCapture.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+
+// ==== SETUP ====
+
+void FrameCapture::init(VkDevice device, const VkAllocationCallbacks* allocator, VkPhysicalDevice physicalDevice, uint32_t queueFamilyIndex, VkExtent2D extent, VkFormat format, const Config& config)
+{
+	this->device = device;
+	this->allocator = allocator;
+	this->physicalDevice = physicalDevice;
+	this->extent = extent;
+	this->format = format;
+	this->config = config;
+
+	// Only the usual 8 bit swap chain formats are converted, raw streams keep whatever the swap chain has
+	const char* pixelFormat = nullptr;
+	switch (format)
+	{
+	case VK_FORMAT_B8G8R8A8_UNORM:
+	case VK_FORMAT_B8G8R8A8_SRGB:
+		swapRedBlue = true;
+		pixelFormat = "bgra";
+		break;
+	case VK_FORMAT_R8G8B8A8_UNORM:
+	case VK_FORMAT_R8G8B8A8_SRGB:
+		swapRedBlue = false;
+		pixelFormat = "rgba";
+		break;
+	default:
+		if (config.format == Format::Png)
+		{
+			throw std::runtime_error("Swap chain format can't be captured as PNG!");
+		}
+		break;
+	}
+
+	frameSize = static_cast<VkDeviceSize>(extent.width) * extent.height * 4;
+
+	VkCommandPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.queueFamilyIndex = queueFamilyIndex;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+	if (vkCreateCommandPool(device, &poolInfo, allocator, &commandPool) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create frame capture command pool!");
+	}
+
+	slots = std::vector<Slot>(std::max(config.ringSize, 1u));
+	writeQueue.reserve(slots.size()); // Every slot at once at most, queueing never allocates
+	for (auto& slot : slots)
+	{
+		VkBufferCreateInfo bufferInfo = {};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = frameSize;
+		bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		if (vkCreateBuffer(device, &bufferInfo, allocator, &slot.buffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create frame capture buffer!");
+		}
+
+		VkMemoryRequirements memRequirements;
+		vkGetBufferMemoryRequirements(device, slot.buffer, &memRequirements);
+
+		// The CPU reads every byte of these, so cached memory is much faster - it just needs an explicit invalidate
+		// when it isn't coherent too
+		uint32_t typeIndex = 0;
+		VkMemoryPropertyFlags typeFlags = 0;
+		if (!findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT, typeIndex, typeFlags) &&
+			!findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, typeIndex, typeFlags))
+		{
+			throw std::runtime_error("Failed to find suitable memory type!");
+		}
+		coherent = (typeFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+
+		VkMemoryAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = memRequirements.size;
+		allocInfo.memoryTypeIndex = typeIndex;
+
+		if (vkAllocateMemory(device, &allocInfo, allocator, &slot.memory) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to allocate frame capture memory!");
+		}
+
+		vkBindBufferMemory(device, slot.buffer, slot.memory, 0);
+		vkMapMemory(device, slot.memory, 0, VK_WHOLE_SIZE, 0, reinterpret_cast<void**>(&slot.data));
+
+		VkCommandBufferAllocateInfo commandBufferInfo = {};
+		commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		commandBufferInfo.commandPool = commandPool;
+		commandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		commandBufferInfo.commandBufferCount = 1;
+
+		VkFenceCreateInfo fenceInfo = {};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+		if (vkAllocateCommandBuffers(device, &commandBufferInfo, &slot.commandBuffer) != VK_SUCCESS ||
+			vkCreateFence(device, &fenceInfo, allocator, &slot.fence) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create frame capture command buffers!");
+		}
+	}
+
+	if (config.format == Format::Raw)
+	{
+		std::string path = config.outputPath + ".raw";
+		rawFile.open(path, std::ios::binary | std::ios::trunc);
+		if (!rawFile.is_open())
+		{
+			throw std::runtime_error("Failed to open file " + path);
+		}
+
+		if (pixelFormat != nullptr)
+		{
+			std::cout << "Capturing to " << path << ", play with: ffmpeg -f rawvideo -pix_fmt " << pixelFormat
+				<< " -s " << extent.width << "x" << extent.height << " -i " << path << "\n";
+		}
+	}
+
+	stopWriter = false;
+	writer = std::thread(&FrameCapture::writerLoop, this);
+}
+
+/****************************************************************************
+ * Must be called once the device is idle. The frames still in flight are written out before returning.
+ */
+void FrameCapture::destroy()
+{
+	if (slots.empty())
+	{
+		return;
+	}
+
+	update();
+
+	{
+		std::lock_guard<std::mutex> lock(writeMutex);
+		stopWriter = true;
+	}
+	writeCondition.notify_all();
+	writer.join();
+
+	for (auto& slot : slots)
+	{
+		vkDestroyFence(device, slot.fence, allocator);
+		vkUnmapMemory(device, slot.memory);
+		vkDestroyBuffer(device, slot.buffer, allocator);
+		vkFreeMemory(device, slot.memory, allocator);
+	}
+	slots.clear();
+
+	vkDestroyCommandPool(device, commandPool, allocator);
+	rawFile.close();
+}
+
+bool FrameCapture::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties, uint32_t& typeIndex, VkMemoryPropertyFlags& typeFlags) const
+{
+	VkPhysicalDeviceMemoryProperties memProperties;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
+	{
+		if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
+		{
+			typeIndex = i;
+			typeFlags = memProperties.memoryTypes[i].propertyFlags;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+// ==== CAPTURE ====
+
+void FrameCapture::update()
+{
+	for (auto& slot : slots)
+	{
+		if (slot.state.load(std::memory_order_acquire) != SlotState::Copying || vkGetFenceStatus(device, slot.fence) != VK_SUCCESS)
+		{
+			continue;
+		}
+
+		if (!coherent)
+		{
+			VkMappedMemoryRange range = {};
+			range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+			range.memory = slot.memory;
+			range.offset = 0;
+			range.size = VK_WHOLE_SIZE;
+			vkInvalidateMappedMemoryRanges(device, 1, &range);
+		}
+
+		slot.state.store(SlotState::Writing, std::memory_order_release);
+		{
+			std::lock_guard<std::mutex> lock(writeMutex);
+			writeQueue.push_back(&slot);
+		}
+		writeCondition.notify_one();
+	}
+}
+
+/****************************************************************************
+ * The slots are used strictly in order, so the frames reach the writer in order as well.
+ * If the next one is still busy, the writer (or the GPU) is behind and this frame is skipped.
+ */
+bool FrameCapture::recordCapture(VkImage image, uint64_t frame, VkCommandBuffer& commandBuffer, VkFence& fence)
+{
+	Slot& slot = slots[nextSlot];
+	if (slot.state.load(std::memory_order_acquire) != SlotState::Free)
+	{
+		std::lock_guard<std::mutex> lock(statisticsMutex);
+		statistics.droppedFrames++;
+		return false;
+	}
+	nextSlot = (nextSlot + 1) % static_cast<uint32_t>(slots.size());
+
+	vkResetFences(device, 1, &slot.fence);
+	vkResetCommandBuffer(slot.commandBuffer, 0);
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	if (vkBeginCommandBuffer(slot.commandBuffer, &beginInfo) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to begin recording frame capture command buffer!");
+	}
+
+	// The frame's commands were submitted earlier to the same queue, so this barrier waits for whatever wrote the image last:
+	// the main pass, the tonemap shader writing it directly, the backbuffer blit after post-processing or the dynamic resolution upscale
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = 1;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+	barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+	VkPipelineStageFlags writeStages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+	vkCmdPipelineBarrier(slot.commandBuffer, writeStages, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+		0, nullptr, 0, nullptr, 1, &barrier);
+
+	VkBufferImageCopy region = {};
+	region.bufferOffset = 0;
+	region.bufferRowLength = 0; // Tightly packed
+	region.bufferImageHeight = 0;
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = 1;
+	region.imageOffset = { 0, 0, 0 };
+	region.imageExtent = { extent.width, extent.height, 1 };
+
+	vkCmdCopyImageToBuffer(slot.commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot.buffer, 1, &region);
+
+	// Back to the present layout, the present waits on the semaphore signaled after this
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = 0;
+
+	VkBufferMemoryBarrier bufferBarrier = {};
+	bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferBarrier.buffer = slot.buffer;
+	bufferBarrier.offset = 0;
+	bufferBarrier.size = VK_WHOLE_SIZE;
+
+	vkCmdPipelineBarrier(slot.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0,
+		0, nullptr, 1, &bufferBarrier, 1, &barrier);
+
+	if (vkEndCommandBuffer(slot.commandBuffer) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to record frame capture command buffer!");
+	}
+
+	slot.frame = frame;
+	slot.state.store(SlotState::Copying, std::memory_order_release);
+
+	{
+		std::lock_guard<std::mutex> lock(statisticsMutex);
+		statistics.capturedFrames++;
+	}
+
+	commandBuffer = slot.commandBuffer;
+	fence = slot.fence;
+	return true;
+}
+
+FrameCapture::Statistics FrameCapture::getStatistics() const
+{
+	std::lock_guard<std::mutex> lock(statisticsMutex);
+	return statistics;
+}
+
+
+// ==== WRITER ====
+
+void FrameCapture::writerLoop()
+{
+	while (true)
+	{
+		Slot* slot = nullptr;
+		{
+			std::unique_lock<std::mutex> lock(writeMutex);
+			writeCondition.wait(lock, [this] { return stopWriter || !writeQueue.empty(); });
+
+			// Everything queued is written before stopping, those frames were already paid for
+			if (writeQueue.empty())
+			{
+				return;
+			}
+
+			slot = writeQueue.front();
+			writeQueue.pop_front();
+		}
+
+		try
+		{
+			writeFrame(*slot);
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << e.what() << std::endl;
+		}
+
+		slot->state.store(SlotState::Free, std::memory_order_release);
+	}
+}
+
+void FrameCapture::writeFrame(const Slot& slot)
+{
+	uint64_t bytes = 0;
+
+	if (config.format == Format::Raw)
+	{
+		rawFile.write(reinterpret_cast<const char*>(slot.data), static_cast<std::streamsize>(frameSize));
+		bytes = frameSize;
+	}
+	else
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "_%06llu.png", static_cast<unsigned long long>(slot.frame));
+		writePng(config.outputPath + name, slot.data);
+		bytes = encoded.size();
+	}
+
+	std::lock_guard<std::mutex> lock(statisticsMutex);
+	statistics.writtenFrames++;
+	statistics.bytesWritten += bytes;
+}
+
+static uint32_t crc32(uint32_t crc, const uint8_t* data, size_t size)
+{
+	static const std::vector<uint32_t> table = []
+	{
+		std::vector<uint32_t> values(256);
+		for (uint32_t i = 0; i < 256; i++)
+		{
+			uint32_t value = i;
+			for (int bit = 0; bit < 8; bit++)
+			{
+				value = (value & 1) ? 0xEDB88320u ^ (value >> 1) : value >> 1;
+			}
+			values[i] = value;
+		}
+		return values;
+	}();
+
+	crc = ~crc;
+	for (size_t i = 0; i < size; i++)
+	{
+		crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+static void appendBigEndian(std::vector<uint8_t>& output, uint32_t value)
+{
+	output.insert(output.end(), { static_cast<uint8_t>(value >> 24), static_cast<uint8_t>(value >> 16), static_cast<uint8_t>(value >> 8), static_cast<uint8_t>(value) });
+}
+
+static void appendChunk(std::vector<uint8_t>& output, const char* type, const uint8_t* data, size_t size)
+{
+	appendBigEndian(output, static_cast<uint32_t>(size));
+	size_t typeOffset = output.size();
+	output.insert(output.end(), type, type + 4);
+	output.insert(output.end(), data, data + size);
+	appendBigEndian(output, crc32(0, output.data() + typeOffset, size + 4));
+}
+
+/****************************************************************************
+ * 8 bit RGB PNG with the image data in stored (uncompressed) deflate blocks.
+ * Any PNG reader can open it and the writer never has to spend time compressing - the frames are meant
+ * to be re-encoded into a video afterwards anyway.
+ */
+void FrameCapture::writePng(const std::string& path, const uint8_t* pixels)
+{
+	const size_t rowSize = static_cast<size_t>(extent.width) * 3 + 1; // Filter type byte, then the pixels
+
+	scanlines.resize(rowSize * extent.height);
+	for (uint32_t y = 0; y < extent.height; y++)
+	{
+		const uint8_t* source = pixels + static_cast<size_t>(y) * extent.width * 4;
+		uint8_t* destination = &scanlines[y * rowSize];
+
+		*destination++ = 0; // No filter
+		for (uint32_t x = 0; x < extent.width; x++, source += 4, destination += 3)
+		{
+			destination[0] = source[swapRedBlue ? 2 : 0];
+			destination[1] = source[1];
+			destination[2] = source[swapRedBlue ? 0 : 2];
+		}
+	}
+
+	// zlib stream: header, stored blocks of at most 65535 bytes and the Adler-32 of the uncompressed data
+	std::vector<uint8_t> zlib;
+	zlib.reserve(scanlines.size() + (scanlines.size() / 65535 + 1) * 5 + 6);
+	zlib.insert(zlib.end(), { 0x78, 0x01 });
+
+	uint32_t adlerA = 1;
+	uint32_t adlerB = 0;
+	size_t offset = 0;
+	do
+	{
+		size_t blockSize = std::min<size_t>(scanlines.size() - offset, 65535);
+		bool last = offset + blockSize == scanlines.size();
+		uint16_t length = static_cast<uint16_t>(blockSize);
+
+		zlib.push_back(last ? 1 : 0);
+		zlib.insert(zlib.end(), { static_cast<uint8_t>(length), static_cast<uint8_t>(length >> 8),
+			static_cast<uint8_t>(~length), static_cast<uint8_t>(~length >> 8) });
+		zlib.insert(zlib.end(), scanlines.begin() + offset, scanlines.begin() + offset + blockSize);
+
+		for (size_t i = offset; i < offset + blockSize; i++)
+		{
+			adlerA = (adlerA + scanlines[i]) % 65521;
+			adlerB = (adlerB + adlerA) % 65521;
+		}
+
+		offset += blockSize;
+	} while (offset < scanlines.size());
+
+	appendBigEndian(zlib, (adlerB << 16) | adlerA);
+
+	uint8_t header[13] = {};
+	header[0] = static_cast<uint8_t>(extent.width >> 24);
+	header[1] = static_cast<uint8_t>(extent.width >> 16);
+	header[2] = static_cast<uint8_t>(extent.width >> 8);
+	header[3] = static_cast<uint8_t>(extent.width);
+	header[4] = static_cast<uint8_t>(extent.height >> 24);
+	header[5] = static_cast<uint8_t>(extent.height >> 16);
+	header[6] = static_cast<uint8_t>(extent.height >> 8);
+	header[7] = static_cast<uint8_t>(extent.height);
+	header[8] = 8; // Bit depth
+	header[9] = 2; // Truecolor, the swap chain alpha isn't meaningful
+
+	static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	encoded.assign(signature, signature + 8);
+	appendChunk(encoded, "IHDR", header, sizeof(header));
+	appendChunk(encoded, "IDAT", zlib.data(), zlib.size());
+	appendChunk(encoded, "IEND", nullptr, 0);
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		throw std::runtime_error("Failed to open file " + path);
+	}
+	file.write(reinterpret_cast<const char*>(encoded.data()), static_cast<std::streamsize>(encoded.size()));
+}
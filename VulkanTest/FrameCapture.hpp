@@ -0,0 +1,113 @@
+#ifndef FRAME_CAPTURE
+#define FRAME_CAPTURE
+
+#include "VulkanDispatch.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "RingQueue.hpp"
+
+/****************************************************************************************************
+ * Asynchronous frame capture.
+ * - The presented image is copied into one of a ring of host visible buffers, right after the frame's commands.
+ * - The copies are tracked with fences, which are only ever polled.
+ * - A writer thread encodes the finished copies and writes them to disk - as one raw video stream or a PNG sequence.
+ *
+ * Nothing here waits: when every buffer is still being copied or written, the frame is simply not captured
+ * and counted as dropped, so a slow disk never slows down the rendering.
+ */
+class FrameCapture
+{
+public:
+	enum class Format
+	{
+		Raw, // All frames appended to one file, playable with e.g. ffmpeg -f rawvideo
+		Png // One file per frame
+	};
+
+	struct Config
+	{
+		Format format = Format::Raw;
+		std::string outputPath = "capture"; // Raw file name or PNG file prefix, without the extension
+		uint32_t ringSize = 4;
+	};
+
+	struct Statistics
+	{
+		uint64_t capturedFrames = 0; // Copies submitted to the GPU
+		uint64_t writtenFrames = 0;
+		uint64_t droppedFrames = 0; // No free buffer - the writer fell behind
+		uint64_t bytesWritten = 0;
+	};
+
+	void init(VkDevice device, const VkAllocationCallbacks* allocator, VkPhysicalDevice physicalDevice, uint32_t queueFamilyIndex, VkExtent2D extent, VkFormat format, const Config& config);
+	void destroy();
+
+	// Hands the finished copies over to the writer, call once per frame
+	void update();
+	// Records a copy of the image (in the present layout, left the same way) into a free buffer.
+	// Returns false if the frame is dropped, otherwise the command buffer must be submitted with the fence
+	// after the frame's commands and before the present.
+	bool recordCapture(VkImage image, uint64_t frame, VkCommandBuffer& commandBuffer, VkFence& fence);
+
+	Statistics getStatistics() const;
+
+private:
+	enum class SlotState
+	{
+		Free,
+		Copying, // GPU copy in flight
+		Writing // Owned by the writer thread
+	};
+
+	struct Slot
+	{
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		uint8_t* data = nullptr; // Persistently mapped
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		VkFence fence = VK_NULL_HANDLE;
+		std::atomic<SlotState> state{ SlotState::Free };
+		uint64_t frame = 0;
+	};
+
+	void writerLoop();
+	void writeFrame(const Slot& slot);
+	void writePng(const std::string& path, const uint8_t* pixels);
+	bool findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties, uint32_t& typeIndex, VkMemoryPropertyFlags& typeFlags) const;
+
+	VkDevice device = VK_NULL_HANDLE;
+	const VkAllocationCallbacks* allocator = nullptr;
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	VkExtent2D extent = {};
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	bool swapRedBlue = false; // BGRA swap chains are written as RGBA
+	bool coherent = true;
+	VkDeviceSize frameSize = 0;
+	Config config;
+
+	VkCommandPool commandPool = VK_NULL_HANDLE;
+	std::vector<Slot> slots; // Never resized after init, the writer keeps pointers into it
+	uint32_t nextSlot = 0;
+
+	std::thread writer;
+	std::mutex writeMutex;
+	std::condition_variable writeCondition;
+	RingQueue<Slot*> writeQueue;
+	bool stopWriter = false;
+	std::ofstream rawFile;
+	std::vector<uint8_t> scanlines; // PNG encoding buffers, writer thread only
+	std::vector<uint8_t> encoded;
+
+	mutable std::mutex statisticsMutex;
+	Statistics statistics;
+};
+
+#endif
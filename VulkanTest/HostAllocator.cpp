@@ -0,0 +1,254 @@
+#include "HostAllocator.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+static void* allocateAligned(size_t size, size_t alignment)
+{
+#ifdef _MSC_VER
+	return _aligned_malloc(size, alignment);
+#else
+	// aligned_alloc needs the size to be a multiple of the alignment
+	return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+#endif
+}
+
+static void freeAligned(void* pointer)
+{
+#ifdef _MSC_VER
+	_aligned_free(pointer);
+#else
+	std::free(pointer);
+#endif
+}
+
+void HostAllocator::init()
+{
+	callbacks.pUserData = this;
+	callbacks.pfnAllocation = &HostAllocator::allocate;
+	callbacks.pfnReallocation = &HostAllocator::reallocate;
+	callbacks.pfnFree = &HostAllocator::free;
+	callbacks.pfnInternalAllocation = &HostAllocator::internalAllocate;
+	callbacks.pfnInternalFree = &HostAllocator::internalFree;
+}
+
+void HostAllocator::destroy()
+{
+	for (auto& sizeClass : classes)
+	{
+		unsigned char* chunk = sizeClass.chunk;
+		while (chunk != nullptr)
+		{
+			unsigned char* previous;
+			std::memcpy(&previous, chunk + chunkLinkOffset, sizeof(previous));
+			freeAligned(chunk);
+			chunk = previous;
+		}
+		sizeClass.freeList = nullptr;
+		sizeClass.chunk = nullptr;
+		sizeClass.chunkOffset = chunkSize;
+	}
+}
+
+HostAllocator::Statistics HostAllocator::getStatistics() const
+{
+	Statistics statistics;
+	for (uint32_t s = 0; s < scopeCount; s++)
+	{
+		statistics.scopes[s].allocations = scopes[s].allocations.load(std::memory_order_relaxed);
+		statistics.scopes[s].currentBytes = scopes[s].currentBytes.load(std::memory_order_relaxed);
+		statistics.scopes[s].peakBytes = scopes[s].peakBytes.load(std::memory_order_relaxed);
+		statistics.scopes[s].internalBytes = scopes[s].internalBytes.load(std::memory_order_relaxed);
+	}
+	statistics.pooledAllocations = pooledAllocations.load(std::memory_order_relaxed);
+	statistics.heapAllocations = heapAllocations.load(std::memory_order_relaxed);
+	statistics.chunkBytes = chunkBytes.load(std::memory_order_relaxed);
+	return statistics;
+}
+
+const char* HostAllocator::getScopeName(VkSystemAllocationScope scope)
+{
+	switch (scope)
+	{
+	case VK_SYSTEM_ALLOCATION_SCOPE_COMMAND: return "command";
+	case VK_SYSTEM_ALLOCATION_SCOPE_OBJECT: return "object";
+	case VK_SYSTEM_ALLOCATION_SCOPE_CACHE: return "cache";
+	case VK_SYSTEM_ALLOCATION_SCOPE_DEVICE: return "device";
+	case VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE: return "instance";
+	default: return "unknown";
+	}
+}
+
+// ==== CALLBACKS ====
+
+VKAPI_ATTR void* VKAPI_CALL HostAllocator::allocate(void* userData, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+	if (size == 0)
+	{
+		return nullptr;
+	}
+	return static_cast<HostAllocator*>(userData)->allocateBlock(size, alignment, scope);
+}
+
+/****************************************************************************
+ * Always moves to a new block - the size class may change, and so may the scope the memory is charged to.
+ * If the new block can't be allocated the original stays untouched, as the spec requires.
+ */
+VKAPI_ATTR void* VKAPI_CALL HostAllocator::reallocate(void* userData, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+	HostAllocator* allocator = static_cast<HostAllocator*>(userData);
+	if (original == nullptr)
+	{
+		return allocate(userData, size, alignment, scope);
+	}
+	if (size == 0)
+	{
+		allocator->freeBlock(original);
+		return nullptr;
+	}
+
+	void* memory = allocator->allocateBlock(size, alignment, scope);
+	if (memory == nullptr)
+	{
+		return nullptr;
+	}
+
+	const Header* header = reinterpret_cast<const Header*>(static_cast<unsigned char*>(original) - sizeof(Header));
+	std::memcpy(memory, original, std::min(size, header->size));
+	allocator->freeBlock(original);
+	return memory;
+}
+
+VKAPI_ATTR void VKAPI_CALL HostAllocator::free(void* userData, void* memory)
+{
+	if (memory != nullptr)
+	{
+		static_cast<HostAllocator*>(userData)->freeBlock(memory);
+	}
+}
+
+VKAPI_ATTR void VKAPI_CALL HostAllocator::internalAllocate(void* userData, size_t size, VkInternalAllocationType, VkSystemAllocationScope scope)
+{
+	static_cast<HostAllocator*>(userData)->scopes[scope].internalBytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+VKAPI_ATTR void VKAPI_CALL HostAllocator::internalFree(void* userData, size_t size, VkInternalAllocationType, VkSystemAllocationScope scope)
+{
+	static_cast<HostAllocator*>(userData)->scopes[scope].internalBytes.fetch_sub(size, std::memory_order_relaxed);
+}
+
+// ==== BLOCKS ====
+
+/****************************************************************************
+ * The header sits right in front of the returned pointer. Its offset into the block is a multiple of the alignment,
+ * and pooled blocks are aligned to their class size, which is at least the alignment.
+ */
+void* HostAllocator::allocateBlock(size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+	alignment = std::max(alignment, alignof(Header));
+	size_t offset = (sizeof(Header) + alignment - 1) / alignment * alignment;
+	size_t blockSize = offset + size;
+
+	uint32_t sizeClass = 0;
+	while (sizeClass < classCount && (minClassSize << sizeClass) < std::max(blockSize, alignment))
+	{
+		sizeClass++;
+	}
+
+	unsigned char* block;
+	if (sizeClass < classCount)
+	{
+		block = takeFromClass(sizeClass);
+		pooledAllocations.fetch_add(1, std::memory_order_relaxed);
+	}
+	else
+	{
+		// The offset is a power of two at least as large as the alignment, so it's reused as the block's alignment
+		block = static_cast<unsigned char*>(allocateAligned(blockSize, offset));
+		sizeClass = heapClass;
+		heapAllocations.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	if (block == nullptr)
+	{
+		return nullptr;
+	}
+
+	Header* header = reinterpret_cast<Header*>(block + offset - sizeof(Header));
+	header->size = size;
+	header->sizeClass = sizeClass;
+	header->scope = static_cast<uint32_t>(scope);
+	header->offset = offset;
+
+	AtomicScope& stats = scopes[scope];
+	stats.allocations.fetch_add(1, std::memory_order_relaxed);
+	size_t current = stats.currentBytes.fetch_add(size, std::memory_order_relaxed) + size;
+	size_t peak = stats.peakBytes.load(std::memory_order_relaxed);
+	while (current > peak && !stats.peakBytes.compare_exchange_weak(peak, current, std::memory_order_relaxed))
+	{
+	}
+
+	return block + offset;
+}
+
+void HostAllocator::freeBlock(void* memory)
+{
+	const Header* header = reinterpret_cast<const Header*>(static_cast<unsigned char*>(memory) - sizeof(Header));
+	unsigned char* block = static_cast<unsigned char*>(memory) - header->offset;
+
+	scopes[header->scope].currentBytes.fetch_sub(header->size, std::memory_order_relaxed);
+
+	if (header->sizeClass == heapClass)
+	{
+		freeAligned(block);
+	}
+	else
+	{
+		returnToClass(header->sizeClass, block);
+	}
+}
+
+unsigned char* HostAllocator::takeFromClass(uint32_t sizeClass)
+{
+	SizeClass& pool = classes[sizeClass];
+	size_t blockSize = minClassSize << sizeClass;
+	std::lock_guard<std::mutex> lock(pool.mutex);
+
+	if (pool.freeList != nullptr)
+	{
+		FreeBlock* block = pool.freeList;
+		pool.freeList = block->next;
+		return reinterpret_cast<unsigned char*>(block);
+	}
+
+	if (pool.chunkOffset + blockSize > chunkLinkOffset)
+	{
+		// Aligned to the largest class, so every block is aligned to its own size
+		unsigned char* chunk = static_cast<unsigned char*>(allocateAligned(chunkSize, maxPooledSize));
+		if (chunk == nullptr)
+		{
+			return nullptr;
+		}
+
+		// Linked through the chunks themselves, so keeping track of them doesn't allocate either
+		std::memcpy(chunk + chunkLinkOffset, &pool.chunk, sizeof(pool.chunk));
+		pool.chunk = chunk;
+		pool.chunkOffset = 0;
+		chunkBytes.fetch_add(chunkSize, std::memory_order_relaxed);
+	}
+
+	unsigned char* block = pool.chunk + pool.chunkOffset;
+	pool.chunkOffset += blockSize;
+	return block;
+}
+
+void HostAllocator::returnToClass(uint32_t sizeClass, unsigned char* block)
+{
+	SizeClass& pool = classes[sizeClass];
+	std::lock_guard<std::mutex> lock(pool.mutex);
+
+	FreeBlock* link = reinterpret_cast<FreeBlock*>(block);
+	link->next = pool.freeList;
+	pool.freeList = link;
+}
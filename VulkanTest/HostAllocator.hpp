@@ -0,0 +1,112 @@
+#ifndef HOST_ALLOCATOR
+#define HOST_ALLOCATOR
+
+#include "VulkanDispatch.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+/****************************************************************************************************
+ * VkAllocationCallbacks that route the driver's host memory through size class pools and track it per allocation scope.
+ * - Requests up to maxPooledSize bytes are served from power of two size classes. Each class carves its blocks out of
+ *   large chunks and keeps the freed ones on a free list, so the short-lived command scope allocations of recording
+ *   and submitting are reused instead of going to the heap every time. Chunks are only released by destroy().
+ * - Larger requests go to the heap directly.
+ * - The chunks and the large blocks come from the C heap, not operator new, so AllocationCounter doesn't see them -
+ *   like the driver's own allocations, they aren't the frame loop's.
+ * - Every allocation carries a small header in front of it with its size, size class and VkSystemAllocationScope,
+ *   so frees and reallocations are charged to the scope they were made in.
+ * - The driver's internal allocations (executable memory it gets some other way) are only reported, they're counted
+ *   separately per scope.
+ *
+ * The callbacks may be called from any thread. Objects must be destroyed with the same callbacks they were created
+ * with, so destroy() may only be called once everything created with them is gone.
+ */
+class HostAllocator
+{
+public:
+	static const uint32_t scopeCount = VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1;
+
+	struct ScopeStatistics
+	{
+		uint64_t allocations = 0;
+		size_t currentBytes = 0;
+		size_t peakBytes = 0;
+		size_t internalBytes = 0; // Reported by the driver, not allocated here
+	};
+
+	struct Statistics
+	{
+		ScopeStatistics scopes[scopeCount];
+		uint64_t pooledAllocations = 0; // Served by a size class
+		uint64_t heapAllocations = 0; // Too large for the pools
+		size_t chunkBytes = 0; // Taken from the heap for the pools
+	};
+
+	void init();
+	void destroy();
+
+	const VkAllocationCallbacks* getCallbacks() const { return &callbacks; }
+	Statistics getStatistics() const;
+
+	static const char* getScopeName(VkSystemAllocationScope scope);
+
+private:
+	static const size_t minClassSize = 32; // Powers of two from here, the header and a free list link have to fit
+	static const uint32_t classCount = 8; // Up to 4 KB
+	static const size_t maxPooledSize = minClassSize << (classCount - 1);
+	static const size_t chunkSize = 64 * 1024;
+	static const uint32_t heapClass = classCount; // Marks allocations that bypassed the pools
+	static const size_t chunkLinkOffset = chunkSize - sizeof(unsigned char*); // Every chunk ends with a pointer to the previous one
+
+	struct alignas(16) Header
+	{
+		size_t size; // As requested
+		uint32_t sizeClass;
+		uint32_t scope;
+		size_t offset; // From the start of the block to the returned pointer
+	};
+
+	struct FreeBlock
+	{
+		FreeBlock* next;
+	};
+
+	struct alignas(64) SizeClass
+	{
+		std::mutex mutex;
+		FreeBlock* freeList = nullptr;
+		unsigned char* chunk = nullptr; // The one blocks are carved from, the newest
+		size_t chunkOffset = chunkSize;
+	};
+
+	struct AtomicScope
+	{
+		std::atomic<uint64_t> allocations{ 0 };
+		std::atomic<size_t> currentBytes{ 0 };
+		std::atomic<size_t> peakBytes{ 0 };
+		std::atomic<size_t> internalBytes{ 0 };
+	};
+
+	static VKAPI_ATTR void* VKAPI_CALL allocate(void* userData, size_t size, size_t alignment, VkSystemAllocationScope scope);
+	static VKAPI_ATTR void* VKAPI_CALL reallocate(void* userData, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope);
+	static VKAPI_ATTR void VKAPI_CALL free(void* userData, void* memory);
+	static VKAPI_ATTR void VKAPI_CALL internalAllocate(void* userData, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+	static VKAPI_ATTR void VKAPI_CALL internalFree(void* userData, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+
+	void* allocateBlock(size_t size, size_t alignment, VkSystemAllocationScope scope);
+	void freeBlock(void* memory);
+	unsigned char* takeFromClass(uint32_t sizeClass);
+	void returnToClass(uint32_t sizeClass, unsigned char* block);
+
+	VkAllocationCallbacks callbacks = {};
+	SizeClass classes[classCount];
+	AtomicScope scopes[scopeCount];
+	std::atomic<uint64_t> pooledAllocations{ 0 };
+	std::atomic<uint64_t> heapAllocations{ 0 };
+	std::atomic<size_t> chunkBytes{ 0 };
+};
+
+#endif
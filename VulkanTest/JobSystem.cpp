@@ -0,0 +1,400 @@
+#include "JobSystem.hpp"
+
+#include <chrono>
+#include <limits>
+#include <stdexcept>
+
+static const uint32_t invalidThreadIndex = std::numeric_limits<uint32_t>::max();
+static thread_local uint32_t threadIndex = invalidThreadIndex;
+
+// ==== WORK STEALING QUEUE ====
+
+bool JobSystem::WorkStealingQueue::push(Job* job)
+{
+	int64_t b = bottom.load(std::memory_order_relaxed);
+	int64_t t = top.load(std::memory_order_acquire);
+
+	if (b - t >= static_cast<int64_t>(queueCapacity))
+	{
+		return false;
+	}
+
+	// Releasing bottom publishes the job and everything written to it before the push
+	jobs[b & (queueCapacity - 1)].store(job, std::memory_order_relaxed);
+	bottom.store(b + 1, std::memory_order_release);
+	return true;
+}
+
+JobSystem::Job* JobSystem::WorkStealingQueue::pop()
+{
+	int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+	bottom.store(b, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t t = top.load(std::memory_order_relaxed);
+
+	if (t > b)
+	{
+		// Empty
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	Job* job = jobs[b & (queueCapacity - 1)].load(std::memory_order_relaxed);
+	if (t == b)
+	{
+		// The last job, a thief may be taking it at the same time
+		if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		{
+			job = nullptr;
+		}
+		bottom.store(b + 1, std::memory_order_relaxed);
+	}
+
+	return job;
+}
+
+JobSystem::Job* JobSystem::WorkStealingQueue::steal()
+{
+	int64_t t = top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t b = bottom.load(std::memory_order_acquire);
+
+	if (t >= b)
+	{
+		return nullptr;
+	}
+
+	Job* job = jobs[t & (queueCapacity - 1)].load(std::memory_order_relaxed);
+	if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+	{
+		return nullptr; // Lost the race to another thief or the owner
+	}
+
+	return job;
+}
+
+
+// ==== SETUP ====
+
+void JobSystem::init(uint32_t workerCount, uint32_t externalThreads)
+{
+	if (workerCount == 0)
+	{
+		uint32_t hardwareThreads = std::thread::hardware_concurrency();
+		workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+
+	threadCount = workerCount + 1 + externalThreads;
+	firstExternalThread = workerCount + 1;
+	attachedThreads = 0;
+	workers.reset(new Worker[threadCount]);
+	for (uint32_t i = 0; i < threadCount; i++)
+	{
+		workers[i].jobPool.reset(new Job[jobPoolSize]);
+		workers[i].randomState = 0x9E3779B9u * (i + 1);
+
+		for (uint32_t j = 0; j < jobPoolSize; j++)
+		{
+			workers[i].jobPool[j].unfinishedJobs.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	threadIndex = 0;
+	stopWorkers = false;
+	for (uint32_t i = 1; i < firstExternalThread; i++)
+	{
+		threads.emplace_back(&JobSystem::workerLoop, this, i);
+	}
+}
+
+/****************************************************************************
+ * The slot's deque is stolen from like any worker's, so the jobs it runs are shared with the pool
+ */
+void JobSystem::attachThread()
+{
+	uint32_t slot = firstExternalThread + attachedThreads.fetch_add(1, std::memory_order_relaxed);
+	if (slot >= threadCount)
+	{
+		throw std::runtime_error("No job system slot left for another thread!");
+	}
+
+	threadIndex = slot;
+}
+
+/****************************************************************************
+ * Jobs still queued are dropped, everything that has to finish must be waited for before this
+ */
+void JobSystem::destroy()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		stopWorkers = true;
+	}
+	sleepCondition.notify_all();
+
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+	threads.clear();
+
+	workers.reset();
+	threadCount = 0;
+}
+
+uint32_t JobSystem::getThreadIndex()
+{
+	return threadIndex;
+}
+
+std::vector<JobSystem::WorkerStatistics> JobSystem::getStatistics() const
+{
+	std::vector<WorkerStatistics> statistics(threadCount);
+	for (uint32_t i = 0; i < threadCount; i++)
+	{
+		statistics[i].executedJobs = workers[i].executedJobs.load(std::memory_order_relaxed);
+		statistics[i].stolenJobs = workers[i].stolenJobs.load(std::memory_order_relaxed);
+		statistics[i].failedSteals = workers[i].failedSteals.load(std::memory_order_relaxed);
+		statistics[i].idleMilliseconds = workers[i].idleNanoseconds.load(std::memory_order_relaxed) / 1000000.0;
+	}
+	return statistics;
+}
+
+
+// ==== JOBS ====
+
+JobSystem::Worker& JobSystem::getWorker()
+{
+	if (threadIndex == invalidThreadIndex)
+	{
+		throw std::runtime_error("Jobs can only be used from the main thread and the job system workers!");
+	}
+
+	return workers[threadIndex];
+}
+
+/****************************************************************************
+ * The pool is a ring: slots are reused once the ring wraps around, skipping the ones whose jobs are still alive
+ * (e.g. a root that's being waited for while nested waits create many more jobs on this thread).
+ */
+JobSystem::Job* JobSystem::allocateJob()
+{
+	Worker& worker = getWorker();
+
+	for (uint32_t i = 0; i < jobPoolSize; i++)
+	{
+		Job* job = &worker.jobPool[worker.nextJob & (jobPoolSize - 1)];
+		worker.nextJob++;
+
+		if (job->unfinishedJobs.load(std::memory_order_acquire) == 0)
+		{
+			return job;
+		}
+	}
+
+	throw std::runtime_error("Too many jobs alive on one thread!");
+}
+
+JobSystem::Job* JobSystem::createJob(JobFunction function, Job* parent)
+{
+	Job* job = allocateJob();
+	job->function = function;
+	job->parent = parent;
+	job->unfinishedJobs.store(1, std::memory_order_relaxed);
+	job->continuationCount.store(0, std::memory_order_relaxed);
+
+	if (parent != nullptr)
+	{
+		parent->unfinishedJobs.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	return job;
+}
+
+void JobSystem::addContinuation(Job* ancestor, Job* continuation)
+{
+	int32_t index = ancestor->continuationCount.fetch_add(1, std::memory_order_relaxed);
+	if (index >= static_cast<int32_t>(maxContinuations))
+	{
+		throw std::runtime_error("Too many continuations on one job!");
+	}
+
+	ancestor->continuations[index] = continuation;
+}
+
+void JobSystem::run(Job* job)
+{
+	Worker& worker = getWorker();
+
+	// A full deque means there's plenty of parallel work already, so running it right here is no loss
+	if (!worker.queue.push(job))
+	{
+		execute(worker, job);
+		return;
+	}
+
+	queuedJobs.fetch_add(1, std::memory_order_seq_cst);
+	if (sleepingWorkers.load(std::memory_order_seq_cst) > 0)
+	{
+		// Taking the mutex makes sure a worker between its check and its wait doesn't miss this
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		sleepCondition.notify_one();
+	}
+}
+
+void JobSystem::wait(const Job* job)
+{
+	waitUntil([job]() { return job->unfinishedJobs.load(std::memory_order_acquire) == 0; });
+}
+
+JobSystem::Job* JobSystem::getJob(Worker& worker)
+{
+	Job* job = worker.queue.pop();
+	if (job != nullptr)
+	{
+		queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+		return job;
+	}
+
+	if (threadCount < 2)
+	{
+		return nullptr;
+	}
+
+	// xorshift, good enough to spread the thieves over the victims
+	worker.randomState ^= worker.randomState << 13;
+	worker.randomState ^= worker.randomState >> 17;
+	worker.randomState ^= worker.randomState << 5;
+
+	uint32_t self = static_cast<uint32_t>(&worker - workers.get());
+	uint32_t victim = worker.randomState % (threadCount - 1);
+	if (victim >= self)
+	{
+		victim++;
+	}
+
+	job = workers[victim].queue.steal();
+	if (job == nullptr)
+	{
+		worker.failedSteals.fetch_add(1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+	worker.stolenJobs.fetch_add(1, std::memory_order_relaxed);
+	return job;
+}
+
+bool JobSystem::helpOnce()
+{
+	Worker& worker = getWorker();
+	Job* job = getJob(worker);
+	if (job == nullptr)
+	{
+		return false;
+	}
+
+	execute(worker, job);
+	return true;
+}
+
+void JobSystem::execute(Worker& worker, Job* job)
+{
+	job->function(*job);
+	finish(job);
+	worker.executedJobs.fetch_add(1, std::memory_order_relaxed);
+}
+
+void JobSystem::finish(Job* job)
+{
+	// Once the count hits zero the slot can be reused by its owner, so everything is read before that
+	Job* parent = job->parent;
+	Job* continuations[maxContinuations];
+	int32_t continuationCount = std::min(job->continuationCount.load(std::memory_order_acquire), static_cast<int32_t>(maxContinuations));
+	std::copy(job->continuations, job->continuations + continuationCount, continuations);
+
+	if (job->unfinishedJobs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+	{
+		return;
+	}
+
+	for (int32_t i = 0; i < continuationCount; i++)
+	{
+		run(continuations[i]);
+	}
+
+	if (parent != nullptr)
+	{
+		finish(parent);
+	}
+}
+
+void JobSystem::workerLoop(uint32_t index)
+{
+	threadIndex = index;
+	Worker& worker = workers[index];
+
+	while (!stopWorkers.load(std::memory_order_acquire))
+	{
+		Job* job = getJob(worker);
+		if (job != nullptr)
+		{
+			execute(worker, job);
+			continue;
+		}
+
+		auto idleStart = std::chrono::steady_clock::now();
+
+		// Spin a little while other workers may be about to push more, then sleep until something is queued
+		for (int i = 0; i < 64 && job == nullptr && queuedJobs.load(std::memory_order_relaxed) > 0; i++)
+		{
+			std::this_thread::yield();
+			job = getJob(worker);
+		}
+
+		if (job == nullptr)
+		{
+			std::unique_lock<std::mutex> lock(sleepMutex);
+			sleepingWorkers.fetch_add(1, std::memory_order_seq_cst);
+			sleepCondition.wait(lock, [this]()
+			{
+				return stopWorkers.load(std::memory_order_relaxed) || queuedJobs.load(std::memory_order_seq_cst) > 0;
+			});
+			sleepingWorkers.fetch_sub(1, std::memory_order_relaxed);
+		}
+
+		worker.idleNanoseconds.fetch_add(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - idleStart).count()), std::memory_order_relaxed);
+
+		if (job != nullptr)
+		{
+			execute(worker, job);
+		}
+	}
+}
+
+
+// ==== PARALLEL FOR ====
+
+/****************************************************************************
+ * Splits the range in halves as child jobs until the batches are small enough, so the work spreads out
+ * through stealing instead of one thread pushing every batch
+ */
+void JobSystem::parallelForJob(Job& job)
+{
+	const ParallelForData& data = getJobData<ParallelForData>(job);
+
+	if (data.end - data.begin > data.batchSize)
+	{
+		ParallelForData left = data;
+		ParallelForData right = data;
+		left.end = right.begin = data.begin + (data.end - data.begin) / 2;
+
+		data.system->run(data.system->createJob(&JobSystem::parallelForJob, left, &job));
+		data.system->run(data.system->createJob(&JobSystem::parallelForJob, right, &job));
+	}
+	else
+	{
+		data.invoke(data.function, data.begin, data.end);
+	}
+}
@@ -0,0 +1,205 @@
+#ifndef JOB_SYSTEM
+#define JOB_SYSTEM
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/****************************************************************************************************
+ * Work-stealing job system.
+ * - Every thread (the main thread and the workers) owns a lock-free deque: it pushes and pops its own jobs
+ *   at the bottom, idle threads steal from the top of a random other deque.
+ * - Jobs are allocated from a per-thread ring, so scheduling never touches the heap.
+ * - A job finishes once its function and all its children have finished, then its continuations are run.
+ * - wait() keeps executing other jobs, so waiting from inside a job can't deadlock the pool.
+ *
+ * Only the main thread (the one that called init), threads that called attachThread() and the workers may create,
+ * run and wait for jobs.
+ */
+class JobSystem
+{
+public:
+	struct Job;
+	typedef void (*JobFunction)(Job& job);
+
+	static const uint32_t maxContinuations = 4;
+	static const size_t jobDataSize = 72; // Makes the whole job 128 bytes, two cache lines
+
+	struct alignas(64) Job
+	{
+		JobFunction function;
+		Job* parent;
+		std::atomic<int32_t> unfinishedJobs; // The job itself plus its unfinished children
+		std::atomic<int32_t> continuationCount;
+		Job* continuations[maxContinuations];
+		alignas(8) unsigned char data[jobDataSize];
+	};
+
+	struct WorkerStatistics
+	{
+		uint64_t executedJobs = 0;
+		uint64_t stolenJobs = 0;
+		uint64_t failedSteals = 0;
+		double idleMilliseconds = 0.0;
+	};
+
+	// 0 workers uses one per hardware thread besides the calling one. The external threads are slots for
+	// threads the application starts itself, each one has to call attachThread() before using jobs.
+	void init(uint32_t workerCount = 0, uint32_t externalThreads = 0);
+	void destroy();
+	// Gives the calling thread its own job deque and pool, until destroy()
+	void attachThread();
+
+	uint32_t getThreadCount() const { return threadCount; } // Workers, the main thread and the external slots
+	static uint32_t getThreadIndex(); // 0 on the main thread, 1 and up on the workers, then the attached threads
+
+	Job* createJob(JobFunction function, Job* parent = nullptr);
+	// Data is copied into the job and read back with getJobData
+	template <typename Data>
+	Job* createJob(JobFunction function, const Data& data, Job* parent);
+	// The lambda is copied into the job, so it has to be small and only capture pointers, references or plain values
+	template <typename Lambda>
+	Job* createLambdaJob(const Lambda& lambda, Job* parent = nullptr);
+
+	template <typename Data>
+	static const Data& getJobData(const Job& job) { return *reinterpret_cast<const Data*>(job.data); }
+
+	// Runs the continuation once the ancestor has finished, must be added before the ancestor is run
+	void addContinuation(Job* ancestor, Job* continuation);
+	void run(Job* job);
+	void wait(const Job* job);
+	// Executes jobs until the predicate is true, for work that's tracked some other way than by a job
+	template <typename Predicate>
+	void waitUntil(const Predicate& done);
+
+	// Calls function(begin, end) for batches of at most batchSize indices, in parallel, and waits for all of them
+	template <typename Function>
+	void parallelFor(uint32_t count, uint32_t batchSize, const Function& function);
+
+	std::vector<WorkerStatistics> getStatistics() const;
+
+private:
+	static const uint32_t queueCapacity = 4096; // Power of two
+	static const uint32_t jobPoolSize = 4096; // Jobs a thread may have alive at once, power of two
+
+	/****************************************************************************
+	 * Chase-Lev deque with a fixed capacity. The owner pushes and pops at the bottom, thieves take from the top
+	 * and only contend with each other (and the owner, for the very last job) through the top counter.
+	 */
+	class WorkStealingQueue
+	{
+	public:
+		bool push(Job* job);
+		Job* pop();
+		Job* steal();
+
+	private:
+		std::atomic<int64_t> top{ 0 };
+		std::atomic<int64_t> bottom{ 0 };
+		std::atomic<Job*> jobs[queueCapacity];
+	};
+
+	struct alignas(64) Worker
+	{
+		WorkStealingQueue queue;
+		std::unique_ptr<Job[]> jobPool;
+		uint32_t nextJob = 0;
+		uint32_t randomState = 0; // For picking the steal victims
+
+		std::atomic<uint64_t> executedJobs{ 0 };
+		std::atomic<uint64_t> stolenJobs{ 0 };
+		std::atomic<uint64_t> failedSteals{ 0 };
+		std::atomic<uint64_t> idleNanoseconds{ 0 };
+	};
+
+	struct ParallelForData
+	{
+		JobSystem* system;
+		const void* function;
+		void (*invoke)(const void* function, uint32_t begin, uint32_t end);
+		uint32_t begin;
+		uint32_t end;
+		uint32_t batchSize;
+	};
+
+	Job* allocateJob();
+	Worker& getWorker();
+	Job* getJob(Worker& worker);
+	void execute(Worker& worker, Job* job);
+	void finish(Job* job);
+	void workerLoop(uint32_t index);
+	bool helpOnce(); // Executes one job if there is any
+
+	static void parallelForJob(Job& job);
+	template <typename Function>
+	static void invokeRange(const void* function, uint32_t begin, uint32_t end)
+	{
+		(*static_cast<const Function*>(function))(begin, end);
+	}
+
+	uint32_t threadCount = 0;
+	uint32_t firstExternalThread = 0;
+	std::atomic<uint32_t> attachedThreads{ 0 };
+	std::unique_ptr<Worker[]> workers;
+	std::vector<std::thread> threads;
+
+	std::atomic<bool> stopWorkers{ false };
+	std::atomic<int64_t> queuedJobs{ 0 }; // Lets idle workers sleep instead of spinning
+	std::atomic<uint32_t> sleepingWorkers{ 0 };
+	std::mutex sleepMutex;
+	std::condition_variable sleepCondition;
+};
+
+
+template <typename Data>
+JobSystem::Job* JobSystem::createJob(JobFunction function, const Data& data, Job* parent)
+{
+	static_assert(std::is_trivially_copyable<Data>::value, "Job data must be trivially copyable");
+	static_assert(sizeof(Data) <= jobDataSize, "Job data is too large");
+	static_assert(alignof(Data) <= 8, "Job data is over aligned");
+
+	Job* job = createJob(function, parent);
+	std::memcpy(job->data, &data, sizeof(Data));
+	return job;
+}
+
+template <typename Lambda>
+JobSystem::Job* JobSystem::createLambdaJob(const Lambda& lambda, Job* parent)
+{
+	return createJob([](Job& job) { getJobData<Lambda>(job)(); }, lambda, parent);
+}
+
+template <typename Predicate>
+void JobSystem::waitUntil(const Predicate& done)
+{
+	while (!done())
+	{
+		if (!helpOnce())
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+template <typename Function>
+void JobSystem::parallelFor(uint32_t count, uint32_t batchSize, const Function& function)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	ParallelForData data = { this, &function, &invokeRange<Function>, 0, count, std::max(batchSize, 1u) };
+	Job* root = createJob(&JobSystem::parallelForJob, data, nullptr);
+	run(root);
+	wait(root);
+}
+
+#endif
@@ -0,0 +1,90 @@
+#include "LodSelector.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+void LodSelector::init(const MeshLod* lods, uint32_t newLodCount, uint32_t objectCount, float newLocalRadius)
+{
+	lodCount = std::min(newLodCount, meshMaxLods);
+	localRadius = newLocalRadius;
+
+	for (uint32_t i = 0; i < lodCount; i++)
+	{
+		lodErrors[i] = lods[i].error;
+		lodTriangles[i] = lods[i].indexCount / 3;
+	}
+
+	currentLods.assign(objectCount, 0);
+	sortedObjects.reserve(objectCount);
+	selectedLods.reserve(objectCount);
+}
+
+void LodSelector::setCamera(const glm::vec3& position, float verticalFieldOfView, float viewportHeight)
+{
+	cameraPosition = position;
+	pixelsPerUnit = viewportHeight / (2.0f * std::tan(verticalFieldOfView * 0.5f));
+}
+
+void LodSelector::select(JobSystem& jobSystem, const uint32_t* visible, uint32_t visibleCount, const glm::mat4* worldMatrices)
+{
+	selectedLods.resize(visibleCount);
+
+	jobSystem.parallelFor(visibleCount, 4096, [this, visible, worldMatrices](uint32_t begin, uint32_t end)
+	{
+		float coarserThreshold = config.errorThreshold * (1.0f - config.hysteresis);
+
+		for (uint32_t i = begin; i < end; i++)
+		{
+			uint32_t object = visible[i];
+			const glm::mat4& world = worldMatrices[object];
+
+			float scaleSquared = 0.0f;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				scaleSquared = std::max(scaleSquared, world[axis][0] * world[axis][0] + world[axis][1] * world[axis][1] + world[axis][2] * world[axis][2]);
+			}
+			float scale = std::sqrt(scaleSquared);
+
+			// Errors are in mesh units, measured at the nearest point of the bounding sphere
+			glm::vec3 offset(world[3][0] - cameraPosition.x, world[3][1] - cameraPosition.y, world[3][2] - cameraPosition.z);
+			float distance = std::sqrt(offset.x * offset.x + offset.y * offset.y + offset.z * offset.z) - localRadius * scale;
+			float errorToPixels = scale * pixelsPerUnit / std::max(distance, 1e-4f);
+
+			uint32_t lod = std::min(static_cast<uint32_t>(currentLods[object]), lodCount - 1);
+			while (lod > 0 && lodErrors[lod] * errorToPixels > config.errorThreshold)
+			{
+				lod--;
+			}
+			while (lod + 1 < lodCount && lodErrors[lod + 1] * errorToPixels <= coarserThreshold)
+			{
+				lod++;
+			}
+
+			currentLods[object] = static_cast<uint8_t>(lod);
+			selectedLods[i] = static_cast<uint8_t>(lod);
+		}
+	});
+
+	// Counting sort by level
+	statistics = Statistics();
+	for (uint32_t i = 0; i < visibleCount; i++)
+	{
+		statistics.instanceCounts[selectedLods[i]]++;
+	}
+
+	uint32_t fill[meshMaxLods];
+	lodOffsets[0] = 0;
+	for (uint32_t lod = 0; lod < lodCount; lod++)
+	{
+		fill[lod] = lodOffsets[lod];
+		lodOffsets[lod + 1] = lodOffsets[lod] + statistics.instanceCounts[lod];
+		statistics.submittedTriangles += static_cast<uint64_t>(statistics.instanceCounts[lod]) * lodTriangles[lod];
+	}
+	statistics.fullDetailTriangles = static_cast<uint64_t>(visibleCount) * lodTriangles[0];
+
+	sortedObjects.resize(visibleCount);
+	for (uint32_t i = 0; i < visibleCount; i++)
+	{
+		sortedObjects[fill[selectedLods[i]]++] = visible[i];
+	}
+}
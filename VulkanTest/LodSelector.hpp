@@ -0,0 +1,67 @@
+#ifndef LOD_SELECTOR
+#define LOD_SELECTOR
+
+#include <cstdint>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include "JobSystem.hpp"
+#include "MeshFormat.hpp"
+
+/****************************************************************************************************
+ * Level of detail selection for the instances of one mesh.
+ * - Every visible instance gets the coarsest level whose error, projected to the screen at the instance's
+ *   nearest point, stays under the pixel threshold.
+ * - Hysteresis against popping: a finer level is taken as soon as the current one is over the threshold,
+ *   a coarser one only once it's clearly under it.
+ * - The result is sorted by level, so each level can be drawn as one instanced draw.
+ */
+class LodSelector
+{
+public:
+	struct Config
+	{
+		float errorThreshold = 1.0f; // Pixels
+		float hysteresis = 0.25f; // Share of the threshold a coarser level has to stay under
+	};
+
+	struct Statistics
+	{
+		uint32_t instanceCounts[meshMaxLods] = {};
+		uint64_t submittedTriangles = 0;
+		uint64_t fullDetailTriangles = 0; // What the same instances would cost without the levels of detail
+	};
+
+	// localRadius is the bounding sphere radius around the instance origin, used for the nearest distance
+	void init(const MeshLod* lods, uint32_t lodCount, uint32_t objectCount, float localRadius);
+	void setConfig(const Config& newConfig) { config = newConfig; }
+	void setCamera(const glm::vec3& position, float verticalFieldOfView, float viewportHeight);
+
+	// Picks a level for every visible object, then getObjects(lod) lists the objects drawn with each level
+	void select(JobSystem& jobSystem, const uint32_t* visible, uint32_t visibleCount, const glm::mat4* worldMatrices);
+
+	uint32_t getLodCount() const { return lodCount; }
+	const uint32_t* getObjects(uint32_t lod) const { return sortedObjects.data() + lodOffsets[lod]; }
+	uint32_t getObjectCount(uint32_t lod) const { return lodOffsets[lod + 1] - lodOffsets[lod]; }
+	const Statistics& getStatistics() const { return statistics; }
+
+private:
+	Config config;
+	uint32_t lodCount = 0;
+	float lodErrors[meshMaxLods] = {};
+	uint32_t lodTriangles[meshMaxLods] = {};
+	float localRadius = 0.0f;
+
+	glm::vec3 cameraPosition = glm::vec3(0.0f);
+	float pixelsPerUnit = 1.0f; // Screen size of one unit at distance one
+
+	std::vector<uint8_t> currentLods; // Per object, kept between frames for the hysteresis
+	std::vector<uint8_t> selectedLods; // Per visible entry
+	std::vector<uint32_t> sortedObjects;
+	uint32_t lodOffsets[meshMaxLods + 1] = {};
+	Statistics statistics;
+};
+
+#endif
@@ -0,0 +1,126 @@
+#include "MemoryBudget.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+bool MemoryBudget::isSupported(VkPhysicalDevice physicalDevice)
+{
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	if (properties.apiVersion < VK_API_VERSION_1_1)
+	{
+		return false; // The budget is chained to vkGetPhysicalDeviceMemoryProperties2
+	}
+
+	uint32_t extensionCount = 0;
+	vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+	std::vector<VkExtensionProperties> extensions(extensionCount);
+	vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, extensions.data());
+
+	return std::any_of(extensions.begin(), extensions.end(), [](const VkExtensionProperties& extension)
+	{
+		return std::strcmp(extension.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0;
+	});
+}
+
+void MemoryBudget::init(VkPhysicalDevice physicalDevice, bool useExtension, const Config& config)
+{
+	this->physicalDevice = physicalDevice;
+	this->useExtension = useExtension;
+	this->config = config;
+
+	query();
+}
+
+void MemoryBudget::setStubHeaps(const std::vector<Heap>& heaps)
+{
+	stubHeaps = heaps;
+	query();
+}
+
+bool MemoryBudget::update(uint64_t frame)
+{
+	if (frame - lastQueryFrame < config.updateInterval)
+	{
+		return false;
+	}
+
+	lastQueryFrame = frame;
+	query();
+	return true;
+}
+
+VkDeviceSize MemoryBudget::getHeadroom(uint32_t heap) const
+{
+	VkDeviceSize limit = static_cast<VkDeviceSize>(heaps[heap].budget * static_cast<double>(config.warningThreshold));
+	return heaps[heap].usage < limit ? limit - heaps[heap].usage : 0;
+}
+
+void MemoryBudget::query()
+{
+	statistics.queries++;
+
+	if (!stubHeaps.empty())
+	{
+		heaps = stubHeaps;
+	}
+	else
+	{
+		VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties = {};
+		budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+		VkPhysicalDeviceMemoryProperties2 properties = {};
+		properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+		if (useExtension)
+		{
+			properties.pNext = &budgetProperties;
+			vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &properties);
+		}
+		else
+		{
+			vkGetPhysicalDeviceMemoryProperties(physicalDevice, &properties.memoryProperties);
+		}
+
+		const VkPhysicalDeviceMemoryProperties& memoryProperties = properties.memoryProperties;
+		heaps.resize(memoryProperties.memoryHeapCount);
+		for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+		{
+			Heap& heap = heaps[i];
+			heap.size = memoryProperties.memoryHeaps[i].size;
+			heap.flags = memoryProperties.memoryHeaps[i].flags;
+			heap.budget = useExtension ? budgetProperties.heapBudget[i] : static_cast<VkDeviceSize>(heap.size * static_cast<double>(config.fallbackBudget));
+			heap.usage = useExtension ? budgetProperties.heapUsage[i] : 0;
+		}
+	}
+
+	warned.resize(heaps.size(), false);
+	deviceLocalHeap = 0;
+	for (uint32_t i = 0; i < heaps.size(); i++)
+	{
+		const Heap& heap = heaps[i];
+		bool deviceLocal = (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+		bool bestDeviceLocal = (heaps[deviceLocalHeap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+		if ((deviceLocal && !bestDeviceLocal) || (deviceLocal == bestDeviceLocal && heap.size > heaps[deviceLocalHeap].size))
+		{
+			deviceLocalHeap = i;
+		}
+
+		if (heap.budget == 0)
+		{
+			continue;
+		}
+
+		float usage = static_cast<float>(static_cast<double>(heap.usage) / heap.budget);
+		statistics.peakUsage = std::max(statistics.peakUsage, usage);
+
+		// Warned once per crossing, before the driver has to start paging
+		if (usage >= config.warningThreshold && !warned[i])
+		{
+			std::cerr << "Memory heap " << i << " is at " << heap.usage / (1024 * 1024) << " of its " << heap.budget / (1024 * 1024)
+				<< " MB budget (" << heap.size / (1024 * 1024) << " MB heap)" << std::endl;
+			statistics.warnings++;
+		}
+		warned[i] = usage >= config.warningThreshold;
+	}
+}
@@ -0,0 +1,78 @@
+#ifndef MEMORY_BUDGET
+#define MEMORY_BUDGET
+
+#include "VulkanDispatch.hpp"
+
+#include <cstdint>
+#include <vector>
+
+/****************************************************************************************************
+ * Per heap memory usage and budget of the device.
+ * - With VK_EXT_memory_budget the driver reports what this process uses of each heap, and its budget: how much
+ *   it can use before the driver starts paging to system memory, which shrinks when other processes share the GPU.
+ * - Without the extension the budget is a fixed fraction of the heap size and the usage is unknown (0).
+ * - A stub heap table can replace what the device reports, to exercise the warnings and the eviction that
+ *   follows the budget without a GPU that is actually full.
+ *
+ * The values are queried every few frames. Crossing the warning threshold of a heap is reported once,
+ * until the usage falls back below it.
+ */
+class MemoryBudget
+{
+public:
+	struct Heap
+	{
+		VkDeviceSize size = 0;
+		VkDeviceSize budget = 0;
+		VkDeviceSize usage = 0; // By this process
+		VkMemoryHeapFlags flags = 0;
+	};
+
+	struct Config
+	{
+		float warningThreshold = 0.9f; // Fraction of the budget
+		float fallbackBudget = 0.8f; // Fraction of the heap size taken as the budget without the extension
+		uint32_t updateInterval = 30; // Frames between queries
+	};
+
+	struct Statistics
+	{
+		uint32_t queries = 0;
+		uint32_t warnings = 0;
+		float peakUsage = 0.0f; // Highest usage of any heap, as a fraction of its budget
+	};
+
+	// Checks for VK_EXT_memory_budget, which then has to be enabled on the device
+	static bool isSupported(VkPhysicalDevice physicalDevice);
+
+	void init(VkPhysicalDevice physicalDevice, bool useExtension, const Config& config);
+	// Reported instead of the device's heaps from the next query on
+	void setStubHeaps(const std::vector<Heap>& heaps);
+	// Queries the heaps if the update interval has passed since the last query, returns whether it did
+	bool update(uint64_t frame);
+
+	const std::vector<Heap>& getHeaps() const { return heaps; }
+	uint32_t getDeviceLocalHeap() const { return deviceLocalHeap; } // The largest one
+	// What the heap can still take before it reaches the warning threshold
+	VkDeviceSize getHeadroom(uint32_t heap) const;
+	bool usesExtension() const { return useExtension; }
+	bool isStubbed() const { return !stubHeaps.empty(); }
+	const Statistics& getStatistics() const { return statistics; }
+
+private:
+	void query();
+
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	bool useExtension = false;
+	Config config;
+
+	std::vector<Heap> heaps;
+	std::vector<Heap> stubHeaps;
+	std::vector<bool> warned; // Per heap, over the threshold since the last warning
+	uint32_t deviceLocalHeap = 0;
+	uint64_t lastQueryFrame = 0;
+
+	Statistics statistics;
+};
+
+#endif
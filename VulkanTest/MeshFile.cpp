@@ -0,0 +1,146 @@
+#include "MeshFile.hpp"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+void MeshFile::open(const std::string& path)
+{
+	close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		throw std::runtime_error("Failed to open mesh file " + path);
+	}
+
+	LARGE_INTEGER fileSize;
+	GetFileSizeEx(file, &fileSize);
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	const void* view = mapping != nullptr ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	if (view == nullptr)
+	{
+		if (mapping != nullptr)
+		{
+			CloseHandle(mapping);
+		}
+		CloseHandle(file);
+		throw std::runtime_error("Failed to map mesh file " + path);
+	}
+
+	fileHandle = file;
+	mappingHandle = mapping;
+	data = static_cast<const uint8_t*>(view);
+	size = static_cast<uint64_t>(fileSize.QuadPart);
+#else
+	int file = ::open(path.c_str(), O_RDONLY);
+	if (file < 0)
+	{
+		throw std::runtime_error("Failed to open mesh file " + path);
+	}
+
+	struct stat fileStat;
+	fstat(file, &fileStat);
+
+	// The mapping keeps its own reference to the file
+	void* view = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+	::close(file);
+	if (view == MAP_FAILED)
+	{
+		throw std::runtime_error("Failed to map mesh file " + path);
+	}
+
+	// Whole file gets copied to the staging buffer right away
+	madvise(view, static_cast<size_t>(fileStat.st_size), MADV_SEQUENTIAL | MADV_WILLNEED);
+
+	data = static_cast<const uint8_t*>(view);
+	size = static_cast<uint64_t>(fileStat.st_size);
+#endif
+
+	try
+	{
+		validate(path);
+	}
+	catch (...)
+	{
+		close();
+		throw;
+	}
+}
+
+void MeshFile::close()
+{
+	if (data == nullptr)
+	{
+		return;
+	}
+
+#ifdef _WIN32
+	UnmapViewOfFile(data);
+	CloseHandle(mappingHandle);
+	CloseHandle(fileHandle);
+	fileHandle = nullptr;
+	mappingHandle = nullptr;
+#else
+	munmap(const_cast<uint8_t*>(data), static_cast<size_t>(size));
+#endif
+
+	data = nullptr;
+	size = 0;
+}
+
+/****************************************************************************
+ * The streams are used without any further checks, so everything the header points to must lie in the file
+ */
+void MeshFile::validate(const std::string& path) const
+{
+	if (size < sizeof(MeshFileHeader))
+	{
+		throw std::runtime_error("Mesh file " + path + " is too small!");
+	}
+
+	const MeshFileHeader& header = getHeader();
+	if (header.magic != meshFileMagic || header.version != meshFileVersion)
+	{
+		throw std::runtime_error("Mesh file " + path + " has unsupported format or version!");
+	}
+
+	auto inFile = [this](uint64_t offset, uint64_t streamSize)
+	{
+		return offset % meshStreamAlignment == 0 && offset <= size && streamSize <= size - offset;
+	};
+
+	if (header.fileSize != size || (header.indexSize != 2 && header.indexSize != 4) ||
+		!inFile(header.vertexOffset, static_cast<uint64_t>(header.vertexCount) * header.vertexStride) ||
+		!inFile(header.indexOffset, static_cast<uint64_t>(header.indexCount) * header.indexSize) ||
+		!inFile(header.meshletOffset, static_cast<uint64_t>(header.meshletCount) * sizeof(Meshlet)) ||
+		!inFile(header.meshletVertexOffset, static_cast<uint64_t>(header.meshletVertexCount) * sizeof(uint32_t)) ||
+		!inFile(header.meshletIndexOffset, header.meshletIndexSize))
+	{
+		throw std::runtime_error("Mesh file " + path + " is corrupted!");
+	}
+
+	if (header.lodCount < 1 || header.lodCount > meshMaxLods)
+	{
+		throw std::runtime_error("Mesh file " + path + " is corrupted!");
+	}
+	for (uint32_t i = 0; i < header.lodCount; i++)
+	{
+		const MeshLod& lod = header.lods[i];
+		if (lod.indexOffset > header.indexCount || lod.indexCount > header.indexCount - lod.indexOffset || lod.indexCount % 3 != 0)
+		{
+			throw std::runtime_error("Mesh file " + path + " is corrupted!");
+		}
+	}
+}
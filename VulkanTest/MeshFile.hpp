@@ -0,0 +1,46 @@
+#ifndef MESH_FILE
+#define MESH_FILE
+
+#include "MeshFormat.hpp"
+
+#include <string>
+
+/****************************************************************************************************
+ * Read-only memory mapping of a converted mesh file.
+ * open() only validates the header against the file size - the streams are used straight from the mapping,
+ * so the loading cost is a single copy into the staging buffer.
+ */
+class MeshFile
+{
+public:
+	MeshFile() = default;
+	MeshFile(const MeshFile&) = delete;
+	MeshFile& operator=(const MeshFile&) = delete;
+	~MeshFile() { close(); }
+
+	void open(const std::string& path);
+	void close();
+
+	const MeshFileHeader& getHeader() const { return *reinterpret_cast<const MeshFileHeader*>(data); }
+	const uint8_t* getData() const { return data; }
+	uint64_t getSize() const { return size; }
+
+	const uint8_t* getVertices() const { return data + getHeader().vertexOffset; }
+	const uint8_t* getIndices() const { return data + getHeader().indexOffset; }
+	const Meshlet* getMeshlets() const { return reinterpret_cast<const Meshlet*>(data + getHeader().meshletOffset); }
+	const uint32_t* getMeshletVertices() const { return reinterpret_cast<const uint32_t*>(data + getHeader().meshletVertexOffset); }
+	const uint8_t* getMeshletIndices() const { return data + getHeader().meshletIndexOffset; }
+
+private:
+	void validate(const std::string& path) const;
+
+	const uint8_t* data = nullptr;
+	uint64_t size = 0;
+
+#ifdef _WIN32
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+#endif
+};
+
+#endif
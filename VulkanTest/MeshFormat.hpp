@@ -0,0 +1,124 @@
+#ifndef MESH_FORMAT
+#define MESH_FORMAT
+
+#include <cstdint>
+
+/****************************************************************************************************
+ * Binary mesh container written by the MeshConverter tool and memory mapped by MeshFile.
+ *
+ * [MeshFileHeader][vertices][indices][meshlets][meshlet vertices][meshlet indices]
+ *
+ * The index stream holds every level of detail one after the other, full detail first. All the levels index
+ * the same vertices, so switching between them only changes the index range that's drawn.
+ *
+ * Every stream starts at a multiple of meshStreamAlignment, so the file can be copied into a staging buffer
+ * as it is and each stream used directly as a copy source. The layout matches the host (little endian)
+ * and all the structures below are plain data, nothing in the file needs to be parsed at load time.
+ */
+
+const uint32_t meshFileMagic = 0x4853454D; // "MESH"
+const uint32_t meshFileVersion = 2;
+const uint64_t meshStreamAlignment = 256; // Covers every buffer offset alignment a device may require
+
+const uint32_t meshMaxLods = 8;
+
+// Largest meshlet, sized for the common mesh shader limits
+const uint32_t meshletMaxVertices = 64;
+const uint32_t meshletMaxTriangles = 124;
+
+// Vertex attributes, the index is also the shader input location
+enum class MeshAttribute : uint32_t
+{
+	Position,
+	Normal,
+	TexCoord,
+	Color,
+	Count
+};
+
+enum class MeshAttributeFormat : uint32_t
+{
+	None, // Attribute isn't present in the file
+	Float2,
+	Float3,
+	Float4,
+	Half2,
+	Half4,
+	Snorm8x4,
+	Unorm8x4,
+	Unorm16x4
+};
+
+struct MeshAttributeDesc
+{
+	MeshAttributeFormat format;
+	uint32_t offset; // Within the vertex
+};
+
+struct MeshBounds
+{
+	float min[3];
+	float max[3];
+	float center[3];
+	float radius; // Sphere around the center, which isn't necessarily the box center
+};
+
+struct Meshlet
+{
+	float center[3];
+	float radius;
+	uint32_t vertexOffset; // First entry in the meshlet vertex stream
+	uint32_t vertexCount;
+	uint32_t indexOffset; // First byte in the meshlet index stream, 3 local indices per triangle
+	uint32_t triangleCount;
+};
+
+struct MeshLod
+{
+	uint32_t indexOffset; // First index of the level in the index stream
+	uint32_t indexCount;
+	float error; // Farthest any vertex moved from the full detail surface, in mesh units
+	uint32_t reserved;
+};
+
+struct MeshFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+
+	uint32_t vertexCount;
+	uint32_t vertexStride;
+	MeshAttributeDesc attributes[static_cast<uint32_t>(MeshAttribute::Count)];
+	// Quantized positions are stored relative to the bounds: position = stored * positionScale + positionOffset
+	float positionScale[3];
+	float positionOffset[3];
+
+	uint32_t indexCount;
+	uint32_t indexSize; // 2 or 4 bytes
+
+	uint32_t meshletCount;
+	uint32_t meshletVertexCount; // uint32_t entries, indices into the vertex stream
+	uint32_t meshletIndexSize; // Bytes, every meshlet starts at a multiple of 4, meshlets cover the full detail level only
+	uint32_t lodCount; // At least 1, level 0 is the full detail mesh
+
+	MeshBounds bounds;
+	MeshLod lods[meshMaxLods];
+
+	uint64_t vertexOffset;
+	uint64_t indexOffset;
+	uint64_t meshletOffset;
+	uint64_t meshletVertexOffset;
+	uint64_t meshletIndexOffset;
+	uint64_t fileSize;
+};
+
+static_assert(sizeof(Meshlet) == 32, "Meshlet layout must not depend on the compiler");
+static_assert(sizeof(MeshLod) == 16, "Mesh LOD layout must not depend on the compiler");
+static_assert(sizeof(MeshFileHeader) == 312, "Mesh file header layout must not depend on the compiler");
+
+inline uint64_t alignMeshStream(uint64_t offset)
+{
+	return (offset + meshStreamAlignment - 1) & ~(meshStreamAlignment - 1);
+}
+
+#endif
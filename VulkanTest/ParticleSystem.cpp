@@ -0,0 +1,531 @@
+#include "ParticleSystem.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <fstream>
+#include <stdexcept>
+
+// ==== SETUP ====
+
+void ParticleSystem::init(VkDevice device, const VkAllocationCallbacks* allocator, VkPhysicalDevice physicalDevice, const std::string& shaderDirectory, VkRenderPass renderPass, uint32_t subpass,
+	VkExtent2D extent, uint32_t frameCount, const Config& config)
+{
+	this->device = device;
+	this->allocator = allocator;
+	this->physicalDevice = physicalDevice;
+	this->config = config;
+	aspectRatio = static_cast<float>(extent.width) / extent.height;
+	statistics.capacity = config.capacity;
+
+	// 32 bytes a particle: position and remaining life, velocity and total life
+	VkDeviceSize particleBufferSize = static_cast<VkDeviceSize>(config.capacity) * 32;
+	for (uint32_t i = 0; i < 2; i++)
+	{
+		createBuffer(particleBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, particleBuffers[i], particleMemory[i]);
+	}
+	createBuffer(sizeof(Control), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, controlBuffer, controlMemory);
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	VkDeviceSize alignment = properties.limits.minUniformBufferOffsetAlignment;
+	parameterStride = (sizeof(FrameParameters) + alignment - 1) / alignment * alignment;
+
+	createBuffer(parameterStride * frameCount, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		parameterBuffer, parameterMemory);
+	vkMapMemory(device, parameterMemory, 0, VK_WHOLE_SIZE, 0, reinterpret_cast<void**>(&parameterData));
+
+	createBuffer(sizeof(uint32_t) * frameCount, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		readbackBuffer, readbackMemory);
+	vkMapMemory(device, readbackMemory, 0, VK_WHOLE_SIZE, 0, reinterpret_cast<void**>(&readbackData));
+	std::fill(readbackData, readbackData + frameCount, 0u);
+
+	for (uint32_t frame = 0; frame < frameCount; frame++)
+	{
+		writeParameters(frame, 0.0f, 0, config.lifetime);
+	}
+
+	// Both particle buffers, the control block and the frame's parameters
+	VkDescriptorSetLayoutBinding bindings[4] = {};
+	for (uint32_t i = 0; i < 4; i++)
+	{
+		bindings[i].binding = i;
+		bindings[i].descriptorCount = 1;
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT;
+	}
+	bindings[3].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	bindings[3].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = 4;
+	layoutInfo.pBindings = bindings;
+
+	if (vkCreateDescriptorSetLayout(device, &layoutInfo, allocator, &setLayout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create particle descriptor set layout!");
+	}
+
+	VkDescriptorPoolSize poolSizes[2] = {};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[0].descriptorCount = frameCount * 3;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	poolSizes[1].descriptorCount = frameCount;
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = frameCount;
+	poolInfo.poolSizeCount = 2;
+	poolInfo.pPoolSizes = poolSizes;
+
+	if (vkCreateDescriptorPool(device, &poolInfo, allocator, &descriptorPool) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create particle descriptor pool!");
+	}
+
+	std::vector<VkDescriptorSetLayout> layouts(frameCount, setLayout);
+	sets.resize(frameCount);
+
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = descriptorPool;
+	allocInfo.descriptorSetCount = frameCount;
+	allocInfo.pSetLayouts = layouts.data();
+
+	if (vkAllocateDescriptorSets(device, &allocInfo, sets.data()) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to allocate particle descriptor sets!");
+	}
+
+	std::vector<VkDescriptorBufferInfo> bufferInfos(frameCount * 4);
+	std::vector<VkWriteDescriptorSet> writes(frameCount * 4);
+	for (uint32_t frame = 0; frame < frameCount; frame++)
+	{
+		VkDescriptorBufferInfo* infos = &bufferInfos[frame * 4];
+		infos[0] = { particleBuffers[0], 0, VK_WHOLE_SIZE };
+		infos[1] = { particleBuffers[1], 0, VK_WHOLE_SIZE };
+		infos[2] = { controlBuffer, 0, VK_WHOLE_SIZE };
+		infos[3] = { parameterBuffer, parameterStride * frame, sizeof(FrameParameters) };
+
+		for (uint32_t binding = 0; binding < 4; binding++)
+		{
+			VkWriteDescriptorSet& write = writes[frame * 4 + binding];
+			write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			write.dstSet = sets[frame];
+			write.dstBinding = binding;
+			write.descriptorCount = 1;
+			write.descriptorType = bindings[binding].descriptorType;
+			write.pBufferInfo = &infos[binding];
+		}
+	}
+
+	vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+	createComputePipelines(shaderDirectory);
+	createDrawPipeline(shaderDirectory, renderPass, subpass);
+}
+
+void ParticleSystem::createComputePipelines(const std::string& shaderDirectory)
+{
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(uint32_t); // The control mode
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &setLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+	if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, allocator, &computeLayout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create particle compute pipeline layout!");
+	}
+
+	VkShaderModule modules[2] = { loadShader(shaderDirectory + "particle_control.spv"), loadShader(shaderDirectory + "particle_simulate.spv") };
+
+	VkComputePipelineCreateInfo pipelineInfos[2] = {};
+	for (uint32_t i = 0; i < 2; i++)
+	{
+		pipelineInfos[i].sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfos[i].stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineInfos[i].stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineInfos[i].stage.module = modules[i];
+		pipelineInfos[i].stage.pName = "main";
+		pipelineInfos[i].layout = computeLayout;
+	}
+
+	VkPipeline pipelines[2];
+	VkResult result = vkCreateComputePipelines(device, VK_NULL_HANDLE, 2, pipelineInfos, allocator, pipelines);
+
+	for (auto module : modules)
+	{
+		vkDestroyShaderModule(device, module, allocator);
+	}
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create particle compute pipelines!");
+	}
+
+	controlPipeline = pipelines[0];
+	simulatePipeline = pipelines[1];
+}
+
+/****************************************************************************
+ * Additive, depth tested quads without vertex input - the vertex shader builds them from the instance's particle.
+ */
+void ParticleSystem::createDrawPipeline(const std::string& shaderDirectory, VkRenderPass renderPass, uint32_t subpass)
+{
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(DrawConstants);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &setLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+	if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, allocator, &drawLayout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create particle pipeline layout!");
+	}
+
+	VkShaderModule vertModule = loadShader(shaderDirectory + "particle_vert.spv");
+	VkShaderModule fragModule = loadShader(shaderDirectory + "particle_frag.spv");
+
+	VkPipelineShaderStageCreateInfo shaderStages[2] = {};
+	shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+	shaderStages[0].module = vertModule;
+	shaderStages[0].pName = "main";
+	shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	shaderStages[1].module = fragModule;
+	shaderStages[1].pName = "main";
+
+	VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
+	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+	VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+	// Whatever the pass around the draw has set, the scene may be rendered at a scaled resolution
+	VkPipelineViewportStateCreateInfo viewportState = {};
+	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportState.viewportCount = 1;
+	viewportState.scissorCount = 1;
+
+	VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+	VkPipelineDynamicStateCreateInfo dynamicState = {};
+	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicState.dynamicStateCount = 2;
+	dynamicState.pDynamicStates = dynamicStates;
+
+	VkPipelineRasterizationStateCreateInfo rasterizer = {};
+	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+	rasterizer.lineWidth = 1.0f;
+	rasterizer.cullMode = VK_CULL_MODE_NONE;
+	rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+
+	VkPipelineMultisampleStateCreateInfo multisampling = {};
+	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	// Tested against the scene, but the particles don't hide each other
+	VkPipelineDepthStencilStateCreateInfo depthStencil = {};
+	depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depthStencil.depthTestEnable = VK_TRUE;
+	depthStencil.depthWriteEnable = VK_FALSE;
+	depthStencil.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+
+	VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
+	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+	colorBlendAttachment.blendEnable = VK_TRUE;
+	colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+	colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+	colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+	colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+	colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+	colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+	VkPipelineColorBlendStateCreateInfo colorBlending = {};
+	colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	colorBlending.attachmentCount = 1;
+	colorBlending.pAttachments = &colorBlendAttachment;
+
+	VkGraphicsPipelineCreateInfo pipelineInfo = {};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineInfo.stageCount = 2;
+	pipelineInfo.pStages = shaderStages;
+	pipelineInfo.pVertexInputState = &vertexInputInfo;
+	pipelineInfo.pInputAssemblyState = &inputAssembly;
+	pipelineInfo.pViewportState = &viewportState;
+	pipelineInfo.pRasterizationState = &rasterizer;
+	pipelineInfo.pMultisampleState = &multisampling;
+	pipelineInfo.pDepthStencilState = &depthStencil;
+	pipelineInfo.pColorBlendState = &colorBlending;
+	pipelineInfo.pDynamicState = &dynamicState;
+	pipelineInfo.layout = drawLayout;
+	pipelineInfo.renderPass = renderPass;
+	pipelineInfo.subpass = subpass;
+	pipelineInfo.basePipelineIndex = -1;
+
+	VkResult result = vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, allocator, &drawPipeline);
+
+	vkDestroyShaderModule(device, fragModule, allocator);
+	vkDestroyShaderModule(device, vertModule, allocator);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create particle pipeline!");
+	}
+}
+
+void ParticleSystem::destroy()
+{
+	if (device == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	vkDestroyPipeline(device, drawPipeline, allocator);
+	vkDestroyPipeline(device, simulatePipeline, allocator);
+	vkDestroyPipeline(device, controlPipeline, allocator);
+	vkDestroyPipelineLayout(device, drawLayout, allocator);
+	vkDestroyPipelineLayout(device, computeLayout, allocator);
+	vkDestroyDescriptorPool(device, descriptorPool, allocator);
+	vkDestroyDescriptorSetLayout(device, setLayout, allocator);
+
+	// Freeing the memory unmaps it too
+	for (uint32_t i = 0; i < 2; i++)
+	{
+		vkDestroyBuffer(device, particleBuffers[i], allocator);
+		vkFreeMemory(device, particleMemory[i], allocator);
+	}
+	vkDestroyBuffer(device, controlBuffer, allocator);
+	vkFreeMemory(device, controlMemory, allocator);
+	vkDestroyBuffer(device, parameterBuffer, allocator);
+	vkFreeMemory(device, parameterMemory, allocator);
+	vkDestroyBuffer(device, readbackBuffer, allocator);
+	vkFreeMemory(device, readbackMemory, allocator);
+
+	sets.clear();
+	device = VK_NULL_HANDLE;
+}
+
+// ==== RECORDING ====
+
+void ParticleSystem::recordReset(VkCommandBuffer commandBuffer) const
+{
+	// Whatever used the control block before - a simulation, a draw or the live count copy
+	memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+	vkCmdFillBuffer(commandBuffer, controlBuffer, 0, VK_WHOLE_SIZE, 0);
+}
+
+/****************************************************************************
+ * Begin pass, the simulation dispatched with the arguments it wrote, then the end pass writing the draw.
+ * The first barrier orders the frame after the previous one: its simulation and draw, or a reset.
+ */
+void ParticleSystem::recordSimulation(VkCommandBuffer commandBuffer, uint32_t frame) const
+{
+	memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computeLayout, 0, 1, &sets[frame], 0, nullptr);
+
+	ControlMode mode = ControlMode::Begin;
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, controlPipeline);
+	vkCmdPushConstants(commandBuffer, computeLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(mode), &mode);
+	vkCmdDispatch(commandBuffer, 1, 1, 1);
+
+	memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+		VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, simulatePipeline);
+	vkCmdDispatchIndirect(commandBuffer, controlBuffer, offsetof(Control, dispatch));
+
+	memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+	mode = ControlMode::End;
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, controlPipeline);
+	vkCmdPushConstants(commandBuffer, computeLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(mode), &mode);
+	vkCmdDispatch(commandBuffer, 1, 1, 1);
+
+	memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+		VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT);
+
+	// The live count is the draw's instance count, a copy of it is all the statistics read back
+	VkBufferCopy copy = {};
+	copy.srcOffset = offsetof(Control, draw) + offsetof(VkDrawIndirectCommand, instanceCount);
+	copy.dstOffset = sizeof(uint32_t) * frame;
+	copy.size = sizeof(uint32_t);
+	vkCmdCopyBuffer(commandBuffer, controlBuffer, readbackBuffer, 1, &copy);
+
+	memoryBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+}
+
+void ParticleSystem::recordDraw(VkCommandBuffer commandBuffer, uint32_t frame, const float viewProjection[16]) const
+{
+	DrawConstants constants = {};
+	std::copy(viewProjection, viewProjection + 16, constants.viewProjection);
+	constants.size[0] = config.particleSize / aspectRatio;
+	constants.size[1] = config.particleSize;
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, drawPipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, drawLayout, 0, 1, &sets[frame], 0, nullptr);
+	vkCmdPushConstants(commandBuffer, drawLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(constants), &constants);
+	vkCmdDrawIndirect(commandBuffer, controlBuffer, offsetof(Control, draw), 1, sizeof(VkDrawIndirectCommand));
+}
+
+/****************************************************************************
+ * The particles live longer than the benchmark runs, so after the first step fills the buffer
+ * every timed step simulates all of them.
+ */
+void ParticleSystem::recordBenchmark(VkCommandBuffer commandBuffer, VkQueryPool queryPool, uint32_t firstQuery, uint32_t iterations)
+{
+	float deltaTime = 1.0f / 60.0f;
+	writeParameters(0, deltaTime, config.capacity, deltaTime * (iterations + 2) * 2.0f);
+
+	vkCmdResetQueryPool(commandBuffer, queryPool, firstQuery, 2);
+	recordReset(commandBuffer);
+	recordSimulation(commandBuffer, 0);
+
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, firstQuery);
+	for (uint32_t i = 0; i < iterations; i++)
+	{
+		recordSimulation(commandBuffer, 0);
+	}
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, firstQuery + 1);
+
+	recordReset(commandBuffer);
+}
+
+void ParticleSystem::memoryBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStages, VkAccessFlags srcAccess,
+	VkPipelineStageFlags dstStages, VkAccessFlags dstAccess) const
+{
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = srcAccess;
+	barrier.dstAccessMask = dstAccess;
+
+	vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+// ==== UPDATE ====
+
+void ParticleSystem::update(uint32_t frame, float deltaTime)
+{
+	// The copy of this frame's previous live count has finished along with it
+	statistics.aliveCount = readbackData[frame];
+	statistics.maxAliveCount = std::max(statistics.maxAliveCount, statistics.aliveCount);
+
+	float emit = config.emissionRate * deltaTime + emitRemainder;
+	uint32_t emitCount = static_cast<uint32_t>(std::min(emit, static_cast<float>(config.capacity)));
+	emitRemainder = emit - emitCount;
+	statistics.emitted += emitCount;
+
+	writeParameters(frame, deltaTime, emitCount, config.lifetime);
+}
+
+void ParticleSystem::writeParameters(uint32_t frame, float deltaTime, uint32_t emitCount, float lifetime)
+{
+	FrameParameters* parameters = reinterpret_cast<FrameParameters*>(parameterData + parameterStride * frame);
+	parameters->emitter[0] = config.emitterPosition[0];
+	parameters->emitter[1] = config.emitterPosition[1];
+	parameters->emitter[2] = config.emitterPosition[2];
+	parameters->emitter[3] = config.emitterRadius;
+	parameters->deltaTime = deltaTime;
+	parameters->lifetime = lifetime;
+	parameters->emitCount = emitCount;
+	parameters->seed = seed++ * 0x9E3779B9u; // Spread out, the shader hashes it with the particle index
+	parameters->speed = config.speed;
+	parameters->gravity = config.gravity;
+	parameters->capacity = config.capacity;
+	parameters->padding = 0;
+}
+
+// ==== HELPERS ====
+
+void ParticleSystem::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& memory)
+{
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = size;
+	bufferInfo.usage = usage;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	if (vkCreateBuffer(device, &bufferInfo, allocator, &buffer) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create particle buffer!");
+	}
+
+	VkMemoryRequirements requirements;
+	vkGetBufferMemoryRequirements(device, buffer, &requirements);
+
+	VkMemoryAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = requirements.size;
+	allocInfo.memoryTypeIndex = findMemoryType(requirements.memoryTypeBits, properties);
+
+	if (vkAllocateMemory(device, &allocInfo, allocator, &memory) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to allocate particle memory!");
+	}
+
+	vkBindBufferMemory(device, buffer, memory, 0);
+}
+
+VkShaderModule ParticleSystem::loadShader(const std::string& path) const
+{
+	std::ifstream file(path, std::ios::ate | std::ios::binary);
+	if (!file.is_open())
+	{
+		throw std::runtime_error("Failed to open " + path + "!");
+	}
+
+	size_t fileSize = static_cast<size_t>(file.tellg());
+	std::vector<char> code(fileSize);
+	file.seekg(0);
+	file.read(code.data(), fileSize);
+
+	VkShaderModuleCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	createInfo.codeSize = code.size();
+	createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+
+	VkShaderModule shaderModule;
+	if (vkCreateShaderModule(device, &createInfo, allocator, &shaderModule) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create shader module " + path + "!");
+	}
+
+	return shaderModule;
+}
+
+uint32_t ParticleSystem::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const
+{
+	VkPhysicalDeviceMemoryProperties memProperties;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
+	{
+		if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
+		{
+			return i;
+		}
+	}
+
+	throw std::runtime_error("Failed to find suitable memory type for particles!");
+}
@@ -0,0 +1,144 @@
+#ifndef PARTICLE_SYSTEM
+#define PARTICLE_SYSTEM
+
+#include "VulkanDispatch.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/****************************************************************************************************
+ * Particle effect that lives entirely on the GPU.
+ * - The particles are in two storage buffers. Every frame the simulation reads the live particles from one,
+ *   spawns the new ones after them, and writes the survivors compacted into the other - the buffers swap
+ *   roles each frame, so the order frames run in is all that matters, not which command buffer runs them.
+ * - A small control buffer holds which buffer is current, the live counts and the indirect arguments: the
+ *   simulation is dispatched with vkCmdDispatchIndirect and the particles are drawn with one instanced
+ *   vkCmdDrawIndirect, a camera facing quad per instance.
+ * - The CPU only writes a few parameters per frame (time step, how many to spawn, a random seed) into
+ *   a host visible buffer per frame in flight, so the command buffers can be recorded once.
+ *
+ * recordSimulation() goes outside of a render pass before the particles are drawn, recordDraw() into the
+ * render pass given to init(), with the viewport and scissor already set. The buffers are synchronized with barriers
+ * in recordSimulation().
+ */
+class ParticleSystem
+{
+public:
+	struct Config
+	{
+		uint32_t capacity = 1 << 20;
+		float emissionRate = 262144.0f; // Particles per second
+		float lifetime = 4.0f; // Seconds, each particle lives between half of this and all of it
+		float emitterPosition[3] = { 0.0f, 0.0f, 0.0f };
+		float emitterRadius = 0.1f;
+		float speed = 1.0f; // Launch speed, world units per second
+		float gravity = 1.0f;
+		float particleSize = 0.004f; // Half size of the quad, in clip space units at distance 1
+	};
+
+	struct Statistics
+	{
+		uint32_t capacity = 0;
+		uint32_t aliveCount = 0; // Read back from the last finished frame
+		uint64_t emitted = 0; // Requested by the CPU, spawns that don't fit in the buffer are dropped
+		uint32_t maxAliveCount = 0;
+	};
+
+	// frameCount parameter buffers are made, one per command buffer that records the simulation
+	void init(VkDevice device, const VkAllocationCallbacks* allocator, VkPhysicalDevice physicalDevice, const std::string& shaderDirectory, VkRenderPass renderPass, uint32_t subpass,
+		VkExtent2D extent, uint32_t frameCount, const Config& config);
+	void destroy();
+
+	// Empties the particle buffers, before the first frame
+	void recordReset(VkCommandBuffer commandBuffer) const;
+	void recordSimulation(VkCommandBuffer commandBuffer, uint32_t frame) const;
+	void recordDraw(VkCommandBuffer commandBuffer, uint32_t frame, const float viewProjection[16]) const;
+	// Fills the buffer and simulates it the given number of times between the two timestamp queries, then empties it
+	void recordBenchmark(VkCommandBuffer commandBuffer, VkQueryPool queryPool, uint32_t firstQuery, uint32_t iterations);
+
+	// Once the frame's previous use has finished on the GPU, before its commands are submitted again
+	void update(uint32_t frame, float deltaTime);
+
+	const Statistics& getStatistics() const { return statistics; }
+
+private:
+	// Matches the Frame uniform block of the particle shaders
+	struct FrameParameters
+	{
+		float emitter[4]; // Position and radius
+		float deltaTime;
+		float lifetime;
+		uint32_t emitCount;
+		uint32_t seed;
+		float speed;
+		float gravity;
+		uint32_t capacity;
+		uint32_t padding;
+	};
+
+	// Matches the Control block, the indirect arguments are at the offsets the commands read them from
+	struct Control
+	{
+		uint32_t current;
+		uint32_t aliveCount[2];
+		uint32_t spawnCount;
+		VkDispatchIndirectCommand dispatch;
+		VkDrawIndirectCommand draw;
+	};
+
+	struct DrawConstants
+	{
+		float viewProjection[16];
+		float size[2];
+		float padding[2];
+	};
+
+	enum class ControlMode : uint32_t
+	{
+		Begin, // Spawn count, dispatch size, clears the next live count
+		End // Draw arguments, swaps the buffers
+	};
+
+	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& memory);
+	VkShaderModule loadShader(const std::string& path) const;
+	void createComputePipelines(const std::string& shaderDirectory);
+	void createDrawPipeline(const std::string& shaderDirectory, VkRenderPass renderPass, uint32_t subpass);
+	void writeParameters(uint32_t frame, float deltaTime, uint32_t emitCount, float lifetime);
+	void memoryBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStages, VkAccessFlags srcAccess,
+		VkPipelineStageFlags dstStages, VkAccessFlags dstAccess) const;
+	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+
+	VkDevice device = VK_NULL_HANDLE;
+	const VkAllocationCallbacks* allocator = nullptr;
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	Config config;
+	float aspectRatio = 1.0f;
+
+	VkBuffer particleBuffers[2] = {};
+	VkDeviceMemory particleMemory[2] = {};
+	VkBuffer controlBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory controlMemory = VK_NULL_HANDLE;
+	VkBuffer parameterBuffer = VK_NULL_HANDLE; // Host visible, one aligned FrameParameters per frame
+	VkDeviceMemory parameterMemory = VK_NULL_HANDLE;
+	char* parameterData = nullptr;
+	VkDeviceSize parameterStride = 0;
+	VkBuffer readbackBuffer = VK_NULL_HANDLE; // Host visible, the live count of each frame
+	VkDeviceMemory readbackMemory = VK_NULL_HANDLE;
+	uint32_t* readbackData = nullptr;
+
+	VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+	std::vector<VkDescriptorSet> sets; // Per frame, only the parameters differ
+	VkPipelineLayout computeLayout = VK_NULL_HANDLE;
+	VkPipelineLayout drawLayout = VK_NULL_HANDLE;
+	VkPipeline controlPipeline = VK_NULL_HANDLE;
+	VkPipeline simulatePipeline = VK_NULL_HANDLE;
+	VkPipeline drawPipeline = VK_NULL_HANDLE;
+
+	float emitRemainder = 0.0f; // Fraction of a particle carried over to the next frame
+	uint32_t seed = 0;
+	Statistics statistics;
+};
+
+#endif
@@ -0,0 +1,535 @@
+#include "PostProcess.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+static const uint32_t histogramBinCount = 256; // Also the exposure shader's workgroup size
+static const uint32_t tileSize = 8; // Workgroup size of the image passes, the histogram uses 16x16
+static const uint32_t histogramTileSize = 16;
+
+static const char* const shaderFiles[] = { "histogram.spv", "exposure.spv", "downsample.spv", "upsample.spv", "tonemap.spv" };
+
+// ==== SETUP ====
+
+bool PostProcess::isSupported(VkPhysicalDevice physicalDevice, uint32_t& subgroupSize)
+{
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	if (properties.apiVersion < VK_API_VERSION_1_1)
+	{
+		return false;
+	}
+
+	VkPhysicalDeviceSubgroupProperties subgroupProperties = {};
+	subgroupProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+
+	VkPhysicalDeviceProperties2 properties2 = {};
+	properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	properties2.pNext = &subgroupProperties;
+	vkGetPhysicalDeviceProperties2(physicalDevice, &properties2);
+
+	VkSubgroupFeatureFlags required = VK_SUBGROUP_FEATURE_BASIC_BIT | VK_SUBGROUP_FEATURE_VOTE_BIT |
+		VK_SUBGROUP_FEATURE_ARITHMETIC_BIT | VK_SUBGROUP_FEATURE_BALLOT_BIT;
+	if (!(subgroupProperties.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) || (subgroupProperties.supportedOperations & required) != required)
+	{
+		return false;
+	}
+
+	subgroupSize = subgroupProperties.subgroupSize;
+	return true;
+}
+
+void PostProcess::init(VkDevice device, const VkAllocationCallbacks* allocator, VkPhysicalDevice physicalDevice, VkFormat outputFormat, const std::string& shaderDirectory, const Config& config)
+{
+	this->device = device;
+	this->allocator = allocator;
+	this->physicalDevice = physicalDevice;
+	this->config = config;
+
+	isSupported(physicalDevice, statistics.subgroupSize);
+
+	VkSamplerCreateInfo samplerInfo = {};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_LINEAR;
+	samplerInfo.minFilter = VK_FILTER_LINEAR;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.maxLod = 0.0f;
+
+	if (vkCreateSampler(device, &samplerInfo, allocator, &sampler) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create post-process sampler!");
+	}
+
+	// Two sampled inputs, the output image, the histogram and the exposure
+	VkDescriptorSetLayoutBinding bindings[5] = {};
+	for (uint32_t i = 0; i < 5; i++)
+	{
+		bindings[i].binding = i;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	bindings[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	bindings[4].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = 5;
+	layoutInfo.pBindings = bindings;
+
+	if (vkCreateDescriptorSetLayout(device, &layoutInfo, allocator, &setLayout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create post-process descriptor set layout!");
+	}
+
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(PushConstants);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &setLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+	if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, allocator, &pipelineLayout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create post-process pipeline layout!");
+	}
+
+	// All the pipelines are created in one call, so the driver can compile them in parallel
+	VkShaderModule modules[static_cast<size_t>(Shader::Count)];
+	VkComputePipelineCreateInfo pipelineInfos[static_cast<size_t>(Shader::Count)] = {};
+	for (size_t i = 0; i < static_cast<size_t>(Shader::Count); i++)
+	{
+		std::string file = shaderFiles[i];
+		if (static_cast<Shader>(i) == Shader::Tonemap && outputFormat == VK_FORMAT_R8G8B8A8_UNORM)
+		{
+			file = "tonemap_rgba8.spv";
+		}
+		modules[i] = loadShader(shaderDirectory + file);
+
+		pipelineInfos[i].sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfos[i].stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineInfos[i].stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineInfos[i].stage.module = modules[i];
+		pipelineInfos[i].stage.pName = "main";
+		pipelineInfos[i].layout = pipelineLayout;
+	}
+
+	VkResult result = vkCreateComputePipelines(device, VK_NULL_HANDLE, static_cast<uint32_t>(Shader::Count), pipelineInfos, allocator, pipelines);
+
+	for (auto module : modules)
+	{
+		vkDestroyShaderModule(device, module, allocator);
+	}
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create post-process pipelines!");
+	}
+
+	// The histogram is cleared on the GPU every frame, the exposure starts out as "not measured yet"
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = histogramBinCount * sizeof(uint32_t);
+	bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	VkMemoryRequirements requirements;
+	VkMemoryAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+
+	if (vkCreateBuffer(device, &bufferInfo, allocator, &histogramBuffer) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create histogram buffer!");
+	}
+	vkGetBufferMemoryRequirements(device, histogramBuffer, &requirements);
+	allocInfo.allocationSize = requirements.size;
+	allocInfo.memoryTypeIndex = findMemoryType(requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	if (vkAllocateMemory(device, &allocInfo, allocator, &histogramMemory) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to allocate histogram memory!");
+	}
+	vkBindBufferMemory(device, histogramBuffer, histogramMemory, 0);
+
+	bufferInfo.size = sizeof(Exposure);
+	bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+	if (vkCreateBuffer(device, &bufferInfo, allocator, &exposureBuffer) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create exposure buffer!");
+	}
+	vkGetBufferMemoryRequirements(device, exposureBuffer, &requirements);
+	allocInfo.allocationSize = requirements.size;
+	allocInfo.memoryTypeIndex = findMemoryType(requirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	if (vkAllocateMemory(device, &allocInfo, allocator, &exposureMemory) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to allocate exposure memory!");
+	}
+	vkBindBufferMemory(device, exposureBuffer, exposureMemory, 0);
+
+	vkMapMemory(device, exposureMemory, 0, sizeof(Exposure), 0, reinterpret_cast<void**>(&exposureData));
+	exposureData->averageLuminance = 0.0f;
+	exposureData->exposure = 1.0f;
+}
+
+/****************************************************************************
+ * Bloom level i is half the size of level i - 1, level 0 half the size of the scene. The upsampled levels
+ * get images of their own, the downsampled ones are still read while the chain goes back up.
+ */
+void PostProcess::addPasses(RenderGraph& graph, RenderGraph::ResourceHandle sceneColor, RenderGraph::ResourceHandle output, VkExtent2D extent)
+{
+	typedef RenderGraph::ResourceUsage Usage;
+
+	passes.clear();
+	float logLuminanceRange = config.maxLogLuminance - config.minLogLuminance;
+
+	auto addPass = [this, &graph](const std::string& name, const Pass& pass) -> RenderGraph::PassHandle
+	{
+		uint32_t passIndex = static_cast<uint32_t>(passes.size());
+		passes.push_back(pass);
+		return graph.addPass(name, RenderGraph::PassType::Compute, [this, passIndex](VkCommandBuffer commandBuffer, uint32_t variant)
+		{
+			recordPass(commandBuffer, passIndex, variant);
+		});
+	};
+
+	Pass histogram;
+	histogram.shader = Shader::Histogram;
+	histogram.input = sceneColor;
+	histogram.extent = extent;
+	histogram.pushConstants = { { config.minLogLuminance, 1.0f / logLuminanceRange, 0.0f, 0.0f } };
+	RenderGraph::PassHandle histogramPass = addPass("Luminance histogram", histogram);
+	graph.readResource(histogramPass, sceneColor, Usage::SampledCompute);
+	graph.setSideEffects(histogramPass); // Its result is a buffer the graph doesn't see
+
+	Pass exposure;
+	exposure.shader = Shader::Exposure;
+	exposure.extent = { 1, 1 };
+	exposure.pushConstants = { { config.minLogLuminance, logLuminanceRange, static_cast<float>(extent.width) * extent.height, config.adaptation } };
+	graph.setSideEffects(addPass("Exposure", exposure));
+
+	uint32_t levelCount = std::max(config.bloomLevels, 2u);
+	std::vector<RenderGraph::ResourceHandle> downLevels(levelCount);
+	std::vector<VkExtent2D> levelExtents(levelCount);
+
+	for (uint32_t i = 0; i < levelCount; i++)
+	{
+		levelExtents[i] = { std::max(extent.width >> (i + 1), 1u), std::max(extent.height >> (i + 1), 1u) };
+		RenderGraph::ImageDesc desc = { VK_FORMAT_R16G16B16A16_SFLOAT, levelExtents[i], VK_IMAGE_ASPECT_COLOR_BIT };
+		downLevels[i] = graph.createImage("Bloom down " + std::to_string(i), desc);
+
+		Pass downsample;
+		downsample.shader = Shader::Downsample;
+		downsample.input = i == 0 ? sceneColor : downLevels[i - 1];
+		downsample.output = downLevels[i];
+		downsample.extent = levelExtents[i];
+		downsample.pushConstants = { { i == 0 ? config.bloomThreshold : 0.0f, 0.0f, 0.0f, 0.0f } };
+
+		RenderGraph::PassHandle pass = addPass("Bloom downsample " + std::to_string(i), downsample);
+		graph.readResource(pass, downsample.input, Usage::SampledCompute);
+		graph.writeResource(pass, downsample.output, Usage::Storage);
+	}
+
+	// The smallest level is the start of the way up
+	RenderGraph::ResourceHandle upper = downLevels[levelCount - 1];
+	for (uint32_t i = levelCount - 1; i-- > 0;)
+	{
+		RenderGraph::ImageDesc desc = { VK_FORMAT_R16G16B16A16_SFLOAT, levelExtents[i], VK_IMAGE_ASPECT_COLOR_BIT };
+		RenderGraph::ResourceHandle upLevel = graph.createImage("Bloom up " + std::to_string(i), desc);
+
+		Pass upsample;
+		upsample.shader = Shader::Upsample;
+		upsample.input = upper;
+		upsample.secondInput = downLevels[i];
+		upsample.output = upLevel;
+		upsample.extent = levelExtents[i];
+
+		RenderGraph::PassHandle pass = addPass("Bloom upsample " + std::to_string(i), upsample);
+		graph.readResource(pass, upsample.input, Usage::SampledCompute);
+		graph.readResource(pass, upsample.secondInput, Usage::SampledCompute);
+		graph.writeResource(pass, upsample.output, Usage::Storage);
+
+		upper = upLevel;
+	}
+
+	Pass tonemap;
+	tonemap.shader = Shader::Tonemap;
+	tonemap.input = sceneColor;
+	tonemap.secondInput = upper;
+	tonemap.output = output;
+	tonemap.extent = extent;
+	tonemap.pushConstants = { { config.bloomIntensity, 0.0f, 0.0f, 0.0f } };
+
+	RenderGraph::PassHandle tonemapPass = addPass("Tonemap", tonemap);
+	graph.readResource(tonemapPass, sceneColor, Usage::SampledCompute);
+	graph.readResource(tonemapPass, upper, Usage::SampledCompute);
+	graph.writeResource(tonemapPass, output, Usage::Storage);
+
+	statistics.computePasses = static_cast<uint32_t>(passes.size());
+}
+
+void PostProcess::createDescriptorSets(const RenderGraph& graph, uint32_t variantCount)
+{
+	uint32_t setCount = static_cast<uint32_t>(passes.size()) * variantCount;
+
+	VkDescriptorPoolSize poolSizes[3] = {};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSizes[0].descriptorCount = setCount * 2;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	poolSizes[1].descriptorCount = setCount;
+	poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[2].descriptorCount = setCount * 2;
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = setCount;
+	poolInfo.poolSizeCount = 3;
+	poolInfo.pPoolSizes = poolSizes;
+
+	if (vkCreateDescriptorPool(device, &poolInfo, allocator, &descriptorPool) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create post-process descriptor pool!");
+	}
+
+	std::vector<VkDescriptorSetLayout> layouts(setCount, setLayout);
+	std::vector<VkDescriptorSet> sets(setCount);
+
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = descriptorPool;
+	allocInfo.descriptorSetCount = setCount;
+	allocInfo.pSetLayouts = layouts.data();
+
+	if (vkAllocateDescriptorSets(device, &allocInfo, sets.data()) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to allocate post-process descriptor sets!");
+	}
+
+	VkDescriptorBufferInfo histogramInfo = { histogramBuffer, 0, VK_WHOLE_SIZE };
+	VkDescriptorBufferInfo exposureInfo = { exposureBuffer, 0, VK_WHOLE_SIZE };
+
+	// Only the bindings a shader actually uses have to be valid
+	std::vector<VkWriteDescriptorSet> writes;
+	std::vector<VkDescriptorImageInfo> imageInfos(setCount * 3);
+	size_t imageInfoCount = 0;
+
+	auto writeImage = [&](VkDescriptorSet set, uint32_t binding, RenderGraph::ResourceHandle resource, uint32_t variant)
+	{
+		VkDescriptorImageInfo& imageInfo = imageInfos[imageInfoCount++];
+		imageInfo.sampler = binding == 2 ? VK_NULL_HANDLE : sampler;
+		imageInfo.imageView = graph.getImageView(resource, variant);
+		imageInfo.imageLayout = binding == 2 ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		VkWriteDescriptorSet write = {};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = set;
+		write.dstBinding = binding;
+		write.descriptorCount = 1;
+		write.descriptorType = binding == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		write.pImageInfo = &imageInfo;
+		writes.push_back(write);
+	};
+
+	auto writeBuffer = [&](VkDescriptorSet set, uint32_t binding, const VkDescriptorBufferInfo& bufferInfo)
+	{
+		VkWriteDescriptorSet write = {};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = set;
+		write.dstBinding = binding;
+		write.descriptorCount = 1;
+		write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		write.pBufferInfo = &bufferInfo;
+		writes.push_back(write);
+	};
+
+	for (size_t p = 0; p < passes.size(); p++)
+	{
+		Pass& pass = passes[p];
+		pass.sets.assign(sets.begin() + p * variantCount, sets.begin() + (p + 1) * variantCount);
+
+		for (uint32_t variant = 0; variant < variantCount; variant++)
+		{
+			VkDescriptorSet set = pass.sets[variant];
+
+			if (pass.input != UINT32_MAX)
+			{
+				writeImage(set, 0, pass.input, variant);
+			}
+			if (pass.secondInput != UINT32_MAX)
+			{
+				writeImage(set, 1, pass.secondInput, variant);
+			}
+			if (pass.output != UINT32_MAX)
+			{
+				writeImage(set, 2, pass.output, variant);
+			}
+			if (pass.shader == Shader::Histogram || pass.shader == Shader::Exposure)
+			{
+				writeBuffer(set, 3, histogramInfo);
+			}
+			if (pass.shader == Shader::Exposure || pass.shader == Shader::Tonemap)
+			{
+				writeBuffer(set, 4, exposureInfo);
+			}
+		}
+	}
+
+	vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+void PostProcess::destroy()
+{
+	if (device == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	vkDestroyDescriptorPool(device, descriptorPool, allocator);
+	for (auto pipeline : pipelines)
+	{
+		vkDestroyPipeline(device, pipeline, allocator);
+	}
+	vkDestroyPipelineLayout(device, pipelineLayout, allocator);
+	vkDestroyDescriptorSetLayout(device, setLayout, allocator);
+	vkDestroySampler(device, sampler, allocator);
+
+	vkDestroyBuffer(device, histogramBuffer, allocator);
+	vkFreeMemory(device, histogramMemory, allocator);
+	vkDestroyBuffer(device, exposureBuffer, allocator);
+	vkFreeMemory(device, exposureMemory, allocator); // Freeing unmaps it too
+
+	passes.clear();
+	device = VK_NULL_HANDLE;
+}
+
+const PostProcess::Statistics& PostProcess::getStatistics()
+{
+	if (exposureData != nullptr)
+	{
+		statistics.averageLuminance = exposureData->averageLuminance;
+		statistics.exposure = exposureData->exposure;
+	}
+
+	return statistics;
+}
+
+// ==== RECORDING ====
+
+/****************************************************************************
+ * The render graph has already synchronized the images, the histogram and exposure buffers are synchronized
+ * here. The barriers also order the passes against the same passes of the previous frame on the queue.
+ */
+void PostProcess::recordPass(VkCommandBuffer commandBuffer, uint32_t passIndex, uint32_t variant) const
+{
+	const Pass& pass = passes[passIndex];
+
+	uint32_t groupSize = tileSize;
+	switch (pass.shader)
+	{
+	case Shader::Histogram:
+		// The previous frame's exposure pass reads the bins that get cleared here
+		bufferBarrier(commandBuffer, histogramBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+		vkCmdFillBuffer(commandBuffer, histogramBuffer, 0, VK_WHOLE_SIZE, 0);
+		bufferBarrier(commandBuffer, histogramBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+		groupSize = histogramTileSize;
+		break;
+	case Shader::Exposure:
+		bufferBarrier(commandBuffer, histogramBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+		// The previous frame's tonemap reads the exposure this pass overwrites
+		bufferBarrier(commandBuffer, exposureBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+		break;
+	case Shader::Tonemap:
+		bufferBarrier(commandBuffer, exposureBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+		break;
+	default:
+		break;
+	}
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelines[static_cast<size_t>(pass.shader)]);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &pass.sets[variant], 0, nullptr);
+	vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pass.pushConstants);
+
+	if (pass.shader == Shader::Exposure)
+	{
+		vkCmdDispatch(commandBuffer, 1, 1, 1);
+	}
+	else
+	{
+		vkCmdDispatch(commandBuffer, (pass.extent.width + groupSize - 1) / groupSize, (pass.extent.height + groupSize - 1) / groupSize, 1);
+	}
+}
+
+void PostProcess::bufferBarrier(VkCommandBuffer commandBuffer, VkBuffer buffer, VkPipelineStageFlags srcStages, VkAccessFlags srcAccess,
+	VkPipelineStageFlags dstStages, VkAccessFlags dstAccess) const
+{
+	VkBufferMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = srcAccess;
+	barrier.dstAccessMask = dstAccess;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = buffer;
+	barrier.offset = 0;
+	barrier.size = VK_WHOLE_SIZE;
+
+	vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+// ==== HELPERS ====
+
+VkShaderModule PostProcess::loadShader(const std::string& path) const
+{
+	std::ifstream file(path, std::ios::ate | std::ios::binary);
+	if (!file.is_open())
+	{
+		throw std::runtime_error("Failed to open " + path + "!");
+	}
+
+	size_t fileSize = static_cast<size_t>(file.tellg());
+	std::vector<char> code(fileSize);
+	file.seekg(0);
+	file.read(code.data(), fileSize);
+
+	VkShaderModuleCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	createInfo.codeSize = code.size();
+	createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+
+	VkShaderModule shaderModule;
+	if (vkCreateShaderModule(device, &createInfo, allocator, &shaderModule) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create shader module " + path + "!");
+	}
+
+	return shaderModule;
+}
+
+uint32_t PostProcess::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const
+{
+	VkPhysicalDeviceMemoryProperties memProperties;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
+	{
+		if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
+		{
+			return i;
+		}
+	}
+
+	throw std::runtime_error("Failed to find suitable memory type for post-processing!");
+}
@@ -0,0 +1,123 @@
+#ifndef POST_PROCESS
+#define POST_PROCESS
+
+#include "VulkanDispatch.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "RenderGraph.hpp"
+
+/****************************************************************************************************
+ * HDR post-processing as a chain of compute passes in the render graph.
+ * - Luminance histogram of the scene, reduced to an average luminance that the exposure adapts to over time.
+ * - Bloom: the bright parts are downsampled through a chain of half resolution images, then upsampled back
+ *   with a tent filter, adding each level on the way up.
+ * - Tonemapping with the adapted exposure and the bloom, written straight to the output image.
+ *
+ * Every pass works on 8x8 or 16x16 pixel tiles. The histogram merges equal bins across a subgroup before
+ * touching shared memory, and the exposure reduction sums the histogram with subgroupAdd, so both need
+ * subgroup arithmetic, ballot and vote in compute shaders (Vulkan 1.1).
+ *
+ * The passes only read and write images the render graph tracks, plus two buffers they synchronize themselves,
+ * so the same chain can go into the frame's graph or into a graph of its own that runs on another queue.
+ */
+class PostProcess
+{
+public:
+	struct Config
+	{
+		uint32_t bloomLevels = 5;
+		float bloomThreshold = 1.0f; // Luminance where the bloom starts
+		float bloomIntensity = 0.05f;
+		float minLogLuminance = -8.0f; // Histogram range, in log2 luminance
+		float maxLogLuminance = 4.0f;
+		float adaptation = 0.05f; // Fraction of the way to the new luminance per frame, the commands are recorded once
+	};
+
+	struct Statistics
+	{
+		uint32_t computePasses = 0;
+		uint32_t subgroupSize = 0;
+		float averageLuminance = 0.0f; // Adapted, read back from the last finished frame
+		float exposure = 0.0f;
+	};
+
+	// Checks the subgroup operations the shaders use
+	static bool isSupported(VkPhysicalDevice physicalDevice, uint32_t& subgroupSize);
+
+	// The tonemap output is written with a rgba8 format qualifier if that's its format, without one otherwise,
+	// which needs shaderStorageImageWriteWithoutFormat
+	void init(VkDevice device, const VkAllocationCallbacks* allocator, VkPhysicalDevice physicalDevice, VkFormat outputFormat, const std::string& shaderDirectory, const Config& config);
+	// Before the graph is compiled, the scene color has to be sampled by compute shaders and the output written as storage
+	void addPasses(RenderGraph& graph, RenderGraph::ResourceHandle sceneColor, RenderGraph::ResourceHandle output, VkExtent2D extent);
+	// After the graph is compiled, one set of descriptors per variant
+	void createDescriptorSets(const RenderGraph& graph, uint32_t variantCount);
+	void destroy();
+
+	const Statistics& getStatistics();
+
+private:
+	enum class Shader
+	{
+		Histogram,
+		Exposure,
+		Downsample,
+		Upsample,
+		Tonemap,
+		Count
+	};
+
+	// Matches the push constant block of every post-process shader
+	struct PushConstants
+	{
+		float parameters[4];
+	};
+
+	struct Exposure
+	{
+		float averageLuminance; // 0 until the first frame, which then starts from its own luminance
+		float exposure;
+	};
+
+	struct Pass
+	{
+		Shader shader;
+		RenderGraph::ResourceHandle input = UINT32_MAX; // Binding 0
+		RenderGraph::ResourceHandle secondInput = UINT32_MAX; // Binding 1
+		RenderGraph::ResourceHandle output = UINT32_MAX; // Binding 2
+		VkExtent2D extent = {}; // Pixels the dispatch covers
+		PushConstants pushConstants = {};
+		std::vector<VkDescriptorSet> sets; // Per variant
+	};
+
+	VkShaderModule loadShader(const std::string& path) const;
+	void recordPass(VkCommandBuffer commandBuffer, uint32_t passIndex, uint32_t variant) const;
+	void bufferBarrier(VkCommandBuffer commandBuffer, VkBuffer buffer, VkPipelineStageFlags srcStages, VkAccessFlags srcAccess,
+		VkPipelineStageFlags dstStages, VkAccessFlags dstAccess) const;
+	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+
+	VkDevice device = VK_NULL_HANDLE;
+	const VkAllocationCallbacks* allocator = nullptr;
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	Config config;
+
+	VkSampler sampler = VK_NULL_HANDLE; // Bilinear, clamped to the edge
+	VkDescriptorSetLayout setLayout = VK_NULL_HANDLE; // Shared by all the passes, each one writes the bindings it uses
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	VkPipeline pipelines[static_cast<size_t>(Shader::Count)] = {};
+	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+
+	VkBuffer histogramBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory histogramMemory = VK_NULL_HANDLE;
+	VkBuffer exposureBuffer = VK_NULL_HANDLE; // Host visible, it's tiny and the statistics read it back
+	VkDeviceMemory exposureMemory = VK_NULL_HANDLE;
+	Exposure* exposureData = nullptr;
+
+	std::vector<Pass> passes;
+
+	Statistics statistics;
+};
+
+#endif
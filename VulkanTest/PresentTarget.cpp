@@ -0,0 +1,326 @@
+#include "PresentTarget.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+
+bool PresentTarget::init(VkDevice device, VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, const Config& config)
+{
+	this->device = device;
+	allocator = config.allocator;
+	enabled = false;
+
+	VkBool32 presentSupport = VK_FALSE;
+	vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, config.presentFamily, surface, &presentSupport);
+
+	VkSurfaceCapabilitiesKHR capabilities;
+	vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface, &capabilities);
+
+	if (!presentSupport || !(capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT))
+	{
+		return false;
+	}
+
+	uint32_t formatCount = 0;
+	vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface, &formatCount, nullptr);
+	std::vector<VkSurfaceFormatKHR> formats(formatCount);
+	vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface, &formatCount, formats.data());
+
+	if (formats.empty())
+	{
+		return false;
+	}
+
+	// Same preference as the main swap chain, so the blit usually doesn't have to convert
+	VkSurfaceFormatKHR surfaceFormat = formats[0];
+	for (const VkSurfaceFormatKHR& format : formats)
+	{
+		if (format.format == VK_FORMAT_B8G8R8A8_UNORM && format.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR)
+		{
+			surfaceFormat = format;
+			break;
+		}
+	}
+	if (surfaceFormat.format == VK_FORMAT_UNDEFINED)
+	{
+		surfaceFormat.format = VK_FORMAT_B8G8R8A8_UNORM; // Any format goes
+	}
+
+	VkFormatProperties sourceProperties;
+	VkFormatProperties targetProperties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, config.sourceFormat, &sourceProperties);
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, surfaceFormat.format, &targetProperties);
+
+	if (!(sourceProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT) ||
+		!(targetProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT))
+	{
+		return false;
+	}
+
+	filter = (sourceProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+
+	createSwapChain(physicalDevice, surface, capabilities, surfaceFormat, config);
+
+	uint32_t imageCount = 0;
+	vkGetSwapchainImagesKHR(device, swapChain, &imageCount, nullptr);
+	images.resize(imageCount);
+	vkGetSwapchainImagesKHR(device, swapChain, &imageCount, images.data());
+
+	commandPools.resize(imageCount);
+	commandBuffers.resize(imageCount);
+	imageValues.assign(imageCount, 0);
+
+	for (uint32_t i = 0; i < imageCount; i++)
+	{
+		VkCommandPoolCreateInfo poolInfo = {};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+		poolInfo.queueFamilyIndex = config.graphicsFamily;
+
+		if (vkCreateCommandPool(device, &poolInfo, allocator, &commandPools[i]) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create present target command pool!");
+		}
+
+		VkCommandBufferAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = commandPools[i];
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandBufferCount = 1;
+
+		if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffers[i]) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to allocate present target command buffer!");
+		}
+	}
+
+	VkSemaphoreCreateInfo semaphoreInfo = {};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+	if (vkCreateSemaphore(device, &semaphoreInfo, allocator, &acquireSemaphore) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create present target semaphore!");
+	}
+
+	enabled = true;
+	return true;
+}
+
+void PresentTarget::destroy()
+{
+	if (device == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	for (VkCommandPool pool : commandPools)
+	{
+		vkDestroyCommandPool(device, pool, allocator);
+	}
+	commandPools.clear();
+	commandBuffers.clear();
+
+	if (acquireSemaphore != VK_NULL_HANDLE)
+	{
+		vkDestroySemaphore(device, acquireSemaphore, allocator);
+		acquireSemaphore = VK_NULL_HANDLE;
+	}
+	if (swapChain != VK_NULL_HANDLE)
+	{
+		vkDestroySwapchainKHR(device, swapChain, allocator);
+		swapChain = VK_NULL_HANDLE;
+	}
+
+	enabled = false;
+	device = VK_NULL_HANDLE;
+}
+
+/****************************************************************************
+ * The targets are presented together with the main window, so a FIFO target would hold every window to its
+ * refresh rate - mailbox or immediate are preferred, as they are for the main swap chain.
+ */
+void PresentTarget::createSwapChain(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, const VkSurfaceCapabilitiesKHR& capabilities,
+	VkSurfaceFormatKHR surfaceFormat, const Config& config)
+{
+	extent = capabilities.currentExtent;
+	if (extent.width == std::numeric_limits<uint32_t>::max())
+	{
+		extent.width = std::max(capabilities.minImageExtent.width, std::min(capabilities.maxImageExtent.width, config.extent.width));
+		extent.height = std::max(capabilities.minImageExtent.height, std::min(capabilities.maxImageExtent.height, config.extent.height));
+	}
+
+	uint32_t presentModeCount = 0;
+	vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &presentModeCount, nullptr);
+	std::vector<VkPresentModeKHR> presentModes(presentModeCount);
+	vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &presentModeCount, presentModes.data());
+
+	VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+	for (VkPresentModeKHR mode : presentModes)
+	{
+		if (mode == VK_PRESENT_MODE_MAILBOX_KHR)
+		{
+			presentMode = mode;
+			break;
+		}
+		if (mode == VK_PRESENT_MODE_IMMEDIATE_KHR)
+		{
+			presentMode = mode;
+		}
+	}
+
+	uint32_t imageCount = capabilities.minImageCount + 1;
+	if (capabilities.maxImageCount > 0 && imageCount > capabilities.maxImageCount)
+	{
+		imageCount = capabilities.maxImageCount;
+	}
+
+	VkSwapchainCreateInfoKHR createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+	createInfo.surface = surface;
+	createInfo.minImageCount = imageCount;
+	createInfo.imageFormat = surfaceFormat.format;
+	createInfo.imageColorSpace = surfaceFormat.colorSpace;
+	createInfo.imageExtent = extent;
+	createInfo.imageArrayLayers = 1;
+	createInfo.imageUsage = VK_IMAGE_USAGE_TRANSFER_DST_BIT; // Only ever blitted into
+
+	uint32_t queueFamilyIndices[] = { config.graphicsFamily, config.presentFamily };
+	if (config.graphicsFamily != config.presentFamily)
+	{
+		createInfo.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
+		createInfo.queueFamilyIndexCount = 2;
+		createInfo.pQueueFamilyIndices = queueFamilyIndices;
+	}
+	else
+	{
+		createInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	}
+
+	createInfo.preTransform = capabilities.currentTransform;
+	createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+	createInfo.presentMode = presentMode;
+	createInfo.clipped = VK_TRUE;
+	createInfo.oldSwapchain = VK_NULL_HANDLE;
+
+	if (vkCreateSwapchainKHR(device, &createInfo, allocator, &swapChain) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create present target swap chain!");
+	}
+}
+
+// ==== FRAME ====
+
+bool PresentTarget::acquire()
+{
+	if (!enabled)
+	{
+		return false;
+	}
+
+	VkResult result = vkAcquireNextImageKHR(device, swapChain, std::numeric_limits<uint64_t>::max(), acquireSemaphore, VK_NULL_HANDLE, &imageIndex);
+	if (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR)
+	{
+		return true;
+	}
+
+	// The windows don't resize, so an out of date swap chain won't get better
+	statistics.skippedFrames++;
+	if (result < 0)
+	{
+		std::cerr << "Present target: acquiring an image failed (" << result << "), the target is disabled\n";
+		disable();
+	}
+	return false;
+}
+
+VkCommandBuffer PresentTarget::recordCopy(VkImage source, VkExtent2D sourceExtent)
+{
+	// The last submission using this image has finished, the caller waited for its timeline value
+	vkResetCommandPool(device, commandPools[imageIndex], 0);
+	VkCommandBuffer commandBuffer = commandBuffers[imageIndex];
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to begin recording present target command buffer!");
+	}
+
+	// The source was last written by a color attachment, a compute shader or a blit, depending on the frame's passes,
+	// and may have been copied from by the frame capture since - all commands before, so the layout changes stay in order.
+	// The target's old contents are discarded, its transition waits for the acquire semaphore through the transfer stage.
+	VkImageMemoryBarrier barriers[2] = {};
+	for (VkImageMemoryBarrier& barrier : barriers)
+	{
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+	}
+
+	barriers[0].image = source;
+	barriers[0].oldLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	barriers[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+	barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+	barriers[1].image = images[imageIndex];
+	barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barriers[1].srcAccessMask = 0;
+	barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+		0, nullptr, 0, nullptr, 2, barriers);
+
+	VkImageBlit blit = {};
+	blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+	blit.srcOffsets[1] = { static_cast<int32_t>(sourceExtent.width), static_cast<int32_t>(sourceExtent.height), 1 };
+	blit.dstSubresource = blit.srcSubresource;
+	blit.dstOffsets[1] = { static_cast<int32_t>(extent.width), static_cast<int32_t>(extent.height), 1 };
+
+	vkCmdBlitImage(commandBuffer, source, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, images[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		1, &blit, filter);
+
+	// Both back to the present layout, the present waits on the semaphore signaled after this
+	barriers[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	barriers[0].newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	barriers[0].srcAccessMask = 0;
+	barriers[0].dstAccessMask = 0;
+
+	barriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barriers[1].newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barriers[1].dstAccessMask = 0;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+		0, nullptr, 0, nullptr, 2, barriers);
+
+	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to record present target command buffer!");
+	}
+
+	return commandBuffer;
+}
+
+void PresentTarget::presented(VkResult result)
+{
+	if (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR)
+	{
+		statistics.presentedFrames++;
+		return;
+	}
+
+	std::cerr << "Present target: presenting failed (" << result << "), the target is disabled\n";
+	disable();
+}
+
+// The swap chain stays until destroy(), its last frames may still be in flight
+void PresentTarget::disable()
+{
+	enabled = false;
+}
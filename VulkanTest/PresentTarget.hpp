@@ -0,0 +1,83 @@
+#ifndef PRESENT_TARGET
+#define PRESENT_TARGET
+
+#include "VulkanDispatch.hpp"
+
+#include <cstdint>
+#include <vector>
+
+/****************************************************************************************************
+ * An extra output of the frame - a window or a headless surface - with its own swap chain on the shared device.
+ * - Nothing is rendered per target: the finished frame is blitted from the main swap chain image into the
+ *   target's image, scaled to its extent, so the pipelines, render graph and caches exist once for all of them.
+ * - The copy is recorded every frame, as the pair of main and target images changes, into a command buffer per
+ *   target image. It's meant to be submitted with the frame's commands, and the image presented together with
+ *   the main one in a single vkQueuePresentKHR.
+ * - A target whose acquire or present fails is disabled instead of taking the frame down with it.
+ *
+ * The surface is created and destroyed by the caller.
+ */
+class PresentTarget
+{
+public:
+	struct Config
+	{
+		uint32_t graphicsFamily = 0; // Records the copies
+		uint32_t presentFamily = 0;
+		VkExtent2D extent = {}; // Used when the surface leaves the extent to the swap chain, like a headless one does
+		VkFormat sourceFormat = VK_FORMAT_UNDEFINED; // Of the images copied from, in the present layout
+		const VkAllocationCallbacks* allocator = nullptr; // For the swap chain, command pools and semaphore, nullptr uses the driver's
+	};
+
+	struct Statistics
+	{
+		uint64_t presentedFrames = 0;
+		uint64_t skippedFrames = 0; // No image could be acquired
+	};
+
+	// Returns false if the surface can't be presented to from the present family or blitted into, nothing is created then
+	bool init(VkDevice device, VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, const Config& config);
+	void destroy();
+
+	// Acquires the next image, signaling the semaphore returned by getAcquireSemaphore(). Returns false if there
+	// is none, the target then sits the frame out.
+	bool acquire();
+	// Records the copy of the source image (in the present layout, left the same way) into the acquired image.
+	// The command buffer has to wait for the acquire semaphore and go before the present.
+	VkCommandBuffer recordCopy(VkImage source, VkExtent2D sourceExtent);
+	// The image acquired and copied into was handed to the present, with its result
+	void presented(VkResult result);
+
+	bool isEnabled() const { return enabled; }
+	void disable();
+
+	VkSwapchainKHR getSwapChain() const { return swapChain; }
+	uint32_t getImageIndex() const { return imageIndex; }
+	VkSemaphore getAcquireSemaphore() const { return acquireSemaphore; }
+	VkExtent2D getExtent() const { return extent; }
+	// Queue timeline value of the last submission that used the acquired image, set by the caller
+	uint64_t& getImageValue() { return imageValues[imageIndex]; }
+	const Statistics& getStatistics() const { return statistics; }
+
+private:
+	void createSwapChain(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, const VkSurfaceCapabilitiesKHR& capabilities,
+		VkSurfaceFormatKHR surfaceFormat, const Config& config);
+
+	VkDevice device = VK_NULL_HANDLE;
+	const VkAllocationCallbacks* allocator = nullptr;
+	VkSwapchainKHR swapChain = VK_NULL_HANDLE;
+	VkExtent2D extent = {};
+	VkFilter filter = VK_FILTER_NEAREST; // Linear if the source format can be filtered
+	bool enabled = false;
+
+	std::vector<VkImage> images;
+	std::vector<VkCommandPool> commandPools; // Per image, reset before every copy is recorded
+	std::vector<VkCommandBuffer> commandBuffers;
+	std::vector<uint64_t> imageValues;
+	VkSemaphore acquireSemaphore = VK_NULL_HANDLE;
+	uint32_t imageIndex = 0;
+
+	Statistics statistics;
+};
+
+#endif
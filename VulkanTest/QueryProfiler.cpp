@@ -0,0 +1,254 @@
+#include "QueryProfiler.hpp"
+
+#include <stdexcept>
+
+static const VkQueryPipelineStatisticFlags pipelineStatisticFlags = VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+	VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT | VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+	VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT | VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+	VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+// ==== SETUP ====
+
+void QueryProfiler::init(VkDevice device, const VkAllocationCallbacks* allocator, VkPhysicalDevice physicalDevice, uint32_t frameCount, const Config& config)
+{
+	this->device = device;
+	this->allocator = allocator;
+	this->config = config;
+	slotSubmitted.assign(frameCount, false);
+
+	VkPhysicalDeviceFeatures features;
+	vkGetPhysicalDeviceFeatures(physicalDevice, &features);
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+	statistics.pipelineStatistics = config.pipelineStatistics && features.pipelineStatisticsQuery;
+	statistics.occlusion = config.occlusion;
+	statistics.preciseOcclusion = config.occlusion && features.occlusionQueryPrecise;
+	statistics.timestamps = config.timestamps && properties.limits.timestampComputeAndGraphics;
+	timestampPeriod = properties.limits.timestampPeriod;
+
+	VkQueryPoolCreateInfo queryPoolInfo = {};
+	queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryPoolInfo.queryCount = frameCount * config.maxScopes;
+
+	if (statistics.pipelineStatistics)
+	{
+		queryPoolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+		queryPoolInfo.pipelineStatistics = pipelineStatisticFlags;
+
+		if (vkCreateQueryPool(device, &queryPoolInfo, allocator, &statisticsPool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create pipeline statistics query pool!");
+		}
+	}
+
+	if (statistics.occlusion)
+	{
+		queryPoolInfo.queryType = VK_QUERY_TYPE_OCCLUSION;
+		queryPoolInfo.pipelineStatistics = 0;
+
+		if (vkCreateQueryPool(device, &queryPoolInfo, allocator, &occlusionPool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create occlusion query pool!");
+		}
+	}
+
+	if (statistics.timestamps)
+	{
+		queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolInfo.queryCount *= 2;
+
+		if (vkCreateQueryPool(device, &queryPoolInfo, allocator, &timestampPool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create scope timestamp query pool!");
+		}
+	}
+}
+
+void QueryProfiler::destroy()
+{
+	if (device == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	vkDestroyQueryPool(device, timestampPool, allocator);
+	vkDestroyQueryPool(device, occlusionPool, allocator);
+	vkDestroyQueryPool(device, statisticsPool, allocator);
+	device = VK_NULL_HANDLE;
+}
+
+QueryProfiler::ScopeHandle QueryProfiler::addScope(const std::string& name)
+{
+	if (scopes.size() >= config.maxScopes)
+	{
+		throw std::runtime_error("Too many query profiler scopes!");
+	}
+
+	Scope scope;
+	scope.name = name;
+	scopes.push_back(scope);
+
+	return static_cast<ScopeHandle>(scopes.size() - 1);
+}
+
+// ==== RECORDING ====
+
+void QueryProfiler::recordReset(VkCommandBuffer commandBuffer, uint32_t frame) const
+{
+	uint32_t first = queryIndex(frame, 0);
+	if (statisticsPool != VK_NULL_HANDLE)
+	{
+		vkCmdResetQueryPool(commandBuffer, statisticsPool, first, config.maxScopes);
+	}
+	if (occlusionPool != VK_NULL_HANDLE)
+	{
+		vkCmdResetQueryPool(commandBuffer, occlusionPool, first, config.maxScopes);
+	}
+	if (timestampPool != VK_NULL_HANDLE)
+	{
+		vkCmdResetQueryPool(commandBuffer, timestampPool, first * 2, config.maxScopes * 2);
+	}
+}
+
+void QueryProfiler::beginScope(VkCommandBuffer commandBuffer, uint32_t frame, ScopeHandle scope) const
+{
+	uint32_t query = queryIndex(frame, scope);
+	if (timestampPool != VK_NULL_HANDLE)
+	{
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampPool, query * 2);
+	}
+	if (statisticsPool != VK_NULL_HANDLE)
+	{
+		vkCmdBeginQuery(commandBuffer, statisticsPool, query, 0);
+	}
+	if (occlusionPool != VK_NULL_HANDLE)
+	{
+		vkCmdBeginQuery(commandBuffer, occlusionPool, query, statistics.preciseOcclusion ? VK_QUERY_CONTROL_PRECISE_BIT : 0);
+	}
+}
+
+void QueryProfiler::endScope(VkCommandBuffer commandBuffer, uint32_t frame, ScopeHandle scope) const
+{
+	uint32_t query = queryIndex(frame, scope);
+	if (occlusionPool != VK_NULL_HANDLE)
+	{
+		vkCmdEndQuery(commandBuffer, occlusionPool, query);
+	}
+	if (statisticsPool != VK_NULL_HANDLE)
+	{
+		vkCmdEndQuery(commandBuffer, statisticsPool, query);
+	}
+	if (timestampPool != VK_NULL_HANDLE)
+	{
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampPool, query * 2 + 1);
+	}
+}
+
+// ==== RESULTS ====
+
+/****************************************************************************
+ * A scope only counts if all of its queries are available, so the counters of a frame always belong together.
+ */
+void QueryProfiler::collect(uint32_t frame)
+{
+	if (device == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	// The slot is about to be used for the first time, there's nothing to read yet
+	if (!slotSubmitted[frame])
+	{
+		slotSubmitted[frame] = true;
+		return;
+	}
+
+	bool collected = false;
+	for (ScopeHandle s = 0; s < scopes.size(); s++)
+	{
+		uint32_t query = queryIndex(frame, s);
+		Counters counters;
+		bool available = true;
+
+		if (statisticsPool != VK_NULL_HANDLE)
+		{
+			uint64_t results[statisticCount + 1] = {};
+			VkResult result = vkGetQueryPoolResults(device, statisticsPool, query, 1, sizeof(results), results, sizeof(results),
+				VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+			available = available && (result == VK_SUCCESS || result == VK_NOT_READY) && results[statisticCount] != 0;
+
+			counters.inputVertices = results[0];
+			counters.inputPrimitives = results[1];
+			counters.vertexInvocations = results[2];
+			counters.clippingInvocations = results[3];
+			counters.clippingPrimitives = results[4];
+			counters.fragmentInvocations = results[5];
+		}
+
+		if (occlusionPool != VK_NULL_HANDLE)
+		{
+			uint64_t results[2] = {};
+			VkResult result = vkGetQueryPoolResults(device, occlusionPool, query, 1, sizeof(results), results, sizeof(results),
+				VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+			available = available && (result == VK_SUCCESS || result == VK_NOT_READY) && results[1] != 0;
+
+			counters.samplesPassed = results[0];
+		}
+
+		if (timestampPool != VK_NULL_HANDLE)
+		{
+			// Begin and end timestamps, each followed by its availability flag
+			uint64_t timestamps[4] = {};
+			VkResult result = vkGetQueryPoolResults(device, timestampPool, query * 2, 2, sizeof(timestamps), timestamps, 2 * sizeof(uint64_t),
+				VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+			available = available && (result == VK_SUCCESS || result == VK_NOT_READY) && timestamps[1] != 0 && timestamps[3] != 0;
+
+			counters.gpuTime = (timestamps[2] - timestamps[0]) * timestampPeriod / 1000000.0;
+		}
+
+		if (!available)
+		{
+			statistics.unavailableResults++;
+			continue;
+		}
+
+		Scope& scope = scopes[s];
+		scope.latest = counters;
+		scope.total.inputVertices += counters.inputVertices;
+		scope.total.inputPrimitives += counters.inputPrimitives;
+		scope.total.vertexInvocations += counters.vertexInvocations;
+		scope.total.clippingInvocations += counters.clippingInvocations;
+		scope.total.clippingPrimitives += counters.clippingPrimitives;
+		scope.total.fragmentInvocations += counters.fragmentInvocations;
+		scope.total.samplesPassed += counters.samplesPassed;
+		scope.total.gpuTime += counters.gpuTime;
+		scope.frames++;
+		collected = true;
+	}
+
+	if (collected)
+	{
+		statistics.collectedFrames++;
+	}
+}
+
+QueryProfiler::Counters QueryProfiler::getAverage(ScopeHandle scope) const
+{
+	const Scope& s = scopes[scope];
+	if (s.frames == 0)
+	{
+		return Counters();
+	}
+
+	Counters average;
+	average.inputVertices = s.total.inputVertices / s.frames;
+	average.inputPrimitives = s.total.inputPrimitives / s.frames;
+	average.vertexInvocations = s.total.vertexInvocations / s.frames;
+	average.clippingInvocations = s.total.clippingInvocations / s.frames;
+	average.clippingPrimitives = s.total.clippingPrimitives / s.frames;
+	average.fragmentInvocations = s.total.fragmentInvocations / s.frames;
+	average.samplesPassed = s.total.samplesPassed / s.frames;
+	average.gpuTime = s.total.gpuTime / s.frames;
+	return average;
+}
@@ -0,0 +1,108 @@
+#ifndef QUERY_PROFILER
+#define QUERY_PROFILER
+
+#include "VulkanDispatch.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/****************************************************************************************************
+ * GPU counters of named scopes - a pass, or a few draws inside one.
+ * - Pipeline statistics: input assembly vertices and primitives, vertex shader invocations, clipping invocations
+ *   and primitives, fragment shader invocations. Together they give vertex reuse, clipping and overdraw.
+ * - An occlusion query counts the samples that passed the depth test, precise if the device supports it.
+ * - Two timestamps give the scope's GPU time.
+ *
+ * Every query pool holds a ring of frame slots, each with a query per scope. A slot is reset at the start of the
+ * frame that writes it and read back with collect() the next time the slot comes around, after that frame has
+ * finished - the read never waits, results that aren't available are skipped.
+ *
+ * A scope's queries begin and end inside one subpass, or both outside of render passes.
+ */
+class QueryProfiler
+{
+public:
+	typedef uint32_t ScopeHandle;
+
+	struct Config
+	{
+		uint32_t maxScopes = 8;
+		bool pipelineStatistics = true;
+		bool occlusion = true;
+		bool timestamps = true;
+	};
+
+	struct Counters
+	{
+		uint64_t inputVertices = 0;
+		uint64_t inputPrimitives = 0;
+		uint64_t vertexInvocations = 0;
+		uint64_t clippingInvocations = 0;
+		uint64_t clippingPrimitives = 0; // Leaving the clipper, a clipped triangle may become several
+		uint64_t fragmentInvocations = 0;
+		uint64_t samplesPassed = 0;
+		double gpuTime = 0.0; // Milliseconds
+	};
+
+	struct Statistics
+	{
+		uint64_t collectedFrames = 0;
+		uint64_t unavailableResults = 0; // Reads skipped because the queries hadn't finished
+		bool pipelineStatistics = false; // The query types the device supports
+		bool occlusion = false;
+		bool preciseOcclusion = false;
+		bool timestamps = false;
+	};
+
+	// Pipeline statistics need the pipelineStatisticsQuery feature, precise occlusion occlusionQueryPrecise, both enabled on the device
+	void init(VkDevice device, const VkAllocationCallbacks* allocator, VkPhysicalDevice physicalDevice, uint32_t frameCount, const Config& config);
+	void destroy();
+
+	ScopeHandle addScope(const std::string& name);
+
+	// Outside of a render pass, before any scope of the frame
+	void recordReset(VkCommandBuffer commandBuffer, uint32_t frame) const;
+	void beginScope(VkCommandBuffer commandBuffer, uint32_t frame, ScopeHandle scope) const;
+	void endScope(VkCommandBuffer commandBuffer, uint32_t frame, ScopeHandle scope) const;
+
+	// Reads the slot's results from the last time it was used, once that frame has finished
+	// and before the slot is submitted again
+	void collect(uint32_t frame);
+
+	uint32_t getScopeCount() const { return static_cast<uint32_t>(scopes.size()); }
+	const std::string& getName(ScopeHandle scope) const { return scopes[scope].name; }
+	const Counters& getLatest(ScopeHandle scope) const { return scopes[scope].latest; }
+	Counters getAverage(ScopeHandle scope) const;
+	const Statistics& getStatistics() const { return statistics; }
+
+private:
+	// Results of every statistic the pool counts, in the order of their bits, then the availability
+	static const uint32_t statisticCount = 6;
+
+	struct Scope
+	{
+		std::string name;
+		Counters latest;
+		Counters total;
+		uint64_t frames = 0;
+	};
+
+	uint32_t queryIndex(uint32_t frame, ScopeHandle scope) const { return frame * config.maxScopes + scope; }
+
+	VkDevice device = VK_NULL_HANDLE;
+	const VkAllocationCallbacks* allocator = nullptr;
+	Config config;
+	float timestampPeriod = 1.0f; // Nanoseconds per tick
+
+	VkQueryPool statisticsPool = VK_NULL_HANDLE;
+	VkQueryPool occlusionPool = VK_NULL_HANDLE;
+	VkQueryPool timestampPool = VK_NULL_HANDLE; // Begin and end of each scope
+
+	std::vector<Scope> scopes;
+	std::vector<bool> slotSubmitted; // Per frame slot, collected once already so a frame has used it since
+
+	Statistics statistics;
+};
+
+#endif
@@ -0,0 +1,314 @@
+#include "QueueTimeline.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+// ==== SETUP ====
+
+bool QueueTimeline::isSupported(VkPhysicalDevice physicalDevice, VkPhysicalDeviceTimelineSemaphoreFeaturesKHR& enabledFeatures)
+{
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	if (properties.apiVersion < VK_API_VERSION_1_1)
+	{
+		return false;
+	}
+
+	uint32_t extensionCount = 0;
+	vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+	std::vector<VkExtensionProperties> extensions(extensionCount);
+	vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, extensions.data());
+
+	auto found = std::find_if(extensions.begin(), extensions.end(), [](const VkExtensionProperties& extension)
+	{
+		return std::strcmp(extension.extensionName, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME) == 0;
+	});
+	if (found == extensions.end())
+	{
+		return false;
+	}
+
+	VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures = {};
+	timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+
+	VkPhysicalDeviceFeatures2 features = {};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features.pNext = &timelineFeatures;
+	vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+
+	if (!timelineFeatures.timelineSemaphore)
+	{
+		return false;
+	}
+
+	enabledFeatures = {};
+	enabledFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+	enabledFeatures.timelineSemaphore = VK_TRUE;
+	return true;
+}
+
+void QueueTimeline::init(VkDevice device, const VkAllocationCallbacks* allocator, VkQueue queue, bool useTimelineSemaphore)
+{
+	this->device = device;
+	this->allocator = allocator;
+	this->queue = queue;
+
+	if (!useTimelineSemaphore)
+	{
+		return;
+	}
+
+	// Loaded with the device only when the extension is enabled
+	if (vkGetSemaphoreCounterValueKHR == nullptr || vkWaitSemaphoresKHR == nullptr)
+	{
+		throw std::runtime_error("Failed to load the timeline semaphore functions!");
+	}
+
+	VkSemaphoreTypeCreateInfoKHR typeInfo = {};
+	typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+	typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+	typeInfo.initialValue = 0;
+
+	VkSemaphoreCreateInfo semaphoreInfo = {};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphoreInfo.pNext = &typeInfo;
+
+	if (vkCreateSemaphore(device, &semaphoreInfo, allocator, &semaphore) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create timeline semaphore!");
+	}
+}
+
+void QueueTimeline::destroy()
+{
+	if (semaphore != VK_NULL_HANDLE)
+	{
+		vkDestroySemaphore(device, semaphore, allocator);
+		semaphore = VK_NULL_HANDLE;
+	}
+
+	for (size_t i = 0; i < submittedFences.size(); i++)
+	{
+		vkDestroyFence(device, submittedFences[i].fence, allocator);
+	}
+	submittedFences.clear();
+
+	for (auto fence : freeFences)
+	{
+		vkDestroyFence(device, fence, allocator);
+	}
+	freeFences.clear();
+}
+
+// ==== SUBMISSION ====
+
+void QueueTimeline::addWait(const QueueTimeline& other, uint64_t value, VkPipelineStageFlags stage)
+{
+	if (semaphore == VK_NULL_HANDLE || other.semaphore == VK_NULL_HANDLE)
+	{
+		throw std::runtime_error("Cross-queue waits need timeline semaphores!");
+	}
+
+	if (value == 0)
+	{
+		return;
+	}
+
+	pendingWaitSemaphores.push_back(other.semaphore);
+	pendingWaitValues.push_back(value);
+	pendingWaitStages.push_back(stage);
+}
+
+/****************************************************************************
+ * The cross-queue waits are added to the first batch and the signal to the last one. Binary semaphores in the same
+ * batches get a value of 0, which the driver ignores, since the value arrays have to cover every semaphore.
+ */
+uint64_t QueueTimeline::submit(uint32_t submitCount, const VkSubmitInfo* submits, VkFence fence)
+{
+	uint64_t value = nextValue++;
+
+	if (semaphore == VK_NULL_HANDLE)
+	{
+		if (vkQueueSubmit(queue, submitCount, submits, fence) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to submit to the queue!");
+		}
+
+		// A submission with no batches signals its fence once everything submitted before it has completed
+		VkFence valueFence;
+		if (!freeFences.empty())
+		{
+			valueFence = freeFences.back();
+			freeFences.pop_back();
+		}
+		else
+		{
+			VkFenceCreateInfo fenceInfo = {};
+			fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+			if (vkCreateFence(device, &fenceInfo, allocator, &valueFence) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create queue timeline fence!");
+			}
+			statistics.fences++;
+		}
+
+		if (vkQueueSubmit(queue, 0, nullptr, valueFence) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to submit queue timeline fence!");
+		}
+
+		submittedFences.push_back({ valueFence, value });
+		statistics.submits += 2;
+		return value;
+	}
+
+	batches.assign(submits, submits + submitCount);
+	if (batches.empty())
+	{
+		VkSubmitInfo signalOnly = {};
+		signalOnly.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		batches.push_back(signalOnly);
+	}
+
+	VkSubmitInfo& first = batches.front();
+	VkSubmitInfo& last = batches.back();
+	bool crossQueueWaits = !pendingWaitSemaphores.empty();
+
+	// Waits of the first batch, then the signals of the last one
+	uint32_t waitCount = first.waitSemaphoreCount + static_cast<uint32_t>(pendingWaitSemaphores.size());
+	uint32_t signalCount = last.signalSemaphoreCount + 1;
+
+	semaphoreScratch.clear();
+	valueScratch.clear();
+	stageScratch.clear();
+	if (crossQueueWaits)
+	{
+		semaphoreScratch.insert(semaphoreScratch.end(), first.pWaitSemaphores, first.pWaitSemaphores + first.waitSemaphoreCount);
+		semaphoreScratch.insert(semaphoreScratch.end(), pendingWaitSemaphores.begin(), pendingWaitSemaphores.end());
+		stageScratch.insert(stageScratch.end(), first.pWaitDstStageMask, first.pWaitDstStageMask + first.waitSemaphoreCount);
+		stageScratch.insert(stageScratch.end(), pendingWaitStages.begin(), pendingWaitStages.end());
+		valueScratch.insert(valueScratch.end(), first.waitSemaphoreCount, 0);
+		valueScratch.insert(valueScratch.end(), pendingWaitValues.begin(), pendingWaitValues.end());
+	}
+	size_t signalOffset = semaphoreScratch.size();
+	semaphoreScratch.insert(semaphoreScratch.end(), last.pSignalSemaphores, last.pSignalSemaphores + last.signalSemaphoreCount);
+	semaphoreScratch.push_back(semaphore);
+	valueScratch.insert(valueScratch.end(), last.signalSemaphoreCount, 0);
+	valueScratch.push_back(value);
+
+	VkTimelineSemaphoreSubmitInfoKHR timelineInfos[2] = {};
+	timelineInfos[0].sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+	timelineInfos[1].sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+
+	if (crossQueueWaits)
+	{
+		timelineInfos[0].pNext = first.pNext;
+		timelineInfos[0].waitSemaphoreValueCount = waitCount;
+		timelineInfos[0].pWaitSemaphoreValues = valueScratch.data();
+
+		first.pNext = &timelineInfos[0];
+		first.waitSemaphoreCount = waitCount;
+		first.pWaitSemaphores = semaphoreScratch.data();
+		first.pWaitDstStageMask = stageScratch.data();
+	}
+
+	// With a single batch the waits and the signal share one chained structure
+	VkTimelineSemaphoreSubmitInfoKHR& signalInfo = crossQueueWaits && batches.size() == 1 ? timelineInfos[0] : timelineInfos[1];
+	if (&signalInfo == &timelineInfos[1])
+	{
+		signalInfo.pNext = last.pNext;
+		last.pNext = &signalInfo;
+	}
+	signalInfo.signalSemaphoreValueCount = signalCount;
+	signalInfo.pSignalSemaphoreValues = valueScratch.data() + signalOffset;
+
+	last.signalSemaphoreCount = signalCount;
+	last.pSignalSemaphores = semaphoreScratch.data() + signalOffset;
+
+	if (vkQueueSubmit(queue, static_cast<uint32_t>(batches.size()), batches.data(), fence) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to submit to the queue!");
+	}
+
+	pendingWaitSemaphores.clear();
+	pendingWaitValues.clear();
+	pendingWaitStages.clear();
+	statistics.submits++;
+	return value;
+}
+
+// ==== PROGRESS ====
+
+uint64_t QueueTimeline::getCompletedValue()
+{
+	if (semaphore != VK_NULL_HANDLE)
+	{
+		vkGetSemaphoreCounterValueKHR(device, semaphore, &completedValue);
+	}
+	else
+	{
+		retireFences(false, 0);
+	}
+
+	return completedValue;
+}
+
+bool QueueTimeline::isComplete(uint64_t value)
+{
+	return value <= completedValue || getCompletedValue() >= value;
+}
+
+void QueueTimeline::wait(uint64_t value)
+{
+	if (isComplete(value))
+	{
+		return;
+	}
+
+	statistics.hostWaits++;
+
+	if (semaphore != VK_NULL_HANDLE)
+	{
+		VkSemaphoreWaitInfoKHR waitInfo = {};
+		waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+		waitInfo.semaphoreCount = 1;
+		waitInfo.pSemaphores = &semaphore;
+		waitInfo.pValues = &value;
+
+		if (vkWaitSemaphoresKHR(device, &waitInfo, UINT64_MAX) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to wait for the queue timeline!");
+		}
+		completedValue = std::max(completedValue, value);
+	}
+	else
+	{
+		retireFences(true, value);
+	}
+}
+
+/****************************************************************************
+ * Fences signal in submission order, so the first unsignaled one ends the search unless it has to be waited for
+ */
+void QueueTimeline::retireFences(bool wait, uint64_t value)
+{
+	while (!submittedFences.empty())
+	{
+		SubmittedFence& front = submittedFences.front();
+		if (vkGetFenceStatus(device, front.fence) != VK_SUCCESS)
+		{
+			if (!wait || front.value > value)
+			{
+				break;
+			}
+			vkWaitForFences(device, 1, &front.fence, VK_TRUE, UINT64_MAX);
+		}
+
+		completedValue = front.value;
+		vkResetFences(device, 1, &front.fence);
+		freeFences.push_back(front.fence);
+		submittedFences.pop_front();
+	}
+}
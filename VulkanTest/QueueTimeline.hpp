@@ -0,0 +1,86 @@
+#ifndef QUEUE_TIMELINE
+#define QUEUE_TIMELINE
+
+#include "VulkanDispatch.hpp"
+
+#include <cstdint>
+#include <vector>
+
+#include "RingQueue.hpp"
+
+/****************************************************************************************************
+ * GPU progress of one queue as a single increasing value.
+ * - Every submit() signals the next value. Whether a value has been reached is the only thing the rest of the
+ *   code has to track: CPU waits, resource lifetimes and waits of other queues all use it.
+ * - With VK_KHR_timeline_semaphore the value is a timeline semaphore counter. The signal rides along with the
+ *   last batch of the submit, so no extra objects or submissions are needed and nothing is ever reset.
+ * - Without it, each value gets a recycled fence in an empty submission behind the batches. Cross-queue
+ *   waits aren't available in that mode.
+ *
+ * Values start at 1, so 0 always counts as complete.
+ */
+class QueueTimeline
+{
+public:
+	struct Statistics
+	{
+		uint64_t submits = 0; // vkQueueSubmit calls, including the fence submissions of the fallback
+		uint64_t hostWaits = 0; // wait() calls that actually had to block
+		uint32_t fences = 0; // Created by the fallback
+	};
+
+	// Fills in the feature to enable on the device, false if the device lacks it
+	static bool isSupported(VkPhysicalDevice physicalDevice, VkPhysicalDeviceTimelineSemaphoreFeaturesKHR& enabledFeatures);
+
+	void init(VkDevice device, const VkAllocationCallbacks* allocator, VkQueue queue, bool useTimelineSemaphore);
+	void destroy(); // The device must be idle
+
+	// vkQueueSubmit that also signals the next value, which it returns. The fence is optional and
+	// the last batch must not chain a VkTimelineSemaphoreSubmitInfoKHR of its own.
+	uint64_t submit(uint32_t submitCount, const VkSubmitInfo* submits, VkFence fence = VK_NULL_HANDLE);
+	// The first batch of the next submit() waits until the other queue reaches the value, needs the timeline semaphore
+	void addWait(const QueueTimeline& other, uint64_t value, VkPipelineStageFlags stage);
+
+	uint64_t getNextValue() const { return nextValue; } // What the next submit() will signal
+	uint64_t getSubmittedValue() const { return nextValue - 1; }
+	uint64_t getCompletedValue(); // Polls the GPU
+	bool isComplete(uint64_t value);
+	void wait(uint64_t value);
+
+	VkQueue getQueue() const { return queue; }
+	bool usesTimelineSemaphore() const { return semaphore != VK_NULL_HANDLE; }
+	const Statistics& getStatistics() const { return statistics; }
+
+private:
+	struct SubmittedFence
+	{
+		VkFence fence;
+		uint64_t value;
+	};
+
+	void retireFences(bool wait, uint64_t value);
+
+	VkDevice device = VK_NULL_HANDLE;
+	const VkAllocationCallbacks* allocator = nullptr;
+	VkQueue queue = VK_NULL_HANDLE;
+	uint64_t nextValue = 1;
+	uint64_t completedValue = 0; // Last value seen complete
+
+	VkSemaphore semaphore = VK_NULL_HANDLE;
+
+	RingQueue<SubmittedFence> submittedFences; // Oldest first
+	std::vector<VkFence> freeFences;
+
+	// Waits for the next submit, and scratch for the patched batches, kept to avoid allocating every frame
+	std::vector<VkSemaphore> pendingWaitSemaphores;
+	std::vector<uint64_t> pendingWaitValues;
+	std::vector<VkPipelineStageFlags> pendingWaitStages;
+	std::vector<VkSubmitInfo> batches;
+	std::vector<VkSemaphore> semaphoreScratch;
+	std::vector<uint64_t> valueScratch;
+	std::vector<VkPipelineStageFlags> stageScratch;
+
+	Statistics statistics;
+};
+
+#endif
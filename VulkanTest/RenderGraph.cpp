@@ -0,0 +1,1104 @@
+#include "RenderGraph.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+// ==== BUILDING ====
+
+RenderGraph::ResourceHandle RenderGraph::createImage(const std::string& name, const ImageDesc& desc)
+{
+	Resource resource;
+	resource.name = name;
+	resource.desc = desc;
+
+	resources.push_back(resource);
+	return static_cast<ResourceHandle>(resources.size() - 1);
+}
+
+RenderGraph::ResourceHandle RenderGraph::importImage(const std::string& name, const ImageDesc& desc,
+	const std::vector<VkImage>& images, const std::vector<VkImageView>& views,
+	VkImageLayout initialLayout, VkImageLayout finalLayout, VkPipelineStageFlags initialStages)
+{
+	if (images.empty() || images.size() != views.size())
+	{
+		throw std::runtime_error("Render graph: imported image " + name + " needs one view per image!");
+	}
+
+	Resource resource;
+	resource.name = name;
+	resource.desc = desc;
+	resource.imported = true;
+	resource.images = images;
+	resource.views = views;
+	resource.initialLayout = initialLayout;
+	resource.finalLayout = finalLayout;
+	resource.initialStages = initialStages;
+
+	resources.push_back(resource);
+	return static_cast<ResourceHandle>(resources.size() - 1);
+}
+
+void RenderGraph::markOutput(ResourceHandle resource)
+{
+	resources[resource].output = true;
+}
+
+RenderGraph::PassHandle RenderGraph::addPass(const std::string& name, PassType type, ExecuteCallback execute)
+{
+	Pass pass;
+	pass.name = name;
+	pass.type = type;
+	pass.execute = execute;
+
+	passes.push_back(pass);
+	return static_cast<PassHandle>(passes.size() - 1);
+}
+
+void RenderGraph::readResource(PassHandle pass, ResourceHandle resource, ResourceUsage usage)
+{
+	Access access = {};
+	access.resource = resource;
+	access.usage = usage;
+	access.write = false;
+	access.clear = false;
+
+	passes[pass].accesses.push_back(access);
+}
+
+void RenderGraph::writeResource(PassHandle pass, ResourceHandle resource, ResourceUsage usage, const VkClearValue* clearValue)
+{
+	Access access = {};
+	access.resource = resource;
+	access.usage = usage;
+	access.write = true;
+	access.clear = clearValue != nullptr;
+	if (clearValue != nullptr)
+	{
+		access.clearValue = *clearValue;
+	}
+
+	passes[pass].accesses.push_back(access);
+}
+
+void RenderGraph::setSideEffects(PassHandle pass)
+{
+	passes[pass].sideEffects = true;
+}
+
+void RenderGraph::setSecondaryCommandBuffers(PassHandle pass)
+{
+	if (passes[pass].type != PassType::Graphics)
+	{
+		throw std::runtime_error("Render graph: only graphics passes can use secondary command buffers!");
+	}
+	passes[pass].secondary = true;
+}
+
+
+// ==== COMPILATION ====
+
+/****************************************************************************
+ * Maps the declared usage to the layout, pipeline stages and access masks it needs
+ */
+RenderGraph::UsageInfo RenderGraph::getUsageInfo(ResourceUsage usage, bool write)
+{
+	UsageInfo info = {};
+
+	switch (usage)
+	{
+	case ResourceUsage::ColorAttachment:
+		info.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		info.stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		info.access = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | (write ? VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT : 0);
+		info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+		info.attachment = true;
+		break;
+	case ResourceUsage::DepthStencilAttachment:
+		info.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		info.stages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		info.access = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		info.imageUsage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+		info.attachment = true;
+		break;
+	case ResourceUsage::DepthStencilReadOnly:
+		info.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+		info.stages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		info.access = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+		info.imageUsage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+		info.attachment = true;
+		break;
+	case ResourceUsage::SampledFragment:
+		info.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		info.stages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		info.access = VK_ACCESS_SHADER_READ_BIT;
+		info.imageUsage = VK_IMAGE_USAGE_SAMPLED_BIT;
+		break;
+	case ResourceUsage::SampledCompute:
+		info.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		info.stages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		info.access = VK_ACCESS_SHADER_READ_BIT;
+		info.imageUsage = VK_IMAGE_USAGE_SAMPLED_BIT;
+		break;
+	case ResourceUsage::Storage:
+		info.layout = VK_IMAGE_LAYOUT_GENERAL;
+		info.stages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		info.access = VK_ACCESS_SHADER_READ_BIT | (write ? VK_ACCESS_SHADER_WRITE_BIT : 0);
+		info.imageUsage = VK_IMAGE_USAGE_STORAGE_BIT;
+		break;
+	case ResourceUsage::TransferSrc:
+		info.layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		info.stages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		info.access = VK_ACCESS_TRANSFER_READ_BIT;
+		info.imageUsage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		break;
+	case ResourceUsage::TransferDst:
+		info.layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		info.stages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		info.access = VK_ACCESS_TRANSFER_WRITE_BIT;
+		info.imageUsage = VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		break;
+	}
+
+	return info;
+}
+
+uint32_t RenderGraph::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties, bool& found) const
+{
+	VkPhysicalDeviceMemoryProperties memProperties;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
+	{
+		if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
+		{
+			found = true;
+			return i;
+		}
+	}
+
+	found = false;
+	return 0;
+}
+
+void RenderGraph::compile(VkDevice device, const VkAllocationCallbacks* allocator, VkPhysicalDevice physicalDevice)
+{
+	if (compiled)
+	{
+		throw std::runtime_error("Render graph is already compiled!");
+	}
+
+	this->device = device;
+	this->allocator = allocator;
+	this->physicalDevice = physicalDevice;
+
+	variantCount = 1;
+	for (const auto& resource : resources)
+	{
+		variantCount = std::max(variantCount, static_cast<uint32_t>(resource.views.size()));
+	}
+
+	cullPasses();
+	buildSteps();
+	computeLifetimes();
+	allocateTransientResources();
+	buildBarriersAndRenderPasses();
+	createFramebuffers();
+
+	compiled = true;
+}
+
+/****************************************************************************
+ * Walks the passes backwards keeping the set of resources whose current contents are still needed.
+ * A pass survives only if it writes something that is needed later, or if it has side effects.
+ */
+void RenderGraph::cullPasses()
+{
+	std::vector<bool> needed(resources.size(), false);
+	for (size_t i = 0; i < resources.size(); i++)
+	{
+		needed[i] = resources[i].output;
+	}
+
+	statistics.passCount = static_cast<uint32_t>(passes.size());
+	statistics.culledPassCount = 0;
+
+	for (auto pass = passes.rbegin(); pass != passes.rend(); ++pass)
+	{
+		bool live = pass->sideEffects;
+		for (const auto& access : pass->accesses)
+		{
+			if (access.write && needed[access.resource])
+			{
+				live = true;
+			}
+		}
+
+		pass->culled = !live;
+		if (!live)
+		{
+			statistics.culledPassCount++;
+			continue;
+		}
+
+		// Everything the pass writes is produced here, unless the write keeps the previous contents
+		for (const auto& access : pass->accesses)
+		{
+			if (access.write)
+			{
+				needed[access.resource] = false;
+			}
+		}
+
+		for (const auto& access : pass->accesses)
+		{
+			if (!access.write || !access.clear)
+			{
+				needed[access.resource] = true;
+			}
+		}
+	}
+}
+
+/****************************************************************************
+ * Groups live passes into steps. Consecutive graphics passes are merged into subpasses of one render pass
+ * when they render to the same extent and don't need a pipeline barrier between them
+ * (which would be the case when one of them samples an image the other one uses).
+ */
+void RenderGraph::buildSteps()
+{
+	steps.clear();
+
+	for (PassHandle p = 0; p < passes.size(); p++)
+	{
+		Pass& pass = passes[p];
+		if (pass.culled)
+		{
+			continue;
+		}
+
+		VkExtent2D extent = {};
+		bool hasAttachment = false;
+		if (pass.type == PassType::Graphics)
+		{
+			for (const auto& access : pass.accesses)
+			{
+				if (!getUsageInfo(access.usage, access.write).attachment)
+				{
+					continue;
+				}
+
+				const VkExtent2D& attachmentExtent = resources[access.resource].desc.extent;
+				if (hasAttachment && (attachmentExtent.width != extent.width || attachmentExtent.height != extent.height))
+				{
+					throw std::runtime_error("Render graph: attachments of pass " + pass.name + " differ in size!");
+				}
+
+				extent = attachmentExtent;
+				hasAttachment = true;
+			}
+
+			if (!hasAttachment)
+			{
+				throw std::runtime_error("Render graph: graphics pass " + pass.name + " has no attachments!");
+			}
+		}
+
+		bool merge = false;
+		if (pass.type == PassType::Graphics && !steps.empty() && steps.back().type == PassType::Graphics)
+		{
+			const Step& step = steps.back();
+			merge = step.extent.width == extent.width && step.extent.height == extent.height;
+
+			for (PassHandle other : step.passes)
+			{
+				for (const auto& otherAccess : passes[other].accesses)
+				{
+					for (const auto& access : pass.accesses)
+					{
+						bool attachments = getUsageInfo(access.usage, access.write).attachment &&
+							getUsageInfo(otherAccess.usage, otherAccess.write).attachment;
+
+						if (access.resource == otherAccess.resource && !attachments)
+						{
+							merge = false;
+						}
+					}
+				}
+			}
+		}
+
+		if (!merge)
+		{
+			Step step;
+			step.type = pass.type;
+			step.extent = extent;
+			steps.push_back(step);
+		}
+
+		pass.step = static_cast<int>(steps.size() - 1);
+		pass.subpass = static_cast<uint32_t>(steps.back().passes.size());
+		steps.back().passes.push_back(p);
+	}
+}
+
+void RenderGraph::computeLifetimes()
+{
+	for (const auto& pass : passes)
+	{
+		if (pass.culled)
+		{
+			continue;
+		}
+
+		for (const auto& access : pass.accesses)
+		{
+			Resource& resource = resources[access.resource];
+			UsageInfo info = getUsageInfo(access.usage, access.write);
+
+			if (resource.firstStep == -1)
+			{
+				resource.firstStep = pass.step;
+			}
+			resource.lastStep = pass.step;
+			resource.usage |= info.imageUsage;
+
+			resource.lastAccess.layout = info.layout;
+			resource.lastAccess.stages = info.stages;
+			resource.lastAccess.access = info.access;
+			resource.lastAccess.write = access.write;
+		}
+	}
+}
+
+/****************************************************************************
+ * Creates the transient images and places them in memory blocks.
+ * Images whose step lifetimes don't overlap are bound to the same block. Attachments that never leave their
+ * render pass don't need memory at all on tiled GPUs, so they get lazily allocated memory when it's available.
+ */
+void RenderGraph::allocateTransientResources()
+{
+	std::vector<VkMemoryRequirements> requirements(resources.size());
+	std::vector<ResourceHandle> aliasable;
+
+	statistics.transientMemory = 0;
+	statistics.unaliasedTransientMemory = 0;
+
+	for (ResourceHandle r = 0; r < resources.size(); r++)
+	{
+		Resource& resource = resources[r];
+		if (resource.imported || resource.firstStep == -1)
+		{
+			continue;
+		}
+
+		VkImageUsageFlags attachmentUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+		bool renderPassLocal = (resource.usage & ~attachmentUsage) == 0 && resource.firstStep == resource.lastStep && !resource.output;
+		if (renderPassLocal)
+		{
+			resource.usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+		}
+
+		VkImageCreateInfo imageInfo = {};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.extent.width = resource.desc.extent.width;
+		imageInfo.extent.height = resource.desc.extent.height;
+		imageInfo.extent.depth = 1;
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.format = resource.desc.format;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageInfo.usage = resource.usage;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		if (vkCreateImage(device, &imageInfo, allocator, &resource.image) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Render graph: failed to create image " + resource.name + "!");
+		}
+
+		vkGetImageMemoryRequirements(device, resource.image, &requirements[r]);
+		statistics.unaliasedTransientMemory += requirements[r].size;
+
+		bool lazyFound = false;
+		if (renderPassLocal)
+		{
+			findMemoryType(requirements[r].memoryTypeBits, VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, lazyFound);
+		}
+
+		if (lazyFound)
+		{
+			MemoryBlock block;
+			block.size = requirements[r].size;
+			block.memoryTypeBits = requirements[r].memoryTypeBits;
+			block.occupants.push_back(r);
+
+			resource.lazilyAllocated = true;
+			resource.memoryBlock = static_cast<int>(memoryBlocks.size());
+			memoryBlocks.push_back(block);
+		}
+		else
+		{
+			aliasable.push_back(r);
+		}
+	}
+
+	// Greedy interval packing - go through the images in order of first use
+	// and put each one in the best fitting block that is free by then
+	std::stable_sort(aliasable.begin(), aliasable.end(), [this](ResourceHandle a, ResourceHandle b)
+		{
+			return resources[a].firstStep < resources[b].firstStep;
+		});
+
+	for (ResourceHandle r : aliasable)
+	{
+		Resource& resource = resources[r];
+		const VkMemoryRequirements& req = requirements[r];
+
+		int bestBlock = -1;
+		VkDeviceSize bestWaste = 0;
+		for (size_t b = 0; b < memoryBlocks.size(); b++)
+		{
+			const MemoryBlock& block = memoryBlocks[b];
+			if (resources[block.occupants.front()].lazilyAllocated || (block.memoryTypeBits & req.memoryTypeBits) == 0)
+			{
+				continue;
+			}
+
+			if (resources[block.occupants.back()].lastStep >= resource.firstStep)
+			{
+				continue;
+			}
+
+			VkDeviceSize waste = block.size > req.size ? block.size - req.size : req.size - block.size;
+			if (bestBlock == -1 || waste < bestWaste)
+			{
+				bestBlock = static_cast<int>(b);
+				bestWaste = waste;
+			}
+		}
+
+		if (bestBlock == -1)
+		{
+			bestBlock = static_cast<int>(memoryBlocks.size());
+			memoryBlocks.push_back(MemoryBlock());
+		}
+
+		MemoryBlock& block = memoryBlocks[bestBlock];
+		block.size = std::max(block.size, req.size);
+		block.memoryTypeBits &= req.memoryTypeBits;
+		block.occupants.push_back(r);
+		resource.memoryBlock = bestBlock;
+	}
+
+	for (auto& block : memoryBlocks)
+	{
+		bool lazy = resources[block.occupants.front()].lazilyAllocated;
+
+		bool found = false;
+		VkMemoryAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = block.size;
+		allocInfo.memoryTypeIndex = findMemoryType(block.memoryTypeBits,
+			lazy ? VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, found);
+
+		if (!found)
+		{
+			throw std::runtime_error("Render graph: failed to find memory type for transient images!");
+		}
+
+		if (vkAllocateMemory(device, &allocInfo, allocator, &block.memory) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Render graph: failed to allocate transient memory!");
+		}
+
+		statistics.transientMemory += block.size;
+
+		// Every occupant starts at the beginning of the block
+		for (ResourceHandle r : block.occupants)
+		{
+			Resource& resource = resources[r];
+			vkBindImageMemory(device, resource.image, block.memory, 0);
+
+			VkImageViewCreateInfo viewInfo = {};
+			viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			viewInfo.image = resource.image;
+			viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			viewInfo.format = resource.desc.format;
+			viewInfo.subresourceRange.aspectMask = resource.desc.aspect;
+			viewInfo.subresourceRange.baseMipLevel = 0;
+			viewInfo.subresourceRange.levelCount = 1;
+			viewInfo.subresourceRange.baseArrayLayer = 0;
+			viewInfo.subresourceRange.layerCount = 1;
+
+			if (vkCreateImageView(device, &viewInfo, allocator, &resource.view) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Render graph: failed to create image view " + resource.name + "!");
+			}
+		}
+	}
+}
+
+/****************************************************************************
+ * State of a resource before its first access in the frame.
+ * Transient images start undefined, but still have to wait for whatever used their memory before -
+ * the previous occupant of the memory block, or the last occupant from the previous frame.
+ */
+RenderGraph::AccessState RenderGraph::getInitialState(ResourceHandle r) const
+{
+	const Resource& resource = resources[r];
+	AccessState state;
+
+	if (resource.imported)
+	{
+		state.layout = resource.initialLayout;
+		state.stages = resource.initialStages;
+		state.access = 0;
+		state.write = true;
+		return state;
+	}
+
+	const MemoryBlock& block = memoryBlocks[resource.memoryBlock];
+	auto occupant = std::find(block.occupants.begin(), block.occupants.end(), r);
+	ResourceHandle previous = occupant == block.occupants.begin() ? block.occupants.back() : *(occupant - 1);
+
+	state = resources[previous].lastAccess;
+	state.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	return state;
+}
+
+/****************************************************************************
+ * Adds the barrier needed before the access, if any. Reads after reads in the same layout don't need one,
+ * the reader stages are accumulated instead, so the next write waits for all of them.
+ */
+void RenderGraph::addBarrier(Step& step, ResourceHandle resource, const UsageInfo& info, bool write, AccessState& state)
+{
+	if (state.layout == info.layout && !state.write && !write)
+	{
+		state.stages |= info.stages;
+		state.access |= info.access;
+		return;
+	}
+
+	Barrier barrier;
+	barrier.resource = resource;
+	barrier.oldLayout = state.layout;
+	barrier.newLayout = info.layout;
+	barrier.srcAccess = state.write ? state.access : 0; // Write after read only needs an execution dependency
+	barrier.dstAccess = info.access;
+
+	step.barriers.push_back(barrier);
+	step.srcStages |= state.stages != 0 ? state.stages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+	step.dstStages |= info.stages;
+
+	state.layout = info.layout;
+	state.stages = info.stages;
+	state.access = info.access;
+	state.write = write;
+}
+
+void RenderGraph::buildRenderPass(Step& step, std::vector<AccessState>& states)
+{
+	int stepIndex = passes[step.passes.front()].step;
+
+	// Non-attachment accesses are synchronized with barriers before the render pass begins
+	for (PassHandle p : step.passes)
+	{
+		for (const auto& access : passes[p].accesses)
+		{
+			UsageInfo info = getUsageInfo(access.usage, access.write);
+			if (!info.attachment)
+			{
+				addBarrier(step, access.resource, info, access.write, states[access.resource]);
+			}
+		}
+	}
+
+	for (PassHandle p : step.passes)
+	{
+		for (const auto& access : passes[p].accesses)
+		{
+			if (getUsageInfo(access.usage, access.write).attachment &&
+				std::find(step.attachments.begin(), step.attachments.end(), access.resource) == step.attachments.end())
+			{
+				step.attachments.push_back(access.resource);
+			}
+		}
+	}
+
+	std::vector<VkAttachmentDescription> attachmentDescriptions(step.attachments.size());
+	std::vector<VkSubpassDependency> dependencies;
+	step.clearValues.assign(step.attachments.size(), VkClearValue());
+
+	auto addDependency = [&dependencies](uint32_t src, uint32_t dst, VkPipelineStageFlags srcStages, VkPipelineStageFlags dstStages,
+		VkAccessFlags srcAccess, VkAccessFlags dstAccess)
+	{
+		for (auto& dependency : dependencies)
+		{
+			if (dependency.srcSubpass == src && dependency.dstSubpass == dst)
+			{
+				dependency.srcStageMask |= srcStages;
+				dependency.dstStageMask |= dstStages;
+				dependency.srcAccessMask |= srcAccess;
+				dependency.dstAccessMask |= dstAccess;
+				return;
+			}
+		}
+
+		VkSubpassDependency dependency = {};
+		dependency.srcSubpass = src;
+		dependency.dstSubpass = dst;
+		dependency.srcStageMask = srcStages;
+		dependency.dstStageMask = dstStages;
+		dependency.srcAccessMask = srcAccess;
+		dependency.dstAccessMask = dstAccess;
+		dependency.dependencyFlags = src == VK_SUBPASS_EXTERNAL ? 0 : VK_DEPENDENCY_BY_REGION_BIT;
+		dependencies.push_back(dependency);
+	};
+
+	std::vector<uint32_t> firstSubpass(step.attachments.size());
+	std::vector<uint32_t> lastSubpass(step.attachments.size());
+
+	for (size_t i = 0; i < step.attachments.size(); i++)
+	{
+		ResourceHandle r = step.attachments[i];
+		const Resource& resource = resources[r];
+
+		// Find the first and the last access of the attachment in this render pass
+		const Access* first = nullptr;
+		const Access* last = nullptr;
+		for (PassHandle p : step.passes)
+		{
+			for (const auto& access : passes[p].accesses)
+			{
+				if (access.resource == r)
+				{
+					if (first == nullptr)
+					{
+						first = &access;
+						firstSubpass[i] = passes[p].subpass;
+					}
+					last = &access;
+					lastSubpass[i] = passes[p].subpass;
+				}
+			}
+		}
+
+		AccessState& state = states[r];
+		UsageInfo firstInfo = getUsageInfo(first->usage, first->write);
+		UsageInfo lastInfo = getUsageInfo(last->usage, last->write);
+		bool preserve = !first->clear && state.layout != VK_IMAGE_LAYOUT_UNDEFINED;
+		bool usedLater = resource.lastStep > stepIndex || resource.output;
+		bool hasStencil = (resource.desc.aspect & VK_IMAGE_ASPECT_STENCIL_BIT) != 0;
+
+		VkAttachmentDescription& description = attachmentDescriptions[i];
+		description.format = resource.desc.format;
+		description.samples = VK_SAMPLE_COUNT_1_BIT;
+		description.loadOp = first->clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : (preserve ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_DONT_CARE);
+		description.storeOp = usedLater ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		description.stencilLoadOp = hasStencil ? description.loadOp : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		description.stencilStoreOp = hasStencil ? description.storeOp : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		description.initialLayout = preserve ? state.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+		description.finalLayout = (resource.imported && resource.lastStep == stepIndex) ? resource.finalLayout : lastInfo.layout;
+
+		if (first->clear)
+		{
+			step.clearValues[i] = first->clearValue;
+		}
+
+		// Wait for the previous user of the image before the first subpass touches it
+		addDependency(VK_SUBPASS_EXTERNAL, firstSubpass[i], state.stages != 0 ? state.stages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			firstInfo.stages, state.write ? state.access : 0, firstInfo.access);
+
+		state.layout = description.finalLayout;
+		state.stages = lastInfo.stages;
+		state.access = lastInfo.access;
+		state.write = last->write;
+	}
+
+	// Subpasses and the dependencies between them
+	std::vector<std::vector<VkAttachmentReference>> colorReferences(step.passes.size());
+	std::vector<VkAttachmentReference> depthReferences(step.passes.size());
+	std::vector<std::vector<uint32_t>> preserveAttachments(step.passes.size());
+	std::vector<VkSubpassDescription> subpasses(step.passes.size());
+
+	std::vector<int> previousSubpass(step.attachments.size(), -1);
+	std::vector<UsageInfo> previousInfo(step.attachments.size());
+	std::vector<bool> previousWrite(step.attachments.size(), false);
+
+	for (uint32_t s = 0; s < step.passes.size(); s++)
+	{
+		const Pass& pass = passes[step.passes[s]];
+		bool hasDepth = false;
+
+		for (const auto& access : pass.accesses)
+		{
+			UsageInfo info = getUsageInfo(access.usage, access.write);
+			if (!info.attachment)
+			{
+				continue;
+			}
+
+			uint32_t index = static_cast<uint32_t>(std::find(step.attachments.begin(), step.attachments.end(), access.resource) - step.attachments.begin());
+
+			VkAttachmentReference reference = {};
+			reference.attachment = index;
+			reference.layout = info.layout;
+
+			if (access.usage == ResourceUsage::ColorAttachment)
+			{
+				colorReferences[s].push_back(reference);
+			}
+			else
+			{
+				if (hasDepth)
+				{
+					throw std::runtime_error("Render graph: pass " + pass.name + " uses more than one depth attachment!");
+				}
+				depthReferences[s] = reference;
+				hasDepth = true;
+			}
+
+			if (previousSubpass[index] != -1 && previousSubpass[index] != static_cast<int>(s) && (previousWrite[index] || access.write))
+			{
+				addDependency(previousSubpass[index], s, previousInfo[index].stages, info.stages,
+					previousWrite[index] ? previousInfo[index].access : 0, info.access);
+			}
+
+			previousSubpass[index] = s;
+			previousInfo[index] = info;
+			previousWrite[index] = access.write;
+		}
+
+		// Attachments used before and after this subpass, but not by it, must keep their contents
+		for (uint32_t i = 0; i < step.attachments.size(); i++)
+		{
+			bool referenced = false;
+			for (const auto& access : pass.accesses)
+			{
+				referenced = referenced || access.resource == step.attachments[i];
+			}
+
+			if (!referenced && firstSubpass[i] < s && lastSubpass[i] > s)
+			{
+				preserveAttachments[s].push_back(i);
+			}
+		}
+
+		VkSubpassDescription& subpass = subpasses[s];
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = static_cast<uint32_t>(colorReferences[s].size());
+		subpass.pColorAttachments = colorReferences[s].data();
+		subpass.pDepthStencilAttachment = hasDepth ? &depthReferences[s] : nullptr;
+		subpass.preserveAttachmentCount = static_cast<uint32_t>(preserveAttachments[s].size());
+		subpass.pPreserveAttachments = preserveAttachments[s].data();
+	}
+
+	VkRenderPassCreateInfo renderPassInfo = {};
+	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	renderPassInfo.attachmentCount = static_cast<uint32_t>(attachmentDescriptions.size());
+	renderPassInfo.pAttachments = attachmentDescriptions.data();
+	renderPassInfo.subpassCount = static_cast<uint32_t>(subpasses.size());
+	renderPassInfo.pSubpasses = subpasses.data();
+	renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+	renderPassInfo.pDependencies = dependencies.data();
+
+	if (vkCreateRenderPass(device, &renderPassInfo, allocator, &step.renderPass) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Render graph: failed to create render pass!");
+	}
+
+	statistics.renderPassCount++;
+}
+
+void RenderGraph::buildBarriersAndRenderPasses()
+{
+	std::vector<AccessState> states(resources.size());
+	for (ResourceHandle r = 0; r < resources.size(); r++)
+	{
+		if (resources[r].firstStep != -1)
+		{
+			states[r] = getInitialState(r);
+		}
+	}
+
+	statistics.renderPassCount = 0;
+	statistics.barrierCount = 0;
+
+	for (auto& step : steps)
+	{
+		if (step.type == PassType::Graphics)
+		{
+			buildRenderPass(step, states);
+		}
+		else
+		{
+			for (PassHandle p : step.passes)
+			{
+				for (const auto& access : passes[p].accesses)
+				{
+					addBarrier(step, access.resource, getUsageInfo(access.usage, access.write), access.write, states[access.resource]);
+				}
+			}
+		}
+
+		statistics.barrierCount += static_cast<uint32_t>(step.barriers.size());
+	}
+
+	// Render passes leave imported attachments in their final layout, images last used outside of one are transitioned after the last step
+	finalBarriers.clear();
+	finalSrcStages = 0;
+	for (ResourceHandle r = 0; r < resources.size(); r++)
+	{
+		const Resource& resource = resources[r];
+		const AccessState& state = states[r];
+		if (!resource.imported || resource.firstStep == -1 || resource.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED || state.layout == resource.finalLayout)
+		{
+			continue;
+		}
+
+		Barrier barrier;
+		barrier.resource = r;
+		barrier.oldLayout = state.layout;
+		barrier.newLayout = resource.finalLayout;
+		barrier.srcAccess = state.write ? state.access : 0;
+		barrier.dstAccess = 0; // Whatever comes next synchronizes with a semaphore
+		finalBarriers.push_back(barrier);
+		finalSrcStages |= state.stages;
+	}
+	statistics.barrierCount += static_cast<uint32_t>(finalBarriers.size());
+}
+
+void RenderGraph::createFramebuffers()
+{
+	for (auto& step : steps)
+	{
+		if (step.type != PassType::Graphics)
+		{
+			continue;
+		}
+
+		step.framebuffers.resize(variantCount);
+
+		for (uint32_t variant = 0; variant < variantCount; variant++)
+		{
+			std::vector<VkImageView> views;
+			for (ResourceHandle r : step.attachments)
+			{
+				const Resource& resource = resources[r];
+				views.push_back(resource.imported ? resource.views[variant % resource.views.size()] : resource.view);
+			}
+
+			VkFramebufferCreateInfo framebufferInfo = {};
+			framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+			framebufferInfo.renderPass = step.renderPass;
+			framebufferInfo.attachmentCount = static_cast<uint32_t>(views.size());
+			framebufferInfo.pAttachments = views.data();
+			framebufferInfo.width = step.extent.width;
+			framebufferInfo.height = step.extent.height;
+			framebufferInfo.layers = 1;
+
+			if (vkCreateFramebuffer(device, &framebufferInfo, allocator, &step.framebuffers[variant]) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Render graph: failed to create framebuffer!");
+			}
+		}
+	}
+}
+
+
+// ==== EXECUTION ====
+
+void RenderGraph::execute(VkCommandBuffer commandBuffer, uint32_t variant) const
+{
+	for (const auto& step : steps)
+	{
+		if (!step.barriers.empty())
+		{
+			recordBarriers(commandBuffer, step.barriers, step.srcStages, step.dstStages, variant);
+		}
+
+		if (step.type == PassType::Graphics)
+		{
+			VkRenderPassBeginInfo renderPassInfo = {};
+			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+			renderPassInfo.renderPass = step.renderPass;
+			renderPassInfo.framebuffer = step.framebuffers[variant % step.framebuffers.size()];
+			renderPassInfo.renderArea.offset = { 0, 0 };
+			renderPassInfo.renderArea.extent = step.extent;
+			renderPassInfo.clearValueCount = static_cast<uint32_t>(step.clearValues.size());
+			renderPassInfo.pClearValues = step.clearValues.data();
+
+			for (size_t i = 0; i < step.passes.size(); i++)
+			{
+				const Pass& pass = passes[step.passes[i]];
+				VkSubpassContents contents = pass.secondary ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE;
+
+				if (i == 0)
+				{
+					vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
+				}
+				else
+				{
+					vkCmdNextSubpass(commandBuffer, contents);
+				}
+
+				pass.execute(commandBuffer, variant);
+			}
+
+			vkCmdEndRenderPass(commandBuffer);
+		}
+		else
+		{
+			for (PassHandle p : step.passes)
+			{
+				passes[p].execute(commandBuffer, variant);
+			}
+		}
+	}
+
+	if (!finalBarriers.empty())
+	{
+		recordBarriers(commandBuffer, finalBarriers, finalSrcStages, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, variant);
+	}
+}
+
+/****************************************************************************
+ * The graph may be executed every frame, so the barriers are filled in on the stack and recorded in batches
+ * of the same stages instead of allocating an array for them.
+ */
+void RenderGraph::recordBarriers(VkCommandBuffer commandBuffer, const std::vector<Barrier>& barriers, VkPipelineStageFlags srcStages,
+	VkPipelineStageFlags dstStages, uint32_t variant) const
+{
+	const uint32_t batchSize = 16;
+	VkImageMemoryBarrier imageBarriers[batchSize];
+	uint32_t count = 0;
+
+	for (const auto& barrier : barriers)
+	{
+		const Resource& resource = resources[barrier.resource];
+
+		VkImageMemoryBarrier imageBarrier = {};
+		imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		imageBarrier.oldLayout = barrier.oldLayout;
+		imageBarrier.newLayout = barrier.newLayout;
+		imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		imageBarrier.image = resource.imported ? resource.images[variant % resource.images.size()] : resource.image;
+		imageBarrier.subresourceRange.aspectMask = resource.desc.aspect;
+		imageBarrier.subresourceRange.baseMipLevel = 0;
+		imageBarrier.subresourceRange.levelCount = 1;
+		imageBarrier.subresourceRange.baseArrayLayer = 0;
+		imageBarrier.subresourceRange.layerCount = 1;
+		imageBarrier.srcAccessMask = barrier.srcAccess;
+		imageBarrier.dstAccessMask = barrier.dstAccess;
+
+		imageBarriers[count++] = imageBarrier;
+		if (count == batchSize)
+		{
+			vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, 0, nullptr, 0, nullptr, count, imageBarriers);
+			count = 0;
+		}
+	}
+
+	if (count > 0)
+	{
+		vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, 0, nullptr, 0, nullptr, count, imageBarriers);
+	}
+}
+
+void RenderGraph::destroy()
+{
+	for (auto& step : steps)
+	{
+		for (auto framebuffer : step.framebuffers)
+		{
+			vkDestroyFramebuffer(device, framebuffer, allocator);
+		}
+
+		if (step.renderPass != VK_NULL_HANDLE)
+		{
+			vkDestroyRenderPass(device, step.renderPass, allocator);
+		}
+	}
+
+	for (auto& resource : resources)
+	{
+		if (!resource.imported && resource.image != VK_NULL_HANDLE)
+		{
+			vkDestroyImageView(device, resource.view, allocator);
+			vkDestroyImage(device, resource.image, allocator);
+		}
+	}
+
+	for (auto& block : memoryBlocks)
+	{
+		vkFreeMemory(device, block.memory, allocator);
+	}
+
+	steps.clear();
+	memoryBlocks.clear();
+	finalBarriers.clear();
+	resources.clear();
+	passes.clear();
+	compiled = false;
+}
+
+VkRenderPass RenderGraph::getRenderPass(PassHandle pass) const
+{
+	if (passes[pass].culled || passes[pass].type != PassType::Graphics)
+	{
+		throw std::runtime_error("Render graph: pass " + passes[pass].name + " has no render pass!");
+	}
+
+	return steps[passes[pass].step].renderPass;
+}
+
+uint32_t RenderGraph::getSubpassIndex(PassHandle pass) const
+{
+	return passes[pass].subpass;
+}
+
+VkFramebuffer RenderGraph::getFramebuffer(PassHandle pass, uint32_t variant) const
+{
+	const std::vector<VkFramebuffer>& framebuffers = steps[passes[pass].step].framebuffers;
+	return framebuffers[variant % framebuffers.size()];
+}
+
+VkImage RenderGraph::getImage(ResourceHandle resource, uint32_t variant) const
+{
+	const Resource& image = resources[resource];
+	if (image.imported)
+	{
+		return image.images[variant % image.images.size()];
+	}
+
+	if (image.image == VK_NULL_HANDLE)
+	{
+		throw std::runtime_error("Render graph: image " + image.name + " isn't used by any pass!");
+	}
+
+	return image.image;
+}
+
+VkImageView RenderGraph::getImageView(ResourceHandle resource, uint32_t variant) const
+{
+	const Resource& image = resources[resource];
+	if (image.imported)
+	{
+		return image.views[variant % image.views.size()];
+	}
+
+	if (image.view == VK_NULL_HANDLE)
+	{
+		throw std::runtime_error("Render graph: image " + image.name + " isn't used by any pass!");
+	}
+
+	return image.view;
+}
+
+bool RenderGraph::isCulled(PassHandle pass) const
+{
+	return passes[pass].culled;
+}
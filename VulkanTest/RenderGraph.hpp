@@ -0,0 +1,228 @@
+#ifndef RENDER_GRAPH
+#define RENDER_GRAPH
+
+#include "VulkanDispatch.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+/****************************************************************************************************
+ * Frame render graph.
+ * Passes declare which images they read and write, and the graph works out everything in between:
+ * - passes whose results are never used by an output are culled,
+ * - consecutive graphics passes rendering to the same extent are merged into subpasses of one render pass,
+ * - layout transitions and barriers are computed from the declared accesses (reads after reads don't sync),
+ * - transient images whose lifetimes don't overlap share the same device memory.
+ *
+ * Usage: create/import resources, add passes with their accesses, compile() once, then execute()
+ * while recording a command buffer. Imported images may have several variants (e.g. one per swap chain image),
+ * the variant index is passed to execute() and to the pass callbacks.
+ */
+class RenderGraph
+{
+public:
+	typedef uint32_t ResourceHandle;
+	typedef uint32_t PassHandle;
+
+	enum class PassType
+	{
+		Graphics, // Runs inside a render pass, must have at least one attachment
+		Compute,
+		Transfer
+	};
+
+	enum class ResourceUsage
+	{
+		ColorAttachment,
+		DepthStencilAttachment,
+		DepthStencilReadOnly, // Depth testing against a depth buffer without writing to it
+		SampledFragment,
+		SampledCompute,
+		Storage,
+		TransferSrc,
+		TransferDst
+	};
+
+	struct ImageDesc
+	{
+		VkFormat format;
+		VkExtent2D extent;
+		VkImageAspectFlags aspect;
+	};
+
+	struct Statistics
+	{
+		uint32_t passCount = 0;
+		uint32_t culledPassCount = 0;
+		uint32_t renderPassCount = 0;
+		uint32_t barrierCount = 0;
+		VkDeviceSize transientMemory = 0; // Memory actually allocated for transient images
+		VkDeviceSize unaliasedTransientMemory = 0; // Memory the transient images would take without aliasing
+	};
+
+	typedef std::function<void(VkCommandBuffer commandBuffer, uint32_t variant)> ExecuteCallback;
+
+	// ==== BUILDING ====
+	ResourceHandle createImage(const std::string& name, const ImageDesc& desc);
+	ResourceHandle importImage(const std::string& name, const ImageDesc& desc,
+		const std::vector<VkImage>& images, const std::vector<VkImageView>& views,
+		VkImageLayout initialLayout, VkImageLayout finalLayout, VkPipelineStageFlags initialStages);
+	void markOutput(ResourceHandle resource);
+
+	PassHandle addPass(const std::string& name, PassType type, ExecuteCallback execute);
+	void readResource(PassHandle pass, ResourceHandle resource, ResourceUsage usage);
+	// Writing an attachment without a clear value keeps (loads) its previous contents
+	void writeResource(PassHandle pass, ResourceHandle resource, ResourceUsage usage, const VkClearValue* clearValue = nullptr);
+	void setSideEffects(PassHandle pass); // The pass is never culled
+	// A graphics pass whose subpass is recorded from secondary command buffers, its callback may only execute them
+	void setSecondaryCommandBuffers(PassHandle pass);
+
+	// ==== COMPILATION AND EXECUTION ====
+	void compile(VkDevice device, const VkAllocationCallbacks* allocator, VkPhysicalDevice physicalDevice);
+	void execute(VkCommandBuffer commandBuffer, uint32_t variant) const;
+	void destroy();
+
+	VkRenderPass getRenderPass(PassHandle pass) const;
+	uint32_t getSubpassIndex(PassHandle pass) const;
+	VkFramebuffer getFramebuffer(PassHandle pass, uint32_t variant) const; // For the inheritance of secondary command buffers
+	// For descriptors and pass callbacks, after compile()
+	VkImage getImage(ResourceHandle resource, uint32_t variant) const;
+	VkImageView getImageView(ResourceHandle resource, uint32_t variant) const;
+	bool isCulled(PassHandle pass) const;
+	const Statistics& getStatistics() const { return statistics; }
+
+private:
+	struct UsageInfo
+	{
+		VkImageLayout layout;
+		VkPipelineStageFlags stages;
+		VkAccessFlags access;
+		VkImageUsageFlags imageUsage;
+		bool attachment;
+	};
+
+	struct Access
+	{
+		ResourceHandle resource;
+		ResourceUsage usage;
+		bool write;
+		bool clear;
+		VkClearValue clearValue;
+	};
+
+	// Last known state of a resource while walking through the passes
+	struct AccessState
+	{
+		VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkPipelineStageFlags stages = 0;
+		VkAccessFlags access = 0;
+		bool write = false;
+	};
+
+	struct Resource
+	{
+		std::string name;
+		ImageDesc desc;
+		bool imported = false;
+		bool output = false;
+
+		// Imported resources
+		std::vector<VkImage> images;
+		std::vector<VkImageView> views;
+		VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkPipelineStageFlags initialStages = 0;
+
+		// Transient resources
+		VkImage image = VK_NULL_HANDLE;
+		VkImageView view = VK_NULL_HANDLE;
+		VkImageUsageFlags usage = 0;
+		int memoryBlock = -1;
+		bool lazilyAllocated = false;
+
+		// Lifetime in steps, -1 if the resource isn't used by any live pass
+		int firstStep = -1;
+		int lastStep = -1;
+		AccessState lastAccess; // State after the last access in the frame
+	};
+
+	struct Pass
+	{
+		std::string name;
+		PassType type;
+		std::vector<Access> accesses;
+		ExecuteCallback execute;
+		bool sideEffects = false;
+		bool secondary = false; // Subpass contents are secondary command buffers
+		bool culled = false;
+		int step = -1;
+		uint32_t subpass = 0;
+	};
+
+	struct Barrier
+	{
+		ResourceHandle resource;
+		VkImageLayout oldLayout;
+		VkImageLayout newLayout;
+		VkAccessFlags srcAccess;
+		VkAccessFlags dstAccess;
+	};
+
+	// A step is either a render pass made of merged graphics passes, or a single compute/transfer pass
+	struct Step
+	{
+		PassType type;
+		std::vector<PassHandle> passes;
+		std::vector<Barrier> barriers; // Recorded before the step
+		VkPipelineStageFlags srcStages = 0;
+		VkPipelineStageFlags dstStages = 0;
+
+		VkExtent2D extent = {};
+		std::vector<ResourceHandle> attachments;
+		std::vector<VkClearValue> clearValues;
+		VkRenderPass renderPass = VK_NULL_HANDLE;
+		std::vector<VkFramebuffer> framebuffers; // One per variant
+	};
+
+	struct MemoryBlock
+	{
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize size = 0;
+		uint32_t memoryTypeBits = ~0u;
+		std::vector<ResourceHandle> occupants; // Sorted by lifetime
+	};
+
+	static UsageInfo getUsageInfo(ResourceUsage usage, bool write);
+	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties, bool& found) const;
+
+	void cullPasses();
+	void buildSteps();
+	void computeLifetimes();
+	void allocateTransientResources();
+	AccessState getInitialState(ResourceHandle resource) const;
+	void addBarrier(Step& step, ResourceHandle resource, const UsageInfo& info, bool write, AccessState& state);
+	void buildRenderPass(Step& step, std::vector<AccessState>& states);
+	void buildBarriersAndRenderPasses();
+	void createFramebuffers();
+	void recordBarriers(VkCommandBuffer commandBuffer, const std::vector<Barrier>& barriers, VkPipelineStageFlags srcStages,
+		VkPipelineStageFlags dstStages, uint32_t variant) const;
+
+	VkDevice device = VK_NULL_HANDLE;
+	const VkAllocationCallbacks* allocator = nullptr;
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+
+	std::vector<Resource> resources;
+	std::vector<Pass> passes;
+	std::vector<Step> steps;
+	std::vector<MemoryBlock> memoryBlocks;
+	std::vector<Barrier> finalBarriers; // Imported images into their final layout, after the last step
+	VkPipelineStageFlags finalSrcStages = 0;
+	uint32_t variantCount = 1;
+	bool compiled = false;
+
+	Statistics statistics;
+};
+
+#endif
@@ -0,0 +1,74 @@
+#include "ResolutionScaler.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+void ResolutionScaler::init(const Config& config)
+{
+	this->config = config;
+	scale = config.maxScale;
+	settling = 0;
+	statistics = Statistics();
+	statistics.lowestScale = scale;
+}
+
+bool ResolutionScaler::update(double gpuTime)
+{
+	statistics.measurements++;
+	statistics.scaleTotal += scale;
+	if (gpuTime > config.targetTime)
+	{
+		statistics.overBudget++;
+	}
+
+	if (settling > 0)
+	{
+		settling--;
+		return false;
+	}
+
+	double lowerTime = config.targetTime * config.lowerThreshold;
+	if (gpuTime <= 0.0 || (gpuTime >= lowerTime && gpuTime <= config.targetTime))
+	{
+		return false;
+	}
+
+	float newScale;
+	if (gpuTime > config.targetTime)
+	{
+		double aimedTime = (lowerTime + config.targetTime) * 0.5;
+		newScale = quantize(static_cast<float>(scale * std::sqrt(aimedTime / gpuTime)));
+	}
+	else
+	{
+		newScale = quantize(scale + config.scaleStep);
+	}
+
+	newScale = std::min(std::max(newScale, config.minScale), config.maxScale);
+	if (std::fabs(newScale - scale) < config.scaleStep * 0.5f)
+	{
+		return false;
+	}
+
+	scale = newScale;
+	settling = config.settleFrames;
+	statistics.changes++;
+	statistics.lowestScale = std::min(statistics.lowestScale, scale);
+	return true;
+}
+
+VkExtent2D ResolutionScaler::getExtent(VkExtent2D fullExtent) const
+{
+	VkExtent2D extent;
+	extent.width = std::max(1u, static_cast<uint32_t>(std::lround(fullExtent.width * scale)));
+	extent.height = std::max(1u, static_cast<uint32_t>(std::lround(fullExtent.height * scale)));
+	extent.width = std::min(extent.width, fullExtent.width);
+	extent.height = std::min(extent.height, fullExtent.height);
+	return extent;
+}
+
+// Rounded down, so a scale that was just enough stays enough
+float ResolutionScaler::quantize(float value) const
+{
+	return std::floor(value / config.scaleStep + 0.001f) * config.scaleStep;
+}
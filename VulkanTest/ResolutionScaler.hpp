@@ -0,0 +1,61 @@
+#ifndef RESOLUTION_SCALER
+#define RESOLUTION_SCALER
+
+#include "VulkanDispatch.hpp"
+
+#include <cstdint>
+
+/****************************************************************************************************
+ * Picks the render resolution scale that keeps the measured GPU frame time within a budget.
+ * - The GPU time is taken to grow with the pixel count, the square of the scale, so an over budget frame is
+ *   answered with the scale that would have hit the middle of the band in one go. Scaling back up goes one step
+ *   at a time, a single cheap frame says little about the next one.
+ * - Hysteresis: nothing changes while the time is between lowerThreshold * targetTime and targetTime.
+ * - Scales are multiples of scaleStep, so the resolution only changes (and the frames get re-recorded) when
+ *   it's worth it, and measurements right after a change are ignored - they still come from frames in flight
+ *   that were rendered at the old scale.
+ */
+class ResolutionScaler
+{
+public:
+	struct Config
+	{
+		double targetTime = 1000.0 / 60.0; // Milliseconds of GPU time per frame
+		float lowerThreshold = 0.8f; // Fraction of the target below which the scale goes up
+		float minScale = 0.5f;
+		float maxScale = 1.0f;
+		float scaleStep = 0.05f;
+		uint32_t settleFrames = 8; // Measurements ignored after a change
+	};
+
+	struct Statistics
+	{
+		uint32_t changes = 0;
+		float lowestScale = 1.0f;
+		double scaleTotal = 0.0;
+		uint64_t measurements = 0;
+		uint64_t overBudget = 0; // Measurements above the target time
+	};
+
+	// Starts at the maximum scale
+	void init(const Config& config);
+	// Takes the GPU time of a finished frame, returns whether the scale changed
+	bool update(double gpuTime);
+
+	float getScale() const { return scale; }
+	// The full extent scaled, at least one pixel
+	VkExtent2D getExtent(VkExtent2D fullExtent) const;
+	const Config& getConfig() const { return config; }
+	const Statistics& getStatistics() const { return statistics; }
+
+private:
+	float quantize(float value) const;
+
+	Config config;
+	float scale = 1.0f;
+	uint32_t settling = 0;
+
+	Statistics statistics;
+};
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef RING_QUEUE
+#define RING_QUEUE
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+/****************************************************************************************************
+ * FIFO queue over one power of two array that wraps around.
+ * - Unlike a deque, pushing and popping never allocate or free anything: the storage only grows, by doubling,
+ *   when the queue is fuller than it has ever been. After a warm-up a queue that's filled and drained every
+ *   frame doesn't touch the heap at all.
+ * - Popping only advances the head: the element is neither moved nor destroyed and stays alive in its slot,
+ *   with whatever memory it owns, until a later push assigns over it or the storage grows or is destroyed.
+ *   clear() works the same way.
+ */
+template <typename T>
+class RingQueue
+{
+public:
+	bool empty() const { return count == 0; }
+	size_t size() const { return count; }
+
+	T& front() { return slots[head]; }
+	const T& front() const { return slots[head]; }
+	T& back() { return slots[(head + count - 1) & mask()]; }
+	const T& back() const { return slots[(head + count - 1) & mask()]; }
+	// Oldest first
+	T& operator[](size_t index) { return slots[(head + index) & mask()]; }
+	const T& operator[](size_t index) const { return slots[(head + index) & mask()]; }
+
+	void push_back(const T& value)
+	{
+		if (count == slots.size())
+		{
+			grow();
+		}
+
+		slots[(head + count) & mask()] = value;
+		count++;
+	}
+
+	void pop_front()
+	{
+		head = (head + 1) & mask();
+		count--;
+	}
+
+	void clear()
+	{
+		head = 0;
+		count = 0;
+	}
+
+	// Makes room for this many elements up front
+	void reserve(size_t capacity)
+	{
+		while (slots.size() < capacity)
+		{
+			grow();
+		}
+	}
+
+private:
+	size_t mask() const { return slots.size() - 1; }
+
+	void grow()
+	{
+		std::vector<T> larger(slots.empty() ? 16 : slots.size() * 2);
+		for (size_t i = 0; i < count; i++)
+		{
+			larger[i] = std::move((*this)[i]);
+		}
+
+		slots.swap(larger);
+		head = 0;
+	}
+
+	std::vector<T> slots;
+	size_t head = 0;
+	size_t count = 0;
+};
+
+#endif
@@ -0,0 +1,29 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(push_constant) uniform MeshConstants
+{
+	mat4 viewProjection;
+	vec4 positionScale;
+	vec4 positionOffset;
+	uint textureSlot;
+	float textureScale;
+} mesh;
+
+// Bindless table, the buffers at binding 2 are not used here
+layout(set = 0, binding = 0) uniform sampler bindlessSampler;
+layout(set = 0, binding = 1) uniform texture2D bindlessTextures[];
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec3 fragWorldPosition;
+
+layout(location = 0) out vec4 outColor;
+
+void main()
+{
+	// The slot is the same for the whole draw, so plain dynamic indexing is enough
+	vec2 uv = fragWorldPosition.xz * mesh.textureScale;
+	vec3 texel = texture(sampler2D(bindlessTextures[mesh.textureSlot], bindlessSampler), uv).rgb;
+
+	outColor = vec4(fragColor * texel, 1.0);
+}
\ No newline at end of file
@@ -1,3 +1,15 @@
 "A:\VulkanSDK\1.1.106.0\Bin32\glslangValidator.exe" -V shader.vert
 "A:\VulkanSDK\1.1.106.0\Bin32\glslangValidator.exe" -V shader.frag
+"A:\VulkanSDK\1.1.106.0\Bin32\glslangValidator.exe" -V mesh.vert -o mesh.spv
+"A:\VulkanSDK\1.1.106.0\Bin32\glslangValidator.exe" -V bindless.frag -o bindless.spv
+"A:\VulkanSDK\1.1.106.0\Bin32\glslangValidator.exe" -V --target-env vulkan1.1 histogram.comp -o histogram.spv
+"A:\VulkanSDK\1.1.106.0\Bin32\glslangValidator.exe" -V --target-env vulkan1.1 exposure.comp -o exposure.spv
+"A:\VulkanSDK\1.1.106.0\Bin32\glslangValidator.exe" -V downsample.comp -o downsample.spv
+"A:\VulkanSDK\1.1.106.0\Bin32\glslangValidator.exe" -V upsample.comp -o upsample.spv
+"A:\VulkanSDK\1.1.106.0\Bin32\glslangValidator.exe" -V tonemap.comp -o tonemap.spv
+"A:\VulkanSDK\1.1.106.0\Bin32\glslangValidator.exe" -V -DOUTPUT_RGBA8 tonemap.comp -o tonemap_rgba8.spv
+"A:\VulkanSDK\1.1.106.0\Bin32\glslangValidator.exe" -V particle_control.comp -o particle_control.spv
+"A:\VulkanSDK\1.1.106.0\Bin32\glslangValidator.exe" -V particle_simulate.comp -o particle_simulate.spv
+"A:\VulkanSDK\1.1.106.0\Bin32\glslangValidator.exe" -V particle.vert -o particle_vert.spv
+"A:\VulkanSDK\1.1.106.0\Bin32\glslangValidator.exe" -V particle.frag -o particle_frag.spv
 pause
\ No newline at end of file
@@ -0,0 +1,31 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(push_constant) uniform MeshConstants
+{
+	mat4 viewProjection;
+	vec4 positionScale;
+	vec4 positionOffset;
+	uint textureSlot;
+	float textureScale;
+} mesh;
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inNormal;
+// Per instance world matrix, takes locations 4 to 7
+layout(location = 4) in mat4 instanceModel;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec3 fragWorldPosition;
+
+
+void main()
+{
+	// Quantized positions are relative to the mesh bounds, float positions come with an identity scale
+	vec3 position = inPosition * mesh.positionScale.xyz + mesh.positionOffset.xyz;
+
+	vec4 worldPosition = instanceModel * vec4(position, 1.0);
+	gl_Position = mesh.viewProjection * worldPosition;
+	fragWorldPosition = worldPosition.xyz;
+	fragColor = normalize(mat3(instanceModel) * inNormal) * 0.5 + 0.5;
+}
\ No newline at end of file
@@ -0,0 +1,15 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragCorner;
+
+layout(location = 0) out vec4 outColor;
+
+
+void main()
+{
+	// Round, soft edged, added to the scene
+	float falloff = max(1.0 - dot(fragCorner, fragCorner), 0.0);
+	outColor = vec4(fragColor * falloff * falloff, 0.0);
+}
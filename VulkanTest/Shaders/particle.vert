@@ -0,0 +1,59 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// A camera facing quad per instance, built from the particle without vertex input
+layout(push_constant) uniform DrawConstants
+{
+	mat4 viewProjection;
+	vec2 size; // Half size in clip space, the aspect ratio is applied to x
+} draw;
+
+struct Particle
+{
+	vec4 position; // w: remaining life
+	vec4 velocity; // w: total life
+};
+
+layout(set = 0, binding = 0) readonly buffer ParticlesA
+{
+	Particle particles[];
+} particlesA;
+
+layout(set = 0, binding = 1) readonly buffer ParticlesB
+{
+	Particle particles[];
+} particlesB;
+
+layout(set = 0, binding = 2) readonly buffer Control
+{
+	uint current;
+} control;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragCorner;
+
+vec2 corners[6] = vec2[](
+	vec2(-1.0, -1.0),
+	vec2(1.0, -1.0),
+	vec2(1.0, 1.0),
+	vec2(-1.0, -1.0),
+	vec2(1.0, 1.0),
+	vec2(-1.0, 1.0)
+	);
+
+
+void main()
+{
+	uint index = gl_InstanceIndex;
+	Particle particle = control.current == 0 ? particlesA.particles[index] : particlesB.particles[index];
+
+	// Offset after the projection, so the quad shrinks with distance but always faces the camera
+	vec2 corner = corners[gl_VertexIndex];
+	gl_Position = draw.viewProjection * vec4(particle.position.xyz, 1.0);
+	gl_Position.xy += corner * draw.size;
+
+	// HDR, from white hot to a dim red as the particle ages
+	float age = 1.0 - particle.position.w / particle.velocity.w;
+	fragColor = mix(vec3(4.0, 2.4, 1.0), vec3(0.6, 0.08, 0.02), age) * (1.0 - age);
+	fragCorner = corner;
+}
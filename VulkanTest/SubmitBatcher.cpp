@@ -0,0 +1,101 @@
+#include "SubmitBatcher.hpp"
+
+#include <algorithm>
+
+void SubmitBatcher::init(QueueTimeline& timeline)
+{
+	this->timeline = &timeline;
+}
+
+// ==== RECORDING ====
+
+/****************************************************************************
+ * The last batch is reused as long as it's open. A wait can't join a batch that already has command buffers,
+ * the semaphore would then hold them back as well.
+ */
+SubmitBatcher::Batch& SubmitBatcher::openBatch(bool forWait)
+{
+	if (!batchOpen || (forWait && batches.back().commandBufferCount > 0))
+	{
+		Batch batch = {};
+		batch.firstWait = static_cast<uint32_t>(waitSemaphores.size());
+		batch.firstCommandBuffer = static_cast<uint32_t>(commandBuffers.size());
+		batch.firstSignal = static_cast<uint32_t>(signalSemaphores.size());
+		batches.push_back(batch);
+		batchOpen = true;
+	}
+
+	return batches.back();
+}
+
+void SubmitBatcher::wait(VkSemaphore semaphore, VkPipelineStageFlags stage)
+{
+	Batch& batch = openBatch(true);
+	waitSemaphores.push_back(semaphore);
+	waitStages.push_back(stage);
+	batch.waitCount++;
+}
+
+void SubmitBatcher::add(VkCommandBuffer commandBuffer)
+{
+	Batch& batch = openBatch(false);
+	commandBuffers.push_back(commandBuffer);
+	batch.commandBufferCount++;
+}
+
+void SubmitBatcher::signal(VkSemaphore semaphore)
+{
+	Batch& batch = openBatch(false);
+	signalSemaphores.push_back(semaphore);
+	batch.signalCount++;
+	batchOpen = false;
+}
+
+// ==== SUBMISSION ====
+
+uint64_t SubmitBatcher::flush(VkFence fence)
+{
+	if (batches.empty() && fence == VK_NULL_HANDLE)
+	{
+		return timeline->getSubmittedValue();
+	}
+
+	// The arrays are complete now, so the pointers stay valid until the submission is made
+	submitInfos.clear();
+	for (const auto& batch : batches)
+	{
+		VkSubmitInfo submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.waitSemaphoreCount = batch.waitCount;
+		submitInfo.pWaitSemaphores = batch.waitCount > 0 ? &waitSemaphores[batch.firstWait] : nullptr;
+		submitInfo.pWaitDstStageMask = batch.waitCount > 0 ? &waitStages[batch.firstWait] : nullptr;
+		submitInfo.commandBufferCount = batch.commandBufferCount;
+		submitInfo.pCommandBuffers = batch.commandBufferCount > 0 ? &commandBuffers[batch.firstCommandBuffer] : nullptr;
+		submitInfo.signalSemaphoreCount = batch.signalCount;
+		submitInfo.pSignalSemaphores = batch.signalCount > 0 ? &signalSemaphores[batch.firstSignal] : nullptr;
+		submitInfos.push_back(submitInfo);
+	}
+
+	uint64_t value = timeline->submit(static_cast<uint32_t>(submitInfos.size()), submitInfos.data(), fence);
+
+	statistics.submits++;
+	statistics.batches += submitInfos.size();
+	statistics.commandBuffers += commandBuffers.size();
+	frameSubmits++;
+
+	batches.clear();
+	waitSemaphores.clear();
+	waitStages.clear();
+	commandBuffers.clear();
+	signalSemaphores.clear();
+	batchOpen = false;
+	return value;
+}
+
+void SubmitBatcher::endFrame()
+{
+	statistics.frames++;
+	statistics.lastFrameSubmits = frameSubmits;
+	statistics.maxFrameSubmits = std::max(statistics.maxFrameSubmits, frameSubmits);
+	frameSubmits = 0;
+}
@@ -0,0 +1,82 @@
+#ifndef SUBMIT_BATCHER
+#define SUBMIT_BATCHER
+
+#include "VulkanDispatch.hpp"
+
+#include <cstdint>
+#include <vector>
+
+#include "QueueTimeline.hpp"
+
+/****************************************************************************************************
+ * Collects the work of one queue during a frame and hands it to the driver in a single vkQueueSubmit.
+ * - Subsystems add command buffers, semaphore waits and semaphore signals in the order the work has to run.
+ *   The calls are turned into as few VkSubmitInfo batches as the semaphores allow:
+ *   - a wait added after command buffers starts a new batch, so it doesn't hold back the work before it
+ *   - a signal closes the batch it's added to, so it doesn't wait for the work after it
+ * - flush() submits all the batches at once through the queue timeline. Every command buffer added before
+ *   it is tracked by the value it returns, and getPendingValue() tells that value in advance.
+ *
+ * Nothing else may submit to the timeline between an add() and the flush() that follows it. A binary semaphore
+ * that another queue waits for is only signaled once the flush happens, so waits on other queues have to come
+ * after it.
+ */
+class SubmitBatcher
+{
+public:
+	struct Statistics
+	{
+		uint64_t frames = 0;
+		uint64_t submits = 0; // vkQueueSubmit calls made by flush()
+		uint64_t batches = 0; // VkSubmitInfo structures in them
+		uint64_t commandBuffers = 0;
+		uint32_t lastFrameSubmits = 0;
+		uint32_t maxFrameSubmits = 0;
+	};
+
+	void init(QueueTimeline& timeline);
+
+	void wait(VkSemaphore semaphore, VkPipelineStageFlags stage);
+	void add(VkCommandBuffer commandBuffer);
+	void signal(VkSemaphore semaphore);
+
+	// Submits everything added so far and returns the timeline value that signals its completion.
+	// With nothing added, no submission is made unless there's a fence to signal.
+	uint64_t flush(VkFence fence = VK_NULL_HANDLE);
+	// Closes the frame for the submits per frame numbers
+	void endFrame();
+
+	uint64_t getPendingValue() const { return timeline->getNextValue(); } // What the next flush() will return
+	QueueTimeline& getTimeline() const { return *timeline; }
+	const Statistics& getStatistics() const { return statistics; }
+
+private:
+	// Ranges in the arrays below, turned into pointers when the batches are submitted
+	struct Batch
+	{
+		uint32_t firstWait;
+		uint32_t waitCount;
+		uint32_t firstCommandBuffer;
+		uint32_t commandBufferCount;
+		uint32_t firstSignal;
+		uint32_t signalCount;
+	};
+
+	Batch& openBatch(bool forWait);
+
+	QueueTimeline* timeline = nullptr;
+	bool batchOpen = false; // Whether the last batch can still take work
+
+	// Kept between frames to avoid allocating
+	std::vector<Batch> batches;
+	std::vector<VkSemaphore> waitSemaphores;
+	std::vector<VkPipelineStageFlags> waitStages;
+	std::vector<VkCommandBuffer> commandBuffers;
+	std::vector<VkSemaphore> signalSemaphores;
+	std::vector<VkSubmitInfo> submitInfos;
+
+	uint32_t frameSubmits = 0;
+	Statistics statistics;
+};
+
+#endif
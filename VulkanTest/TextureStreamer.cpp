@@ -0,0 +1,987 @@
+#include "TextureStreamer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+static const VkFormat textureFormat = VK_FORMAT_R8G8B8A8_UNORM;
+static const VkDeviceSize stagingAlignment = 16; // Satisfies the texel size and the usual optimalBufferCopyOffsetAlignment
+static const uint32_t batchCount = 4;
+
+// ==== SETUP ====
+
+void TextureStreamer::init(VkDevice device, const VkAllocationCallbacks* allocator, VkPhysicalDevice physicalDevice, SubmitBatcher& batcher, uint32_t queueFamilyIndex,
+	DeletionQueue& deletionQueue, JobSystem* jobSystem, const Config& config)
+{
+	this->device = device;
+	this->allocator = allocator;
+	this->physicalDevice = physicalDevice;
+	this->batcher = &batcher;
+	this->timeline = &batcher.getTimeline();
+	this->deletionQueue = &deletionQueue;
+	this->jobSystem = jobSystem;
+	this->config = config;
+
+	// Mip generation blits with linear filtering, which isn't guaranteed for every format
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, textureFormat, &formatProperties);
+	if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT))
+	{
+		throw std::runtime_error("Texture image format does not support linear blitting!");
+	}
+
+	// Blits need a graphics capable queue, so the uploads are recorded for the graphics family
+	VkCommandPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.queueFamilyIndex = queueFamilyIndex;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+	if (vkCreateCommandPool(device, &poolInfo, allocator, &commandPool) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create texture streaming command pool!");
+	}
+
+	batches.resize(batchCount);
+	for (auto& batch : batches)
+	{
+		VkCommandBufferAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = commandPool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandBufferCount = 1;
+
+		if (vkAllocateCommandBuffers(device, &allocInfo, &batch.commandBuffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create texture streaming batches!");
+		}
+	}
+
+	// Staging ring, mapped for the whole lifetime of the streamer
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = config.stagingSize;
+	bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	if (vkCreateBuffer(device, &bufferInfo, allocator, &stagingBuffer) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create texture staging buffer!");
+	}
+
+	VkMemoryRequirements memRequirements;
+	vkGetBufferMemoryRequirements(device, stagingBuffer, &memRequirements);
+
+	VkMemoryAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = memRequirements.size;
+	allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+	if (vkAllocateMemory(device, &allocInfo, allocator, &stagingMemory) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to allocate texture staging memory!");
+	}
+
+	vkBindBufferMemory(device, stagingBuffer, stagingMemory, 0);
+	vkMapMemory(device, stagingMemory, 0, config.stagingSize, 0, reinterpret_cast<void**>(&stagingData));
+
+	if (jobSystem != nullptr)
+	{
+		return;
+	}
+
+	stopWorkers = false;
+	for (uint32_t i = 0; i < std::max(config.workerCount, 1u); i++)
+	{
+		workers.emplace_back(&TextureStreamer::workerLoop, this);
+	}
+}
+
+/****************************************************************************
+ * Must be called once the device is idle - nothing here waits for the GPU.
+ * Replaced images are owned by the deletion queue by now and are destroyed with it.
+ */
+void TextureStreamer::destroy()
+{
+	{
+		std::lock_guard<std::mutex> lock(jobMutex);
+		stopWorkers = true;
+		jobs.clear();
+	}
+	jobCondition.notify_all();
+
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
+	workers.clear();
+
+	// Jobs already scheduled find the queue empty, only the ones in the middle of decoding take a while
+	if (jobSystem != nullptr)
+	{
+		jobSystem->waitUntil([this]() { return scheduledJobs.load(std::memory_order_acquire) == 0; });
+	}
+
+	for (auto& batch : batches)
+	{
+		for (const auto& upload : batch.uploads)
+		{
+			vkDestroyImageView(device, upload.view, allocator);
+			vkDestroyImage(device, upload.image, allocator);
+			vkFreeMemory(device, upload.memory, allocator);
+		}
+	}
+	batches.clear();
+
+	for (auto& texture : textures)
+	{
+		if (texture.image != VK_NULL_HANDLE)
+		{
+			vkDestroyImageView(device, texture.view, allocator);
+			vkDestroyImage(device, texture.image, allocator);
+			vkFreeMemory(device, texture.memory, allocator);
+		}
+	}
+	textures.clear();
+
+	vkUnmapMemory(device, stagingMemory);
+	vkDestroyBuffer(device, stagingBuffer, allocator);
+	vkFreeMemory(device, stagingMemory, allocator);
+
+	vkDestroyCommandPool(device, commandPool, allocator);
+}
+
+uint32_t TextureStreamer::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const
+{
+	VkPhysicalDeviceMemoryProperties memProperties;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
+	{
+		if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
+		{
+			return i;
+		}
+	}
+
+	throw std::runtime_error("Failed to find suitable memory type!");
+}
+
+
+// ==== REQUESTS ====
+
+TextureStreamer::TextureHandle TextureStreamer::load(const std::string& path)
+{
+	Texture texture;
+	texture.path = path;
+	texture.busy = true;
+	textures.push_back(texture);
+
+	TextureHandle handle = static_cast<TextureHandle>(textures.size() - 1);
+
+	Job job = {};
+	job.type = JobType::Decode;
+	job.texture = handle;
+	job.path = path;
+	pushJob(job);
+
+	return handle;
+}
+
+void TextureStreamer::requestMip(TextureHandle texture, uint32_t finestMip, uint64_t frame)
+{
+	textures[texture].requestedMip = finestMip;
+	textures[texture].lastUsedFrame = frame;
+}
+
+VkImageView TextureStreamer::getView(TextureHandle texture) const
+{
+	return textures[texture].view;
+}
+
+uint32_t TextureStreamer::getResidentMip(TextureHandle texture) const
+{
+	return textures[texture].residentMip;
+}
+
+VkDeviceSize TextureStreamer::imageSize(const Texture& texture, uint32_t baseMip) const
+{
+	// Estimate from the texel data - the real allocation is only known once the image is created
+	VkDeviceSize size = 0;
+	for (uint32_t mip = baseMip; mip < texture.mipLevels; mip++)
+	{
+		size += static_cast<VkDeviceSize>(mipSize(texture.width, mip)) * mipSize(texture.height, mip) * 4;
+	}
+
+	return size;
+}
+
+
+// ==== WORKERS ====
+
+void TextureStreamer::pushJob(const Job& job)
+{
+	{
+		std::lock_guard<std::mutex> lock(jobMutex);
+		jobs.push_back(job);
+	}
+
+	if (jobSystem != nullptr)
+	{
+		// The job only says "process one queued entry", so the entries stay in order and destroy() can drop them
+		scheduledJobs.fetch_add(1, std::memory_order_relaxed);
+		jobSystem->run(jobSystem->createLambdaJob([this]() { runQueuedJob(); }));
+	}
+	else
+	{
+		jobCondition.notify_one();
+	}
+}
+
+void TextureStreamer::workerLoop()
+{
+	while (true)
+	{
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(jobMutex);
+			jobCondition.wait(lock, [this]() { return stopWorkers || !jobs.empty(); });
+
+			if (stopWorkers)
+			{
+				return;
+			}
+
+			job = jobs.front();
+			jobs.pop_front();
+		}
+
+		processJob(job);
+	}
+}
+
+void TextureStreamer::runQueuedJob()
+{
+	Job job;
+	bool found = false;
+	{
+		std::lock_guard<std::mutex> lock(jobMutex);
+		if (!jobs.empty())
+		{
+			job = jobs.front();
+			jobs.pop_front();
+			found = true;
+		}
+	}
+
+	if (found)
+	{
+		processJob(job);
+	}
+
+	scheduledJobs.fetch_sub(1, std::memory_order_release);
+}
+
+void TextureStreamer::processJob(const Job& job)
+{
+	JobResult result = {};
+	result.type = job.type;
+	result.texture = job.texture;
+	result.mip = job.mip;
+
+	if (job.type == JobType::Decode)
+	{
+		auto pixels = std::make_shared<std::vector<uint8_t>>();
+		result.success = decodeImage(job.path, *pixels, result.width, result.height);
+		result.pixels = pixels;
+	}
+	else
+	{
+		result.success = true;
+		result.width = mipSize(job.width, job.mip);
+		result.height = mipSize(job.height, job.mip);
+		result.pixels = job.mip == 0 ? job.pixels :
+			std::make_shared<const std::vector<uint8_t>>(buildMip(*job.pixels, job.width, job.height, job.mip));
+	}
+
+	std::lock_guard<std::mutex> lock(resultMutex);
+	results.push_back(result);
+}
+
+/****************************************************************************
+ * CPU source for an uploaded level - halves the image with a 2x2 box filter until it reaches the mip.
+ * Only the uploaded level is built here, everything below it is generated on the GPU.
+ */
+std::vector<uint8_t> TextureStreamer::buildMip(const std::vector<uint8_t>& pixels, uint32_t width, uint32_t height, uint32_t mip)
+{
+	std::vector<uint8_t> source = pixels;
+	std::vector<uint8_t> destination;
+
+	for (uint32_t level = 0; level < mip; level++)
+	{
+		uint32_t dstWidth = std::max(width / 2, 1u);
+		uint32_t dstHeight = std::max(height / 2, 1u);
+		destination.resize(static_cast<size_t>(dstWidth) * dstHeight * 4);
+
+		for (uint32_t y = 0; y < dstHeight; y++)
+		{
+			uint32_t y0 = std::min(y * 2, height - 1);
+			uint32_t y1 = std::min(y * 2 + 1, height - 1);
+
+			for (uint32_t x = 0; x < dstWidth; x++)
+			{
+				uint32_t x0 = std::min(x * 2, width - 1);
+				uint32_t x1 = std::min(x * 2 + 1, width - 1);
+
+				for (uint32_t c = 0; c < 4; c++)
+				{
+					uint32_t sum = source[(static_cast<size_t>(y0) * width + x0) * 4 + c] + source[(static_cast<size_t>(y0) * width + x1) * 4 + c] +
+						source[(static_cast<size_t>(y1) * width + x0) * 4 + c] + source[(static_cast<size_t>(y1) * width + x1) * 4 + c];
+					destination[(static_cast<size_t>(y) * dstWidth + x) * 4 + c] = static_cast<uint8_t>((sum + 2) / 4);
+				}
+			}
+		}
+
+		source.swap(destination);
+		width = dstWidth;
+		height = dstHeight;
+	}
+
+	return source;
+}
+
+
+// ==== DECODING ====
+
+static bool decodeTGA(const std::vector<uint8_t>& file, std::vector<uint8_t>& pixels, uint32_t& width, uint32_t& height)
+{
+	if (file.size() < 18)
+	{
+		return false;
+	}
+
+	uint8_t idLength = file[0];
+	uint8_t colorMapType = file[1];
+	uint8_t imageType = file[2];
+	width = file[12] | (file[13] << 8);
+	height = file[14] | (file[15] << 8);
+	uint8_t bitsPerPixel = file[16];
+	bool topToBottom = (file[17] & 0x20) != 0;
+
+	// Only uncompressed true color and grayscale images
+	if (colorMapType != 0 || (imageType != 2 && imageType != 3) || width == 0 || height == 0)
+	{
+		return false;
+	}
+
+	uint32_t bytesPerPixel = bitsPerPixel / 8;
+	if ((imageType == 2 && bytesPerPixel != 3 && bytesPerPixel != 4) || (imageType == 3 && bytesPerPixel != 1))
+	{
+		return false;
+	}
+
+	size_t dataOffset = 18 + idLength;
+	if (file.size() < dataOffset + static_cast<size_t>(width) * height * bytesPerPixel)
+	{
+		return false;
+	}
+
+	pixels.resize(static_cast<size_t>(width) * height * 4);
+	for (uint32_t y = 0; y < height; y++)
+	{
+		uint32_t row = topToBottom ? y : height - 1 - y;
+		const uint8_t* src = &file[dataOffset + static_cast<size_t>(y) * width * bytesPerPixel];
+		uint8_t* dst = &pixels[static_cast<size_t>(row) * width * 4];
+
+		for (uint32_t x = 0; x < width; x++, src += bytesPerPixel, dst += 4)
+		{
+			if (bytesPerPixel == 1)
+			{
+				dst[0] = dst[1] = dst[2] = src[0];
+				dst[3] = 255;
+			}
+			else
+			{
+				// TGA stores pixels as BGR(A)
+				dst[0] = src[2];
+				dst[1] = src[1];
+				dst[2] = src[0];
+				dst[3] = bytesPerPixel == 4 ? src[3] : 255;
+			}
+		}
+	}
+
+	return true;
+}
+
+static bool decodePPM(const std::vector<uint8_t>& file, std::vector<uint8_t>& pixels, uint32_t& width, uint32_t& height)
+{
+	if (file.size() < 2 || file[0] != 'P' || file[1] != '6')
+	{
+		return false;
+	}
+
+	// Header: magic, width, height and max value separated by whitespace, with optional # comments
+	size_t position = 2;
+	uint32_t values[3] = {};
+	for (uint32_t i = 0; i < 3; i++)
+	{
+		while (position < file.size() && (isspace(file[position]) || file[position] == '#'))
+		{
+			if (file[position] == '#')
+			{
+				while (position < file.size() && file[position] != '\n')
+				{
+					position++;
+				}
+			}
+			else
+			{
+				position++;
+			}
+		}
+
+		while (position < file.size() && isdigit(file[position]))
+		{
+			values[i] = values[i] * 10 + (file[position] - '0');
+			position++;
+		}
+	}
+	position++; // Single whitespace before the binary data
+
+	width = values[0];
+	height = values[1];
+	if (width == 0 || height == 0 || values[2] == 0 || values[2] > 255 ||
+		file.size() < position + static_cast<size_t>(width) * height * 3)
+	{
+		return false;
+	}
+
+	pixels.resize(static_cast<size_t>(width) * height * 4);
+	for (size_t i = 0; i < static_cast<size_t>(width) * height; i++)
+	{
+		for (uint32_t c = 0; c < 3; c++)
+		{
+			pixels[i * 4 + c] = static_cast<uint8_t>(file[position + i * 3 + c] * 255 / values[2]);
+		}
+		pixels[i * 4 + 3] = 255;
+	}
+
+	return true;
+}
+
+bool TextureStreamer::decodeImage(const std::string& path, std::vector<uint8_t>& pixels, uint32_t& width, uint32_t& height)
+{
+	std::ifstream file(path, std::ios::ate | std::ios::binary);
+	if (!file.is_open())
+	{
+		return false;
+	}
+
+	std::vector<uint8_t> data(static_cast<size_t>(file.tellg()));
+	file.seekg(0);
+	file.read(reinterpret_cast<char*>(data.data()), data.size());
+	file.close();
+
+	return decodePPM(data, pixels, width, height) || decodeTGA(data, pixels, width, height);
+}
+
+
+// ==== PER FRAME UPDATE ====
+
+void TextureStreamer::update(uint64_t frame)
+{
+	completeBatches(frame);
+
+	collectResults();
+	scheduleMips(frame);
+
+	if (pendingUploads.empty())
+	{
+		return;
+	}
+
+	auto freeBatch = std::find_if(batches.begin(), batches.end(), [](const Batch& batch) { return !batch.inFlight; });
+	if (freeBatch == batches.end())
+	{
+		return;
+	}
+
+	Batch& batch = *freeBatch;
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	vkResetCommandBuffer(batch.commandBuffer, 0);
+	if (vkBeginCommandBuffer(batch.commandBuffer, &beginInfo) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to begin recording texture upload!");
+	}
+
+	while (!pendingUploads.empty() && recordUpload(batch, pendingUploads.front()))
+	{
+		pendingUploads.pop_front();
+	}
+
+	if (vkEndCommandBuffer(batch.commandBuffer) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to record texture upload!");
+	}
+
+	if (batch.uploads.empty())
+	{
+		return;
+	}
+
+	// Runs ahead of the frame's commands in the next flush, which also signals its completion
+	batcher->add(batch.commandBuffer);
+	batch.timelineValue = batcher->getPendingValue();
+	batch.inFlight = true;
+	batch.stagingEnd = stagingHead;
+	submittedBatches.push_back(static_cast<size_t>(freeBatch - batches.begin()));
+	statistics.uploadsInFlight += static_cast<uint32_t>(batch.uploads.size());
+}
+
+/****************************************************************************
+ * Polls the queue timeline. Finished uploads replace the texture images and release their staging ring space.
+ */
+void TextureStreamer::completeBatches(uint64_t frame)
+{
+	// Batches are submitted to one queue and finish in order, so the ring tail only moves forward
+	while (!submittedBatches.empty())
+	{
+		Batch& batch = batches[submittedBatches.front()];
+		if (!timeline->isComplete(batch.timelineValue))
+		{
+			break;
+		}
+
+		for (const auto& upload : batch.uploads)
+		{
+			Texture& texture = textures[upload.texture];
+			if (texture.image != VK_NULL_HANDLE)
+			{
+				retireImage(texture.image, texture.memory, texture.view, texture.memorySize, frame);
+			}
+
+			texture.image = upload.image;
+			texture.memory = upload.memory;
+			texture.view = upload.view;
+			texture.memorySize = upload.memorySize;
+			texture.residentMip = upload.mip;
+			texture.busy = false;
+		}
+
+		statistics.uploadsInFlight -= static_cast<uint32_t>(batch.uploads.size());
+		batch.uploads.clear();
+		batch.inFlight = false;
+
+		stagingTail = batch.stagingEnd;
+		submittedBatches.pop_front();
+	}
+
+	// Nothing left in flight, start the ring from the beginning to avoid needless wrapping
+	if (submittedBatches.empty())
+	{
+		stagingHead = stagingTail = 0;
+	}
+}
+
+void TextureStreamer::retireImage(VkImage image, VkDeviceMemory memory, VkImageView view, VkDeviceSize memorySize, uint64_t frame)
+{
+	// Frames up to this one may still sample the old image
+	deletionQueue->push(VK_OBJECT_TYPE_IMAGE_VIEW, view, frame);
+	deletionQueue->push(VK_OBJECT_TYPE_IMAGE, image, frame);
+	deletionQueue->push(VK_OBJECT_TYPE_DEVICE_MEMORY, memory, frame);
+	statistics.residentBytes -= memorySize;
+}
+
+void TextureStreamer::collectResults()
+{
+	std::vector<JobResult> finished;
+	{
+		std::lock_guard<std::mutex> lock(resultMutex);
+		finished.swap(results);
+	}
+
+	for (auto& result : finished)
+	{
+		Texture& texture = textures[result.texture];
+
+		if (result.type == JobType::BuildMip)
+		{
+			pendingUploads.push_back(result);
+			continue;
+		}
+
+		texture.busy = false;
+		if (!result.success)
+		{
+			texture.failed = true;
+			std::cerr << "Failed to decode texture " << texture.path << std::endl;
+			continue;
+		}
+
+		texture.decoded = true;
+		texture.pixels = result.pixels;
+		texture.width = result.width;
+		texture.height = result.height;
+		texture.mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(result.width, result.height)))) + 1;
+
+		// The tail is the first level small enough to be uploaded right away
+		texture.tailMip = 0;
+		while (std::max(mipSize(texture.width, texture.tailMip), mipSize(texture.height, texture.tailMip)) > config.tailSize)
+		{
+			texture.tailMip++;
+		}
+	}
+}
+
+/****************************************************************************
+ * Decides which levels should be resident and starts building them on the workers.
+ * Textures always get their tail first. Finer levels are only scheduled if they fit in the budget,
+ * possibly after dropping the finest levels of textures that weren't used in this frame (oldest first).
+ * If the budget has shrunk below what is already committed, levels are dropped the same way first -
+ * from textures used in this frame too, since staying over the budget means paging.
+ */
+void TextureStreamer::scheduleMips(uint64_t frame)
+{
+	VkDeviceSize committed = 0;
+	for (const auto& texture : textures)
+	{
+		if (texture.decoded)
+		{
+			uint32_t mip = texture.busy ? texture.targetMip : texture.residentMip;
+			committed += mip < texture.mipLevels ? imageSize(texture, mip) : 0;
+		}
+	}
+
+	evictMips(committed, config.residencyBudget, UINT32_MAX, frame + 1);
+
+	for (TextureHandle t = 0; t < textures.size(); t++)
+	{
+		Texture& texture = textures[t];
+		if (!texture.decoded || texture.busy)
+		{
+			continue;
+		}
+
+		uint32_t desiredMip = std::min(texture.requestedMip, texture.tailMip);
+		desiredMip = std::min(desiredMip, texture.mipLevels - 1);
+
+		// A level is uploaded in one copy, one that can't fit the staging ring even when it's empty would never go out
+		while (desiredMip < texture.mipLevels - 1 &&
+			static_cast<VkDeviceSize>(mipSize(texture.width, desiredMip)) * mipSize(texture.height, desiredMip) * 4 > config.stagingSize)
+		{
+			desiredMip++;
+		}
+		if (desiredMip >= texture.residentMip)
+		{
+			continue;
+		}
+
+		VkDeviceSize currentSize = texture.residentMip < texture.mipLevels ? imageSize(texture, texture.residentMip) : 0;
+
+		// Evict least recently used levels until the new residency fits
+		VkDeviceSize growth = imageSize(texture, desiredMip) - currentSize;
+		evictMips(committed, config.residencyBudget > growth ? config.residencyBudget - growth : 0, t, frame);
+
+		// If there's still not enough space, settle for a coarser level
+		while (desiredMip < texture.residentMip && desiredMip < texture.tailMip &&
+			committed + imageSize(texture, desiredMip) - currentSize > config.residencyBudget)
+		{
+			desiredMip++;
+		}
+
+		if (desiredMip >= texture.residentMip)
+		{
+			continue;
+		}
+
+		committed += imageSize(texture, desiredMip) - currentSize;
+		texture.busy = true;
+		texture.targetMip = desiredMip;
+
+		Job job = {};
+		job.type = JobType::BuildMip;
+		job.texture = t;
+		job.pixels = texture.pixels;
+		job.width = texture.width;
+		job.height = texture.height;
+		job.mip = desiredMip;
+		pushJob(job);
+	}
+
+	statistics.committedBytes = committed;
+}
+
+/****************************************************************************
+ * Drops the finest levels of the least recently used textures until the committed size is within the limit.
+ * Only textures last used before the given frame are candidates, busy ones and the one being scheduled are left alone.
+ */
+void TextureStreamer::evictMips(VkDeviceSize& committed, VkDeviceSize limit, TextureHandle keep, uint64_t usedBefore)
+{
+	if (committed <= limit)
+	{
+		return;
+	}
+
+	std::vector<TextureHandle>& candidates = evictionCandidates;
+	candidates.clear();
+	for (TextureHandle c = 0; c < textures.size(); c++)
+	{
+		const Texture& candidate = textures[c];
+		if (c != keep && !candidate.busy && candidate.residentMip < candidate.tailMip && candidate.lastUsedFrame < usedBefore)
+		{
+			candidates.push_back(c);
+		}
+	}
+
+	std::sort(candidates.begin(), candidates.end(), [this](TextureHandle a, TextureHandle b)
+		{
+			return textures[a].lastUsedFrame < textures[b].lastUsedFrame;
+		});
+
+	for (TextureHandle c : candidates)
+	{
+		if (committed <= limit)
+		{
+			break;
+		}
+
+		Texture& victim = textures[c];
+		uint32_t victimMip = victim.residentMip;
+		while (victimMip < victim.tailMip && committed > limit)
+		{
+			committed -= imageSize(victim, victimMip) - imageSize(victim, victimMip + 1);
+			victimMip++;
+			statistics.evictedMips++;
+		}
+
+		// The coarser image is rebuilt from the CPU source, the current one stays in use until it's replaced
+		victim.busy = true;
+		victim.targetMip = victimMip;
+
+		Job job = {};
+		job.type = JobType::BuildMip;
+		job.texture = c;
+		job.pixels = victim.pixels;
+		job.width = victim.width;
+		job.height = victim.height;
+		job.mip = victimMip;
+		pushJob(job);
+	}
+}
+
+/****************************************************************************
+ * Copies the level into the staging ring and records the upload into a new image holding the levels from
+ * the uploaded one down to 1x1. The rest of the chain is generated with blits, each level from the previous one.
+ */
+bool TextureStreamer::recordUpload(Batch& batch, const JobResult& result)
+{
+	const Texture& texture = textures[result.texture];
+	VkDeviceSize dataSize = static_cast<VkDeviceSize>(result.width) * result.height * 4;
+
+	VkDeviceSize stagingOffset;
+	if (!allocateStaging(dataSize, stagingOffset))
+	{
+		statistics.stagingStalls++;
+		return false;
+	}
+
+	memcpy(stagingData + stagingOffset, result.pixels->data(), static_cast<size_t>(dataSize));
+
+	Upload upload = {};
+	upload.texture = result.texture;
+	upload.mip = result.mip;
+	uint32_t levels = texture.mipLevels - result.mip;
+
+	VkImageCreateInfo imageInfo = {};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.extent.width = result.width;
+	imageInfo.extent.height = result.height;
+	imageInfo.extent.depth = 1;
+	imageInfo.mipLevels = levels;
+	imageInfo.arrayLayers = 1;
+	imageInfo.format = textureFormat;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	if (vkCreateImage(device, &imageInfo, allocator, &upload.image) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create texture image!");
+	}
+
+	VkMemoryRequirements memRequirements;
+	vkGetImageMemoryRequirements(device, upload.image, &memRequirements);
+
+	VkMemoryAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = memRequirements.size;
+	allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	if (vkAllocateMemory(device, &allocInfo, allocator, &upload.memory) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to allocate texture image memory!");
+	}
+
+	vkBindImageMemory(device, upload.image, upload.memory, 0);
+	upload.memorySize = memRequirements.size;
+
+	VkImageViewCreateInfo viewInfo = {};
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.image = upload.image;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.format = textureFormat;
+	viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	viewInfo.subresourceRange.baseMipLevel = 0;
+	viewInfo.subresourceRange.levelCount = levels;
+	viewInfo.subresourceRange.baseArrayLayer = 0;
+	viewInfo.subresourceRange.layerCount = 1;
+
+	if (vkCreateImageView(device, &viewInfo, allocator, &upload.view) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create texture image view!");
+	}
+
+	VkCommandBuffer commandBuffer = batch.commandBuffer;
+
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = upload.image;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+
+	// Every level starts as a transfer destination
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = levels;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+		0, nullptr, 0, nullptr, 1, &barrier);
+
+	VkBufferImageCopy region = {};
+	region.bufferOffset = stagingOffset;
+	region.bufferRowLength = 0; // Tightly packed
+	region.bufferImageHeight = 0;
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = 1;
+	region.imageOffset = { 0, 0, 0 };
+	region.imageExtent = { result.width, result.height, 1 };
+
+	vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, upload.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+	barrier.subresourceRange.levelCount = 1;
+	int32_t mipWidth = static_cast<int32_t>(result.width);
+	int32_t mipHeight = static_cast<int32_t>(result.height);
+
+	for (uint32_t level = 1; level < levels; level++)
+	{
+		// The previous level is complete, turn it into the blit source
+		barrier.subresourceRange.baseMipLevel = level - 1;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+			0, nullptr, 0, nullptr, 1, &barrier);
+
+		VkImageBlit blit = {};
+		blit.srcOffsets[0] = { 0, 0, 0 };
+		blit.srcOffsets[1] = { mipWidth, mipHeight, 1 };
+		blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		blit.srcSubresource.mipLevel = level - 1;
+		blit.srcSubresource.baseArrayLayer = 0;
+		blit.srcSubresource.layerCount = 1;
+		blit.dstOffsets[0] = { 0, 0, 0 };
+		blit.dstOffsets[1] = { mipWidth > 1 ? mipWidth / 2 : 1, mipHeight > 1 ? mipHeight / 2 : 1, 1 };
+		blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		blit.dstSubresource.mipLevel = level;
+		blit.dstSubresource.baseArrayLayer = 0;
+		blit.dstSubresource.layerCount = 1;
+
+		vkCmdBlitImage(commandBuffer, upload.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, upload.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			1, &blit, VK_FILTER_LINEAR);
+
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+			0, nullptr, 0, nullptr, 1, &barrier);
+
+		mipWidth = mipWidth > 1 ? mipWidth / 2 : 1;
+		mipHeight = mipHeight > 1 ? mipHeight / 2 : 1;
+	}
+
+	// The last level was only ever written to
+	barrier.subresourceRange.baseMipLevel = levels - 1;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+		0, nullptr, 0, nullptr, 1, &barrier);
+
+	batch.uploads.push_back(upload);
+	statistics.residentBytes += upload.memorySize;
+	statistics.uploadedBytes += dataSize;
+
+	return true;
+}
+
+/****************************************************************************
+ * Ring allocation. Free space is [head, end) + [0, tail) when the head is ahead of the tail,
+ * and [head, tail) after the head has wrapped around.
+ */
+bool TextureStreamer::allocateStaging(VkDeviceSize size, VkDeviceSize& offset)
+{
+	VkDeviceSize alignedHead = (stagingHead + stagingAlignment - 1) & ~(stagingAlignment - 1);
+
+	if (stagingTail <= stagingHead)
+	{
+		if (alignedHead + size <= config.stagingSize)
+		{
+			offset = alignedHead;
+			stagingHead = alignedHead + size;
+			return true;
+		}
+
+		// Wrap around, the head must never catch up with the tail
+		if (size < stagingTail)
+		{
+			offset = 0;
+			stagingHead = size;
+			return true;
+		}
+
+		return false;
+	}
+
+	if (alignedHead + size < stagingTail)
+	{
+		offset = alignedHead;
+		stagingHead = alignedHead + size;
+		return true;
+	}
+
+	return false;
+}
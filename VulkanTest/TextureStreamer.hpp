@@ -0,0 +1,207 @@
+#ifndef TEXTURE_STREAMER
+#define TEXTURE_STREAMER
+
+#include "VulkanDispatch.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "DeletionQueue.hpp"
+#include "JobSystem.hpp"
+#include "QueueTimeline.hpp"
+#include "RingQueue.hpp"
+#include "SubmitBatcher.hpp"
+
+/****************************************************************************************************
+ * Asynchronous texture streaming.
+ * - Jobs decode the image files and build the CPU source for the requested mip level, either on the job system
+ *   or on the streamer's own worker threads.
+ * - Pixels go through a persistently mapped staging ring buffer, so uploads never allocate staging memory.
+ * - The mip chain below the uploaded level is generated on the GPU with vkCmdBlitImage.
+ * - Textures become resident coarse to fine: the small mip tail first, finer levels when they're requested.
+ *   When the residency budget would be exceeded, the least recently used textures drop their finest levels.
+ *
+ * update() is meant to be called once per frame from the render thread and never waits for the GPU or the workers:
+ * anything that isn't ready yet (decoding, ring space, uploads in flight) is simply retried on the next frame.
+ * The upload commands are added to the submit batcher and go to the GPU with the frame's own submission.
+ */
+class TextureStreamer
+{
+public:
+	typedef uint32_t TextureHandle;
+
+	struct Config
+	{
+		uint32_t workerCount = 2; // Own decoding threads, only used without a job system
+		VkDeviceSize stagingSize = 32 * 1024 * 1024; // Also bounds the size of the finest level streamed in
+		VkDeviceSize residencyBudget = 256 * 1024 * 1024; // Device memory the texture images may take in total
+		uint32_t tailSize = 64; // Largest dimension of the mip level uploaded first
+	};
+
+	struct Statistics
+	{
+		VkDeviceSize residentBytes = 0; // Replaced images stop counting once they're handed to the deletion queue
+		VkDeviceSize committedBytes = 0; // What the textures take once all the scheduled uploads finish
+		VkDeviceSize uploadedBytes = 0;
+		uint32_t uploadsInFlight = 0;
+		uint32_t evictedMips = 0;
+		uint32_t stagingStalls = 0; // Uploads postponed because the staging ring was full
+	};
+
+	// Replaced images go to the deletion queue, tagged with the frame passed to update().
+	// The job system is optional, without it the streamer starts its own worker threads.
+	void init(VkDevice device, const VkAllocationCallbacks* allocator, VkPhysicalDevice physicalDevice, SubmitBatcher& batcher, uint32_t queueFamilyIndex,
+		DeletionQueue& deletionQueue, JobSystem* jobSystem, const Config& config);
+	void destroy();
+
+	// Starts decoding the file on a worker thread, the texture gets a valid view once its mip tail is uploaded
+	TextureHandle load(const std::string& path);
+	// Marks the texture as used in this frame and asks for its mip levels down to finestMip to be made resident
+	void requestMip(TextureHandle texture, uint32_t finestMip, uint64_t frame);
+	void update(uint64_t frame);
+	// Takes effect on the next update(), which drops levels if the textures already take more
+	void setResidencyBudget(VkDeviceSize budget) { config.residencyBudget = budget; }
+	VkDeviceSize getResidencyBudget() const { return config.residencyBudget; }
+
+	VkImageView getView(TextureHandle texture) const; // VK_NULL_HANDLE until the texture is resident
+	uint32_t getResidentMip(TextureHandle texture) const; // Finest resident level in the full mip chain numbering
+	const Statistics& getStatistics() const { return statistics; }
+
+	// Decodes uncompressed TGA and binary PPM files into RGBA8 pixels
+	static bool decodeImage(const std::string& path, std::vector<uint8_t>& pixels, uint32_t& width, uint32_t& height);
+
+private:
+	struct Texture
+	{
+		std::string path;
+		bool decoded = false;
+		bool failed = false;
+
+		std::shared_ptr<const std::vector<uint8_t>> pixels; // Level 0 in RGBA8, shared with the workers
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t mipLevels = 0;
+		uint32_t tailMip = 0;
+
+		VkImage image = VK_NULL_HANDLE; // Holds the levels from residentMip to the end of the chain
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkImageView view = VK_NULL_HANDLE;
+		VkDeviceSize memorySize = 0;
+		uint32_t residentMip = UINT32_MAX;
+
+		uint32_t requestedMip = UINT32_MAX;
+		uint32_t targetMip = UINT32_MAX; // Level the pending upload will make resident
+		bool busy = false; // A mip job or an upload is in progress
+		uint64_t lastUsedFrame = 0;
+	};
+
+	enum class JobType
+	{
+		Decode,
+		BuildMip
+	};
+
+	struct Job
+	{
+		JobType type;
+		TextureHandle texture;
+		std::string path;
+		std::shared_ptr<const std::vector<uint8_t>> pixels;
+		uint32_t width;
+		uint32_t height;
+		uint32_t mip;
+	};
+
+	struct JobResult
+	{
+		JobType type;
+		TextureHandle texture;
+		bool success;
+		std::shared_ptr<const std::vector<uint8_t>> pixels;
+		uint32_t width;
+		uint32_t height;
+		uint32_t mip;
+	};
+
+	struct Upload
+	{
+		TextureHandle texture;
+		uint32_t mip;
+		VkImage image;
+		VkDeviceMemory memory;
+		VkImageView view;
+		VkDeviceSize memorySize;
+	};
+
+	struct Batch
+	{
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		uint64_t timelineValue = 0; // Signaled when the upload has finished
+		bool inFlight = false;
+		VkDeviceSize stagingEnd = 0; // Ring offset released when the batch completes
+		std::vector<Upload> uploads;
+	};
+
+	void workerLoop();
+	void runQueuedJob(); // One queued job, as a job system job
+	void processJob(const Job& job);
+	void pushJob(const Job& job);
+	static std::vector<uint8_t> buildMip(const std::vector<uint8_t>& pixels, uint32_t width, uint32_t height, uint32_t mip);
+
+	static uint32_t mipSize(uint32_t size, uint32_t mip) { return size >> mip > 0 ? size >> mip : 1; }
+	VkDeviceSize imageSize(const Texture& texture, uint32_t baseMip) const;
+	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+
+	bool allocateStaging(VkDeviceSize size, VkDeviceSize& offset);
+	void completeBatches(uint64_t frame);
+	void collectResults();
+	void scheduleMips(uint64_t frame);
+	void evictMips(VkDeviceSize& committed, VkDeviceSize limit, TextureHandle keep, uint64_t usedBefore);
+	bool recordUpload(Batch& batch, const JobResult& result);
+	void retireImage(VkImage image, VkDeviceMemory memory, VkImageView view, VkDeviceSize memorySize, uint64_t frame);
+
+	VkDevice device = VK_NULL_HANDLE;
+	const VkAllocationCallbacks* allocator = nullptr;
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	SubmitBatcher* batcher = nullptr; // Uploads are submitted through it
+	QueueTimeline* timeline = nullptr; // The batcher's
+	DeletionQueue* deletionQueue = nullptr;
+	JobSystem* jobSystem = nullptr;
+	Config config;
+
+	VkCommandPool commandPool = VK_NULL_HANDLE;
+	std::vector<Batch> batches;
+
+	// Staging ring - head is where the next allocation goes, tail is the oldest byte still used by the GPU
+	VkBuffer stagingBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory stagingMemory = VK_NULL_HANDLE;
+	uint8_t* stagingData = nullptr;
+	VkDeviceSize stagingHead = 0;
+	VkDeviceSize stagingTail = 0;
+	RingQueue<size_t> submittedBatches; // Oldest first
+
+	std::vector<Texture> textures;
+	std::vector<TextureHandle> evictionCandidates; // Scratch, kept to avoid allocating every frame
+	std::deque<JobResult> pendingUploads;
+
+	std::vector<std::thread> workers;
+	std::mutex jobMutex;
+	std::condition_variable jobCondition;
+	std::deque<Job> jobs;
+	bool stopWorkers = false;
+	std::atomic<uint32_t> scheduledJobs{ 0 }; // Job system jobs that haven't finished yet
+
+	std::mutex resultMutex;
+	std::vector<JobResult> results;
+
+	Statistics statistics;
+};
+
+#endif
@@ -0,0 +1,316 @@
+#include "TransformSystem.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TRANSFORM_SYSTEM_SSE
+#include <emmintrin.h>
+#endif
+
+// Transforms per job, small enough to spread a level over the workers, large enough to hide the job overhead
+static const uint32_t transformBatchSize = 2048;
+
+void TransformSystem::reserve(uint32_t count)
+{
+	positions.reserve(count);
+	rotations.reserve(count);
+	scales.reserve(count);
+	parents.reserve(count);
+	levels.reserve(count);
+	worldMatrices.reserve(count);
+	handleToIndex.reserve(count);
+	indexToHandle.reserve(count);
+}
+
+/****************************************************************************
+ * Appending keeps the breadth-first order as long as the new transform is at least as deep as the last one,
+ * which is the case when a hierarchy is built level by level. Anything else is sorted out by the next update.
+ */
+TransformSystem::TransformHandle TransformSystem::create(TransformHandle parent, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+{
+	uint32_t parentIndex = parent == invalidHandle ? noParent : handleToIndex[parent];
+	uint32_t level = parentIndex == noParent ? 0 : levels[parentIndex] + 1;
+
+	if (!levels.empty() && (level < levels.back() || (parentIndex != noParent && parentIndex < parents.back() && parents.back() != noParent)))
+	{
+		orderDirty = true;
+	}
+
+	TransformHandle handle = static_cast<TransformHandle>(handleToIndex.size());
+	uint32_t index = static_cast<uint32_t>(positions.size());
+
+	positions.push_back(position);
+	rotations.push_back(rotation);
+	scales.push_back(scale);
+	parents.push_back(parentIndex);
+	levels.push_back(level);
+	worldMatrices.push_back(glm::mat4(1.0f));
+	handleToIndex.push_back(index);
+	indexToHandle.push_back(handle);
+
+	if (!orderDirty)
+	{
+		if (levelOffsets.empty())
+		{
+			levelOffsets = { 0, 1 };
+		}
+		else if (level + 2 > levelOffsets.size())
+		{
+			levelOffsets.push_back(index + 1); // The old end marker becomes the start of the new level
+		}
+		else
+		{
+			levelOffsets.back() = index + 1;
+		}
+	}
+
+	return handle;
+}
+
+/****************************************************************************
+ * Breadth-first walk from the roots, which also puts the children of one parent next to each other
+ */
+void TransformSystem::rebuildOrder()
+{
+	uint32_t count = getCount();
+
+	// Children lists in one array, counting sort by parent
+	std::vector<uint32_t> childOffsets(count + 1, 0);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (parents[i] != noParent)
+		{
+			childOffsets[parents[i] + 1]++;
+		}
+	}
+	for (uint32_t i = 0; i < count; i++)
+	{
+		childOffsets[i + 1] += childOffsets[i];
+	}
+
+	std::vector<uint32_t> children(childOffsets[count]);
+	std::vector<uint32_t> fill(childOffsets.begin(), childOffsets.end() - 1);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (parents[i] != noParent)
+		{
+			children[fill[parents[i]]++] = i;
+		}
+	}
+
+	std::vector<uint32_t> order;
+	order.reserve(count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (parents[i] == noParent)
+		{
+			order.push_back(i);
+		}
+	}
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		uint32_t node = order[i];
+		order.insert(order.end(), children.begin() + childOffsets[node], children.begin() + childOffsets[node + 1]);
+	}
+
+	std::vector<uint32_t> newIndex(count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		newIndex[order[i]] = i;
+	}
+
+	auto permute = [&order](auto& values)
+	{
+		auto source = values;
+		for (size_t i = 0; i < order.size(); i++)
+		{
+			values[i] = source[order[i]];
+		}
+	};
+
+	permute(positions);
+	permute(rotations);
+	permute(scales);
+	permute(parents);
+	permute(levels);
+	permute(worldMatrices);
+	permute(indexToHandle);
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (parents[i] != noParent)
+		{
+			parents[i] = newIndex[parents[i]];
+		}
+		handleToIndex[indexToHandle[i]] = i;
+	}
+
+	levelOffsets.clear();
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (i == 0 || levels[i] != levels[i - 1])
+		{
+			levelOffsets.push_back(i);
+		}
+	}
+	levelOffsets.push_back(count);
+
+	orderDirty = false;
+}
+
+void TransformSystem::update(JobSystem& jobSystem, glm::mat4* instanceMatrices)
+{
+	if (orderDirty)
+	{
+		rebuildOrder();
+	}
+
+	// Each level only reads the world matrices of the previous one
+	for (size_t level = 0; level + 1 < levelOffsets.size(); level++)
+	{
+		uint32_t begin = levelOffsets[level];
+		uint32_t end = levelOffsets[level + 1];
+
+		jobSystem.parallelFor(end - begin, transformBatchSize, [this, begin, instanceMatrices](uint32_t first, uint32_t last)
+		{
+			composeRange(begin + first, begin + last, instanceMatrices);
+		});
+	}
+}
+
+void TransformSystem::gatherWorldMatrices(JobSystem& jobSystem, const uint32_t* indices, uint32_t count, glm::mat4* output) const
+{
+	gatherMatrices(jobSystem, worldMatrices.data(), indices, count, output);
+}
+
+void TransformSystem::gatherMatrices(JobSystem& jobSystem, const glm::mat4* matrices, const uint32_t* indices, uint32_t count, glm::mat4* output)
+{
+	jobSystem.parallelFor(count, transformBatchSize, [matrices, indices, output](uint32_t begin, uint32_t end)
+	{
+#ifdef TRANSFORM_SYSTEM_SSE
+		if ((reinterpret_cast<uintptr_t>(output) & 15) == 0)
+		{
+			for (uint32_t i = begin; i < end; i++)
+			{
+				const float* source = &matrices[indices[i]][0][0];
+				float* destination = &output[i][0][0];
+				for (int c = 0; c < 4; c++)
+				{
+					_mm_stream_ps(destination + c * 4, _mm_loadu_ps(source + c * 4));
+				}
+			}
+			_mm_sfence();
+			return;
+		}
+#endif
+		for (uint32_t i = begin; i < end; i++)
+		{
+			output[i] = matrices[indices[i]];
+		}
+	});
+}
+
+/****************************************************************************
+ * Local matrix straight from the quaternion, scale and translation, then world = parent world * local.
+ * The local matrix has (0, 0, 0, 1) as its last row, so the product needs only 3 multiply-adds per column
+ * plus the parent translation.
+ */
+void TransformSystem::composeRange(uint32_t begin, uint32_t end, glm::mat4* instanceMatrices)
+{
+#ifdef TRANSFORM_SYSTEM_SSE
+	bool streamOutput = instanceMatrices != nullptr && (reinterpret_cast<uintptr_t>(instanceMatrices) & 15) == 0;
+#endif
+
+	for (uint32_t i = begin; i < end; i++)
+	{
+		const glm::quat& q = rotations[i];
+		const glm::vec3& s = scales[i];
+		const glm::vec3& t = positions[i];
+
+		float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+		float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+		float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+
+		float local[3][4] = {
+			{ (1.0f - 2.0f * (yy + zz)) * s.x, 2.0f * (xy + wz) * s.x, 2.0f * (xz - wy) * s.x, 0.0f },
+			{ 2.0f * (xy - wz) * s.y, (1.0f - 2.0f * (xx + zz)) * s.y, 2.0f * (yz + wx) * s.y, 0.0f },
+			{ 2.0f * (xz + wy) * s.z, 2.0f * (yz - wx) * s.z, (1.0f - 2.0f * (xx + yy)) * s.z, 0.0f }
+		};
+
+		float* world = &worldMatrices[i][0][0];
+
+#ifdef TRANSFORM_SYSTEM_SSE
+		__m128 column[4];
+
+		if (parents[i] == noParent)
+		{
+			column[0] = _mm_loadu_ps(local[0]);
+			column[1] = _mm_loadu_ps(local[1]);
+			column[2] = _mm_loadu_ps(local[2]);
+			column[3] = _mm_setr_ps(t.x, t.y, t.z, 1.0f);
+		}
+		else
+		{
+			const float* parent = &worldMatrices[parents[i]][0][0];
+			__m128 p0 = _mm_loadu_ps(parent);
+			__m128 p1 = _mm_loadu_ps(parent + 4);
+			__m128 p2 = _mm_loadu_ps(parent + 8);
+			__m128 p3 = _mm_loadu_ps(parent + 12);
+
+			for (int c = 0; c < 3; c++)
+			{
+				column[c] = _mm_add_ps(_mm_add_ps(
+					_mm_mul_ps(p0, _mm_set1_ps(local[c][0])),
+					_mm_mul_ps(p1, _mm_set1_ps(local[c][1]))),
+					_mm_mul_ps(p2, _mm_set1_ps(local[c][2])));
+			}
+			column[3] = _mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(p0, _mm_set1_ps(t.x)),
+				_mm_mul_ps(p1, _mm_set1_ps(t.y))),
+				_mm_add_ps(_mm_mul_ps(p2, _mm_set1_ps(t.z)), p3));
+		}
+
+		for (int c = 0; c < 4; c++)
+		{
+			_mm_storeu_ps(world + c * 4, column[c]);
+		}
+
+		if (instanceMatrices != nullptr)
+		{
+			// Mapped GPU memory is usually write-combined, streaming stores skip the cache entirely
+			float* instance = &instanceMatrices[i][0][0];
+			for (int c = 0; c < 4; c++)
+			{
+				if (streamOutput)
+				{
+					_mm_stream_ps(instance + c * 4, column[c]);
+				}
+				else
+				{
+					_mm_storeu_ps(instance + c * 4, column[c]);
+				}
+			}
+		}
+#else
+		glm::mat4 localMatrix(1.0f);
+		for (int c = 0; c < 3; c++)
+		{
+			localMatrix[c] = glm::vec4(local[c][0], local[c][1], local[c][2], 0.0f);
+		}
+		localMatrix[3] = glm::vec4(t, 1.0f);
+
+		worldMatrices[i] = parents[i] == noParent ? localMatrix : worldMatrices[parents[i]] * localMatrix;
+
+		if (instanceMatrices != nullptr)
+		{
+			instanceMatrices[i] = worldMatrices[i];
+		}
+		(void)world;
+#endif
+	}
+
+#ifdef TRANSFORM_SYSTEM_SSE
+	if (streamOutput)
+	{
+		_mm_sfence(); // Streaming stores are weakly ordered, make them visible before the job counts as finished
+	}
+#endif
+}
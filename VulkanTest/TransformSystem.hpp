@@ -0,0 +1,76 @@
+#ifndef TRANSFORM_SYSTEM
+#define TRANSFORM_SYSTEM
+
+#include <cstdint>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "JobSystem.hpp"
+
+/****************************************************************************************************
+ * Scene transform hierarchy in structure-of-arrays layout.
+ * - Positions, rotations, scales, parents and world matrices each live in their own tightly packed array,
+ *   so an update streams through exactly the data it needs.
+ * - The arrays are kept in breadth-first order with siblings next to each other: every parent comes before its
+ *   children, so one pass per hierarchy level computes all the world matrices, and the levels run in parallel.
+ * - The matrix composition uses SSE, and the results can be streamed straight into a mapped instance buffer.
+ *
+ * Handles stay valid forever, dense indices (which are also the instance indices) change when creating a transform
+ * breaks the breadth-first order. update() restores it.
+ */
+class TransformSystem
+{
+public:
+	typedef uint32_t TransformHandle;
+	static const TransformHandle invalidHandle = ~0u;
+
+	void reserve(uint32_t count);
+	TransformHandle create(TransformHandle parent = invalidHandle, const glm::vec3& position = glm::vec3(0.0f),
+		const glm::quat& rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f), const glm::vec3& scale = glm::vec3(1.0f));
+
+	void setPosition(TransformHandle transform, const glm::vec3& position) { positions[handleToIndex[transform]] = position; }
+	void setRotation(TransformHandle transform, const glm::quat& rotation) { rotations[handleToIndex[transform]] = rotation; }
+	void setScale(TransformHandle transform, const glm::vec3& scale) { scales[handleToIndex[transform]] = scale; }
+	const glm::mat4& getWorldMatrix(TransformHandle transform) const { return worldMatrices[handleToIndex[transform]]; }
+
+	// Direct access to the dense arrays, for animating many transforms at once
+	uint32_t getCount() const { return static_cast<uint32_t>(positions.size()); }
+	uint32_t getIndex(TransformHandle transform) const { return handleToIndex[transform]; }
+	TransformHandle getHandle(uint32_t index) const { return indexToHandle[index]; }
+	glm::vec3* getPositions() { return positions.data(); }
+	glm::quat* getRotations() { return rotations.data(); }
+	glm::vec3* getScales() { return scales.data(); }
+	const glm::mat4* getWorldMatrices() const { return worldMatrices.data(); }
+
+	// Recomputes every world matrix. If instanceMatrices is given (e.g. a mapped instance buffer with getCount() entries)
+	// the matrices are also written there in dense order, with non-temporal stores since it's never read back.
+	void update(JobSystem& jobSystem, glm::mat4* instanceMatrices = nullptr);
+	// Copies the world matrices at the given dense indices in that order, e.g. only the visible ones into an instance buffer
+	void gatherWorldMatrices(JobSystem& jobSystem, const uint32_t* indices, uint32_t count, glm::mat4* output) const;
+	// The same from a copy of the world matrices, e.g. one written by update() on another thread
+	static void gatherMatrices(JobSystem& jobSystem, const glm::mat4* matrices, const uint32_t* indices, uint32_t count, glm::mat4* output);
+
+private:
+	static const uint32_t noParent = ~0u;
+
+	void rebuildOrder();
+	void composeRange(uint32_t begin, uint32_t end, glm::mat4* instanceMatrices);
+
+	// Dense arrays in breadth-first order
+	std::vector<glm::vec3> positions;
+	std::vector<glm::quat> rotations;
+	std::vector<glm::vec3> scales;
+	std::vector<uint32_t> parents; // Dense index of the parent or noParent
+	std::vector<uint32_t> levels;
+	std::vector<glm::mat4> worldMatrices;
+
+	std::vector<uint32_t> levelOffsets; // First dense index of every level, plus the total count at the end
+	std::vector<uint32_t> handleToIndex;
+	std::vector<uint32_t> indexToHandle;
+	bool orderDirty = false;
+};
+
+#endif
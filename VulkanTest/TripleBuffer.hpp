@@ -0,0 +1,55 @@
+#ifndef TRIPLE_BUFFER
+#define TRIPLE_BUFFER
+
+#include <atomic>
+#include <cstdint>
+
+/****************************************************************************************************
+ * Lock-free handoff of the latest value from one producer thread to one consumer thread.
+ * - The producer always has a slot of its own to write, the consumer a slot of its own to read, and the third
+ *   slot holds the newest published value. Publishing and taking swap a private slot with that middle one
+ *   in a single atomic exchange, so neither side ever waits for the other.
+ * - The consumer always gets the newest value: values published while it was busy are overwritten, not queued.
+ *   If nothing new was published, it keeps reading the one it has.
+ *
+ * The slots are default constructed and reused, so a value that owns memory (e.g. a vector sized once through
+ * getSlot()) never allocates after setup.
+ */
+template <typename T>
+class TripleBuffer
+{
+public:
+	// Producer: the slot to fill, then publish() hands it over
+	T& getWriteBuffer() { return slots[back]; }
+	void publish()
+	{
+		back = middle.exchange(back | freshBit, std::memory_order_acq_rel) & indexMask;
+	}
+
+	// Consumer: takes the newest published value if there is one, returns whether it did
+	bool acquire()
+	{
+		if ((middle.load(std::memory_order_relaxed) & freshBit) == 0)
+		{
+			return false;
+		}
+
+		front = middle.exchange(front, std::memory_order_acq_rel) & indexMask;
+		return true;
+	}
+	const T& getReadBuffer() const { return slots[front]; }
+
+	// Any of the three, only while neither thread is using them
+	T& getSlot(uint32_t index) { return slots[index]; }
+
+private:
+	static const uint32_t indexMask = 3;
+	static const uint32_t freshBit = 4; // The middle slot holds a value the consumer hasn't taken yet
+
+	T slots[3];
+	uint32_t back = 0; // Producer only
+	alignas(64) std::atomic<uint32_t> middle{ 1 };
+	alignas(64) uint32_t front = 2; // Consumer only
+};
+
+#endif
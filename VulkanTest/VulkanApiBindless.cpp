@@ -0,0 +1,87 @@
+#include "VulkanApiImplementation.hpp"
+
+/****************************************************************************
+ * One bindless set per swap chain image. Every streamed texture gets its slot up front, pointing at a white
+ * fallback until the texture is resident, so the slot numbers can go into the recorded push constants and the
+ * streamer's view changes never require re-recording.
+ */
+void VulkanApi::createBindlessTable()
+{
+	if (!bindlessActive)
+	{
+		return;
+	}
+
+	BindlessTable::Config config;
+	bindlessTable.init(device, allocator, physicalDevice, static_cast<uint32_t>(swapChainImages.size()), config);
+
+	// 1x1 white, cleared rather than uploaded
+	createImage(1, 1, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, fallbackTexture, fallbackTextureMemory);
+
+	VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = fallbackTexture;
+	barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	VkClearColorValue white = { { 1.0f, 1.0f, 1.0f, 1.0f } };
+	vkCmdClearColorImage(commandBuffer, fallbackTexture, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &white, 1, &barrier.subresourceRange);
+
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	endSingleTimeCommands(commandBuffer);
+
+	fallbackTextureView = createImageView(fallbackTexture, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT);
+	BindlessTable::Slot fallbackSlot = bindlessTable.addImage(fallbackTextureView);
+
+	textureSlots.resize(textures.size());
+	textureSlotViews.assign(textures.size(), VK_NULL_HANDLE);
+	for (size_t i = 0; i < textures.size(); i++)
+	{
+		textureSlots[i] = bindlessTable.addImage(fallbackTextureView);
+	}
+
+	// The mesh has no texture coordinates its instances could share, so the first texture is projected from above
+	meshConstants.textureSlot = textureSlots.empty() ? fallbackSlot : textureSlots[0];
+	meshConstants.textureScale = meshLoaded ? 0.5f / meshHeader.bounds.radius : 1.0f;
+
+	std::cout << "Bindless table: " << bindlessTable.getStatistics().imageSlots << " image slots in use\n";
+}
+
+/****************************************************************************
+ * Points the slots at the streamer's current views and writes the changes into this image's set.
+ * The views the streamer replaces stay alive until their last frame has finished, and until then
+ * the other images' sets still get their own update before they're used again.
+ */
+void VulkanApi::updateBindlessTable(uint32_t imageIndex)
+{
+	if (!bindlessActive)
+	{
+		return;
+	}
+
+	for (size_t i = 0; i < textures.size(); i++)
+	{
+		VkImageView view = textureStreamer.getView(textures[i]);
+		if (view != textureSlotViews[i])
+		{
+			bindlessTable.setImage(textureSlots[i], view != VK_NULL_HANDLE ? view : fallbackTextureView);
+			textureSlotViews[i] = view;
+		}
+	}
+
+	bindlessTable.update(imageIndex, deletionQueue);
+}
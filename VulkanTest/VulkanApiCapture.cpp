@@ -0,0 +1,29 @@
+#include "VulkanApiImplementation.hpp"
+
+/****************************************************************************
+ * Starts the frame capture if it's enabled and the swap chain images could be created as transfer sources.
+ * The copies are recorded for the graphics queue, right behind the frame's own commands.
+ */
+void VulkanApi::createFrameCapture()
+{
+	if (!enableFrameCapture)
+	{
+		return;
+	}
+
+	VkSurfaceCapabilitiesKHR capabilities;
+	vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface, &capabilities);
+
+	if (!(capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT))
+	{
+		std::cout << "Swap chain images can't be copied from, frame capture disabled.\n";
+		return;
+	}
+
+	QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+
+	FrameCapture::Config config;
+	config.format = frameCaptureFormat;
+	frameCapture.init(device, allocator, physicalDevice, indices.graphicsFamily.value(), swapChainExtent, swapChainImageFormat, config);
+	frameCaptureActive = true;
+}
@@ -0,0 +1,136 @@
+#include "VulkanApiImplementation.hpp"
+
+/****************************************************************************
+ * A bucket per group of draws that change together: the depth pre-pass meshes, the main pass meshes and the
+ * particles. A variant per swap chain image, like the primary command buffers executing them.
+ */
+void VulkanApi::createCommandCache()
+{
+	if (!enableCommandCache)
+	{
+		return;
+	}
+
+	QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+	commandCache.init(device, allocator, indices.graphicsFamily.value(), static_cast<uint32_t>(swapChainImages.size()));
+
+	if (enableDepthPrePass)
+	{
+		depthPrePassBucket = commandCache.addBucket("Depth pre-pass meshes");
+	}
+	meshBucket = commandCache.addBucket("Meshes");
+	if (enableParticles)
+	{
+		particleBucket = commandCache.addBucket("Particles");
+	}
+}
+
+// Primary command buffers are reused, so this one's last frame has finished - drawFrame() waited for it
+void VulkanApi::recordFrame(uint32_t imageIndex)
+{
+	auto recordStart = std::chrono::steady_clock::now();
+
+	vkResetCommandPool(device, recordingCommandPools[imageIndex], 0);
+	if (recordCommandBuffer(imageIndex) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to record command buffer!");
+	}
+
+	commandRecordTimeTotal += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - recordStart).count();
+	recordedFrameCount++;
+}
+
+VkCommandBufferInheritanceInfo VulkanApi::getPassInheritance(RenderGraph::PassHandle pass, uint32_t imageIndex)
+{
+	VkCommandBufferInheritanceInfo inheritance = {};
+	inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritance.renderPass = renderGraph.getRenderPass(pass);
+	inheritance.subpass = renderGraph.getSubpassIndex(pass);
+	inheritance.framebuffer = renderGraph.getFramebuffer(pass, imageIndex);
+	return inheritance;
+}
+
+/****************************************************************************
+ * Everything recordMeshDraw() and the viewport read. The instance and indirect buffers are filled every frame,
+ * but only their handles are recorded.
+ */
+uint64_t VulkanApi::getMeshDrawKey(uint32_t imageIndex, VkPipeline pipeline)
+{
+	uint64_t key = CommandCache::hash(imageRenderExtents[imageIndex]);
+	key = CommandCache::hash(pipeline, key);
+	key = CommandCache::hash(pipelineLayout, key);
+	key = CommandCache::hash(meshConstants, key);
+
+	if (meshLoaded)
+	{
+		key = CommandCache::hash(vertexBuffer, key);
+		key = CommandCache::hash(indexBuffer, key);
+		key = CommandCache::hash(instanceBuffers[imageIndex], key);
+		key = CommandCache::hash(indirectBuffers[imageIndex], key);
+		key = CommandCache::hash(meshHeader.lodCount, key);
+		key = CommandCache::hash(transformSystem.getCount(), key);
+	}
+	if (bindlessActive)
+	{
+		key = CommandCache::hash(bindlessTable.getSet(imageIndex), key);
+	}
+	return key;
+}
+
+void VulkanApi::executeCachedDepthPrePass(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+	VkCommandBuffer meshes = commandCache.get(depthPrePassBucket, imageIndex, getMeshDrawKey(imageIndex, depthPrePassPipeline),
+		getPassInheritance(depthPrePass, imageIndex), [this, imageIndex](VkCommandBuffer secondary)
+		{
+			recordDepthPrePass(secondary, imageIndex);
+		});
+
+	vkCmdExecuteCommands(commandBuffer, 1, &meshes);
+}
+
+// The particle system's own objects never change after it's created, only its view and the viewport do
+void VulkanApi::executeCachedMainPass(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+	VkCommandBufferInheritanceInfo inheritance = getPassInheritance(mainPass, imageIndex);
+	VkCommandBuffer secondaries[2];
+	uint32_t secondaryCount = 0;
+
+	secondaries[secondaryCount++] = commandCache.get(meshBucket, imageIndex, getMeshDrawKey(imageIndex, graphicsPipeline), inheritance,
+		[this, imageIndex](VkCommandBuffer secondary)
+		{
+			recordMainMeshes(secondary, imageIndex);
+		});
+
+	if (enableParticles)
+	{
+		uint64_t particleKey = CommandCache::hash(imageRenderExtents[imageIndex]);
+		particleKey = CommandCache::hash(meshConstants.viewProjection, particleKey);
+
+		secondaries[secondaryCount++] = commandCache.get(particleBucket, imageIndex, particleKey, inheritance,
+			[this, imageIndex](VkCommandBuffer secondary)
+			{
+				recordParticleDraw(secondary, imageIndex);
+			});
+	}
+
+	vkCmdExecuteCommands(commandBuffer, secondaryCount, secondaries);
+}
+
+void VulkanApi::printCommandCache()
+{
+	if (!enableCommandCache || recordedFrameCount == 0)
+	{
+		return;
+	}
+
+	CommandCache::Statistics total = commandCache.getTotalStatistics();
+	std::cout << "Command cache: " << 100.0 * total.hits / std::max<uint64_t>(total.lookups, 1) << "% hit rate over " << total.lookups
+		<< " lookups, " << total.recordings << " secondary recordings, " << commandRecordTimeTotal / recordedFrameCount
+		<< " ms recording per frame on average\n";
+
+	for (CommandCache::BucketHandle bucket = 0; bucket < commandCache.getBucketCount(); bucket++)
+	{
+		const CommandCache::Statistics& stats = commandCache.getStatistics(bucket);
+		std::cout << "\t" << commandCache.getBucketName(bucket) << ": " << stats.hits << " hits, " << stats.recordings << " recordings\n";
+	}
+}
@@ -0,0 +1,154 @@
+#include "VulkanApiImplementation.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <random>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+/****************************************************************************
+ * Frustum culling of every instance, then occlusion culling against the nearest visible instances.
+ * The visible instances are sorted by level of detail, their world matrices packed into the level's region
+ * of this image's instance buffer and the level's indirect draw set to draw just those.
+ */
+void VulkanApi::cullScene(uint32_t imageIndex, const glm::mat4* worldMatrices)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	culling.updateSpheres(jobSystem, worldMatrices, meshHeader.bounds.radius);
+	culling.beginFrame(meshConstants.viewProjection);
+	culling.cullFrustum(jobSystem);
+
+	if (enableOcclusionCulling && !occluderIndices.empty())
+	{
+		// Clip space w is the distance along the view direction, the nearest instances hide the most
+		const glm::mat4& viewProjection = meshConstants.viewProjection;
+		auto viewDepth = [&viewProjection, worldMatrices](uint32_t index)
+		{
+			const glm::vec4& position = worldMatrices[index][3];
+			return viewProjection[0][3] * position.x + viewProjection[1][3] * position.y + viewProjection[2][3] * position.z + viewProjection[3][3];
+		};
+
+		const std::vector<uint32_t>& frustumVisible = culling.getVisible();
+		uint32_t candidateCount = static_cast<uint32_t>(frustumVisible.size());
+		uint32_t* candidates = frameAllocator.allocate<uint32_t>(candidateCount);
+		std::copy(frustumVisible.begin(), frustumVisible.end(), candidates);
+
+		uint32_t occluders = std::min(occluderInstanceCount, candidateCount);
+		std::partial_sort(candidates, candidates + occluders, candidates + candidateCount,
+			[&viewDepth](uint32_t a, uint32_t b) { return viewDepth(a) < viewDepth(b); });
+
+		for (uint32_t i = 0; i < occluders; i++)
+		{
+			culling.rasterizeOccluder(occluderVertices.data(), occluderIndices.data(), static_cast<uint32_t>(occluderIndices.size()),
+				worldMatrices[candidates[i]]);
+		}
+
+		culling.cullOcclusion(jobSystem);
+	}
+
+	const std::vector<uint32_t>& visible = culling.getVisible();
+	lodSelector.select(jobSystem, visible.data(), static_cast<uint32_t>(visible.size()), worldMatrices);
+
+	for (uint32_t lod = 0; lod < lodSelector.getLodCount(); lod++)
+	{
+		uint32_t count = lodSelector.getObjectCount(lod);
+		TransformSystem::gatherMatrices(jobSystem, worldMatrices, lodSelector.getObjects(lod), count, instanceData[imageIndex] + lod * transformSystem.getCount());
+		indirectCommands[imageIndex][lod].instanceCount = count;
+	}
+
+	const CullingSystem::Statistics& stats = culling.getStatistics();
+	frustumVisibleTotal += stats.frustumVisible;
+	occlusionVisibleTotal += stats.occlusionVisible;
+	submittedTrianglesTotal += lodSelector.getStatistics().submittedTriangles;
+	fullDetailTrianglesTotal += lodSelector.getStatistics().fullDetailTriangles;
+	cullingTimeTotal += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+/****************************************************************************
+ * Startup benchmark on a million random spheres seen from inside the field, with a wall of boxes in front of
+ * the camera as occluders. The SIMD frustum result is checked against a plain per-sphere test, a mismatch throws.
+ */
+void VulkanApi::runCullingBenchmark()
+{
+	const uint32_t objectCount = 1000000;
+	const uint32_t rounds = 10;
+	const float fieldSize = 2000.0f;
+
+	CullingSystem benchmark;
+	benchmark.resize(objectCount);
+
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> coordinate(-fieldSize * 0.5f, fieldSize * 0.5f);
+	std::uniform_real_distribution<float> radius(0.5f, 4.0f);
+
+	std::vector<glm::vec4> spheres(objectCount);
+	for (uint32_t i = 0; i < objectCount; i++)
+	{
+		spheres[i] = glm::vec4(coordinate(random), coordinate(random) * 0.05f, coordinate(random), radius(random));
+		benchmark.setSphere(i, glm::vec3(spheres[i].x, spheres[i].y, spheres[i].z), spheres[i].w);
+	}
+
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 10.0f, 0.0f), glm::vec3(0.0f, 10.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.5f, fieldSize);
+	projection[1][1] *= -1;
+	glm::mat4 viewProjection = projection * view;
+
+	// Unit cube, stretched into a row of walls across the view
+	const glm::vec3 boxVertices[] = {
+		{ -1.0f, -1.0f, -1.0f }, { 1.0f, -1.0f, -1.0f }, { 1.0f, 1.0f, -1.0f }, { -1.0f, 1.0f, -1.0f },
+		{ -1.0f, -1.0f, 1.0f }, { 1.0f, -1.0f, 1.0f }, { 1.0f, 1.0f, 1.0f }, { -1.0f, 1.0f, 1.0f }
+	};
+	const uint32_t boxIndices[] = {
+		0, 1, 2, 0, 2, 3, 4, 6, 5, 4, 7, 6, 0, 4, 5, 0, 5, 1, 3, 2, 6, 3, 6, 7, 0, 3, 7, 0, 7, 4, 1, 5, 6, 1, 6, 2
+	};
+	const uint32_t wallCount = 8;
+
+	double frustumTime = 0.0, rasterizeTime = 0.0, occlusionTime = 0.0;
+	for (uint32_t round = 0; round < rounds; round++)
+	{
+		benchmark.beginFrame(viewProjection);
+		benchmark.cullFrustum(jobSystem);
+
+		for (uint32_t wall = 0; wall < wallCount; wall++)
+		{
+			glm::mat4 world = glm::translate(glm::mat4(1.0f), glm::vec3((wall - (wallCount - 1) * 0.5f) * 12.0f, 10.0f, -40.0f));
+			world = glm::scale(world, glm::vec3(6.0f, 8.0f, 1.0f));
+			benchmark.rasterizeOccluder(boxVertices, boxIndices, 36, world);
+		}
+
+		benchmark.cullOcclusion(jobSystem);
+
+		const CullingSystem::Statistics& stats = benchmark.getStatistics();
+		frustumTime += stats.frustumMilliseconds;
+		rasterizeTime += stats.rasterizeMilliseconds;
+		occlusionTime += stats.occlusionMilliseconds;
+	}
+
+	// Reference frustum test, one sphere and one plane at a time
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++)
+	{
+		rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+	}
+	glm::vec4 planes[6] = { rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1], rows[3] - rows[1], rows[2], rows[3] - rows[2] };
+
+	uint32_t referenceVisible = 0;
+	for (const glm::vec4& sphere : spheres)
+	{
+		bool inside = true;
+		for (const glm::vec4& plane : planes)
+		{
+			float length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+			inside &= (plane.x * sphere.x + plane.y * sphere.y + plane.z * sphere.z + plane.w) / length + sphere.w > 0.0f;
+		}
+		referenceVisible += inside ? 1 : 0;
+	}
+
+	const CullingSystem::Statistics& stats = benchmark.getStatistics();
+	std::cout << "Culling benchmark: " << objectCount << " objects, " << jobSystem.getThreadCount() << " threads\n"
+		<< "  frustum: " << frustumTime / rounds << " ms, " << stats.frustumVisible << " visible, " << referenceVisible << " expected\n"
+		<< "  occluders: " << rasterizeTime / rounds << " ms for " << stats.occluderTriangles << " triangles\n"
+		<< "  occlusion: " << occlusionTime / rounds << " ms, " << stats.occlusionVisible << " visible\n";
+	checkBenchmarkResult("Frustum culling", stats.frustumVisible == referenceVisible);
+}
@@ -2,40 +2,90 @@
 
 void VulkanApi::drawFrame()
 {
+	// Nothing below may allocate once the warm-up is over, transient data comes from the frame allocator
+	uint64_t allocationsBefore = AllocationCounter::getThreadCount();
+	frameAllocator.reset();
+
 	uint32_t imageIndex;
 	// std::numeric_limits<uint64_t>::max() disables the image acquire timeout
 	vkAcquireNextImageKHR(device, swapChain, std::numeric_limits<uint64_t>::max(), imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
+	acquirePresentTargets();
+
+	// The per image buffers and descriptors are rewritten below, so the last frame that used them has to be done
+	graphicsTimeline.wait(imageTimelineValues[imageIndex]);
+	if (postProcessAsync)
+	{
+		computeTimeline.wait(imageComputeValues[imageIndex]);
+	}
+
+	// Everything the frame waits for is done, so the input is as fresh as it can be for it
+	sampleInput();
+
+	// Collect the statistics from the previous use of this image before its queries get reset again
+	readPipelineStatistics(imageIndex);
+	updateRenderScale(imageIndex);
+
+	// Objects replaced in frames the GPU has finished can go now
+	deletionQueue.collect();
+
+	updateScene(imageIndex);
+	updateParticles(imageIndex);
+
+	updateTextureStreaming();
+	updateBindlessTable(imageIndex);
+
+	// Mostly executing cached secondary command buffers, only the buckets whose inputs changed are recorded again
+	if (enableCommandCache)
+	{
+		recordFrame(imageIndex);
+	}
 
-	VkSubmitInfo submitInfo = {};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	// The streamer's uploads are already in the batcher and don't wait for the image, the frame's commands do -
+	// unless the post-processing on the compute queue is the only thing writing the image
+	if (postProcessAsync)
+	{
+		graphicsBatcher.add(commandBuffers[imageIndex]);
+		graphicsBatcher.signal(sceneReadySemaphore);
+	}
+	else
+	{
+		graphicsBatcher.wait(imageAvailableSemaphore, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+		graphicsBatcher.add(commandBuffers[imageIndex]);
+	}
 
-	VkSemaphore waitSemaphores[] = { imageAvailableSemaphore };
-	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-	submitInfo.waitSemaphoreCount = 1;
-	submitInfo.pWaitSemaphores = waitSemaphores;
-	submitInfo.pWaitDstStageMask = waitStages;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &commandBuffers[imageIndex];
+	// The capture copy goes right after the frame's commands, and the present then waits for it as well
+	VkFence submitFence = VK_NULL_HANDLE;
+	if (frameCaptureActive)
+	{
+		frameCapture.update();
 
-	VkSemaphore signalSemaphores[] = { renderFinishedSemaphore };
-	submitInfo.signalSemaphoreCount = 1;
-	submitInfo.pSignalSemaphores = signalSemaphores;
+		VkCommandBuffer captureCommandBuffer;
+		if (frameCapture.recordCapture(swapChainImages[imageIndex], frameNumber, captureCommandBuffer, submitFence))
+		{
+			graphicsBatcher.add(captureCommandBuffer);
+		}
+	}
+
+	// The extra targets get the finished frame copied in, in the same submission
+	submitPresentTargets(imageIndex);
 
-	if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+	if (!postProcessAsync)
 	{
-		throw std::runtime_error("Failed to submit draw command buffer!");
+		graphicsBatcher.signal(renderFinishedSemaphore);
 	}
 
-	VkPresentInfoKHR presentInfo = {};
-	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-	presentInfo.waitSemaphoreCount = 1;
-	presentInfo.pWaitSemaphores = signalSemaphores;
+	imageTimelineValues[imageIndex] = graphicsBatcher.flush(submitFence);
+	graphicsBatcher.endFrame();
+
+	// Submitted after the graphics queue, which has to signal the scene semaphore first
+	if (postProcessAsync)
+	{
+		submitPostProcess(imageIndex);
+	}
+	deletionQueue.signalFrame(frameNumber);
 
-	VkSwapchainKHR swapChains[] = { swapChain };
-	presentInfo.swapchainCount = 1;
-	presentInfo.pSwapchains = swapChains;
-	presentInfo.pImageIndices = &imageIndex;
-	presentInfo.pResults = nullptr; // Optional
+	presentFrame(imageIndex);
 
-	vkQueuePresentKHR(presentQueue, &presentInfo);
+	checkFrameAllocations(allocationsBefore);
+	frameNumber++;
 }
\ No newline at end of file
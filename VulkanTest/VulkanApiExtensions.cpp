@@ -83,5 +83,24 @@ std::vector<const char*> VulkanApi::getRequiredExtensions()
 		// This VK_EXT_DEBUG_UTILS_EXTENSION_NAME macro is equal to VK_EXT_debug_utils
 	}
 
+	// Headless present targets need it, they're left out if the instance doesn't have it
+	if (headlessTargetCount > 0)
+	{
+		uint32_t availableExtensionCount = 0;
+		vkEnumerateInstanceExtensionProperties(nullptr, &availableExtensionCount, nullptr);
+		std::vector<VkExtensionProperties> availableExtensions(availableExtensionCount);
+		vkEnumerateInstanceExtensionProperties(nullptr, &availableExtensionCount, availableExtensions.data());
+
+		for (const auto& extension : availableExtensions)
+		{
+			if (std::string(extension.extensionName) == VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME)
+			{
+				extensions.push_back(VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME);
+				headlessSurfaceExtension = true;
+				break;
+			}
+		}
+	}
+
 	return extensions;
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #ifndef VULKAN_API_IMPLEMENTATION
 #define VULKAN_API_IMPLEMENTATION
 
+#include "VulkanDispatch.hpp" // Has to come before anything else includes the Vulkan header
 #define GLFW_INCLUDE_VULKAN // This define includes vulkan headers by glfw3 automatically
 #include <GLFW/glfw3.h>
 
@@ -12,12 +13,44 @@
 // EXIT_SUCCESS and EXIT_FAILURE macros
 #include <cstdlib>
 #include <vector>
+#include <array>
 #include <string>
 #include <map>
 #include <optional>
 #include <set>
 #include <algorithm>
 #include <fstream>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE // Vulkan clip space depth goes from 0 to 1
+#include <glm/glm.hpp>
+
+#include "AllocationCounter.hpp"
+#include "BindlessTable.hpp"
+#include "CommandCache.hpp"
+#include "CullingSystem.hpp"
+#include "DeletionQueue.hpp"
+#include "FrameAllocator.hpp"
+#include "FrameCapture.hpp"
+#include "HostAllocator.hpp"
+#include "JobSystem.hpp"
+#include "LodSelector.hpp"
+#include "MemoryBudget.hpp"
+#include "MeshFormat.hpp"
+#include "ParticleSystem.hpp"
+#include "PostProcess.hpp"
+#include "PresentTarget.hpp"
+#include "QueryProfiler.hpp"
+#include "QueueTimeline.hpp"
+#include "RenderGraph.hpp"
+#include "ResolutionScaler.hpp"
+#include "SubmitBatcher.hpp"
+#include "TextureStreamer.hpp"
+#include "TransformSystem.hpp"
+#include "TripleBuffer.hpp"
 
 const int WIDTH = 800;
 const int HEIGHT = 600;
@@ -28,6 +61,90 @@ const bool enableValidationLayers = false;
 const bool enableValidationLayers = true;
 #endif
 
+// Depth-only pre-pass fills the depth buffer first, so the color pass shades only the visible fragments
+const bool enableDepthPrePass = false;
+
+// Pipeline statistics, occlusion and timestamp queries around each pass, read back frames later without waiting
+const bool enablePassQueries = true;
+
+// Measures the job system on startup: job overhead and parallel-for scaling against a single thread
+const bool enableJobSystemBenchmark = false;
+
+// Every .tga and .ppm file in this directory is streamed in at startup
+const char* const textureDirectory = "textures";
+
+// Copies every presented frame to disk in the background, frames are dropped rather than waited for
+const bool enableFrameCapture = false;
+const FrameCapture::Format frameCaptureFormat = FrameCapture::Format::Raw;
+
+// Converted with the MeshConverter tool, the built-in triangle is drawn if the file doesn't exist
+const char* const meshPath = "models/scene.mesh";
+
+// Seconds, the scene is animated at this fixed rate on a thread of its own
+const double simulationTimestep = 1.0 / 60.0;
+
+// The mesh is instanced over a grid of groups, each a root with a ring of children that have satellites of their own
+const uint32_t sceneGridSize = 8;
+const uint32_t sceneChildrenPerGroup = 8;
+const uint32_t sceneSatellitesPerChild = 3;
+
+// The nearest visible instances are rasterized into the CPU depth buffer, if the mesh is simple enough to be an occluder
+const bool enableOcclusionCulling = true;
+const uint32_t occluderInstanceCount = 16;
+const uint32_t occluderMaxTriangles = 1024;
+
+// Measures the culling on startup, frustum and occlusion tests of a million synthetic objects
+const bool enableCullingBenchmark = false;
+
+// Textures are read through one descriptor set of resource arrays, if the device supports descriptor indexing
+const bool enableBindless = true;
+
+// GPU progress is tracked with a timeline semaphore if the device supports it, with fences otherwise
+const bool enableTimelineSemaphores = true;
+
+// The scene is rendered in HDR and tonemapped by compute passes (auto exposure, bloom), if the device has the subgroup operations they use
+const bool enablePostProcess = true;
+// The post-processing runs on a compute-only queue, overlapping the next frame's geometry, if the device has one
+const bool enableAsyncPostProcess = true;
+
+// A million particle fountain simulated and drawn entirely on the GPU
+const bool enableParticles = true;
+// Measures the particle simulation on startup, GPU time of simulating a full buffer
+const bool enableParticleBenchmark = false;
+
+// Per heap usage and budget from VK_EXT_memory_budget if the device supports it, the texture streaming stays within it
+const bool enableMemoryBudget = true;
+// Replaces the device's heaps with a small, nearly full table, to try the warnings and the eviction
+const bool useStubMemoryHeaps = false;
+
+// Heap allocations drawFrame() makes after the warm-up frames are counted and reported, they show up as frame time spikes
+const uint32_t allocationWarmupFrames = 100;
+// Runs this many frames and then fails if any of them allocated after the warm-up, 0 runs until the window is closed.
+// Overridden with the --allocation-check <frames> argument
+const uint32_t defaultAllocationCheckFrames = 0;
+// Bytes of transient CPU data a frame may allocate from the frame allocator
+const size_t frameAllocatorCapacity = 1024 * 1024;
+
+// The driver's host memory for the objects created here goes through pooled, per scope tracked callbacks instead of its own allocator
+const bool enableHostAllocator = true;
+
+// The scene is rendered at the fraction of the window resolution that keeps the GPU frame time within the budget, then upscaled
+const bool enableDynamicResolution = true;
+// Milliseconds of GPU time per frame
+const double dynamicResolutionBudget = 1000.0 / 60.0;
+const float dynamicResolutionMinScale = 0.5f;
+const float dynamicResolutionMaxScale = 1.0f;
+
+// Extra windows showing the frame, copied in by the same submission and presented by the same vkQueuePresentKHR as the main one.
+// Any present target makes the swap chain images transfer sources, which keeps the post-processing off the async compute queue
+const uint32_t extraWindowCount = 0;
+// Present targets on VK_EXT_headless_surface surfaces, like outputs without a display attached
+const uint32_t headlessTargetCount = 0;
+
+// The frame's command buffer is recorded every frame, with the draws coming from secondary command buffers
+// that are only re-recorded when their inputs change
+const bool enableCommandCache = true;
+
 // Validation layers vectors ======================
 const std::vector<const char*> validationLayers = {
 	"VK_LAYER_KHRONOS_validation"
@@ -43,6 +160,7 @@ struct QueueFamilyIndices
 {
 	std::optional<uint32_t> graphicsFamily;
 	std::optional<uint32_t> presentFamily;
+	std::optional<uint32_t> computeFamily; // Compute without graphics, optional
 
 	bool isComplete()
 	{
@@ -50,6 +168,29 @@ struct QueueFamilyIndices
 	}
 };
 
+// Matches the push constant block in mesh.vert and bindless.frag
+struct MeshPushConstants
+{
+	glm::mat4 viewProjection;
+	glm::vec4 positionScale; // Dequantization of the stored positions
+	glm::vec4 positionOffset;
+	uint32_t textureSlot; // Bindless image slot, only read when the bindless table is active
+	float textureScale;
+	uint32_t padding[2];
+};
+
+// Immutable once published - the simulation thread writes a snapshot, the render thread draws the newest one
+struct SceneSnapshot
+{
+	uint64_t step = 0;
+	double time = 0.0; // Simulated seconds, stops while paused
+	std::chrono::steady_clock::time_point publishTime;
+	std::vector<glm::mat4> worldMatrices; // Dense transform order, sized once
+};
+
+// First of the four locations the per-instance world matrix takes in mesh.vert, right after the mesh attributes
+const uint32_t instanceMatrixLocation = static_cast<uint32_t>(MeshAttribute::Count);
+
 struct SwapChainSupportDetails
 {
 	VkSurfaceCapabilitiesKHR capabilities;
@@ -62,16 +203,37 @@ struct SwapChainSupportDetails
 class VulkanApi
 {
 public:
-	void run()
+	// From the command line, see main()
+	struct Options
 	{
+		uint32_t allocationCheckFrames = defaultAllocationCheckFrames;
+		bool hiddenWindows = false; // Nothing is shown, for runs that end on their own like the allocation check
+	};
+
+	void run(const Options& runOptions)
+	{
+		options = runOptions;
+
 		initWindow();
 		initVulkan();
 		mainLoop();
 		cleanup();
+
+		// Fails the run, so a script running it can tell
+		if (options.allocationCheckFrames > 0 && steadyStateAllocations > 0)
+		{
+			throw std::runtime_error("The frame loop allocated after the warm-up!");
+		}
 	}
 
 private:
+	Options options;
+
 	GLFWwindow* window; // Main glfw window handle
+	std::vector<GLFWwindow*> extraWindows;
+
+	HostAllocator hostAllocator; // Outlives the instance, everything created with its callbacks is destroyed with them
+	const VkAllocationCallbacks* allocator = nullptr; // Passed to every create and destroy call, nullptr uses the driver's allocator
 
 	VkInstance instance; // Main Vulkan instance
 	VkDebugUtilsMessengerEXT debugMessenger; // Main debug callback messenger
@@ -89,18 +251,157 @@ private:
 	VkExtent2D swapChainExtent;
 
 	std::vector<VkImageView> swapChainImageViews;
-	VkRenderPass renderPass;
+
+	VkFormat depthFormat; // The depth image itself is a transient render graph resource
+
+	RenderGraph renderGraph; // Owns the render passes, framebuffers and transient images
+	RenderGraph::PassHandle depthPrePass;
+	RenderGraph::PassHandle mainPass;
+
+	VkRenderPass renderPass; // Render pass the main pass ended up in
 	VkPipelineLayout pipelineLayout;
 
 	VkPipeline graphicsPipeline;
-	std::vector<VkFramebuffer> swapChainFramebuffers;
+	VkPipeline depthPrePassPipeline = VK_NULL_HANDLE; // Only created when enableDepthPrePass is set
+
+	bool meshLoaded = false;
+	MeshFileHeader meshHeader = {};
+	std::vector<Meshlet> meshlets;
+	VkBuffer vertexBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory vertexBufferMemory = VK_NULL_HANDLE;
+	VkBuffer indexBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory indexBufferMemory = VK_NULL_HANDLE;
+	VkIndexType meshIndexType = VK_INDEX_TYPE_UINT32;
+	MeshPushConstants meshConstants = {};
+	float cameraRadius = 1.0f; // Radius of what the camera looks at
+
+	TransformSystem transformSystem; // Every instance of the mesh, in instance order
+	std::vector<float> sceneSpinSpeeds; // Radians per second, per transform
+	std::vector<VkBuffer> instanceBuffers; // World matrices, one host visible buffer per swap chain image
+	std::vector<VkDeviceMemory> instanceBufferMemory;
+	std::vector<glm::mat4*> instanceData; // Persistently mapped, the visible instances in one fixed region per level of detail
+	std::vector<VkBuffer> indirectBuffers; // One draw per level of detail with its visible instance count, one buffer per swap chain image
+	std::vector<VkDeviceMemory> indirectBufferMemory;
+	std::vector<VkDrawIndexedIndirectCommand*> indirectCommands; // Persistently mapped
+	double transformUpdateTimeTotal = 0.0; // Milliseconds, simulation thread only
+	uint64_t transformUpdateCount = 0;
+
+	TripleBuffer<SceneSnapshot> sceneSnapshots; // Handed from the simulation thread to the render thread without locks
+	std::thread simulationThread;
+	std::atomic<bool> simulationRunning{ false };
+	std::atomic<bool> simulationPaused{ false }; // Toggled with space
+	bool pauseKeyDown = false;
+	uint64_t droppedSimulationSteps = 0; // Simulation thread only
+	uint64_t sceneFrameCount = 0; // Frames that took a snapshot, render thread only
+	uint64_t repeatedSnapshots = 0;
+	double snapshotAgeTotal = 0.0; // Milliseconds from publishing to rendering
+
+	CullingSystem culling;
+	std::vector<glm::vec3> occluderVertices; // The mesh itself, centered, empty if it has too many triangles
+	std::vector<uint32_t> occluderIndices;
+	double cullingTimeTotal = 0.0; // Milliseconds
+	uint64_t frustumVisibleTotal = 0;
+	uint64_t occlusionVisibleTotal = 0;
+
+	LodSelector lodSelector;
+	uint64_t submittedTrianglesTotal = 0;
+	uint64_t fullDetailTrianglesTotal = 0;
+
+	JobSystem jobSystem; // Worker threads for anything that can run in parallel - decoding, recording, compiling
 
 	VkCommandPool commandPool;
+	std::vector<VkCommandPool> recordingCommandPools; // One per swap chain image, for parallel recording
 	std::vector<VkCommandBuffer> commandBuffers;
 
 	VkSemaphore imageAvailableSemaphore;
 	VkSemaphore renderFinishedSemaphore;
 
+	QueueTimeline graphicsTimeline; // Every submission to the graphics queue goes through it
+	SubmitBatcher graphicsBatcher; // Gathers the frame's graphics queue work into one submission
+	std::vector<uint64_t> imageTimelineValues; // Timeline value of the last frame that used each swap chain image
+
+	QueryProfiler queryProfiler; // A slot per swap chain image, its queries are read when the image comes around again
+	QueryProfiler::ScopeHandle depthPrePassScope = 0;
+	QueryProfiler::ScopeHandle mainScope = 0;
+	QueryProfiler::ScopeHandle particleScope = 0;
+	float overdrawRatio = 0.0f; // Fragment shader invocations of the main pass per framebuffer pixel in the last finished frame
+
+	VkQueryPool timestampQueryPool = VK_NULL_HANDLE; // Frame begin and end timestamps per swap chain image, if supported
+	float timestampPeriod = 1.0f; // Nanoseconds per timestamp tick
+	double gpuFrameTime = 0.0; // Milliseconds, last finished frame
+	double gpuFrameTimeTotal = 0.0;
+	uint64_t gpuFrameCount = 0;
+
+	DeletionQueue deletionQueue; // Runtime replaced objects, destroyed once the frames using them have finished
+
+	TextureStreamer textureStreamer;
+	std::vector<TextureStreamer::TextureHandle> textures;
+	VkDeviceSize textureBudgetLimit = 0; // The streamer's configured residency budget, the memory budget only lowers it
+
+	MemoryBudget memoryBudget;
+	bool memoryBudgetExtension = false; // VK_EXT_memory_budget is enabled
+	uint64_t frameNumber = 0;
+
+	FrameAllocator frameAllocator; // Reset at the start of every frame
+	uint64_t steadyStateAllocations = 0; // Heap allocations in drawFrame() after the warm-up
+	uint64_t allocatingFrames = 0;
+
+	FrameCapture frameCapture;
+	bool frameCaptureActive = false; // Needs transfer source support on the swap chain images
+
+	BindlessTable bindlessTable;
+	bool bindlessActive = false; // Needs descriptor indexing on the device
+	std::vector<BindlessTable::Slot> textureSlots; // Per streamed texture
+	std::vector<VkImageView> textureSlotViews; // Streamer view each slot was last pointed at
+	VkImage fallbackTexture = VK_NULL_HANDLE; // Shown until a texture is resident
+	VkDeviceMemory fallbackTextureMemory = VK_NULL_HANDLE;
+	VkImageView fallbackTextureView = VK_NULL_HANDLE;
+
+	PostProcess postProcess;
+	bool postProcessActive = false; // Needs the subgroup operations and a way to get the result into the swap chain
+	bool postProcessDirectOutput = false; // The tonemap writes the swap chain images, otherwise its result is blitted over
+	bool postProcessAsync = false; // On the compute queue, needs the direct output and no frame capture
+	RenderGraph postGraph; // The post-processing passes, when they run on the compute queue
+	std::vector<VkImage> sceneColorImages; // Per swap chain image when the post-processing runs on the compute queue
+	std::vector<VkDeviceMemory> sceneColorMemory;
+	std::vector<VkImageView> sceneColorViews;
+	VkQueue computeQueue = VK_NULL_HANDLE;
+	QueueTimeline computeTimeline;
+	SubmitBatcher computeBatcher;
+	VkCommandPool computeCommandPool = VK_NULL_HANDLE;
+	std::vector<VkCommandBuffer> computeCommandBuffers; // Per swap chain image, the post-process graph
+	VkSemaphore sceneReadySemaphore = VK_NULL_HANDLE; // The geometry is done, the compute queue can take over
+	std::vector<uint64_t> imageComputeValues; // Compute timeline value of the last frame that used each swap chain image
+
+	ParticleSystem particleSystem;
+	double particleTime = 0.0; // Seconds, when the particles were last updated
+
+	ResolutionScaler resolutionScaler;
+	bool dynamicResolutionActive = false; // Needs timestamps and linear blits of the scene format
+	VkExtent2D renderExtent = {}; // The scene's part of the color target at the current scale
+	std::vector<VkExtent2D> imageRenderExtents; // Per swap chain image, the extent its commands were recorded with
+	uint64_t scaledGpuFrameCount = 0; // GPU frame times the scaler has seen
+	uint32_t rerecordedCommandBuffers = 0;
+
+	std::vector<PresentTarget> presentTargets; // The extra windows first, then the headless ones
+	std::vector<VkSurfaceKHR> presentTargetSurfaces;
+	std::vector<GLFWwindow*> presentTargetWindows; // nullptr for the headless targets
+	bool headlessSurfaceExtension = false; // VK_EXT_headless_surface is enabled
+	// Scratch, kept to avoid allocating every frame
+	std::vector<uint32_t> acquiredTargets; // Targets getting the current frame
+	std::vector<VkSwapchainKHR> presentSwapChains;
+	std::vector<uint32_t> presentImageIndices;
+	std::vector<VkResult> presentResults;
+	uint64_t presentCount = 0;
+	uint64_t presentedSwapChainTotal = 0;
+
+	CommandCache commandCache; // Secondary command buffers of the scene passes, when enableCommandCache is set
+	CommandCache::BucketHandle depthPrePassBucket = 0;
+	CommandCache::BucketHandle meshBucket = 0;
+	CommandCache::BucketHandle particleBucket = 0;
+	double commandRecordTimeTotal = 0.0; // Milliseconds spent recording the frames' primary command buffers
+	uint64_t recordedFrameCount = 0;
+
 	// Member function prototypes
 	
 	// ==== SETUP ====
@@ -111,6 +412,102 @@ private:
 	std::vector<const char*> getRequiredExtensions();
 	// ==== VALIDATION LAYERS ====
 	bool checkValidationLayerSupport();
+	// ==== IMAGES ====
+	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+	void createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage,
+		VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory);
+	VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags);
+	VkFormat findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
+	VkFormat findDepthFormat();
+	bool hasStencilComponent(VkFormat format);
+	// ==== BUFFERS ====
+	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
+	VkCommandBuffer beginSingleTimeCommands();
+	void endSingleTimeCommands(VkCommandBuffer commandBuffer);
+	// ==== MESHES ====
+	void loadMesh();
+	void updateCamera(const glm::vec3& center, float radius);
+	void getMeshVertexInput(std::vector<VkVertexInputBindingDescription>& bindingDescriptions, std::vector<VkVertexInputAttributeDescription>& attributeDescriptions);
+	void recordMeshDraw(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+	// ==== SCENE ====
+	void createScene();
+	void stepSimulation(SceneSnapshot& snapshot, double time);
+	void updateScene(uint32_t imageIndex);
+	// ==== SIMULATION ====
+	void startSimulation();
+	void stopSimulation();
+	void simulationLoop();
+	void sampleInput();
+	void printSimulationStatistics();
+	// ==== CULLING ====
+	void cullScene(uint32_t imageIndex, const glm::mat4* worldMatrices);
+	void runCullingBenchmark();
+	// ==== RENDER GRAPH ====
+	void createRenderGraph();
+	void recordDepthPrePass(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+	void recordMainPass(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+	void recordMainMeshes(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+	void recordParticleDraw(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+	// ==== STATISTICS ====
+	void createQueryProfiler();
+	void createTimestampQueryPool();
+	void readPipelineStatistics(uint32_t imageIndex);
+	void printPassStatistics();
+	void checkBenchmarkResult(const char* benchmark, bool matchesReference);
+	// ==== TEXTURES ====
+	void createTextureStreamer();
+	void updateTextureStreaming();
+	// ==== CAPTURE ====
+	void createFrameCapture();
+	// ==== BINDLESS ====
+	void createBindlessTable();
+	void updateBindlessTable(uint32_t imageIndex);
+	// ==== POST PROCESS ====
+	VkImageUsageFlags choosePostProcessOutput(VkFormat format, const VkSurfaceCapabilitiesKHR& capabilities);
+	RenderGraph::ResourceHandle addSceneColor();
+	void addPostProcessPasses(RenderGraph::ResourceHandle sceneColor, RenderGraph::ResourceHandle backbuffer);
+	void createPostProcessDescriptors();
+	void createPostProcessCommandBuffers();
+	void submitPostProcess(uint32_t imageIndex);
+	void printPostProcessStatistics();
+	void destroyPostProcess();
+	// ==== PARTICLES ====
+	void createParticleSystem();
+	void runParticleBenchmark();
+	void updateParticles(uint32_t imageIndex);
+	void printParticleStatistics();
+	// ==== RESOLUTION ====
+	VkImageUsageFlags chooseDynamicResolution(VkFormat format, const VkSurfaceCapabilitiesKHR& capabilities);
+	RenderGraph::ResourceHandle addScaledScene();
+	void addUpscalePass(RenderGraph::ResourceHandle scaledScene, RenderGraph::ResourceHandle colorTarget);
+	void setRenderViewport(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+	void updateRenderScale(uint32_t imageIndex);
+	void printDynamicResolution();
+	// ==== PRESENT ====
+	void createPresentTargets();
+	void acquirePresentTargets();
+	void submitPresentTargets(uint32_t imageIndex);
+	void presentFrame(uint32_t imageIndex);
+	void printPresentTargets();
+	void destroyPresentTargets();
+	// ==== COMMAND CACHE ====
+	void createCommandCache();
+	void recordFrame(uint32_t imageIndex);
+	VkCommandBufferInheritanceInfo getPassInheritance(RenderGraph::PassHandle pass, uint32_t imageIndex);
+	uint64_t getMeshDrawKey(uint32_t imageIndex, VkPipeline pipeline);
+	void executeCachedDepthPrePass(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+	void executeCachedMainPass(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+	void printCommandCache();
+	// ==== MEMORY ====
+	void createMemoryBudget();
+	void updateMemoryBudget();
+	void printMemoryBudget();
+	void checkFrameAllocations(uint64_t allocationsBefore);
+	void printAllocationStatistics();
+	void printHostAllocator();
+	// ==== JOBS ====
+	void runJobSystemBenchmark();
+	void printJobSystemStatistics();
 	
 	// Initialization, main loop and cleanup
 	
@@ -120,84 +517,233 @@ private:
 
 		glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API); // Prevent the glfw from loading OpenGL libraries
 		glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE); // Prevent the window from resizing - because it takes some more attention to do it properly
+		glfwWindowHint(GLFW_VISIBLE, options.hiddenWindows ? GLFW_FALSE : GLFW_TRUE); // Hidden windows still get swap chains and present
 
 		window = glfwCreateWindow(WIDTH, HEIGHT, "Vulkan", nullptr, nullptr); // Creating the main application window
+
+		// Smaller, the frame is scaled into them
+		for (uint32_t i = 0; i < extraWindowCount; i++)
+		{
+			extraWindows.push_back(glfwCreateWindow(WIDTH / 2, HEIGHT / 2, "Vulkan - extra window", nullptr, nullptr));
+		}
 	}
 
 	void initVulkan()
 	{
+		jobSystem.init(0, 1); // The simulation thread runs jobs too
+		frameAllocator.init(frameAllocatorCapacity);
+		if (enableHostAllocator)
+		{
+			hostAllocator.init();
+			allocator = hostAllocator.getCallbacks();
+		}
+		if (enableJobSystemBenchmark)
+		{
+			runJobSystemBenchmark();
+		}
+		if (enableCullingBenchmark)
+		{
+			runCullingBenchmark();
+		}
+
 		createInstance();
 		setupDebugMessenger();
 		createSurface();
 		pickPhysicalDevice();
 		createLogicalDevice();
+		createMemoryBudget();
 		createSwapChain();
 		createImageViews();
-		createRenderPass();
-		createGraphicsPipeline();
-		createFramebuffers();
+		createRenderGraph();
 		createCommandPool();
+		loadMesh();
+		createScene();
+		deletionQueue.init(device, allocator, graphicsTimeline);
+		createTextureStreamer();
+		createBindlessTable(); // The pipeline layout and the recorded push constants need the table
+		createGraphicsPipeline();
+		createQueryProfiler();
+		createTimestampQueryPool();
+		createParticleSystem(); // Also needs the timestamp period for its benchmark
+		createCommandCache();
 		createCommandBuffers();
+		createPostProcessCommandBuffers();
 		createSemaphores();
+		createFrameCapture();
+		createPresentTargets();
+		startSimulation();
 	}
 
 	void mainLoop()
 	{
-		while (!glfwWindowShouldClose(window))
+		// The events are polled inside drawFrame(), as late as possible
+		while (!glfwWindowShouldClose(window) && (options.allocationCheckFrames == 0 || frameNumber < options.allocationCheckFrames))
 		{
-			glfwPollEvents();
 			drawFrame();
 		}
 
+		stopSimulation();
 		vkDeviceWaitIdle(device);
+
+		printPassStatistics();
+
+		// Comparing these between the float and the quantized conversion of a mesh shows what the vertex format costs
+		if (meshLoaded)
+		{
+			std::cout << "Vertex buffer: " << static_cast<uint64_t>(meshHeader.vertexCount) * meshHeader.vertexStride << " bytes ("
+				<< meshHeader.vertexStride << " byte vertices)\n";
+		}
+		printSimulationStatistics();
+		if (sceneFrameCount > 0)
+		{
+			std::cout << "Culling: " << frustumVisibleTotal / sceneFrameCount << " in the frustum, " << occlusionVisibleTotal / sceneFrameCount
+				<< " not occluded on average, " << cullingTimeTotal / sceneFrameCount << " ms\n";
+			std::cout << "Levels of detail: " << submittedTrianglesTotal / sceneFrameCount << " triangles submitted on average, "
+				<< fullDetailTrianglesTotal / sceneFrameCount << " at full detail\n";
+		}
+		if (gpuFrameCount > 0)
+		{
+			std::cout << "Average GPU frame time: " << gpuFrameTimeTotal / gpuFrameCount << " ms over " << gpuFrameCount << " frames\n";
+		}
+
+		const TextureStreamer::Statistics& textureStats = textureStreamer.getStatistics();
+		std::cout << "Textures: " << textureStats.residentBytes << " bytes resident, " << textureStats.uploadedBytes << " bytes uploaded, "
+			<< textureStats.evictedMips << " mips evicted, " << textureStats.stagingStalls << " staging stalls\n";
+
+		printJobSystemStatistics();
+		printPostProcessStatistics();
+		printParticleStatistics();
+		printDynamicResolution();
+		printPresentTargets();
+		printCommandCache();
+		printMemoryBudget();
+		printAllocationStatistics();
+		printHostAllocator();
+
+		if (bindlessActive)
+		{
+			const BindlessTable::Statistics& bindlessStats = bindlessTable.getStatistics();
+			std::cout << "Bindless table: " << bindlessStats.imageSlots << " image and " << bindlessStats.bufferSlots << " buffer slots in use, "
+				<< bindlessStats.descriptorWrites << " descriptor writes\n";
+		}
+
+		const QueueTimeline::Statistics& timelineStats = graphicsTimeline.getStatistics();
+		std::cout << "Graphics queue: " << timelineStats.submits << " submits, " << timelineStats.hostWaits << " host waits, tracked with "
+			<< (graphicsTimeline.usesTimelineSemaphore() ? "a timeline semaphore\n" : "fences\n");
+
+		const SubmitBatcher::Statistics& batcherStats = graphicsBatcher.getStatistics();
+		if (batcherStats.frames > 0)
+		{
+			std::cout << "Submit batching: " << static_cast<double>(batcherStats.submits) / batcherStats.frames << " submits per frame (at most "
+				<< batcherStats.maxFrameSubmits << "), " << batcherStats.batches << " batches with " << batcherStats.commandBuffers << " command buffers\n";
+		}
+
+		DeletionQueue::Statistics deletionStats = deletionQueue.getStatistics();
+		std::cout << "Deferred destruction: " << deletionStats.destroyedObjects << " objects destroyed at runtime, "
+			<< deletionStats.pendingObjects << " still pending\n";
+
+		if (frameCaptureActive)
+		{
+			FrameCapture::Statistics captureStats = frameCapture.getStatistics();
+			std::cout << "Frame capture: " << captureStats.capturedFrames << " captured, " << captureStats.writtenFrames << " written ("
+				<< captureStats.bytesWritten << " bytes), " << captureStats.droppedFrames << " dropped\n";
+		}
 		/// LAST CHECKPOINT: Frames in flight
 	}
 
 	void cleanup()
 	{
-		vkDestroySemaphore(device, renderFinishedSemaphore, nullptr);
-		vkDestroySemaphore(device, imageAvailableSemaphore, nullptr);
+		// Writes out the remaining frames first
+		frameCapture.destroy();
+		textureStreamer.destroy();
+		deletionQueue.destroy();
+		graphicsTimeline.destroy();
+		destroyPostProcess();
+		particleSystem.destroy();
+
+		if (bindlessActive)
+		{
+			bindlessTable.destroy();
+			vkDestroyImageView(device, fallbackTextureView, allocator);
+			vkDestroyImage(device, fallbackTexture, allocator);
+			vkFreeMemory(device, fallbackTextureMemory, allocator);
+		}
+		jobSystem.destroy();
 
-		vkDestroyCommandPool(device, commandPool, nullptr);
+		vkDestroySemaphore(device, renderFinishedSemaphore, allocator);
+		vkDestroySemaphore(device, imageAvailableSemaphore, allocator);
 
-		// Destroying the framebuffers
-		for (auto framebuffer : swapChainFramebuffers)
+		queryProfiler.destroy();
+		if (timestampQueryPool != VK_NULL_HANDLE)
 		{
-			vkDestroyFramebuffer(device, framebuffer, nullptr);
+			vkDestroyQueryPool(device, timestampQueryPool, allocator);
 		}
 
-		// Destroy the pipeline
-		vkDestroyPipeline(device, graphicsPipeline, nullptr);
+		commandCache.destroy();
+		for (auto pool : recordingCommandPools)
+		{
+			vkDestroyCommandPool(device, pool, allocator);
+		}
+		vkDestroyCommandPool(device, commandPool, allocator);
+
+		for (size_t i = 0; i < instanceBuffers.size(); i++)
+		{
+			vkDestroyBuffer(device, instanceBuffers[i], allocator);
+			vkFreeMemory(device, instanceBufferMemory[i], allocator); // Freeing unmaps it too
+			vkDestroyBuffer(device, indirectBuffers[i], allocator);
+			vkFreeMemory(device, indirectBufferMemory[i], allocator);
+		}
+
+		if (meshLoaded)
+		{
+			vkDestroyBuffer(device, indexBuffer, allocator);
+			vkFreeMemory(device, indexBufferMemory, allocator);
+			vkDestroyBuffer(device, vertexBuffer, allocator);
+			vkFreeMemory(device, vertexBufferMemory, allocator);
+		}
+
+		// Destroy the pipelines
+		if (depthPrePassPipeline != VK_NULL_HANDLE)
+		{
+			vkDestroyPipeline(device, depthPrePassPipeline, allocator);
+		}
+		vkDestroyPipeline(device, graphicsPipeline, allocator);
 
 		// Destroy the pipeline layout
-		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+		vkDestroyPipelineLayout(device, pipelineLayout, allocator);
 
-		// Destroy the render pass
-		vkDestroyRenderPass(device, renderPass, nullptr);
+		// Destroy the render passes, framebuffers and transient images
+		renderGraph.destroy();
 
 		// Destroy created image views
 		for (auto imageView : swapChainImageViews)
 		{
-			vkDestroyImageView(device, imageView, nullptr);
+			vkDestroyImageView(device, imageView, allocator);
 		}
 
 		// Destory the swap chain, must be before the device destruction
-		vkDestroySwapchainKHR(device, swapChain, nullptr);
+		vkDestroySwapchainKHR(device, swapChain, allocator);
+		destroyPresentTargets();
 
 		// Destroy the logical device
-		vkDestroyDevice(device, nullptr);
+		vkDestroyDevice(device, allocator);
 
 		if (enableValidationLayers)
 		{
-			DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
+			DestroyDebugUtilsMessengerEXT(instance, debugMessenger, allocator);
 		}
 
 		// Destroy the window surface, must be done before instance destruction
-		vkDestroySurfaceKHR(instance, surface, nullptr);
+		vkDestroySurfaceKHR(instance, surface, allocator);
 
 		// Destroy the instance we created in create instance function
-		vkDestroyInstance(instance, nullptr);
+		vkDestroyInstance(instance, allocator);
+		hostAllocator.destroy();
 
+		for (GLFWwindow* extraWindow : extraWindows)
+		{
+			glfwDestroyWindow(extraWindow);
+		}
 		glfwDestroyWindow(window);
 
 		glfwTerminate();
@@ -0,0 +1,78 @@
+#include "VulkanApiImplementation.hpp"
+
+#include <chrono>
+#include <cmath>
+
+/****************************************************************************
+ * Startup microbenchmark of the job system. The per job cost decides how fine the parallel work may be split,
+ * the parallel-for speedup shows how well the workers scale. Every parallel result is checked against the
+ * single threaded one, a mismatch throws. The job system's own tests are in the JobSystemTest project.
+ */
+void VulkanApi::runJobSystemBenchmark()
+{
+	typedef std::chrono::steady_clock Clock;
+	auto milliseconds = [](Clock::time_point start) { return std::chrono::duration<double, std::milli>(Clock::now() - start).count(); };
+
+	// Empty jobs, children of one root - pure scheduling overhead
+	const uint32_t rounds = 100;
+	const uint32_t jobsPerRound = 2000;
+
+	auto start = Clock::now();
+	for (uint32_t round = 0; round < rounds; round++)
+	{
+		JobSystem::Job* root = jobSystem.createJob([](JobSystem::Job&) {});
+		for (uint32_t i = 0; i < jobsPerRound; i++)
+		{
+			jobSystem.run(jobSystem.createLambdaJob([]() {}, root));
+		}
+		jobSystem.run(root);
+		jobSystem.wait(root);
+	}
+	double emptyTime = milliseconds(start);
+
+	std::cout << "Job system: " << jobSystem.getThreadCount() << " threads, "
+		<< emptyTime * 1000000.0 / (rounds * jobsPerRound) << " ns per empty job\n";
+
+	// Some arithmetic per element, so it's not only memory bandwidth being measured
+	const uint32_t elementCount = 1 << 22;
+	std::vector<uint32_t> reference(elementCount);
+	std::vector<uint32_t> output(elementCount);
+
+	auto work = [](uint32_t* values, uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; i++)
+		{
+			float x = static_cast<float>(i);
+			values[i] = static_cast<uint32_t>(std::sqrt(x) * std::sin(x * 0.001f) * 1000.0f);
+		}
+	};
+
+	start = Clock::now();
+	work(reference.data(), 0, elementCount);
+	double serialTime = milliseconds(start);
+	std::cout << "  serial: " << serialTime << " ms\n";
+
+	for (uint32_t batchSize : { 256u, 4096u, 65536u })
+	{
+		std::fill(output.begin(), output.end(), 0);
+
+		start = Clock::now();
+		jobSystem.parallelFor(elementCount, batchSize, [&](uint32_t begin, uint32_t end) { work(output.data(), begin, end); });
+		double parallelTime = milliseconds(start);
+
+		std::cout << "  parallel-for, batches of " << batchSize << ": " << parallelTime << " ms, " << serialTime / parallelTime << "x\n";
+		checkBenchmarkResult("Job system parallel-for", output == reference);
+	}
+}
+
+void VulkanApi::printJobSystemStatistics()
+{
+	std::vector<JobSystem::WorkerStatistics> statistics = jobSystem.getStatistics();
+
+	std::cout << "Job system threads (executed / stolen / failed steals / idle ms):\n";
+	for (size_t i = 0; i < statistics.size(); i++)
+	{
+		std::cout << "  " << (i == 0 ? "main" : std::to_string(i)) << ": " << statistics[i].executedJobs << " / " << statistics[i].stolenJobs
+			<< " / " << statistics[i].failedSteals << " / " << statistics[i].idleMilliseconds << "\n";
+	}
+}
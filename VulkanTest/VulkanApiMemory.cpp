@@ -0,0 +1,119 @@
+#include "VulkanApiImplementation.hpp"
+
+/****************************************************************************
+ * The stub table is a GPU shared with another process that already took most of it,
+ * which makes the budget warn and the texture streamer stay at coarse levels.
+ */
+void VulkanApi::createMemoryBudget()
+{
+	MemoryBudget::Config config;
+	memoryBudget.init(physicalDevice, memoryBudgetExtension, config);
+
+	if (useStubMemoryHeaps)
+	{
+		const VkDeviceSize megabyte = 1024 * 1024;
+
+		std::vector<MemoryBudget::Heap> heaps(2);
+		heaps[0].size = 4096 * megabyte;
+		heaps[0].budget = 1024 * megabyte;
+		heaps[0].usage = 950 * megabyte;
+		heaps[0].flags = VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+		heaps[1].size = 16384 * megabyte;
+		heaps[1].budget = 12288 * megabyte;
+		heaps[1].usage = 256 * megabyte;
+
+		memoryBudget.setStubHeaps(heaps);
+	}
+
+	std::cout << "Memory budget: " << memoryBudget.getHeaps().size() << " heaps, "
+		<< (memoryBudget.isStubbed() ? "stubbed\n" : memoryBudget.usesExtension() ? "reported by VK_EXT_memory_budget\n" : "estimated from the heap sizes\n");
+}
+
+/****************************************************************************
+ * The texture residency budget follows what the device local heap has left, counting the textures
+ * as free - they're what would be evicted. It's never raised above the streamer's own budget.
+ */
+void VulkanApi::updateMemoryBudget()
+{
+	if (!memoryBudget.update(frameNumber))
+	{
+		return;
+	}
+
+	// Only the real usage includes the textures
+	uint32_t heapIndex = memoryBudget.getDeviceLocalHeap();
+	const MemoryBudget::Heap& heap = memoryBudget.getHeaps()[heapIndex];
+	VkDeviceSize textureUsage = memoryBudget.usesExtension() && !memoryBudget.isStubbed() ? textureStreamer.getStatistics().residentBytes : 0;
+	VkDeviceSize available = memoryBudget.getHeadroom(heapIndex) + std::min(textureUsage, heap.usage);
+
+	textureStreamer.setResidencyBudget(std::min(available, textureBudgetLimit));
+}
+
+void VulkanApi::printMemoryBudget()
+{
+	const VkDeviceSize megabyte = 1024 * 1024;
+
+	const std::vector<MemoryBudget::Heap>& heaps = memoryBudget.getHeaps();
+	for (uint32_t i = 0; i < heaps.size(); i++)
+	{
+		std::cout << "Memory heap " << i << ((heaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? " (device local): " : ": ")
+			<< heaps[i].usage / megabyte << " MB used of a " << heaps[i].budget / megabyte << " MB budget, " << heaps[i].size / megabyte << " MB heap\n";
+	}
+
+	const MemoryBudget::Statistics& stats = memoryBudget.getStatistics();
+	std::cout << "Memory budget: " << stats.queries << " queries, peak usage " << stats.peakUsage * 100.0f << "% of the budget, "
+		<< stats.warnings << " warnings, texture budget " << textureStreamer.getResidencyBudget() / megabyte << " MB\n";
+}
+
+/****************************************************************************
+ * Counts the heap allocations of the render thread during the frame, jobs it ran while waiting included.
+ * The warm-up frames may still grow the scratch arrays and queues to their working size.
+ */
+void VulkanApi::checkFrameAllocations(uint64_t allocationsBefore)
+{
+	uint64_t allocations = AllocationCounter::getThreadCount() - allocationsBefore;
+	if (frameNumber < allocationWarmupFrames || allocations == 0)
+	{
+		return;
+	}
+
+	if (steadyStateAllocations == 0)
+	{
+		std::cerr << "Frame " << frameNumber << " allocated " << allocations << " times after the warm-up\n";
+	}
+
+	steadyStateAllocations += allocations;
+	allocatingFrames++;
+}
+
+void VulkanApi::printAllocationStatistics()
+{
+	uint64_t checkedFrames = frameNumber > allocationWarmupFrames ? frameNumber - allocationWarmupFrames : 0;
+	std::cout << "Allocations: " << steadyStateAllocations << " in " << allocatingFrames << " of " << checkedFrames
+		<< " frames after the warm-up, " << AllocationCounter::getCount() << " in total (" << AllocationCounter::getBytes() / 1024 << " KB)\n";
+
+	const FrameAllocator::Statistics& stats = frameAllocator.getStatistics();
+	std::cout << "Frame allocator: peak " << stats.peakBytes << " of " << stats.capacity << " bytes\n";
+}
+
+/****************************************************************************
+ * Printed before cleanup, so the current usage is what the driver holds while running.
+ */
+void VulkanApi::printHostAllocator()
+{
+	if (allocator == nullptr)
+	{
+		return;
+	}
+
+	HostAllocator::Statistics stats = hostAllocator.getStatistics();
+	for (uint32_t s = 0; s < HostAllocator::scopeCount; s++)
+	{
+		const HostAllocator::ScopeStatistics& scope = stats.scopes[s];
+		std::cout << "Driver host memory, " << HostAllocator::getScopeName(static_cast<VkSystemAllocationScope>(s)) << " scope: "
+			<< scope.allocations << " allocations, " << scope.currentBytes / 1024 << " KB current, " << scope.peakBytes / 1024 << " KB peak, "
+			<< scope.internalBytes / 1024 << " KB internal\n";
+	}
+	std::cout << "Driver host memory: " << stats.pooledAllocations << " pooled and " << stats.heapAllocations << " heap allocations, "
+		<< stats.chunkBytes / 1024 << " KB of pool chunks\n";
+}
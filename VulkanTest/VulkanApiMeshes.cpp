@@ -0,0 +1,214 @@
+#include "VulkanApiImplementation.hpp"
+
+#include <cstring>
+#include <filesystem>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "MeshFile.hpp"
+
+static VkFormat getAttributeFormat(MeshAttributeFormat format)
+{
+	switch (format)
+	{
+	case MeshAttributeFormat::Float2: return VK_FORMAT_R32G32_SFLOAT;
+	case MeshAttributeFormat::Float3: return VK_FORMAT_R32G32B32_SFLOAT;
+	case MeshAttributeFormat::Float4: return VK_FORMAT_R32G32B32A32_SFLOAT;
+	case MeshAttributeFormat::Half2: return VK_FORMAT_R16G16_SFLOAT;
+	case MeshAttributeFormat::Half4: return VK_FORMAT_R16G16B16A16_SFLOAT;
+	case MeshAttributeFormat::Snorm8x4: return VK_FORMAT_R8G8B8A8_SNORM;
+	case MeshAttributeFormat::Unorm8x4: return VK_FORMAT_R8G8B8A8_UNORM;
+	case MeshAttributeFormat::Unorm16x4: return VK_FORMAT_R16G16B16A16_UNORM;
+	default: return VK_FORMAT_UNDEFINED;
+	}
+}
+
+/****************************************************************************
+ * Maps the converted mesh file and uploads its vertex and index streams.
+ * Without a mesh file the pipeline keeps drawing the triangle built into the vertex shader.
+ */
+void VulkanApi::loadMesh()
+{
+	std::error_code error;
+	if (!std::filesystem::is_regular_file(meshPath, error))
+	{
+		std::cout << "No mesh found at " << meshPath << ", drawing the built-in triangle\n";
+		return;
+	}
+
+	MeshFile file;
+	file.open(meshPath);
+	meshHeader = file.getHeader();
+
+	// The index stream directly follows the vertex stream, so both go through staging with a single copy
+	VkDeviceSize vertexSize = static_cast<VkDeviceSize>(meshHeader.vertexCount) * meshHeader.vertexStride;
+	VkDeviceSize indexSize = static_cast<VkDeviceSize>(meshHeader.indexCount) * meshHeader.indexSize;
+	VkDeviceSize stagingSize = meshHeader.indexOffset + indexSize - meshHeader.vertexOffset;
+
+	VkBuffer stagingBuffer;
+	VkDeviceMemory stagingBufferMemory;
+	createBuffer(stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		stagingBuffer, stagingBufferMemory);
+
+	void* data;
+	vkMapMemory(device, stagingBufferMemory, 0, stagingSize, 0, &data);
+	memcpy(data, file.getVertices(), static_cast<size_t>(stagingSize));
+	vkUnmapMemory(device, stagingBufferMemory);
+
+	createBuffer(vertexSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		vertexBuffer, vertexBufferMemory);
+	createBuffer(indexSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		indexBuffer, indexBufferMemory);
+
+	VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+
+	VkBufferCopy vertexCopy = { 0, 0, vertexSize };
+	vkCmdCopyBuffer(commandBuffer, stagingBuffer, vertexBuffer, 1, &vertexCopy);
+	VkBufferCopy indexCopy = { meshHeader.indexOffset - meshHeader.vertexOffset, 0, indexSize };
+	vkCmdCopyBuffer(commandBuffer, stagingBuffer, indexBuffer, 1, &indexCopy);
+
+	endSingleTimeCommands(commandBuffer);
+
+	vkDestroyBuffer(device, stagingBuffer, allocator);
+	vkFreeMemory(device, stagingBufferMemory, allocator);
+
+	meshlets.assign(file.getMeshlets(), file.getMeshlets() + meshHeader.meshletCount);
+	meshIndexType = meshHeader.indexSize == 2 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+	meshLoaded = true;
+
+	// The instance transforms place and rotate the mesh around its own center, so the dequantization moves it to the origin
+	const MeshBounds& bounds = meshHeader.bounds;
+	glm::vec3 center(bounds.center[0], bounds.center[1], bounds.center[2]);
+
+	meshConstants.positionScale = glm::vec4(meshHeader.positionScale[0], meshHeader.positionScale[1], meshHeader.positionScale[2], 0.0f);
+	meshConstants.positionOffset = glm::vec4(meshHeader.positionOffset[0] - center.x, meshHeader.positionOffset[1] - center.y,
+		meshHeader.positionOffset[2] - center.z, 0.0f);
+	updateCamera(glm::vec3(0.0f), bounds.radius);
+
+	// Small meshes double as their own occluders in the CPU occlusion culling, decoded the same way the vertex shader does.
+	// Only the full detail level, the simplified ones may stick out of the actual surface.
+	if (meshHeader.lods[0].indexCount / 3 <= occluderMaxTriangles)
+	{
+		const MeshAttributeDesc& position = meshHeader.attributes[static_cast<uint32_t>(MeshAttribute::Position)];
+		occluderVertices.resize(meshHeader.vertexCount);
+		for (uint32_t i = 0; i < meshHeader.vertexCount; i++)
+		{
+			const uint8_t* vertex = file.getVertices() + static_cast<size_t>(i) * meshHeader.vertexStride + position.offset;
+			float stored[3];
+			if (position.format == MeshAttributeFormat::Unorm16x4)
+			{
+				const uint16_t* values = reinterpret_cast<const uint16_t*>(vertex);
+				for (int c = 0; c < 3; c++)
+				{
+					stored[c] = values[c] / 65535.0f;
+				}
+			}
+			else
+			{
+				memcpy(stored, vertex, sizeof(stored));
+			}
+
+			occluderVertices[i] = glm::vec3(stored[0] * meshConstants.positionScale.x + meshConstants.positionOffset.x,
+				stored[1] * meshConstants.positionScale.y + meshConstants.positionOffset.y, stored[2] * meshConstants.positionScale.z + meshConstants.positionOffset.z);
+		}
+
+		occluderIndices.resize(meshHeader.lods[0].indexCount);
+		for (uint32_t i = 0; i < meshHeader.lods[0].indexCount; i++)
+		{
+			occluderIndices[i] = meshHeader.indexSize == 2 ? reinterpret_cast<const uint16_t*>(file.getIndices())[i] : reinterpret_cast<const uint32_t*>(file.getIndices())[i];
+		}
+	}
+
+	std::cout << "Loaded " << meshPath << ": " << meshHeader.vertexCount << " vertices, " << meshHeader.lods[0].indexCount / 3 << " triangles, "
+		<< meshHeader.meshletCount << " meshlets, " << meshHeader.lodCount << " levels of detail\n";
+}
+
+/****************************************************************************
+ * Fixed camera looking at a sphere, the projection flips Y to match the Vulkan clip space
+ */
+void VulkanApi::updateCamera(const glm::vec3& center, float radius)
+{
+	glm::vec3 eye = center + glm::vec3(0.0f, 0.5f, 2.5f) * radius;
+
+	glm::mat4 view = glm::lookAt(eye, center, glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), swapChainExtent.width / (float)swapChainExtent.height,
+		radius * 0.1f, radius * 10.0f);
+	projection[1][1] *= -1;
+
+	meshConstants.viewProjection = projection * view;
+	cameraRadius = radius;
+	lodSelector.setCamera(eye, glm::radians(45.0f), static_cast<float>(swapChainExtent.height));
+}
+
+/****************************************************************************
+ * Vertex input matching the attributes stored in the mesh file, each attribute at the location of its index.
+ * The second binding steps once per instance and carries the world matrix, one column per location.
+ */
+void VulkanApi::getMeshVertexInput(std::vector<VkVertexInputBindingDescription>& bindingDescriptions, std::vector<VkVertexInputAttributeDescription>& attributeDescriptions)
+{
+	bindingDescriptions.resize(2);
+	bindingDescriptions[0].binding = 0;
+	bindingDescriptions[0].stride = meshHeader.vertexStride;
+	bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+	bindingDescriptions[1].binding = 1;
+	bindingDescriptions[1].stride = sizeof(glm::mat4);
+	bindingDescriptions[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+	attributeDescriptions.clear();
+	for (uint32_t i = 0; i < static_cast<uint32_t>(MeshAttribute::Count); i++)
+	{
+		const MeshAttributeDesc& attribute = meshHeader.attributes[i];
+		if (attribute.format == MeshAttributeFormat::None)
+		{
+			continue;
+		}
+
+		VkVertexInputAttributeDescription description = {};
+		description.binding = 0;
+		description.location = i;
+		description.format = getAttributeFormat(attribute.format);
+		description.offset = attribute.offset;
+		attributeDescriptions.push_back(description);
+	}
+
+	for (uint32_t column = 0; column < 4; column++)
+	{
+		VkVertexInputAttributeDescription description = {};
+		description.binding = 1;
+		description.location = instanceMatrixLocation + column;
+		description.format = VK_FORMAT_R32G32B32A32_SFLOAT;
+		description.offset = column * sizeof(glm::vec4);
+		attributeDescriptions.push_back(description);
+	}
+}
+
+void VulkanApi::recordMeshDraw(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+	if (!meshLoaded)
+	{
+		vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+		return;
+	}
+
+	VkDeviceSize offset = 0;
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &offset);
+	vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, meshIndexType);
+	vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(MeshPushConstants), &meshConstants);
+
+	// The only descriptor set, every draw after it picks its resources by index
+	if (bindlessActive)
+	{
+		VkDescriptorSet set = bindlessTable.getSet(imageIndex);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &set, 0, nullptr);
+	}
+
+	// The instance counts come from the culling every frame, so the recorded command buffer stays valid.
+	// Every level of detail has a fixed region of the instance buffer, which keeps firstInstance at 0.
+	for (uint32_t lod = 0; lod < meshHeader.lodCount; lod++)
+	{
+		VkDeviceSize instanceOffset = static_cast<VkDeviceSize>(lod) * transformSystem.getCount() * sizeof(glm::mat4);
+		vkCmdBindVertexBuffers(commandBuffer, 1, 1, &instanceBuffers[imageIndex], &instanceOffset);
+		vkCmdDrawIndexedIndirect(commandBuffer, indirectBuffers[imageIndex], lod * sizeof(VkDrawIndexedIndirectCommand), 1,
+			sizeof(VkDrawIndexedIndirectCommand));
+	}
+}
@@ -0,0 +1,98 @@
+#include "VulkanApiImplementation.hpp"
+
+/****************************************************************************
+ * The particle fountain rises from the middle of the scene, scaled to the camera distance.
+ * Its draw goes into the main pass, so it needs the render pass the graph compiled.
+ */
+void VulkanApi::createParticleSystem()
+{
+	if (!enableParticles)
+	{
+		return;
+	}
+
+	ParticleSystem::Config config;
+	config.emitterRadius = cameraRadius * 0.05f;
+	config.speed = cameraRadius * 0.9f;
+	config.gravity = cameraRadius * 0.45f;
+	config.particleSize = cameraRadius * 0.01f;
+
+	particleSystem.init(device, allocator, physicalDevice, "shaders/", renderPass, renderGraph.getSubpassIndex(mainPass), swapChainExtent,
+		static_cast<uint32_t>(swapChainImages.size()), config);
+
+	if (enableParticleBenchmark)
+	{
+		runParticleBenchmark();
+	}
+
+	VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+	particleSystem.recordReset(commandBuffer);
+	endSingleTimeCommands(commandBuffer);
+
+	particleTime = glfwGetTime();
+}
+
+/****************************************************************************
+ * Simulation steps of a full buffer between two timestamps, so the result is the GPU time alone.
+ */
+void VulkanApi::runParticleBenchmark()
+{
+	if (timestampQueryPool == VK_NULL_HANDLE)
+	{
+		std::cout << "Particle benchmark skipped, timestamp queries not supported.\n";
+		return;
+	}
+
+	const uint32_t iterations = 100;
+
+	VkQueryPoolCreateInfo queryPoolInfo = {};
+	queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	queryPoolInfo.queryCount = 2;
+
+	VkQueryPool queryPool;
+	if (vkCreateQueryPool(device, &queryPoolInfo, allocator, &queryPool) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create particle benchmark query pool!");
+	}
+
+	VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+	particleSystem.recordBenchmark(commandBuffer, queryPool, 0, iterations);
+	endSingleTimeCommands(commandBuffer);
+
+	uint64_t timestamps[2] = {};
+	vkGetQueryPoolResults(device, queryPool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+	vkDestroyQueryPool(device, queryPool, allocator);
+
+	double milliseconds = (timestamps[1] - timestamps[0]) * timestampPeriod / 1000000.0;
+	double particles = static_cast<double>(particleSystem.getStatistics().capacity) * iterations;
+	std::cout << "Particle benchmark: " << iterations << " steps of " << particleSystem.getStatistics().capacity << " particles in "
+		<< milliseconds << " ms, " << particles / milliseconds << " particles/ms\n";
+}
+
+void VulkanApi::updateParticles(uint32_t imageIndex)
+{
+	if (!enableParticles)
+	{
+		return;
+	}
+
+	// Clamped, so a long stall doesn't launch a second's worth of particles at once
+	double time = glfwGetTime();
+	float deltaTime = std::min(static_cast<float>(time - particleTime), 0.1f);
+	particleTime = time;
+
+	particleSystem.update(imageIndex, deltaTime);
+}
+
+void VulkanApi::printParticleStatistics()
+{
+	if (!enableParticles)
+	{
+		return;
+	}
+
+	const ParticleSystem::Statistics& stats = particleSystem.getStatistics();
+	std::cout << "Particles: " << stats.aliveCount << " alive (at most " << stats.maxAliveCount << ") of " << stats.capacity << ", "
+		<< stats.emitted << " emitted\n";
+}
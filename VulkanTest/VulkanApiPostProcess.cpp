@@ -0,0 +1,283 @@
+#include "VulkanApiImplementation.hpp"
+
+/****************************************************************************
+ * Decides how the tonemapped result gets into the swap chain and returns the image usage that needs.
+ * Writing the swap chain image straight from the tonemap shader is preferred, otherwise the result is
+ * tonemapped to an rgba8 image and blitted over - which has to stay on the graphics queue.
+ */
+VkImageUsageFlags VulkanApi::choosePostProcessOutput(VkFormat format, const VkSurfaceCapabilitiesKHR& capabilities)
+{
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
+
+	VkPhysicalDeviceFeatures features;
+	vkGetPhysicalDeviceFeatures(physicalDevice, &features);
+
+	// The shader has a format qualifier only for rgba8, anything else is written without one
+	bool shaderCanWrite = format == VK_FORMAT_R8G8B8A8_UNORM || features.shaderStorageImageWriteWithoutFormat;
+	postProcessDirectOutput = shaderCanWrite && (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT) &&
+		(capabilities.supportedUsageFlags & VK_IMAGE_USAGE_STORAGE_BIT);
+
+	if (postProcessDirectOutput)
+	{
+		return VK_IMAGE_USAGE_STORAGE_BIT;
+	}
+
+	postProcessAsync = false;
+	if ((formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT) && (capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT))
+	{
+		return VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	}
+
+	std::cout << "Post-process: the swap chain images can't be written or blitted to, rendering without it\n";
+	postProcessActive = false;
+	return 0;
+}
+
+/****************************************************************************
+ * The HDR image the main pass renders to. On the graphics queue it's a transient image like the depth buffer.
+ * With the post-processing on the compute queue every swap chain image gets one of its own, since the compute
+ * queue still reads a frame's scene while the graphics queue renders the next one.
+ */
+RenderGraph::ResourceHandle VulkanApi::addSceneColor()
+{
+	RenderGraph::ImageDesc desc = { VK_FORMAT_R16G16B16A16_SFLOAT, swapChainExtent, VK_IMAGE_ASPECT_COLOR_BIT };
+	if (!postProcessAsync)
+	{
+		return renderGraph.createImage("Scene color", desc);
+	}
+
+	// Shared by both queues, so no ownership transfers are needed between them
+	QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+	uint32_t queueFamilyIndices[] = { indices.graphicsFamily.value(), indices.computeFamily.value() };
+
+	size_t imageCount = swapChainImages.size();
+	sceneColorImages.resize(imageCount);
+	sceneColorMemory.resize(imageCount);
+	sceneColorViews.resize(imageCount);
+
+	for (size_t i = 0; i < imageCount; i++)
+	{
+		VkImageCreateInfo imageInfo = {};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.extent.width = swapChainExtent.width;
+		imageInfo.extent.height = swapChainExtent.height;
+		imageInfo.extent.depth = 1;
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.format = desc.format;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		if (dynamicResolutionActive)
+		{
+			imageInfo.usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT; // The scaled scene is upscaled into it
+		}
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+		imageInfo.queueFamilyIndexCount = 2;
+		imageInfo.pQueueFamilyIndices = queueFamilyIndices;
+
+		if (vkCreateImage(device, &imageInfo, allocator, &sceneColorImages[i]) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create scene color image!");
+		}
+
+		VkMemoryRequirements memRequirements;
+		vkGetImageMemoryRequirements(device, sceneColorImages[i], &memRequirements);
+
+		VkMemoryAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = memRequirements.size;
+		allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		if (vkAllocateMemory(device, &allocInfo, allocator, &sceneColorMemory[i]) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to allocate scene color memory!");
+		}
+
+		vkBindImageMemory(device, sceneColorImages[i], sceneColorMemory[i], 0);
+		sceneColorViews[i] = createImageView(sceneColorImages[i], desc.format, VK_IMAGE_ASPECT_COLOR_BIT);
+	}
+
+	// Left in the layout the compute passes sample it in, the graph on the compute queue starts from there
+	RenderGraph::ResourceHandle sceneColor = renderGraph.importImage("Scene color", desc, sceneColorImages, sceneColorViews,
+		VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+	renderGraph.markOutput(sceneColor);
+	return sceneColor;
+}
+
+void VulkanApi::addPostProcessPasses(RenderGraph::ResourceHandle sceneColor, RenderGraph::ResourceHandle backbuffer)
+{
+	VkFormat outputFormat = postProcessDirectOutput ? swapChainImageFormat : VK_FORMAT_R8G8B8A8_UNORM;
+	postProcess.init(device, allocator, physicalDevice, outputFormat, "shaders/", PostProcess::Config());
+
+	if (postProcessAsync)
+	{
+		RenderGraph::ImageDesc sceneDesc = { VK_FORMAT_R16G16B16A16_SFLOAT, swapChainExtent, VK_IMAGE_ASPECT_COLOR_BIT };
+		RenderGraph::ImageDesc colorDesc = { swapChainImageFormat, swapChainExtent, VK_IMAGE_ASPECT_COLOR_BIT };
+
+		RenderGraph::ResourceHandle scene = postGraph.importImage("Scene color", sceneDesc, sceneColorImages, sceneColorViews,
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+		// The compute queue waits for the acquired image at the compute shader stage
+		RenderGraph::ResourceHandle output = postGraph.importImage("Backbuffer", colorDesc, swapChainImages, swapChainImageViews,
+			VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+		postGraph.markOutput(output);
+
+		postProcess.addPasses(postGraph, scene, output, swapChainExtent);
+		postGraph.compile(device, allocator, physicalDevice);
+		return;
+	}
+
+	if (postProcessDirectOutput)
+	{
+		postProcess.addPasses(renderGraph, sceneColor, backbuffer, swapChainExtent);
+		return;
+	}
+
+	RenderGraph::ImageDesc tonemappedDesc = { VK_FORMAT_R8G8B8A8_UNORM, swapChainExtent, VK_IMAGE_ASPECT_COLOR_BIT };
+	RenderGraph::ResourceHandle tonemapped = renderGraph.createImage("Tonemapped", tonemappedDesc);
+	postProcess.addPasses(renderGraph, sceneColor, tonemapped, swapChainExtent);
+
+	RenderGraph::PassHandle blitPass = renderGraph.addPass("Backbuffer blit", RenderGraph::PassType::Transfer,
+		[this, tonemapped, backbuffer](VkCommandBuffer commandBuffer, uint32_t imageIndex)
+		{
+			VkImageBlit blit = {};
+			blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+			blit.srcOffsets[1] = { static_cast<int32_t>(swapChainExtent.width), static_cast<int32_t>(swapChainExtent.height), 1 };
+			blit.dstSubresource = blit.srcSubresource;
+			blit.dstOffsets[1] = blit.srcOffsets[1];
+
+			// Same size, the blit only converts the format
+			vkCmdBlitImage(commandBuffer, renderGraph.getImage(tonemapped, imageIndex), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				renderGraph.getImage(backbuffer, imageIndex), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_NEAREST);
+		});
+	renderGraph.readResource(blitPass, tonemapped, RenderGraph::ResourceUsage::TransferSrc);
+	renderGraph.writeResource(blitPass, backbuffer, RenderGraph::ResourceUsage::TransferDst);
+}
+
+void VulkanApi::createPostProcessDescriptors()
+{
+	uint32_t imageCount = static_cast<uint32_t>(swapChainImages.size());
+	postProcess.createDescriptorSets(postProcessAsync ? postGraph : renderGraph, imageCount);
+
+	if (postProcessAsync)
+	{
+		const RenderGraph::Statistics& stats = postGraph.getStatistics();
+		std::cout << "Post-process graph: " << stats.passCount << " passes, " << stats.barrierCount << " barriers, "
+			<< stats.transientMemory << " bytes of transient memory (" << stats.unaliasedTransientMemory << " without aliasing)\n";
+	}
+}
+
+void VulkanApi::createPostProcessCommandBuffers()
+{
+	if (!postProcessAsync)
+	{
+		return;
+	}
+
+	QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+
+	VkCommandPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.queueFamilyIndex = indices.computeFamily.value();
+
+	if (vkCreateCommandPool(device, &poolInfo, allocator, &computeCommandPool) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create compute command pool!");
+	}
+
+	computeCommandBuffers.resize(swapChainImages.size());
+
+	VkCommandBufferAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.commandPool = computeCommandPool;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandBufferCount = static_cast<uint32_t>(computeCommandBuffers.size());
+
+	if (vkAllocateCommandBuffers(device, &allocInfo, computeCommandBuffers.data()) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to allocate compute command buffers!");
+	}
+
+	// A handful of dispatches each, not worth spreading over the job system
+	for (uint32_t i = 0; i < computeCommandBuffers.size(); i++)
+	{
+		VkCommandBufferBeginInfo beginInfo = {};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+
+		if (vkBeginCommandBuffer(computeCommandBuffers[i], &beginInfo) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to begin recording compute command buffer!");
+		}
+
+		postGraph.execute(computeCommandBuffers[i], i);
+
+		if (vkEndCommandBuffer(computeCommandBuffers[i]) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to record compute command buffer!");
+		}
+	}
+}
+
+/****************************************************************************
+ * Hands the frame to the compute queue once its geometry is submitted. The swap chain image is only touched
+ * here, so the compute queue is the one waiting for it to be acquired, and the one the present waits for.
+ */
+void VulkanApi::submitPostProcess(uint32_t imageIndex)
+{
+	computeBatcher.wait(sceneReadySemaphore, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+	computeBatcher.wait(imageAvailableSemaphore, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+	computeBatcher.add(computeCommandBuffers[imageIndex]);
+	computeBatcher.signal(renderFinishedSemaphore);
+
+	imageComputeValues[imageIndex] = computeBatcher.flush();
+	computeBatcher.endFrame();
+}
+
+void VulkanApi::printPostProcessStatistics()
+{
+	if (!postProcessActive)
+	{
+		return;
+	}
+
+	const PostProcess::Statistics& stats = postProcess.getStatistics();
+	std::cout << "Post-process: " << stats.computePasses << " compute passes on the " << (postProcessAsync ? "compute" : "graphics")
+		<< " queue, subgroup size " << stats.subgroupSize << ", average luminance " << stats.averageLuminance << ", exposure " << stats.exposure
+		<< (postProcessDirectOutput ? "\n" : ", blitted to the swap chain\n");
+
+	if (postProcessAsync)
+	{
+		const QueueTimeline::Statistics& timelineStats = computeTimeline.getStatistics();
+		std::cout << "Compute queue: " << timelineStats.submits << " submits, " << timelineStats.hostWaits << " host waits\n";
+	}
+}
+
+void VulkanApi::destroyPostProcess()
+{
+	postProcess.destroy();
+	postGraph.destroy();
+
+	for (size_t i = 0; i < sceneColorImages.size(); i++)
+	{
+		vkDestroyImageView(device, sceneColorViews[i], allocator);
+		vkDestroyImage(device, sceneColorImages[i], allocator);
+		vkFreeMemory(device, sceneColorMemory[i], allocator);
+	}
+
+	if (computeCommandPool != VK_NULL_HANDLE)
+	{
+		vkDestroyCommandPool(device, computeCommandPool, allocator);
+	}
+	if (sceneReadySemaphore != VK_NULL_HANDLE)
+	{
+		vkDestroySemaphore(device, sceneReadySemaphore, allocator);
+	}
+
+	// Set up along with the device, even if the swap chain then ruled out the compute queue
+	computeTimeline.destroy();
+}
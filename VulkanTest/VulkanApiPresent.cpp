@@ -0,0 +1,205 @@
+#include "VulkanApiImplementation.hpp"
+
+/****************************************************************************
+ * Creates the surfaces of the extra windows and the headless targets, and a present target on each. They all
+ * get the frame out of the main swap chain images, so those have to be transfer sources.
+ */
+void VulkanApi::createPresentTargets()
+{
+	// The main swap chain takes the first entry of every present
+	uint32_t maxTargets = static_cast<uint32_t>(extraWindows.size()) + headlessTargetCount;
+	presentSwapChains.reserve(maxTargets + 1);
+	presentImageIndices.reserve(maxTargets + 1);
+	presentResults.reserve(maxTargets + 1);
+	acquiredTargets.reserve(maxTargets);
+
+	if (maxTargets == 0)
+	{
+		return;
+	}
+
+	VkSurfaceCapabilitiesKHR capabilities;
+	vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface, &capabilities);
+
+	if (!(capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT))
+	{
+		std::cout << "Swap chain images can't be copied from, the extra present targets are disabled.\n";
+		return;
+	}
+
+	QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+
+	PresentTarget::Config config;
+	config.graphicsFamily = indices.graphicsFamily.value();
+	config.presentFamily = indices.presentFamily.value();
+	config.extent = { WIDTH, HEIGHT };
+	config.sourceFormat = swapChainImageFormat;
+	config.allocator = allocator;
+
+	for (uint32_t i = 0; i < maxTargets; i++)
+	{
+		GLFWwindow* targetWindow = i < extraWindows.size() ? extraWindows[i] : nullptr;
+
+		VkSurfaceKHR targetSurface = VK_NULL_HANDLE;
+		if (targetWindow != nullptr)
+		{
+			if (glfwCreateWindowSurface(instance, targetWindow, allocator, &targetSurface) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create window surface!");
+			}
+		}
+		else
+		{
+			if (!headlessSurfaceExtension)
+			{
+				std::cout << "VK_EXT_headless_surface is not supported, the headless present targets are disabled.\n";
+				break;
+			}
+
+			VkHeadlessSurfaceCreateInfoEXT surfaceInfo = {};
+			surfaceInfo.sType = VK_STRUCTURE_TYPE_HEADLESS_SURFACE_CREATE_INFO_EXT;
+
+			if (vkCreateHeadlessSurfaceEXT(instance, &surfaceInfo, allocator, &targetSurface) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create headless surface!");
+			}
+		}
+
+		PresentTarget target;
+		if (!target.init(device, physicalDevice, targetSurface, config))
+		{
+			std::cout << "Present target " << i << " can't be presented to from the present queue or blitted into, it's skipped.\n";
+			vkDestroySurfaceKHR(instance, targetSurface, allocator);
+			if (targetWindow != nullptr)
+			{
+				glfwHideWindow(targetWindow);
+			}
+			continue;
+		}
+
+		presentTargets.push_back(target);
+		presentTargetSurfaces.push_back(targetSurface);
+		presentTargetWindows.push_back(targetWindow);
+	}
+}
+
+/****************************************************************************
+ * Acquires an image on every target still enabled. A closed extra window just stops being presented to,
+ * only the main window ends the loop.
+ */
+void VulkanApi::acquirePresentTargets()
+{
+	acquiredTargets.clear();
+
+	for (uint32_t i = 0; i < presentTargets.size(); i++)
+	{
+		PresentTarget& target = presentTargets[i];
+		if (!target.isEnabled())
+		{
+			continue;
+		}
+
+		if (presentTargetWindows[i] != nullptr && glfwWindowShouldClose(presentTargetWindows[i]))
+		{
+			glfwHideWindow(presentTargetWindows[i]);
+			target.disable();
+			continue;
+		}
+
+		if (target.acquire())
+		{
+			// Its copy command buffer is re-recorded below
+			graphicsTimeline.wait(target.getImageValue());
+			acquiredTargets.push_back(i);
+		}
+	}
+}
+
+// Right after the frame's commands, in the same submission, which then signals the present semaphore for all of them
+void VulkanApi::submitPresentTargets(uint32_t imageIndex)
+{
+	for (uint32_t i : acquiredTargets)
+	{
+		PresentTarget& target = presentTargets[i];
+
+		graphicsBatcher.wait(target.getAcquireSemaphore(), VK_PIPELINE_STAGE_TRANSFER_BIT);
+		graphicsBatcher.add(target.recordCopy(swapChainImages[imageIndex], swapChainExtent));
+		target.getImageValue() = graphicsBatcher.getPendingValue();
+	}
+}
+
+/****************************************************************************
+ * One vkQueuePresentKHR for the main swap chain and every target that got the frame. The per swap chain results
+ * tell which target failed, the main one is handled as it always was - not at all.
+ */
+void VulkanApi::presentFrame(uint32_t imageIndex)
+{
+	presentSwapChains.clear();
+	presentImageIndices.clear();
+
+	presentSwapChains.push_back(swapChain);
+	presentImageIndices.push_back(imageIndex);
+	for (uint32_t i : acquiredTargets)
+	{
+		presentSwapChains.push_back(presentTargets[i].getSwapChain());
+		presentImageIndices.push_back(presentTargets[i].getImageIndex());
+	}
+	presentResults.assign(presentSwapChains.size(), VK_SUCCESS);
+
+	VkSemaphore waitSemaphores[] = { renderFinishedSemaphore };
+
+	VkPresentInfoKHR presentInfo = {};
+	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+	presentInfo.waitSemaphoreCount = 1;
+	presentInfo.pWaitSemaphores = waitSemaphores;
+	presentInfo.swapchainCount = static_cast<uint32_t>(presentSwapChains.size());
+	presentInfo.pSwapchains = presentSwapChains.data();
+	presentInfo.pImageIndices = presentImageIndices.data();
+	presentInfo.pResults = presentResults.data();
+
+	vkQueuePresentKHR(presentQueue, &presentInfo);
+
+	for (uint32_t k = 0; k < acquiredTargets.size(); k++)
+	{
+		presentTargets[acquiredTargets[k]].presented(presentResults[k + 1]);
+	}
+
+	presentCount++;
+	presentedSwapChainTotal += presentSwapChains.size();
+}
+
+void VulkanApi::printPresentTargets()
+{
+	if (presentTargets.empty())
+	{
+		return;
+	}
+
+	std::cout << "Presentation: " << static_cast<double>(presentedSwapChainTotal) / std::max<uint64_t>(presentCount, 1)
+		<< " swap chains per present on average, " << presentTargets.size() << " extra targets\n";
+
+	for (uint32_t i = 0; i < presentTargets.size(); i++)
+	{
+		const PresentTarget& target = presentTargets[i];
+		const PresentTarget::Statistics& stats = target.getStatistics();
+		std::cout << "\tTarget " << i << " (" << (presentTargetWindows[i] != nullptr ? "window" : "headless") << ", "
+			<< target.getExtent().width << "x" << target.getExtent().height << "): " << stats.presentedFrames << " frames presented, "
+			<< stats.skippedFrames << " skipped" << (target.isEnabled() ? "\n" : ", disabled\n");
+	}
+}
+
+// The targets' swap chains go before the device, their surfaces before the instance
+void VulkanApi::destroyPresentTargets()
+{
+	for (PresentTarget& target : presentTargets)
+	{
+		target.destroy();
+	}
+	for (VkSurfaceKHR targetSurface : presentTargetSurfaces)
+	{
+		vkDestroySurfaceKHR(instance, targetSurface, allocator);
+	}
+	presentTargets.clear();
+	presentTargetSurfaces.clear();
+	presentTargetWindows.clear();
+}
@@ -0,0 +1,162 @@
+#include "VulkanApiImplementation.hpp"
+
+/****************************************************************************
+ * Declares the frame as render graph passes and compiles it.
+ * This replaces the hand-written render pass and framebuffers - the graph derives the attachments,
+ * load/store ops, layouts and subpass dependencies from what each pass reads and writes.
+ */
+void VulkanApi::createRenderGraph()
+{
+	depthFormat = findDepthFormat();
+
+	RenderGraph::ImageDesc colorDesc = { swapChainImageFormat, swapChainExtent, VK_IMAGE_ASPECT_COLOR_BIT };
+	RenderGraph::ImageDesc depthDesc = { depthFormat, swapChainExtent, VK_IMAGE_ASPECT_DEPTH_BIT };
+
+	// The swap chain image is acquired with a semaphore waited on at the color attachment output stage
+	RenderGraph::ResourceHandle backbuffer = renderGraph.importImage("Backbuffer", colorDesc, swapChainImages, swapChainImageViews,
+		VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+	renderGraph.markOutput(backbuffer);
+
+	RenderGraph::ResourceHandle depth = renderGraph.createImage("Depth", depthDesc);
+
+	// With post-processing the geometry goes to an HDR image, the tonemap pass writes the backbuffer
+	RenderGraph::ResourceHandle colorTarget = postProcessActive ? addSceneColor() : backbuffer;
+
+	// With dynamic resolution it goes to a scaled image first, which is then upscaled to the color target
+	renderExtent = dynamicResolutionActive ? resolutionScaler.getExtent(swapChainExtent) : swapChainExtent;
+	imageRenderExtents.assign(swapChainImages.size(), renderExtent);
+	RenderGraph::ResourceHandle sceneTarget = dynamicResolutionActive ? addScaledScene() : colorTarget;
+
+	VkClearValue clearColor = {};
+	clearColor.color = { 0.0f, 0.0f, 0.0f, 1.0f };
+	VkClearValue clearDepth = {};
+	clearDepth.depthStencil = { 1.0f, 0 };
+
+	// Buffers only, which the graph doesn't track - the particle system synchronizes them itself
+	if (enableParticles)
+	{
+		RenderGraph::PassHandle particlePass = renderGraph.addPass("Particles", RenderGraph::PassType::Compute,
+			[this](VkCommandBuffer commandBuffer, uint32_t imageIndex)
+			{
+				particleSystem.recordSimulation(commandBuffer, imageIndex);
+			});
+		renderGraph.setSideEffects(particlePass);
+	}
+
+	if (enableDepthPrePass)
+	{
+		depthPrePass = renderGraph.addPass("Depth pre-pass", RenderGraph::PassType::Graphics,
+			[this](VkCommandBuffer commandBuffer, uint32_t imageIndex)
+			{
+				if (enableCommandCache)
+				{
+					executeCachedDepthPrePass(commandBuffer, imageIndex);
+				}
+				else
+				{
+					recordDepthPrePass(commandBuffer, imageIndex);
+				}
+			});
+		renderGraph.writeResource(depthPrePass, depth, RenderGraph::ResourceUsage::DepthStencilAttachment, &clearDepth);
+		if (enableCommandCache)
+		{
+			renderGraph.setSecondaryCommandBuffers(depthPrePass);
+		}
+	}
+
+	mainPass = renderGraph.addPass("Main", RenderGraph::PassType::Graphics,
+		[this](VkCommandBuffer commandBuffer, uint32_t imageIndex)
+		{
+			if (enableCommandCache)
+			{
+				executeCachedMainPass(commandBuffer, imageIndex);
+			}
+			else
+			{
+				recordMainPass(commandBuffer, imageIndex);
+			}
+		});
+	renderGraph.writeResource(mainPass, sceneTarget, RenderGraph::ResourceUsage::ColorAttachment, &clearColor);
+	if (enableCommandCache)
+	{
+		renderGraph.setSecondaryCommandBuffers(mainPass);
+	}
+
+	if (enableDepthPrePass)
+	{
+		renderGraph.readResource(mainPass, depth, RenderGraph::ResourceUsage::DepthStencilReadOnly);
+	}
+	else
+	{
+		renderGraph.writeResource(mainPass, depth, RenderGraph::ResourceUsage::DepthStencilAttachment, &clearDepth);
+	}
+
+	if (dynamicResolutionActive)
+	{
+		addUpscalePass(sceneTarget, colorTarget);
+	}
+
+	if (postProcessActive)
+	{
+		addPostProcessPasses(colorTarget, backbuffer);
+	}
+
+	renderGraph.compile(device, allocator, physicalDevice);
+	renderPass = renderGraph.getRenderPass(mainPass);
+
+	if (postProcessActive)
+	{
+		createPostProcessDescriptors();
+	}
+
+	const RenderGraph::Statistics& stats = renderGraph.getStatistics();
+	std::cout << "Render graph: " << stats.passCount << " passes (" << stats.culledPassCount << " culled) in "
+		<< stats.renderPassCount << " render passes, " << stats.barrierCount << " barriers, "
+		<< stats.transientMemory << " bytes of transient memory (" << stats.unaliasedTransientMemory << " without aliasing)\n";
+}
+
+void VulkanApi::recordDepthPrePass(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+	queryProfiler.beginScope(commandBuffer, imageIndex, depthPrePassScope);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, depthPrePassPipeline);
+	setRenderViewport(commandBuffer, imageIndex);
+
+	recordMeshDraw(commandBuffer, imageIndex);
+
+	queryProfiler.endScope(commandBuffer, imageIndex, depthPrePassScope);
+}
+
+void VulkanApi::recordMainPass(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+	recordMainMeshes(commandBuffer, imageIndex);
+
+	// After the opaque geometry, tested against its depth
+	if (enableParticles)
+	{
+		recordParticleDraw(commandBuffer, imageIndex);
+	}
+}
+
+void VulkanApi::recordMainMeshes(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+	// A query can't span subpasses, so each pass has its own scope - the color pass is where the overdraw cost is
+	queryProfiler.beginScope(commandBuffer, imageIndex, mainScope);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+	setRenderViewport(commandBuffer, imageIndex);
+
+	recordMeshDraw(commandBuffer, imageIndex);
+
+	queryProfiler.endScope(commandBuffer, imageIndex, mainScope);
+}
+
+// In a scope of its own, overdraw is about the geometry. Sets the viewport again, with the command cache the
+// particles are a secondary command buffer of their own.
+void VulkanApi::recordParticleDraw(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+	queryProfiler.beginScope(commandBuffer, imageIndex, particleScope);
+	setRenderViewport(commandBuffer, imageIndex);
+	particleSystem.recordDraw(commandBuffer, imageIndex, &meshConstants.viewProjection[0][0]);
+	queryProfiler.endScope(commandBuffer, imageIndex, particleScope);
+}
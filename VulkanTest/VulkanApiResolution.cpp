@@ -0,0 +1,140 @@
+#include "VulkanApiImplementation.hpp"
+
+/****************************************************************************
+ * Dynamic resolution needs the GPU frame time, and a linear blit from the scaled scene to the image that was
+ * rendered to before - the HDR scene color with post-processing, the swap chain image without. Returns the swap
+ * chain image usage the upscale needs.
+ */
+VkImageUsageFlags VulkanApi::chooseDynamicResolution(VkFormat format, const VkSurfaceCapabilitiesKHR& capabilities)
+{
+	dynamicResolutionActive = false;
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+	VkFormat targetFormat = postProcessActive ? VK_FORMAT_R16G16B16A16_SFLOAT : format;
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, targetFormat, &formatProperties);
+
+	const VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+		VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+	bool canBlit = (formatProperties.optimalTilingFeatures & blitFeatures) == blitFeatures;
+	bool canWriteTarget = postProcessActive || (capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+
+	if (!properties.limits.timestampComputeAndGraphics || !canBlit || !canWriteTarget)
+	{
+		std::cout << "Dynamic resolution: not supported, rendering at the window resolution\n";
+		return 0;
+	}
+
+	ResolutionScaler::Config config;
+	config.targetTime = dynamicResolutionBudget;
+	config.minScale = dynamicResolutionMinScale;
+	config.maxScale = dynamicResolutionMaxScale;
+	resolutionScaler.init(config);
+	dynamicResolutionActive = true;
+
+	return postProcessActive ? 0 : VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+}
+
+/****************************************************************************
+ * The scene passes render into the top left corner of a full size image, as much of it as the current scale
+ * covers, so changing the scale never recreates anything.
+ */
+RenderGraph::ResourceHandle VulkanApi::addScaledScene()
+{
+	VkFormat format = postProcessActive ? VK_FORMAT_R16G16B16A16_SFLOAT : swapChainImageFormat;
+	RenderGraph::ImageDesc desc = { format, swapChainExtent, VK_IMAGE_ASPECT_COLOR_BIT };
+	return renderGraph.createImage("Scaled scene", desc);
+}
+
+/****************************************************************************
+ * Stretches the scaled corner over the image the scene used to be rendered to, after the scene passes.
+ */
+void VulkanApi::addUpscalePass(RenderGraph::ResourceHandle scaledScene, RenderGraph::ResourceHandle colorTarget)
+{
+	// Linear filtering reads half a texel past the scaled corner at its right and bottom edges, which is cleared
+	// to the background and barely shows. Without post-processing this blit is the swap chain image's last write,
+	// so the copies out of it (frame capture, present targets) have to wait for transfer writes
+	RenderGraph::PassHandle upscalePass = renderGraph.addPass("Upscale", RenderGraph::PassType::Transfer,
+		[this, scaledScene, colorTarget](VkCommandBuffer commandBuffer, uint32_t imageIndex)
+		{
+			const VkExtent2D& extent = imageRenderExtents[imageIndex];
+
+			VkImageBlit blit = {};
+			blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+			blit.srcOffsets[1] = { static_cast<int32_t>(extent.width), static_cast<int32_t>(extent.height), 1 };
+			blit.dstSubresource = blit.srcSubresource;
+			blit.dstOffsets[1] = { static_cast<int32_t>(swapChainExtent.width), static_cast<int32_t>(swapChainExtent.height), 1 };
+
+			vkCmdBlitImage(commandBuffer, renderGraph.getImage(scaledScene, imageIndex), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				renderGraph.getImage(colorTarget, imageIndex), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+		});
+	renderGraph.readResource(upscalePass, scaledScene, RenderGraph::ResourceUsage::TransferSrc);
+	renderGraph.writeResource(upscalePass, colorTarget, RenderGraph::ResourceUsage::TransferDst);
+}
+
+void VulkanApi::setRenderViewport(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+	const VkExtent2D& extent = imageRenderExtents[imageIndex];
+
+	VkViewport viewport = { 0.0f, 0.0f, static_cast<float>(extent.width), static_cast<float>(extent.height), 0.0f, 1.0f };
+	VkRect2D scissor = { { 0, 0 }, extent };
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+}
+
+/****************************************************************************
+ * Feeds every new GPU frame time to the scaler. The viewports and the upscale are baked into the command buffers,
+ * so an image whose commands were recorded at another scale is re-recorded - its last use has finished by now.
+ * With the command cache the frame is recorded anyway, and the extent is part of the cached buffers' keys.
+ */
+void VulkanApi::updateRenderScale(uint32_t imageIndex)
+{
+	if (!dynamicResolutionActive)
+	{
+		return;
+	}
+
+	if (gpuFrameCount != scaledGpuFrameCount)
+	{
+		scaledGpuFrameCount = gpuFrameCount;
+		if (resolutionScaler.update(gpuFrameTime))
+		{
+			renderExtent = resolutionScaler.getExtent(swapChainExtent);
+		}
+	}
+
+	VkExtent2D& recordedExtent = imageRenderExtents[imageIndex];
+	if (recordedExtent.width == renderExtent.width && recordedExtent.height == renderExtent.height)
+	{
+		return;
+	}
+
+	recordedExtent = renderExtent;
+	if (enableCommandCache)
+	{
+		return;
+	}
+
+	vkResetCommandPool(device, recordingCommandPools[imageIndex], 0);
+	if (recordCommandBuffer(imageIndex) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to re-record command buffer!");
+	}
+	rerecordedCommandBuffers++;
+}
+
+void VulkanApi::printDynamicResolution()
+{
+	if (!dynamicResolutionActive)
+	{
+		return;
+	}
+
+	const ResolutionScaler::Statistics& stats = resolutionScaler.getStatistics();
+	double averageScale = stats.measurements > 0 ? stats.scaleTotal / stats.measurements : resolutionScaler.getScale();
+	std::cout << "Dynamic resolution: average scale " << averageScale << ", lowest " << stats.lowestScale << ", " << stats.changes
+		<< " changes, " << rerecordedCommandBuffers << " command buffers re-recorded, " << stats.overBudget << " of " << stats.measurements
+		<< " frames over the " << resolutionScaler.getConfig().targetTime << " ms budget\n";
+}
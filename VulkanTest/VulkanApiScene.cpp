@@ -0,0 +1,158 @@
+#include "VulkanApiImplementation.hpp"
+
+#include <chrono>
+#include <cmath>
+
+static glm::quat axisRotation(const glm::vec3& axis, float angle)
+{
+	float s = std::sin(angle * 0.5f);
+	return glm::quat(std::cos(angle * 0.5f), axis.x * s, axis.y * s, axis.z * s);
+}
+
+/****************************************************************************
+ * Builds the transform hierarchy the mesh is instanced over: a grid of groups, each a root with a ring of children,
+ * each child with its own satellites. Every level spins, so every world matrix changes every frame.
+ * The hierarchy is created level by level, which is already the breadth-first order the transform system wants.
+ */
+void VulkanApi::createScene()
+{
+	if (!meshLoaded)
+	{
+		return;
+	}
+
+	float radius = meshHeader.bounds.radius;
+	float spacing = radius * 6.0f;
+	uint32_t groupCount = sceneGridSize * sceneGridSize;
+
+	transformSystem.reserve(groupCount * (1 + sceneChildrenPerGroup * (1 + sceneSatellitesPerChild)));
+
+	std::vector<TransformSystem::TransformHandle> roots;
+	for (uint32_t z = 0; z < sceneGridSize; z++)
+	{
+		for (uint32_t x = 0; x < sceneGridSize; x++)
+		{
+			glm::vec3 position((x - (sceneGridSize - 1) * 0.5f) * spacing, 0.0f, (z - (sceneGridSize - 1) * 0.5f) * spacing);
+			roots.push_back(transformSystem.create(TransformSystem::invalidHandle, position));
+		}
+	}
+
+	std::vector<TransformSystem::TransformHandle> children;
+	for (TransformSystem::TransformHandle root : roots)
+	{
+		for (uint32_t i = 0; i < sceneChildrenPerGroup; i++)
+		{
+			float angle = glm::radians(360.0f) * i / sceneChildrenPerGroup;
+			glm::vec3 position(std::cos(angle) * radius * 2.0f, 0.0f, std::sin(angle) * radius * 2.0f);
+			children.push_back(transformSystem.create(root, position, glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(0.4f)));
+		}
+	}
+
+	for (TransformSystem::TransformHandle child : children)
+	{
+		for (uint32_t i = 0; i < sceneSatellitesPerChild; i++)
+		{
+			float angle = glm::radians(360.0f) * i / sceneSatellitesPerChild;
+			glm::vec3 position(std::cos(angle) * radius * 2.0f, radius * 1.5f, std::sin(angle) * radius * 2.0f);
+			transformSystem.create(child, position, glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(0.5f));
+		}
+	}
+
+	// Deeper levels spin faster, neighbours in opposite directions
+	sceneSpinSpeeds.resize(transformSystem.getCount());
+	for (uint32_t i = 0; i < transformSystem.getCount(); i++)
+	{
+		float speed = i < groupCount ? 0.3f : (i < groupCount * (1 + sceneChildrenPerGroup) ? 1.0f : 2.5f);
+		sceneSpinSpeeds[i] = (i & 1) ? -speed : speed;
+	}
+
+	// The instance data and the draw are rewritten every frame, so they live in host memory and the GPU reads them from there
+	size_t imageCount = swapChainImages.size();
+	VkDeviceSize instanceBufferSize = sizeof(glm::mat4) * transformSystem.getCount() * meshHeader.lodCount;
+	VkDeviceSize indirectBufferSize = sizeof(VkDrawIndexedIndirectCommand) * meshHeader.lodCount;
+	instanceBuffers.resize(imageCount);
+	instanceBufferMemory.resize(imageCount);
+	instanceData.resize(imageCount);
+	indirectBuffers.resize(imageCount);
+	indirectBufferMemory.resize(imageCount);
+	indirectCommands.resize(imageCount);
+
+	for (size_t i = 0; i < imageCount; i++)
+	{
+		createBuffer(instanceBufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			instanceBuffers[i], instanceBufferMemory[i]);
+		createBuffer(indirectBufferSize, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, indirectBuffers[i], indirectBufferMemory[i]);
+
+		void* data;
+		vkMapMemory(device, instanceBufferMemory[i], 0, instanceBufferSize, 0, &data);
+		instanceData[i] = static_cast<glm::mat4*>(data);
+		vkMapMemory(device, indirectBufferMemory[i], 0, indirectBufferSize, 0, &data);
+		indirectCommands[i] = static_cast<VkDrawIndexedIndirectCommand*>(data);
+
+		// Nothing is drawn until the first culling result
+		for (uint32_t lod = 0; lod < meshHeader.lodCount; lod++)
+		{
+			indirectCommands[i][lod] = { meshHeader.lods[lod].indexCount, 0, meshHeader.lods[lod].indexOffset, 0, 0 };
+		}
+	}
+
+	culling.resize(transformSystem.getCount());
+	lodSelector.init(meshHeader.lods, meshHeader.lodCount, transformSystem.getCount(), radius);
+
+	// Close enough that the outer groups leave the screen and the front rows hide the ones behind
+	updateCamera(glm::vec3(0.0f), spacing * sceneGridSize * 0.35f);
+
+	std::cout << "Scene: " << transformSystem.getCount() << " instances in " << groupCount << " groups\n";
+}
+
+/****************************************************************************
+ * One fixed step of the animation, on the simulation thread. The world matrices are streamed straight
+ * into the snapshot, nothing of the transform system is read by the render thread.
+ */
+void VulkanApi::stepSimulation(SceneSnapshot& snapshot, double time)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	float angleTime = static_cast<float>(time);
+	glm::quat* rotations = transformSystem.getRotations();
+	const float* speeds = sceneSpinSpeeds.data();
+
+	jobSystem.parallelFor(transformSystem.getCount(), 4096, [rotations, speeds, angleTime](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; i++)
+		{
+			rotations[i] = axisRotation(glm::vec3(0.0f, 1.0f, 0.0f), speeds[i] * angleTime);
+		}
+	});
+
+	transformSystem.update(jobSystem, snapshot.worldMatrices.data());
+	snapshot.time = time;
+
+	transformUpdateTimeTotal += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	transformUpdateCount++;
+}
+
+/****************************************************************************
+ * Takes the newest snapshot the simulation published, then the culling fills the instance buffer of this image
+ * with its visible instances. Like the command buffers, the buffers are only reused once the same swap chain
+ * image comes around again.
+ */
+void VulkanApi::updateScene(uint32_t imageIndex)
+{
+	if (!meshLoaded)
+	{
+		return;
+	}
+
+	if (!sceneSnapshots.acquire())
+	{
+		repeatedSnapshots++; // Rendering faster than the simulation steps
+	}
+
+	const SceneSnapshot& snapshot = sceneSnapshots.getReadBuffer();
+	snapshotAgeTotal += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - snapshot.publishTime).count();
+	sceneFrameCount++;
+
+	cullScene(imageIndex, snapshot.worldMatrices.data());
+}
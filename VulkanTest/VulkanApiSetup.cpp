@@ -3,6 +3,10 @@
 
 void VulkanApi::createInstance()
 {
+	// The instance level functions can only be loaded once the instance exists, everything before needs the global ones
+	loadVulkanGlobalFunctions();
+
+
 	// === Checking for extensions support ===
 
 	if (!checkRequiredExtensionsAvailability())
@@ -37,7 +41,7 @@ void VulkanApi::createInstance()
 	appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
 	appInfo.pEngineName = "No Engine";
 	appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-	appInfo.apiVersion = VK_API_VERSION_1_0;
+	appInfo.apiVersion = VK_API_VERSION_1_1; // The feature queries of the optional device extensions need 1.1
 
 
 	// === VkInstanceCreateInfo struct === NOT OPTIONAL ===
@@ -81,10 +85,12 @@ void VulkanApi::createInstance()
 	// VkResult result = vkCreateInstance(&createInfo, nullptr, &instance);
 
 	// vkCreateInstance returns either VK_SUCCESS or an error code, so we throw an exception if something fails
-	if (vkCreateInstance(&createInfo, nullptr, &instance) != VK_SUCCESS)
+	if (vkCreateInstance(&createInfo, allocator, &instance) != VK_SUCCESS)
 	{
 		throw std::runtime_error("Failed to create Vulkan instance!");
 	}
+
+	loadVulkanInstanceFunctions(instance);
 }
 
 
@@ -96,151 +102,127 @@ void VulkanApi::createInstance()
 		VkSemaphoreCreateInfo semaphoreInfo = {};
 		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-		if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphore) != VK_SUCCESS ||
-			vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphore) != VK_SUCCESS)
+		if (vkCreateSemaphore(device, &semaphoreInfo, allocator, &imageAvailableSemaphore) != VK_SUCCESS ||
+			vkCreateSemaphore(device, &semaphoreInfo, allocator, &renderFinishedSemaphore) != VK_SUCCESS)
 		{
 			throw std::runtime_error("Failed to create semaphores!");
 		}
+
+		imageTimelineValues.assign(swapChainImages.size(), 0);
+
+		if (postProcessAsync)
+		{
+			if (vkCreateSemaphore(device, &semaphoreInfo, allocator, &sceneReadySemaphore) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create semaphores!");
+			}
+
+			imageComputeValues.assign(swapChainImages.size(), 0);
+		}
 	}
 
 	void createCommandBuffers()
 	{
-		commandBuffers.resize(swapChainFramebuffers.size());
-
-		VkCommandBufferAllocateInfo allocInfo = {};
-		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-		allocInfo.commandPool = commandPool;
-		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-		allocInfo.commandBufferCount = (uint32_t)commandBuffers.size();
+		commandBuffers.resize(swapChainImages.size());
+		recordingCommandPools.resize(swapChainImages.size());
 
-		if (vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data()) != VK_SUCCESS)
-		{
-			throw std::runtime_error("Failed to allocate command buffers!");
-		}
+		// Command pools can't be used from two threads at once, so every image gets its own to be recorded in parallel
+		QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
 
 		for (size_t i = 0; i < commandBuffers.size(); i++)
 		{
-			VkCommandBufferBeginInfo beginInfo = {};
-			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-			beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
-			beginInfo.pInheritanceInfo = nullptr; // Optional
+			VkCommandPoolCreateInfo poolInfo = {};
+			poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+			poolInfo.flags = 0; // Optional
 
-			if (vkBeginCommandBuffer(commandBuffers[i], &beginInfo) != VK_SUCCESS)
+			if (vkCreateCommandPool(device, &poolInfo, allocator, &recordingCommandPools[i]) != VK_SUCCESS)
 			{
-				throw std::runtime_error("Failed to begin recording command buffer!");
+				throw std::runtime_error("Failed to create command pool!");
 			}
 
-			// Starting a render pass
-			VkRenderPassBeginInfo renderPassInfo = {};
-			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-			renderPassInfo.renderPass = renderPass;
-			renderPassInfo.framebuffer = swapChainFramebuffers[i];
-			renderPassInfo.renderArea.offset = { 0, 0 };
-			renderPassInfo.renderArea.extent = swapChainExtent;
-			VkClearValue clearColor = { 0.0f, 0.0f, 0.0f, 1.0f };
-			renderPassInfo.clearValueCount = 1;
-			renderPassInfo.pClearValues = &clearColor;
+			VkCommandBufferAllocateInfo allocInfo = {};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.commandPool = recordingCommandPools[i];
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			allocInfo.commandBufferCount = 1;
 
-			vkCmdBeginRenderPass(commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-			vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+			if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffers[i]) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to allocate command buffers!");
+			}
+		}
 
-			vkCmdDraw(commandBuffers[i], 3, 1, 0, 0);
+		// With the command cache they're recorded every frame instead
+		if (enableCommandCache)
+		{
+			return;
+		}
 
-			vkCmdEndRenderPass(commandBuffers[i]);
+		// Exceptions can't leave a job, so the results are checked afterwards
+		std::vector<VkResult> results(commandBuffers.size(), VK_SUCCESS);
+		jobSystem.parallelFor(static_cast<uint32_t>(commandBuffers.size()), 1, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i = begin; i < end; i++)
+			{
+				results[i] = recordCommandBuffer(i);
+			}
+		});
 
-			if (vkEndCommandBuffer(commandBuffers[i]) != VK_SUCCESS)
+		for (VkResult result : results)
+		{
+			if (result != VK_SUCCESS)
 			{
 				throw std::runtime_error("Failed to record command buffer!");
 			}
 		}
 	}
 
-	void createCommandPool()
+	VkResult recordCommandBuffer(uint32_t i)
 	{
-		QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
-
-		VkCommandPoolCreateInfo poolInfo = {};
-		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-		poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
-		poolInfo.flags = 0; // Optional
+		VkCommandBufferBeginInfo beginInfo = {};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		// Recorded once and submitted every time the image comes around, or recorded for every frame with the command cache
+		beginInfo.flags = enableCommandCache ? VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT : VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+		beginInfo.pInheritanceInfo = nullptr; // Optional
+
+		VkResult result = vkBeginCommandBuffer(commandBuffers[i], &beginInfo);
+		if (result != VK_SUCCESS)
+		{
+			return result;
+		}
 
-		if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS)
+		// Queries have to be reset outside of a render pass
+		queryProfiler.recordReset(commandBuffers[i], i);
+		if (timestampQueryPool != VK_NULL_HANDLE)
 		{
-			throw std::runtime_error("Failed to create command pool!");
+			vkCmdResetQueryPool(commandBuffers[i], timestampQueryPool, i * 2, 2);
+			vkCmdWriteTimestamp(commandBuffers[i], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampQueryPool, i * 2);
 		}
-	}
 
-	void createFramebuffers()
-	{
-		swapChainFramebuffers.resize(swapChainImageViews.size());
+		// The render graph records all the passes along with the barriers and render passes between them
+		renderGraph.execute(commandBuffers[i], i);
 
-		// We'll iterate through the image views and create framebuffers for them
-		for (size_t i = 0; i < swapChainImageViews.size(); i++)
+		if (timestampQueryPool != VK_NULL_HANDLE)
 		{
-			VkImageView attachments[] =
-			{
-				swapChainImageViews[i]
-			};
-
-			VkFramebufferCreateInfo framebufferInfo = {};
-			framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-			framebufferInfo.renderPass = renderPass;
-			framebufferInfo.attachmentCount = 1;
-			framebufferInfo.pAttachments = attachments;
-			framebufferInfo.width = swapChainExtent.width;
-			framebufferInfo.height = swapChainExtent.height;
-			framebufferInfo.layers = 1;
-
-			if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &swapChainFramebuffers[i]) != VK_SUCCESS)
-			{
-				throw std::runtime_error("Failed to create framebuffer!");
-			}
+			vkCmdWriteTimestamp(commandBuffers[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampQueryPool, i * 2 + 1);
 		}
+
+		return vkEndCommandBuffer(commandBuffers[i]);
 	}
 
-	void createRenderPass()
+	void createCommandPool()
 	{
-		VkAttachmentDescription colorAttachment = {};
-		colorAttachment.format = swapChainImageFormat;
-		colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-		colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR; // What to do with the data before rendering; Using clear mode clears the framebuffer to black before drawing
-		colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE; // What to do with the data after rendering; We choose to store rendered contents in memory
-		colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE; // We don't have the stencil data, so these two lines are irrelevant
-		colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED; // Using undefined layout means that we don't care what previous layout the image was in
-		colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-		VkAttachmentReference colorAttachmentRef = {};
-		colorAttachmentRef.attachment = 0; // Specifies which attachment in the attachment descriptions array to reference
-		colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL; // We intend to use the attachment function as a color buffer
-
-		VkSubpassDescription subpass = {};
-		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-		subpass.colorAttachmentCount = 1;
-		subpass.pColorAttachments = &colorAttachmentRef; // The index of the attachment in this array is directly referenced from the fragment shader
-
-		VkRenderPassCreateInfo renderPassInfo = {};
-		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-		renderPassInfo.attachmentCount = 1;
-		renderPassInfo.pAttachments = &colorAttachment;
-		renderPassInfo.subpassCount = 1;
-		renderPassInfo.pSubpasses = &subpass;
-
-		VkSubpassDependency dependency = {};
-		dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-		dependency.dstSubpass = 0;
-		dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependency.srcAccessMask = 0;
-		dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
-		renderPassInfo.dependencyCount = 1;
-		renderPassInfo.pDependencies = &dependency;
-
-		if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS)
-		{
-			throw std::runtime_error("Failed to create render pass!");
+		QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
+
+		VkCommandPoolCreateInfo poolInfo = {};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+		poolInfo.flags = 0; // Optional
+
+		if (vkCreateCommandPool(device, &poolInfo, allocator, &commandPool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create command pool!");
 		}
 	}
 
@@ -248,8 +230,9 @@ void VulkanApi::createInstance()
 	{
 		// After creating graphics pipeline the shader modules can be deleted,
 		// so they are created as local variables, not as members of the class
-		auto vertShaderCode = readFile("shaders/vert.spv");
-		auto fragShaderCode = readFile("shaders/frag.spv");
+		// The mesh shader reads the vertex attributes, the default one has its triangle built in
+		auto vertShaderCode = readFile(meshLoaded ? "shaders/mesh.spv" : "shaders/vert.spv");
+		auto fragShaderCode = readFile(meshLoaded && bindlessActive ? "shaders/bindless.spv" : "shaders/frag.spv");
 
 		VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
 		VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
@@ -278,12 +261,19 @@ void VulkanApi::createInstance()
 
 
 		// Here we create the vertex input
+		std::vector<VkVertexInputBindingDescription> bindingDescriptions;
+		std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+		if (meshLoaded)
+		{
+			getMeshVertexInput(bindingDescriptions, attributeDescriptions);
+		}
+
 		VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
 		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-		vertexInputInfo.vertexBindingDescriptionCount = 0;
-		vertexInputInfo.pVertexBindingDescriptions = nullptr; // Optional
-		vertexInputInfo.vertexAttributeDescriptionCount = 0;
-		vertexInputInfo.pVertexAttributeDescriptions = nullptr; // Optional
+		vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
+		vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
+		vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+		vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 
 
 		// Input assembly
@@ -293,29 +283,11 @@ void VulkanApi::createInstance()
 		inputAssembly.primitiveRestartEnable = VK_FALSE;
 
 
-		// Viewport creation
-		VkViewport viewport = {};
-		viewport.x = 0.0f;
-		viewport.y = 0.0f;
-		viewport.width = (float)swapChainExtent.width;
-		viewport.height = (float)swapChainExtent.height;
-		viewport.minDepth = 0.0f;
-		viewport.maxDepth = 1.0f;
-
-
-		// Scissor rectangle
-		VkRect2D scissor = {};
-		scissor.offset = { 0, 0 };
-		scissor.extent = swapChainExtent;
-
-
-		// Viewport state creation
+		// Viewport state creation, the viewport and scissor are dynamic - they follow the render scale
 		VkPipelineViewportStateCreateInfo viewportState = {};
 		viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
 		viewportState.viewportCount = 1;
-		viewportState.pViewports = &viewport;
 		viewportState.scissorCount = 1;
-		viewportState.pScissors = &scissor;
 
 
 		// Creating a rasterizer
@@ -326,7 +298,9 @@ void VulkanApi::createInstance()
 		rasterizer.polygonMode = VK_POLYGON_MODE_FILL; // Determines how fragments are generated for geometry
 		rasterizer.lineWidth = 1.0f; // Lines thicker than 1.0f require us to enable wideLines GPU feature
 		rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-		rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE; // Vertex order for faces to be considered fron facing
+		// Vertex order for faces to be considered fron facing
+		// Meshes keep the usual counter clockwise winding, which the Y flip in the projection turns into clockwise on screen
+		rasterizer.frontFace = meshLoaded ? VK_FRONT_FACE_COUNTER_CLOCKWISE : VK_FRONT_FACE_CLOCKWISE;
 		rasterizer.depthBiasEnable = VK_FALSE;
 		rasterizer.depthBiasConstantFactor = 0.0f; // Optional
 		rasterizer.depthBiasClamp = 0.0f; // Optional
@@ -344,7 +318,18 @@ void VulkanApi::createInstance()
 		multisampling.alphaToOneEnable = VK_FALSE; // Optional
 
 
-		// Here we can create the Depth Stencil creation info, but we'll leave it and come back to it later
+		// Depth and stencil testing
+		// With the depth pre-pass the depth buffer is already final when the color pass runs,
+		// so the color pass only tests against it, without writing
+		VkPipelineDepthStencilStateCreateInfo depthStencil = {};
+		depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+		depthStencil.depthTestEnable = VK_TRUE;
+		depthStencil.depthWriteEnable = enableDepthPrePass ? VK_FALSE : VK_TRUE;
+		depthStencil.depthCompareOp = enableDepthPrePass ? VK_COMPARE_OP_LESS_OR_EQUAL : VK_COMPARE_OP_LESS; // Lower depth means closer
+		depthStencil.depthBoundsTestEnable = VK_FALSE;
+		depthStencil.minDepthBounds = 0.0f; // Optional
+		depthStencil.maxDepthBounds = 1.0f; // Optional
+		depthStencil.stencilTestEnable = VK_FALSE;
 
 
 		// Color blending
@@ -382,7 +367,7 @@ void VulkanApi::createInstance()
 		VkDynamicState dynamicStates[] =
 		{
 			VK_DYNAMIC_STATE_VIEWPORT,
-			VK_DYNAMIC_STATE_LINE_WIDTH
+			VK_DYNAMIC_STATE_SCISSOR
 		};
 		VkPipelineDynamicStateCreateInfo dynamicState = {};
 		dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
@@ -391,14 +376,20 @@ void VulkanApi::createInstance()
 
 
 		// Pipeline layout
+		VkPushConstantRange pushConstantRange = {};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(MeshPushConstants);
+
 		VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
 		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		pipelineLayoutInfo.setLayoutCount = 0; // Optional
-		pipelineLayoutInfo.pSetLayouts = nullptr; // Optional
-		pipelineLayoutInfo.pushConstantRangeCount = 0; // Optional
-		pipelineLayoutInfo.pPushConstantRanges = nullptr; // Optional
+		VkDescriptorSetLayout bindlessLayout = bindlessTable.getLayout();
+		pipelineLayoutInfo.setLayoutCount = bindlessActive ? 1 : 0;
+		pipelineLayoutInfo.pSetLayouts = bindlessActive ? &bindlessLayout : nullptr;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
-		if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+		if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, allocator, &pipelineLayout) != VK_SUCCESS)
 		{
 			throw std::runtime_error("Failed to create pipeline layout!");
 		}
@@ -414,24 +405,63 @@ void VulkanApi::createInstance()
 		pipelineInfo.pViewportState = &viewportState;
 		pipelineInfo.pRasterizationState = &rasterizer;
 		pipelineInfo.pMultisampleState = &multisampling;
-		pipelineInfo.pDepthStencilState = nullptr; // Optional
+		pipelineInfo.pDepthStencilState = &depthStencil;
 		pipelineInfo.pColorBlendState = &colorBlending;
-		pipelineInfo.pDynamicState = nullptr; // Optional
+		pipelineInfo.pDynamicState = &dynamicState;
 
 		pipelineInfo.layout = pipelineLayout;
 		pipelineInfo.renderPass = renderPass;
-		pipelineInfo.subpass = 0;
+		pipelineInfo.subpass = renderGraph.getSubpassIndex(mainPass);
 
 		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
 		pipelineInfo.basePipelineIndex = -1; // Optional
 
-		if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS)
+		std::vector<VkGraphicsPipelineCreateInfo> pipelineInfos = { pipelineInfo };
+		std::vector<VkPipeline*> pipelines = { &graphicsPipeline };
+
+		// The depth pre-pass pipeline reuses the same state, but has no fragment stage and writes no color
+		VkPipelineDepthStencilStateCreateInfo prePassDepthStencil = depthStencil;
+		VkPipelineColorBlendAttachmentState prePassBlendAttachment = colorBlendAttachment;
+		VkPipelineColorBlendStateCreateInfo prePassColorBlending = colorBlending;
+		if (enableDepthPrePass)
+		{
+			prePassDepthStencil.depthWriteEnable = VK_TRUE;
+			prePassDepthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+			prePassBlendAttachment.colorWriteMask = 0;
+			prePassColorBlending.pAttachments = &prePassBlendAttachment;
+
+			VkGraphicsPipelineCreateInfo prePassInfo = pipelineInfo;
+			prePassInfo.stageCount = 1;
+			prePassInfo.pDepthStencilState = &prePassDepthStencil;
+			prePassInfo.pColorBlendState = &prePassColorBlending;
+			prePassInfo.renderPass = renderGraph.getRenderPass(depthPrePass);
+			prePassInfo.subpass = renderGraph.getSubpassIndex(depthPrePass);
+
+			pipelineInfos.push_back(prePassInfo);
+			pipelines.push_back(&depthPrePassPipeline);
+		}
+
+		// Shader compilation in the driver is the slow part, so every pipeline is compiled on its own job
+		std::vector<VkResult> results(pipelineInfos.size(), VK_SUCCESS);
+		jobSystem.parallelFor(static_cast<uint32_t>(pipelineInfos.size()), 1, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i = begin; i < end; i++)
+			{
+				results[i] = vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfos[i], allocator, pipelines[i]);
+			}
+		});
+
+		if (results[0] != VK_SUCCESS)
 		{
 			throw std::runtime_error("Failed to create graphics pipeline!");
 		}
+		if (enableDepthPrePass && results[1] != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create depth pre-pass pipeline!");
+		}
 
-		vkDestroyShaderModule(device, fragShaderModule, nullptr);
-		vkDestroyShaderModule(device, vertShaderModule, nullptr);
+		vkDestroyShaderModule(device, fragShaderModule, allocator);
+		vkDestroyShaderModule(device, vertShaderModule, allocator);
 	}
 
 	VkShaderModule createShaderModule(const std::vector<char>& code)
@@ -446,7 +476,7 @@ void VulkanApi::createInstance()
 		createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
 
 		VkShaderModule shaderModule;
-		if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS)
+		if (vkCreateShaderModule(device, &createInfo, allocator, &shaderModule) != VK_SUCCESS)
 		{
 			throw std::runtime_error("Failed to create shader module!");
 		}
@@ -481,7 +511,7 @@ void VulkanApi::createInstance()
 			createInfo.subresourceRange.baseArrayLayer = 0;
 			createInfo.subresourceRange.layerCount = 1;
 
-			if (vkCreateImageView(device, &createInfo, nullptr, &swapChainImageViews[i]) != VK_SUCCESS)
+			if (vkCreateImageView(device, &createInfo, allocator, &swapChainImageViews[i]) != VK_SUCCESS)
 			{
 				throw std::runtime_error("Failed to create image views!");
 			}
@@ -491,7 +521,7 @@ void VulkanApi::createInstance()
 	void createSurface()
 	{
 		// Using glfwCreateWindowSurface to create a surface for window regardless of platform
-		if (glfwCreateWindowSurface(instance, window, nullptr, &surface) != VK_SUCCESS)
+		if (glfwCreateWindowSurface(instance, window, allocator, &surface) != VK_SUCCESS)
 		{
 			throw std::runtime_error("Failed to create window surface!");
 		}
@@ -528,15 +558,39 @@ void VulkanApi::createInstance()
 		createInfo.imageArrayLayers = 1; // This specifies the amount of layers each image consists of. Should be 1 unless dealing with stereoscopic application
 		createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT; // Set the images for rendering directly to them
 
+		// Frame capture and the extra present targets copy out of the swap chain images
+		bool copiesSwapChain = enableFrameCapture || extraWindowCount > 0 || headlessTargetCount > 0;
+		if (copiesSwapChain && (swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT))
+		{
+			createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		}
+
+		// The tonemap pass writes the swap chain images as storage images, or they get its result blitted in
+		if (postProcessActive)
+		{
+			createInfo.imageUsage |= choosePostProcessOutput(surfaceFormat.format, swapChainSupport.capabilities);
+		}
+
+		// Without post-processing the scaled scene is upscaled straight into them
+		if (enableDynamicResolution)
+		{
+			createInfo.imageUsage |= chooseDynamicResolution(surfaceFormat.format, swapChainSupport.capabilities);
+		}
+
 		QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
-		uint32_t queueFamilyIndices[] = { indices.graphicsFamily.value(), indices.presentFamily.value() };
+		std::set<uint32_t> sharingFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value() };
+		if (postProcessAsync)
+		{
+			sharingFamilies.insert(indices.computeFamily.value());
+		}
+		std::vector<uint32_t> queueFamilyIndices(sharingFamilies.begin(), sharingFamilies.end());
 
 		// If we have a one queue family, set the sharing mode to exclusive, otherwise choose concurrent
-		if (indices.graphicsFamily != indices.presentFamily)
+		if (queueFamilyIndices.size() > 1)
 		{
 			createInfo.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
-			createInfo.queueFamilyIndexCount = 2;
-			createInfo.pQueueFamilyIndices = queueFamilyIndices;
+			createInfo.queueFamilyIndexCount = static_cast<uint32_t>(queueFamilyIndices.size());
+			createInfo.pQueueFamilyIndices = queueFamilyIndices.data();
 		}
 		else
 		{
@@ -560,7 +614,7 @@ void VulkanApi::createInstance()
 		createInfo.oldSwapchain = VK_NULL_HANDLE;
 
 		// Creating the swap chain instance
-		if (vkCreateSwapchainKHR(device, &createInfo, nullptr, &swapChain) != VK_SUCCESS)
+		if (vkCreateSwapchainKHR(device, &createInfo, allocator, &swapChain) != VK_SUCCESS)
 		{
 			throw std::runtime_error("Failed to create swap chain!");
 		}
@@ -678,6 +732,16 @@ void VulkanApi::createInstance()
 		std::vector<VkDeviceQueueCreateInfo> queueCreateInfos = {};
 		std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value() };
 
+		// The post-processing gets a queue of its own only if nothing has to copy out of the swap chain on the graphics queue
+		uint32_t subgroupSize = 0;
+		bool copiesSwapChain = enableFrameCapture || extraWindowCount > 0 || headlessTargetCount > 0;
+		postProcessActive = enablePostProcess && PostProcess::isSupported(physicalDevice, subgroupSize);
+		postProcessAsync = postProcessActive && enableAsyncPostProcess && !copiesSwapChain && indices.computeFamily.has_value();
+		if (postProcessAsync)
+		{
+			uniqueQueueFamilies.insert(indices.computeFamily.value());
+		}
+
 		// Setting the queue priority number (should be between 0.0f and 1.0f)
 		float queuePriority = 1.0f;
 
@@ -686,14 +750,50 @@ void VulkanApi::createInstance()
 			VkDeviceQueueCreateInfo queueCreateInfo = {};
 
 			queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+			queueCreateInfo.queueFamilyIndex = queueFamily;
 			queueCreateInfo.queueCount = 1;
 			queueCreateInfo.pQueuePriorities = &queuePriority;
 
 			queueCreateInfos.push_back(queueCreateInfo);
 		}
 
-		// For now we're leaving physical device features untouched, we'll come back to it later
+		// Enabling only the optional features we actually use
+		VkPhysicalDeviceFeatures supportedFeatures;
+		vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+
 		VkPhysicalDeviceFeatures deviceFeatures = {};
+		deviceFeatures.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery; // Used for measuring overdraw and vertex reuse
+		deviceFeatures.occlusionQueryPrecise = supportedFeatures.occlusionQueryPrecise; // Exact passed sample counts per pass
+		if (postProcessActive)
+		{
+			// The tonemap pass can then write swap chain formats it has no format qualifier for
+			deviceFeatures.shaderStorageImageWriteWithoutFormat = supportedFeatures.shaderStorageImageWriteWithoutFormat;
+		}
+
+		// Descriptor indexing is optional, without it the meshes are drawn untextured
+		std::vector<const char*> extensions(deviceExtensions.begin(), deviceExtensions.end());
+		VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+		bindlessActive = enableBindless && BindlessTable::isSupported(physicalDevice, indexingFeatures);
+		if (bindlessActive)
+		{
+			extensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+		}
+
+		// Timeline semaphores are optional too, the queue timeline falls back to fences
+		VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures = {};
+		bool useTimelineSemaphore = enableTimelineSemaphores && QueueTimeline::isSupported(physicalDevice, timelineFeatures);
+		if (useTimelineSemaphore)
+		{
+			extensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+			timelineFeatures.pNext = bindlessActive ? &indexingFeatures : nullptr;
+		}
+
+		// Without the memory budget extension the budget is estimated from the heap sizes
+		memoryBudgetExtension = enableMemoryBudget && MemoryBudget::isSupported(physicalDevice);
+		if (memoryBudgetExtension)
+		{
+			extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+		}
 
 
 		// Creating the logical device
@@ -703,11 +803,19 @@ void VulkanApi::createInstance()
 		createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
 		createInfo.pEnabledFeatures = &deviceFeatures;
+		if (useTimelineSemaphore)
+		{
+			createInfo.pNext = &timelineFeatures;
+		}
+		else if (bindlessActive)
+		{
+			createInfo.pNext = &indexingFeatures;
+		}
 
 		// New versions of Vulkan ignore validation layers of a device, 
 		// but it is still a good idea to set them anyways to ensure backwards compatibility
-		createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-		createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+		createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+		createInfo.ppEnabledExtensionNames = extensions.data();
 
 		if (enableValidationLayers)
 		{
@@ -720,13 +828,27 @@ void VulkanApi::createInstance()
 		}
 
 		// Instantiation of the logical device happens here, and check if the procedure completed succesfully
-		if (vkCreateDevice(physicalDevice, &createInfo, nullptr, &device) != VK_SUCCESS)
+		if (vkCreateDevice(physicalDevice, &createInfo, allocator, &device) != VK_SUCCESS)
 		{
 			throw std::runtime_error("Failed to create logical device!");
 		}
 
+		// From here on the device functions skip the loader
+		uint32_t deviceFunctionCount = loadVulkanDeviceFunctions(device);
+		std::cout << "Dispatch: " << deviceFunctionCount << " device functions loaded from the driver\n";
+
 		vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
 		vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
+
+		graphicsTimeline.init(device, allocator, graphicsQueue, useTimelineSemaphore);
+		graphicsBatcher.init(graphicsTimeline);
+
+		if (postProcessAsync)
+		{
+			vkGetDeviceQueue(device, indices.computeFamily.value(), 0, &computeQueue);
+			computeTimeline.init(device, allocator, computeQueue, useTimelineSemaphore);
+			computeBatcher.init(computeTimeline);
+		}
 	}
 
 	void pickPhysicalDevice()
@@ -914,6 +1036,16 @@ void VulkanApi::createInstance()
 			i++;
 		}
 
+		// A family without graphics usually maps to the GPU's asynchronous compute queues
+		for (uint32_t j = 0; j < queueFamilyCount; j++)
+		{
+			if (queueFamilies[j].queueCount > 0 && (queueFamilies[j].queueFlags & VK_QUEUE_COMPUTE_BIT) && !(queueFamilies[j].queueFlags & VK_QUEUE_GRAPHICS_BIT))
+			{
+				indices.computeFamily = j;
+				break;
+			}
+		}
+
 		return indices;
 	}
 
@@ -927,7 +1059,7 @@ void VulkanApi::createInstance()
 		populateDebugMessengerCreateInfo(createInfo);
 
 		// Create the extension object if available
-		if (CreateDebugUtilsMessengerEXT(instance, &createInfo, nullptr, &debugMessenger) != VK_SUCCESS)
+		if (CreateDebugUtilsMessengerEXT(instance, &createInfo, allocator, &debugMessenger) != VK_SUCCESS)
 		{
 			throw std::runtime_error("Failed to set up debug messenger!");
 		}
@@ -0,0 +1,121 @@
+#include "VulkanApiImplementation.hpp"
+
+#include <chrono>
+
+/****************************************************************************
+ * The first snapshot is simulated right here, so the render thread always has one to take.
+ * Every slot gets its matrices now, the steps only ever overwrite them.
+ */
+void VulkanApi::startSimulation()
+{
+	if (!meshLoaded)
+	{
+		return;
+	}
+
+	for (uint32_t i = 0; i < 3; i++)
+	{
+		sceneSnapshots.getSlot(i).worldMatrices.resize(transformSystem.getCount());
+	}
+
+	SceneSnapshot& first = sceneSnapshots.getWriteBuffer();
+	stepSimulation(first, 0.0);
+	first.step = 0;
+	first.publishTime = std::chrono::steady_clock::now();
+	sceneSnapshots.publish();
+	sceneSnapshots.acquire();
+
+	simulationRunning = true;
+	simulationThread = std::thread(&VulkanApi::simulationLoop, this);
+}
+
+void VulkanApi::stopSimulation()
+{
+	if (!simulationThread.joinable())
+	{
+		return;
+	}
+
+	simulationRunning = false;
+	simulationThread.join();
+}
+
+/****************************************************************************
+ * Fixed timestep: a step is due every simulationTimestep seconds of real time, and the thread sleeps in between.
+ * If it falls far behind (a debugger break, a stalled machine) the missed steps are dropped instead of
+ * being caught up all at once. Pausing stops the simulated time, the steps keep coming.
+ */
+void VulkanApi::simulationLoop()
+{
+	jobSystem.attachThread();
+
+	const auto stepDuration = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(simulationTimestep));
+	auto nextStep = std::chrono::steady_clock::now() + stepDuration;
+	uint64_t step = 0;
+	double time = 0.0;
+
+	while (simulationRunning.load(std::memory_order_acquire))
+	{
+		std::this_thread::sleep_until(nextStep);
+
+		// The input is read at the step that uses it, not when the frame that shows it started
+		step++;
+		if (!simulationPaused.load(std::memory_order_relaxed))
+		{
+			time += simulationTimestep;
+		}
+
+		SceneSnapshot& snapshot = sceneSnapshots.getWriteBuffer();
+		stepSimulation(snapshot, time);
+		snapshot.step = step;
+		snapshot.publishTime = std::chrono::steady_clock::now();
+		sceneSnapshots.publish();
+
+		nextStep += stepDuration;
+		auto now = std::chrono::steady_clock::now();
+		if (now > nextStep + stepDuration * 4)
+		{
+			droppedSimulationSteps += (now - nextStep) / stepDuration;
+			nextStep = now;
+		}
+	}
+}
+
+/****************************************************************************
+ * Called by the render thread once the frame's image and the resources of its last use are available -
+ * the latest point before anything the input affects is read.
+ */
+void VulkanApi::sampleInput()
+{
+	glfwPollEvents();
+
+	bool pauseKey = glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS;
+	if (pauseKey && !pauseKeyDown)
+	{
+		simulationPaused = !simulationPaused;
+	}
+	pauseKeyDown = pauseKey;
+
+	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+	{
+		glfwSetWindowShouldClose(window, GLFW_TRUE);
+	}
+}
+
+void VulkanApi::printSimulationStatistics()
+{
+	if (transformUpdateCount == 0)
+	{
+		return;
+	}
+
+	std::cout << "Simulation: " << transformUpdateCount << " steps at " << 1.0 / simulationTimestep << " Hz on its own thread, "
+		<< transformSystem.getCount() << " transforms updated in " << transformUpdateTimeTotal / transformUpdateCount << " ms on average, "
+		<< droppedSimulationSteps << " steps dropped\n";
+
+	if (sceneFrameCount > 0)
+	{
+		std::cout << "Snapshots: " << sceneFrameCount << " rendered, " << repeatedSnapshots << " of them repeated, "
+			<< snapshotAgeTotal / sceneFrameCount << " ms old on average when taken\n";
+	}
+}
@@ -0,0 +1,138 @@
+#include "VulkanApiImplementation.hpp"
+
+/****************************************************************************
+ * Query scopes around the graphics passes, one slot per swap chain image.
+ * Counting fragment shader invocations lets us see how much overdraw the frame has, e.g. with and without
+ * the depth pre-pass, and vertex shader invocations against the indexed vertices how well the cache is reused.
+ */
+void VulkanApi::createQueryProfiler()
+{
+	if (!enablePassQueries)
+	{
+		return;
+	}
+
+	QueryProfiler::Config config;
+	queryProfiler.init(device, allocator, physicalDevice, static_cast<uint32_t>(swapChainImages.size()), config);
+
+	if (enableDepthPrePass)
+	{
+		depthPrePassScope = queryProfiler.addScope("Depth pre-pass");
+	}
+	mainScope = queryProfiler.addScope("Main");
+	if (enableParticles)
+	{
+		particleScope = queryProfiler.addScope("Particles");
+	}
+
+	const QueryProfiler::Statistics& stats = queryProfiler.getStatistics();
+	if (!stats.pipelineStatistics)
+	{
+		std::cout << "Pipeline statistics queries not supported, overdraw will not be measured.\n";
+	}
+}
+
+/****************************************************************************
+ * Creates a timestamp query pool with a begin and end query per swap chain image.
+ * The GPU frame time is the cost that vertex formats, culling or resolution changes are compared by.
+ */
+void VulkanApi::createTimestampQueryPool()
+{
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+	if (!properties.limits.timestampComputeAndGraphics)
+	{
+		std::cout << "Timestamp queries not supported, GPU frame time will not be measured.\n";
+		return;
+	}
+
+	timestampPeriod = properties.limits.timestampPeriod;
+
+	VkQueryPoolCreateInfo queryPoolInfo = {};
+	queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	queryPoolInfo.queryCount = static_cast<uint32_t>(swapChainImages.size()) * 2;
+
+	if (vkCreateQueryPool(device, &queryPoolInfo, allocator, &timestampQueryPool) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create timestamp query pool!");
+	}
+}
+
+/****************************************************************************
+ * Reads the result written the last time the image's command buffer was executed.
+ * The read never waits - if the result isn't available yet, the previous values are kept.
+ */
+void VulkanApi::readPipelineStatistics(uint32_t imageIndex)
+{
+	if (timestampQueryPool != VK_NULL_HANDLE)
+	{
+		// Begin and end timestamps, each followed by its availability flag
+		uint64_t timestamps[4] = {};
+		VkResult result = vkGetQueryPoolResults(device, timestampQueryPool, imageIndex * 2, 2, sizeof(timestamps), timestamps, 2 * sizeof(uint64_t),
+			VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+		if ((result == VK_SUCCESS || result == VK_NOT_READY) && timestamps[1] != 0 && timestamps[3] != 0)
+		{
+			gpuFrameTime = (timestamps[2] - timestamps[0]) * timestampPeriod / 1000000.0;
+			gpuFrameTimeTotal += gpuFrameTime;
+			gpuFrameCount++;
+		}
+	}
+
+	queryProfiler.collect(imageIndex);
+	if (queryProfiler.getScopeCount() > 0)
+	{
+		// Pixels at the scale the image's commands were recorded with, which is what the queries counted
+		const VkExtent2D& extent = imageRenderExtents[imageIndex];
+		overdrawRatio = static_cast<float>(queryProfiler.getLatest(mainScope).fragmentInvocations) / (extent.width * extent.height);
+	}
+}
+
+/****************************************************************************
+ * Averages over the frames whose queries were all available. Vertex reuse is indexed vertices per
+ * vertex shader invocation, clipped is the share of primitives that reached the clipper and left it.
+ */
+void VulkanApi::printPassStatistics()
+{
+	if (queryProfiler.getScopeCount() == 0)
+	{
+		return;
+	}
+
+	const QueryProfiler::Statistics& stats = queryProfiler.getStatistics();
+	for (QueryProfiler::ScopeHandle scope = 0; scope < queryProfiler.getScopeCount(); scope++)
+	{
+		QueryProfiler::Counters counters = queryProfiler.getAverage(scope);
+		std::cout << "Pass " << queryProfiler.getName(scope) << ":";
+		if (stats.pipelineStatistics)
+		{
+			double vertexReuse = counters.vertexInvocations > 0 ? static_cast<double>(counters.inputVertices) / counters.vertexInvocations : 0.0;
+			double clipped = counters.clippingInvocations > 0 ? static_cast<double>(counters.clippingPrimitives) / counters.clippingInvocations : 0.0;
+			std::cout << " " << counters.inputPrimitives << " primitives, " << counters.vertexInvocations << " vertex invocations (reuse "
+				<< vertexReuse << "), " << clipped * 100.0 << "% past clipping, " << counters.fragmentInvocations << " fragment invocations,";
+		}
+		if (stats.occlusion)
+		{
+			std::cout << " " << counters.samplesPassed << (stats.preciseOcclusion ? "" : " (approximate)") << " samples passed,";
+		}
+		if (stats.timestamps)
+		{
+			std::cout << " " << counters.gpuTime << " ms";
+		}
+		std::cout << "\n";
+	}
+
+	std::cout << "Pass queries: " << stats.collectedFrames << " frames collected, " << stats.unavailableResults
+		<< " results not ready, overdraw " << overdrawRatio << "\n";
+}
+
+// A benchmark that computes something wrong has measured nothing, so it fails the run like the allocation check does
+void VulkanApi::checkBenchmarkResult(const char* benchmark, bool matchesReference)
+{
+	if (!matchesReference)
+	{
+		throw std::runtime_error(std::string(benchmark) + " benchmark result doesn't match the reference!");
+	}
+}
@@ -0,0 +1,46 @@
+#include "VulkanApiImplementation.hpp"
+
+#include <filesystem>
+
+/****************************************************************************
+ * Starts the texture streamer and queues every image found in the textures directory.
+ * The uploads go to the graphics queue, since the mip chain is generated with blits, and the decoding to the job system.
+ */
+void VulkanApi::createTextureStreamer()
+{
+	QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+
+	TextureStreamer::Config config;
+	textureBudgetLimit = config.residencyBudget;
+	textureStreamer.init(device, allocator, physicalDevice, graphicsBatcher, indices.graphicsFamily.value(), deletionQueue, &jobSystem, config);
+
+	std::error_code error;
+	if (!std::filesystem::is_directory(textureDirectory, error))
+	{
+		return;
+	}
+
+	for (const auto& entry : std::filesystem::directory_iterator(textureDirectory, error))
+	{
+		std::string extension = entry.path().extension().string();
+		if (entry.is_regular_file() && (extension == ".tga" || extension == ".ppm"))
+		{
+			textures.push_back(textureStreamer.load(entry.path().string()));
+		}
+	}
+
+	std::cout << "Streaming " << textures.size() << " textures from " << textureDirectory << "\n";
+}
+
+void VulkanApi::updateTextureStreaming()
+{
+	// Nothing samples the textures yet, so all of them ask for their full resolution
+	for (auto texture : textures)
+	{
+		textureStreamer.requestMip(texture, 0, frameNumber);
+	}
+
+	updateMemoryBudget();
+
+	textureStreamer.update(frameNumber);
+}
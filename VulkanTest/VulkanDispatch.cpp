@@ -0,0 +1,67 @@
+#include "VulkanDispatch.hpp"
+
+#include <stdexcept>
+#include <string>
+
+#define VULKAN_DEFINE_FUNCTION(name) PFN_##name name = nullptr;
+VULKAN_GLOBAL_FUNCTIONS(VULKAN_DEFINE_FUNCTION)
+VULKAN_INSTANCE_FUNCTIONS(VULKAN_DEFINE_FUNCTION)
+VULKAN_OPTIONAL_INSTANCE_FUNCTIONS(VULKAN_DEFINE_FUNCTION)
+VULKAN_DEVICE_FUNCTIONS(VULKAN_DEFINE_FUNCTION)
+VULKAN_OPTIONAL_DEVICE_FUNCTIONS(VULKAN_DEFINE_FUNCTION)
+#undef VULKAN_DEFINE_FUNCTION
+
+static void checkLoaded(PFN_vkVoidFunction function, const char* name)
+{
+	if (function == nullptr)
+	{
+		throw std::runtime_error("Failed to load " + std::string(name) + "!");
+	}
+}
+
+void loadVulkanGlobalFunctions()
+{
+#define VULKAN_LOAD_FUNCTION(name) \
+	name = reinterpret_cast<PFN_##name>(vkGetInstanceProcAddr(VK_NULL_HANDLE, #name)); \
+	checkLoaded(reinterpret_cast<PFN_vkVoidFunction>(name), #name);
+	VULKAN_GLOBAL_FUNCTIONS(VULKAN_LOAD_FUNCTION)
+#undef VULKAN_LOAD_FUNCTION
+}
+
+void loadVulkanInstanceFunctions(VkInstance instance)
+{
+#define VULKAN_LOAD_FUNCTION(name) \
+	name = reinterpret_cast<PFN_##name>(vkGetInstanceProcAddr(instance, #name)); \
+	checkLoaded(reinterpret_cast<PFN_vkVoidFunction>(name), #name);
+	VULKAN_INSTANCE_FUNCTIONS(VULKAN_LOAD_FUNCTION)
+#undef VULKAN_LOAD_FUNCTION
+
+	// Null when the extension isn't enabled on the instance
+#define VULKAN_LOAD_FUNCTION(name) name = reinterpret_cast<PFN_##name>(vkGetInstanceProcAddr(instance, #name));
+	VULKAN_OPTIONAL_INSTANCE_FUNCTIONS(VULKAN_LOAD_FUNCTION)
+#undef VULKAN_LOAD_FUNCTION
+}
+
+/****************************************************************************
+ * vkGetDeviceProcAddr returns the driver's own entry points, no trampoline in between.
+ */
+uint32_t loadVulkanDeviceFunctions(VkDevice device)
+{
+	uint32_t loadedCount = 0;
+
+#define VULKAN_LOAD_FUNCTION(name) \
+	name = reinterpret_cast<PFN_##name>(vkGetDeviceProcAddr(device, #name)); \
+	checkLoaded(reinterpret_cast<PFN_vkVoidFunction>(name), #name); \
+	loadedCount++;
+	VULKAN_DEVICE_FUNCTIONS(VULKAN_LOAD_FUNCTION)
+#undef VULKAN_LOAD_FUNCTION
+
+	// Null when the extension isn't enabled on the device
+#define VULKAN_LOAD_FUNCTION(name) \
+	name = reinterpret_cast<PFN_##name>(vkGetDeviceProcAddr(device, #name)); \
+	loadedCount += name != nullptr ? 1 : 0;
+	VULKAN_OPTIONAL_DEVICE_FUNCTIONS(VULKAN_LOAD_FUNCTION)
+#undef VULKAN_LOAD_FUNCTION
+
+	return loadedCount;
+}
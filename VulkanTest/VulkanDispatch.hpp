@@ -0,0 +1,193 @@
+#ifndef VULKAN_DISPATCH
+#define VULKAN_DISPATCH
+
+// Every Vulkan function is a pointer declared below instead of the loader's exported prototype,
+// so this header has to be included instead of <vulkan/vulkan.h>
+#ifndef VK_NO_PROTOTYPES
+#define VK_NO_PROTOTYPES
+#endif
+#include <vulkan/vulkan.h>
+
+/****************************************************************************************************
+ * Vulkan function pointers loaded straight from the driver.
+ * - The loader's exported functions are trampolines: each call looks up the dispatch table of its instance or
+ *   device object and jumps to it. Pointers from vkGetDeviceProcAddr go to the driver (or the first enabled layer)
+ *   directly, which adds up over the thousands of vkCmd* calls of a frame.
+ * - The functions keep their usual names, so the code calls them as before. The pointers are global because the
+ *   application has a single device: they are the dispatch table of that device.
+ * - loadVulkanGlobalFunctions() before creating the instance, loadVulkanInstanceFunctions() after it and
+ *   loadVulkanDeviceFunctions() after the device. Functions used before a stage is loaded are null.
+ *
+ * The lists below are the whole dispatch layer: a function is declared, defined and loaded from its list entry.
+ * Core and required extension functions throw when missing, optional extension functions stay null.
+ */
+
+// Only exported function that is still called, everything else comes from it
+extern "C" VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vkGetInstanceProcAddr(VkInstance instance, const char* pName);
+
+#define VULKAN_GLOBAL_FUNCTIONS(X) \
+	X(vkCreateInstance) \
+	X(vkEnumerateInstanceExtensionProperties) \
+	X(vkEnumerateInstanceLayerProperties)
+
+#define VULKAN_INSTANCE_FUNCTIONS(X) \
+	X(vkDestroyInstance) \
+	X(vkEnumeratePhysicalDevices) \
+	X(vkGetPhysicalDeviceFeatures) \
+	X(vkGetPhysicalDeviceFeatures2) \
+	X(vkGetPhysicalDeviceFormatProperties) \
+	X(vkGetPhysicalDeviceImageFormatProperties) \
+	X(vkGetPhysicalDeviceProperties) \
+	X(vkGetPhysicalDeviceProperties2) \
+	X(vkGetPhysicalDeviceQueueFamilyProperties) \
+	X(vkGetPhysicalDeviceMemoryProperties) \
+	X(vkGetPhysicalDeviceMemoryProperties2) \
+	X(vkGetDeviceProcAddr) \
+	X(vkCreateDevice) \
+	X(vkEnumerateDeviceExtensionProperties) \
+	X(vkEnumerateDeviceLayerProperties) \
+	X(vkDestroySurfaceKHR) \
+	X(vkGetPhysicalDeviceSurfaceSupportKHR) \
+	X(vkGetPhysicalDeviceSurfaceCapabilitiesKHR) \
+	X(vkGetPhysicalDeviceSurfaceFormatsKHR) \
+	X(vkGetPhysicalDeviceSurfacePresentModesKHR)
+
+#define VULKAN_OPTIONAL_INSTANCE_FUNCTIONS(X) \
+	X(vkCreateDebugUtilsMessengerEXT) \
+	X(vkDestroyDebugUtilsMessengerEXT) \
+	X(vkCreateHeadlessSurfaceEXT)
+
+#define VULKAN_DEVICE_FUNCTIONS(X) \
+	X(vkDestroyDevice) \
+	X(vkGetDeviceQueue) \
+	X(vkQueueSubmit) \
+	X(vkQueueWaitIdle) \
+	X(vkDeviceWaitIdle) \
+	X(vkAllocateMemory) \
+	X(vkFreeMemory) \
+	X(vkMapMemory) \
+	X(vkUnmapMemory) \
+	X(vkFlushMappedMemoryRanges) \
+	X(vkInvalidateMappedMemoryRanges) \
+	X(vkBindBufferMemory) \
+	X(vkBindImageMemory) \
+	X(vkGetBufferMemoryRequirements) \
+	X(vkGetImageMemoryRequirements) \
+	X(vkCreateFence) \
+	X(vkDestroyFence) \
+	X(vkResetFences) \
+	X(vkGetFenceStatus) \
+	X(vkWaitForFences) \
+	X(vkCreateSemaphore) \
+	X(vkDestroySemaphore) \
+	X(vkCreateEvent) \
+	X(vkDestroyEvent) \
+	X(vkGetEventStatus) \
+	X(vkSetEvent) \
+	X(vkResetEvent) \
+	X(vkCreateQueryPool) \
+	X(vkDestroyQueryPool) \
+	X(vkGetQueryPoolResults) \
+	X(vkCreateBuffer) \
+	X(vkDestroyBuffer) \
+	X(vkCreateBufferView) \
+	X(vkDestroyBufferView) \
+	X(vkCreateImage) \
+	X(vkDestroyImage) \
+	X(vkGetImageSubresourceLayout) \
+	X(vkCreateImageView) \
+	X(vkDestroyImageView) \
+	X(vkCreateShaderModule) \
+	X(vkDestroyShaderModule) \
+	X(vkCreatePipelineCache) \
+	X(vkDestroyPipelineCache) \
+	X(vkGetPipelineCacheData) \
+	X(vkMergePipelineCaches) \
+	X(vkCreateGraphicsPipelines) \
+	X(vkCreateComputePipelines) \
+	X(vkDestroyPipeline) \
+	X(vkCreatePipelineLayout) \
+	X(vkDestroyPipelineLayout) \
+	X(vkCreateSampler) \
+	X(vkDestroySampler) \
+	X(vkCreateDescriptorSetLayout) \
+	X(vkDestroyDescriptorSetLayout) \
+	X(vkCreateDescriptorPool) \
+	X(vkDestroyDescriptorPool) \
+	X(vkResetDescriptorPool) \
+	X(vkAllocateDescriptorSets) \
+	X(vkFreeDescriptorSets) \
+	X(vkUpdateDescriptorSets) \
+	X(vkCreateFramebuffer) \
+	X(vkDestroyFramebuffer) \
+	X(vkCreateRenderPass) \
+	X(vkDestroyRenderPass) \
+	X(vkCreateCommandPool) \
+	X(vkDestroyCommandPool) \
+	X(vkResetCommandPool) \
+	X(vkAllocateCommandBuffers) \
+	X(vkFreeCommandBuffers) \
+	X(vkBeginCommandBuffer) \
+	X(vkEndCommandBuffer) \
+	X(vkResetCommandBuffer) \
+	X(vkCmdBindPipeline) \
+	X(vkCmdSetViewport) \
+	X(vkCmdSetScissor) \
+	X(vkCmdBindDescriptorSets) \
+	X(vkCmdBindIndexBuffer) \
+	X(vkCmdBindVertexBuffers) \
+	X(vkCmdDraw) \
+	X(vkCmdDrawIndexed) \
+	X(vkCmdDrawIndirect) \
+	X(vkCmdDrawIndexedIndirect) \
+	X(vkCmdDispatch) \
+	X(vkCmdDispatchIndirect) \
+	X(vkCmdCopyBuffer) \
+	X(vkCmdCopyImage) \
+	X(vkCmdBlitImage) \
+	X(vkCmdCopyBufferToImage) \
+	X(vkCmdCopyImageToBuffer) \
+	X(vkCmdUpdateBuffer) \
+	X(vkCmdFillBuffer) \
+	X(vkCmdClearColorImage) \
+	X(vkCmdClearDepthStencilImage) \
+	X(vkCmdClearAttachments) \
+	X(vkCmdResolveImage) \
+	X(vkCmdSetEvent) \
+	X(vkCmdResetEvent) \
+	X(vkCmdWaitEvents) \
+	X(vkCmdPipelineBarrier) \
+	X(vkCmdBeginQuery) \
+	X(vkCmdEndQuery) \
+	X(vkCmdResetQueryPool) \
+	X(vkCmdWriteTimestamp) \
+	X(vkCmdCopyQueryPoolResults) \
+	X(vkCmdPushConstants) \
+	X(vkCmdBeginRenderPass) \
+	X(vkCmdNextSubpass) \
+	X(vkCmdEndRenderPass) \
+	X(vkCmdExecuteCommands) \
+	X(vkCreateSwapchainKHR) \
+	X(vkDestroySwapchainKHR) \
+	X(vkGetSwapchainImagesKHR) \
+	X(vkAcquireNextImageKHR) \
+	X(vkQueuePresentKHR)
+
+#define VULKAN_OPTIONAL_DEVICE_FUNCTIONS(X) \
+	X(vkGetSemaphoreCounterValueKHR) \
+	X(vkWaitSemaphoresKHR)
+
+#define VULKAN_DECLARE_FUNCTION(name) extern PFN_##name name;
+VULKAN_GLOBAL_FUNCTIONS(VULKAN_DECLARE_FUNCTION)
+VULKAN_INSTANCE_FUNCTIONS(VULKAN_DECLARE_FUNCTION)
+VULKAN_OPTIONAL_INSTANCE_FUNCTIONS(VULKAN_DECLARE_FUNCTION)
+VULKAN_DEVICE_FUNCTIONS(VULKAN_DECLARE_FUNCTION)
+VULKAN_OPTIONAL_DEVICE_FUNCTIONS(VULKAN_DECLARE_FUNCTION)
+#undef VULKAN_DECLARE_FUNCTION
+
+void loadVulkanGlobalFunctions();
+void loadVulkanInstanceFunctions(VkInstance instance);
+// Returns how many functions were found, for the startup output
+uint32_t loadVulkanDeviceFunctions(VkDevice device);
+
+#endif
@@ -3,12 +3,10 @@
 VkResult CreateDebugUtilsMessengerEXT(VkInstance instance, const VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo,
 	const VkAllocationCallbacks* pAllocator, VkDebugUtilsMessengerEXT* pDebugMessenger)
 {
-	// This function will return nullptr if the function specified couldn't be loaded
-	auto func = (PFN_vkCreateDebugUtilsMessengerEXT)vkGetInstanceProcAddr(instance, "vkCreateDebugUtilsMessengerEXT");
-
-	if (func != nullptr)
+	// Loaded with the instance, nullptr if the extension isn't enabled
+	if (vkCreateDebugUtilsMessengerEXT != nullptr)
 	{
-		return func(instance, pCreateInfo, pAllocator, pDebugMessenger);
+		return vkCreateDebugUtilsMessengerEXT(instance, pCreateInfo, pAllocator, pDebugMessenger);
 	}
 	else
 	{
@@ -18,9 +16,8 @@ VkResult CreateDebugUtilsMessengerEXT(VkInstance instance, const VkDebugUtilsMes
 
 void DestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMessengerEXT debugMessenger, const VkAllocationCallbacks* pAllocator)
 {
-	auto func = (PFN_vkDestroyDebugUtilsMessengerEXT)vkGetInstanceProcAddr(instance, "vkDestroyDebugUtilsMessengerEXT");
-	if (func != nullptr)
+	if (vkDestroyDebugUtilsMessengerEXT != nullptr)
 	{
-		func(instance, debugMessenger, pAllocator);
+		vkDestroyDebugUtilsMessengerEXT(instance, debugMessenger, pAllocator);
 	}
 }
\ No newline at end of file
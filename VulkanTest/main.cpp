@@ -1,18 +1,43 @@
 #include "VulkanApiImplementation.cpp"
 
-int main() 
+/****************************************************************************
+ * VulkanTest [--allocation-check <frames>] [--hidden]
+ * --allocation-check runs that many frames and fails if any of them allocated after the warm-up,
+ * --hidden creates the windows invisible, so a script can run the check without showing anything
+ */
+int main(int argc, char** argv)
 {
+	VulkanApi::Options options;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string argument = argv[i];
+		if (argument == "--allocation-check" && i + 1 < argc)
+		{
+			options.allocationCheckFrames = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+		}
+		else if (argument == "--hidden")
+		{
+			options.hiddenWindows = true;
+		}
+		else
+		{
+			std::cerr << "Usage: VulkanTest [--allocation-check <frames>] [--hidden]" << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
 	VulkanApi graphicsApi;
 
-	try 
+	try
 	{
-		graphicsApi.run();
+		graphicsApi.run(options);
 	}
-	catch (const std::exception& e) 
+	catch (const std::exception& e)
 	{
 		std::cerr << e.what() << std::endl;
 		return EXIT_FAILURE;
 	}
 
 	return EXIT_SUCCESS;
-}
\ No newline at end of file
+}